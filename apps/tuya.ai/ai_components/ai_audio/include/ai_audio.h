@@ -56,6 +56,14 @@ typedef struct {
     AI_AUDIO_STATE_INFORM_CB state_inform_cb;
 } AI_AUDIO_CONFIG_T;
 
+typedef struct {
+    uint32_t turns;         // replies measured
+    uint32_t e2e_last_ms;   // end of speech to the first tts sample on the speaker, last reply
+    uint32_t e2e_avg_ms;
+    uint32_t e2e_max_ms;
+    uint32_t heap_free_min; // lowest free heap seen while the pipeline runs
+} AI_AUDIO_PIPELINE_STATS_T;
+
 /***********************************************************
 ********************function declaration********************
 ***********************************************************/
@@ -101,4 +109,11 @@ OPERATE_RET ai_audio_manual_stop_single_talk(void);
 
 OPERATE_RET ai_audio_set_wakeup(void);
 
-AI_AUDIO_STATE_E ai_audio_get_state(void);
\ No newline at end of file
+AI_AUDIO_STATE_E ai_audio_get_state(void);
+
+/**
+ * @brief Gets the end-to-end latency and memory statistics of the voice pipeline.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK if the operation is successful, otherwise an error code.
+ */
+OPERATE_RET ai_audio_get_pipeline_stats(AI_AUDIO_PIPELINE_STATS_T *stats);
\ No newline at end of file
@@ -0,0 +1,109 @@
+/**
+ * @file ai_audio_aec.h
+ * @brief Provides declarations for the software acoustic echo canceller.
+ *
+ * Boards without a hardware AEC can cancel the echo of the player in software
+ * so the microphone stays usable while audio is playing. The player output is
+ * the far-end reference, the delay between playback and capture is estimated
+ * from the signals. 16 kHz mono 16-bit PCM only.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __AI_AUDIO_AEC_H__
+#define __AI_AUDIO_AEC_H__
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+// only used when the board has no hardware aec (ENABLE_AUDIO_AEC)
+#ifndef AI_AUDIO_SW_AEC
+#define AI_AUDIO_SW_AEC 0
+#endif
+
+// echo tail covered by the adaptive filter, 256 taps is 16ms at 16 kHz
+#ifndef AI_AUDIO_AEC_TAPS
+#define AI_AUDIO_AEC_TAPS 256
+#endif
+
+// upper bound of the playback to capture delay
+#ifndef AI_AUDIO_AEC_MAX_DELAY_MS
+#define AI_AUDIO_AEC_MAX_DELAY_MS 256
+#endif
+
+// each sample adapts one tap in AI_AUDIO_AEC_UPDATE_DIV, 1 adapts them all
+#ifndef AI_AUDIO_AEC_UPDATE_DIV
+#define AI_AUDIO_AEC_UPDATE_DIV 2
+#endif
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    uint32_t frames;        // mic blocks processed
+    uint32_t adapt_frames;  // blocks the filter adapted on
+    uint32_t dt_frames;     // blocks frozen by the double-talk detector
+    uint32_t ref_drop;      // reference samples dropped, the player ran too far ahead
+    uint32_t delay_samples; // estimated playback to capture delay
+    int32_t erle_db_x10;    // smoothed echo return loss enhancement, in 0.1 dB
+} AI_AUDIO_AEC_STATS_T;
+
+/***********************************************************
+********************function declaration********************
+***********************************************************/
+/**
+ * @brief Initializes the software echo canceller.
+ * @param None
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_aec_init(void);
+
+/**
+ * @brief Feeds the PCM handed to the speaker as the far-end reference.
+ * @param pcm The played samples.
+ * @param samples Number of samples.
+ * @return None
+ */
+void ai_audio_aec_ref_write(const int16_t *pcm, uint32_t samples);
+
+/**
+ * @brief Removes the echo of the reference from captured samples, in place.
+ * @param mic The captured samples.
+ * @param samples Number of samples.
+ * @return None
+ */
+void ai_audio_aec_process(int16_t *mic, uint32_t samples);
+
+/**
+ * @brief Runs the echo delay search on the last snapshot of the mic callback,
+ * from the input task.
+ * @param None
+ * @return None
+ */
+void ai_audio_aec_update(void);
+
+/**
+ * @brief Clears the adaptive filter and the delay estimate.
+ * @param None
+ * @return None
+ */
+void ai_audio_aec_reset(void);
+
+/**
+ * @brief Gets the echo canceller statistics.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_aec_get_stats(AI_AUDIO_AEC_STATS_T *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __AI_AUDIO_AEC_H__ */
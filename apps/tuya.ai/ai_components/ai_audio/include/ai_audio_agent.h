@@ -23,6 +23,11 @@ extern "C" {
 /***********************************************************
 ************************macro define************************
 ***********************************************************/
+// uplink audio codec: AUDIO_CODEC_PCM, AUDIO_CODEC_OPUS or AUDIO_CODEC_ADPCM
+#ifndef AI_AGENT_UPLOAD_CODEC
+#define AI_AGENT_UPLOAD_CODEC AUDIO_CODEC_PCM
+#endif
+
 typedef enum {
     AI_AGENT_CHAT_STREAM_START,
     AI_AGENT_CHAT_STREAM_DATA,
@@ -80,6 +85,24 @@ OPERATE_RET ai_audio_agent_upload_start(uint8_t enable_vad);
  */
 OPERATE_RET ai_audio_agent_upload_data(uint8_t *data, uint32_t len);
 
+/**
+ * @brief Selects the codec of uploaded audio, takes effect at the next upload start.
+ *
+ * If the codec has no registered encoder the upload falls back to IMA-ADPCM,
+ * then to PCM. The codec in use is sent in the attributes of every audio packet.
+ *
+ * @param codec_type AUDIO_CODEC_PCM, AUDIO_CODEC_OPUS, AUDIO_CODEC_ADPCM or any registered codec.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_agent_set_upload_codec(AI_AUDIO_CODEC_TYPE codec_type);
+
+/**
+ * @brief Gets the codec of the current TTS stream, as picked by the cloud.
+ * @param None
+ * @return AI_AUDIO_CODEC_TYPE - The codec, AUDIO_CODEC_MP3 when the stream did not name one.
+ */
+AI_AUDIO_CODEC_TYPE ai_audio_agent_get_tts_codec(void);
+
 /**
  * @brief Stops the AI audio upload process.
  * @param None
@@ -21,6 +21,18 @@ extern "C" {
 /***********************************************************
 ************************macro define************************
 ***********************************************************/
+// audio carried by one uplink packet. Every packet pays the protocol head, the
+// encryption and a TLS record once, longer packets trade latency for bandwidth
+#ifndef AI_AUDIO_UPLOAD_PACKET_MS
+#define AI_AUDIO_UPLOAD_PACKET_MS (100)
+#endif
+#define AI_AUDIO_UPLOAD_PACKET_MIN_MS (20)
+#define AI_AUDIO_UPLOAD_PACKET_MAX_MS (200)
+
+// the upload buffer holds AI_AUDIO_UPLOAD_PACKET_MAX_MS of audio
+#if (AI_AUDIO_UPLOAD_PACKET_MS < AI_AUDIO_UPLOAD_PACKET_MIN_MS) || (AI_AUDIO_UPLOAD_PACKET_MS > AI_AUDIO_UPLOAD_PACKET_MAX_MS)
+#error "AI_AUDIO_UPLOAD_PACKET_MS must be within AI_AUDIO_UPLOAD_PACKET_MIN_MS and AI_AUDIO_UPLOAD_PACKET_MAX_MS"
+#endif
 
 typedef enum {
     AI_CLOUD_ASR_STATE_IDLE = 0,
@@ -31,6 +43,11 @@ typedef enum {
 /***********************************************************
 ***********************typedef define***********************
 ***********************************************************/
+typedef struct {
+    uint32_t packets;       // audio packets uploaded
+    uint32_t bytes;         // pcm bytes uploaded, before encoding
+    uint32_t flush_packets; // packets sent short of the packet size at the end of speech
+} AI_CLOUD_ASR_UPLOAD_STATS_T;
 
 /***********************************************************
 ********************function declaration********************
@@ -77,6 +94,21 @@ OPERATE_RET ai_audio_cloud_asr_set_idle(bool is_forced);
  */
 AI_CLOUD_ASR_STATE_E ai_audio_cloud_asr_get_state(void);
 
+/**
+ * @brief Sets how much audio is sent per uplink packet, takes effect at the next packet.
+ * @param latency_ms Audio per packet, AI_AUDIO_UPLOAD_PACKET_MIN_MS to AI_AUDIO_UPLOAD_PACKET_MAX_MS.
+ * @param max_len Upper bound of pcm bytes per packet, 0 for no bound beyond the latency.
+ * @return OPERATE_RET - OPRT_OK if the operation is successful, otherwise an error code.
+ */
+OPERATE_RET ai_audio_cloud_asr_set_packet(uint32_t latency_ms, uint32_t max_len);
+
+/**
+ * @brief Gets the uplink packet statistics.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK if the operation is successful, otherwise an error code.
+ */
+OPERATE_RET ai_audio_cloud_asr_get_upload_stats(AI_CLOUD_ASR_UPLOAD_STATS_T *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,164 @@
+/**
+ * @file ai_audio_decoder.h
+ * @brief Provides declarations for the TTS audio decoder registry.
+ *
+ * The formats the device can play are advertised to the cloud when the AI
+ * session is created, ordered by preference, and the player decodes the TTS
+ * stream with the decoder of the codec the cloud picked. MP3 and raw PCM are
+ * built in; other codecs such as Opus are registered by the application when
+ * the codec library is linked.
+ *
+ * Decoders are preferred by their CPU cost. A decoder is only advertised when
+ * it fits the memory and bandwidth profile of the device.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __AI_AUDIO_DECODER_H__
+#define __AI_AUDIO_DECODER_H__
+
+#include "tuya_cloud_types.h"
+#include "tuya_ai_protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define AI_AUDIO_DECODER_MAX_NUM 4
+
+#define AI_AUDIO_DECODER_SAMPLE_RATE 16000
+
+// samples a decode call may output, an mp3 frame of two granules in stereo
+#define AI_AUDIO_DECODER_PCM_MAX (1152 * 2)
+
+// memory a decoder may use, 0 for no limit
+#ifndef AI_AUDIO_DECODER_MEM_BUDGET
+#define AI_AUDIO_DECODER_MEM_BUDGET 0
+#endif
+
+// downlink bandwidth the tts stream may use, 0 for no limit. The default leaves raw pcm out
+#ifndef AI_AUDIO_DECODER_BANDWIDTH_KBPS
+#define AI_AUDIO_DECODER_BANDWIDTH_KBPS 64
+#endif
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    AI_AUDIO_CODEC_TYPE codec_type;
+    const char *format;    // format name advertised in tts.order.supports, e.g. "mp3"
+    const char *container; // container advertised in tts.order.supports, "" for a raw stream
+    uint32_t cpu_cost;     // relative cost to decode a second of audio, raw pcm is 1
+    uint32_t mem_size;     // decoder state in bytes
+    uint32_t bitrate_kbps; // nominal bitrate of the stream at 16 kHz mono
+    OPERATE_RET (*create)(uint32_t sample_rate, uint8_t channels, void **handle);
+    // decodes at most one frame: consumed bytes of in are used, samples are written to pcm, which holds
+    // AI_AUDIO_DECODER_PCM_MAX samples. Nothing consumed means more input is needed
+    OPERATE_RET (*decode)(void *handle, const uint8_t *in, uint32_t in_len, int16_t *pcm, uint32_t *consumed,
+                          uint32_t *samples);
+    // bitrate from the stream head, 0 if not known yet. Optional, the nominal bitrate is used without it
+    uint32_t (*probe_kbps)(void *handle, const uint8_t *in, uint32_t in_len);
+    // called at the start of every tts stream
+    void (*reset)(void *handle);
+    void (*destroy)(void *handle);
+} AI_AUDIO_DECODER_T;
+
+typedef struct {
+    uint32_t mem_budget;     // bytes, 0 for no limit
+    uint32_t bandwidth_kbps; // 0 for no limit
+} AI_AUDIO_DECODER_PROFILE_T;
+
+typedef struct {
+    uint32_t frames;      // decode calls that produced pcm
+    uint32_t in_bytes;    // coded bytes consumed
+    uint32_t out_samples; // pcm samples produced
+    uint64_t decode_us;   // time spent decoding, on the clock of ai_audio_decoder_set_clock()
+} AI_AUDIO_DECODER_STATS_T;
+
+// a free running microsecond clock, or the cpu time of the calling thread
+typedef uint64_t (*AI_AUDIO_DECODER_CLOCK_CB)(void);
+
+/***********************************************************
+********************function declaration********************
+***********************************************************/
+/**
+ * @brief Registers a TTS audio decoder.
+ * @param decoder Decoder description, must stay valid after registration.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_decoder_register(const AI_AUDIO_DECODER_T *decoder);
+
+/**
+ * @brief Finds the decoder of a codec type.
+ * @param codec_type AI protocol audio codec type.
+ * @return The decoder, or NULL if the codec is not available.
+ */
+const AI_AUDIO_DECODER_T *ai_audio_decoder_find(AI_AUDIO_CODEC_TYPE codec_type);
+
+/**
+ * @brief Sets the memory and bandwidth profile decoders are selected by, takes effect at the next session.
+ * @param profile The device profile.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_decoder_set_profile(const AI_AUDIO_DECODER_PROFILE_T *profile);
+
+/**
+ * @brief Lists the decoders that fit the profile, cheapest first.
+ * @param list Output decoders.
+ * @param num Size of the list.
+ * @return The number of decoders listed.
+ */
+uint32_t ai_audio_decoder_select(const AI_AUDIO_DECODER_T **list, uint32_t num);
+
+/**
+ * @brief Builds the tts.order.supports attribute from the selected decoders.
+ *
+ * MP3 is advertised when no decoder fits the profile, the cloud always needs one format.
+ *
+ * @param buf The output buffer.
+ * @param len Size of the output buffer.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_decoder_get_tts_supports(char *buf, uint32_t len);
+
+/**
+ * @brief Decodes one frame and accounts its cost to the decoder statistics.
+ * @param decoder The decoder.
+ * @param handle Handle created by the decoder.
+ * @param in Coded data.
+ * @param in_len Length of the coded data.
+ * @param pcm Output pcm, holds AI_AUDIO_DECODER_PCM_MAX samples.
+ * @param consumed Output bytes of in used.
+ * @param samples Output samples written to pcm.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_decoder_decode(const AI_AUDIO_DECODER_T *decoder, void *handle, const uint8_t *in,
+                                    uint32_t in_len, int16_t *pcm, uint32_t *consumed, uint32_t *samples);
+
+/**
+ * @brief Sets the clock the decode cost is measured on.
+ *
+ * A frame decodes in well under a millisecond, so without a clock the cost is only counted in the
+ * whole milliseconds of tal_system_get_millisecond() a call happens to cross.
+ *
+ * @param now_us The clock, NULL for the millisecond clock.
+ * @return None
+ */
+void ai_audio_decoder_set_clock(AI_AUDIO_DECODER_CLOCK_CB now_us);
+
+/**
+ * @brief Gets the decode cost statistics of a codec.
+ * @param codec_type AI protocol audio codec type.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_decoder_get_stats(AI_AUDIO_CODEC_TYPE codec_type, AI_AUDIO_DECODER_STATS_T *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __AI_AUDIO_DECODER_H__ */
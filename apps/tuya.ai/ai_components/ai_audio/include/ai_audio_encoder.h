@@ -0,0 +1,70 @@
+/**
+ * @file ai_audio_encoder.h
+ * @brief Provides declarations for the uplink audio encoder registry.
+ *
+ * The AI agent can compress the captured 16-bit PCM before it is sent to the
+ * cloud. Encoders are looked up by their AI protocol codec type. IMA-ADPCM is
+ * built in; other codecs such as Opus are registered by the application when
+ * the codec library is linked.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __AI_AUDIO_ENCODER_H__
+#define __AI_AUDIO_ENCODER_H__
+
+#include "tuya_cloud_types.h"
+#include "tuya_ai_protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define AI_AUDIO_ENCODER_MAX_NUM 4
+
+// IMA-ADPCM block head: int16 predictor (little endian), uint8 step index, uint8 reserved
+#define AI_AUDIO_ADPCM_HEAD_LEN 4
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    AI_AUDIO_CODEC_TYPE codec_type;
+    const char *name;
+    // samples per encode call, the caller only passes whole frames. 0 means any length
+    uint32_t frame_samples;
+    // max encoded length of samples pcm samples
+    uint32_t (*get_max_out_len)(uint32_t samples);
+    OPERATE_RET (*create)(uint32_t sample_rate, uint8_t channels, void **handle);
+    OPERATE_RET (*encode)(void *handle, const int16_t *pcm, uint32_t samples, uint8_t *out, uint32_t out_size,
+                          uint32_t *out_len);
+    // called at the start of every upload stream
+    void (*reset)(void *handle);
+    void (*destroy)(void *handle);
+} AI_AUDIO_ENCODER_T;
+
+/***********************************************************
+********************function declaration********************
+***********************************************************/
+/**
+ * @brief Registers an uplink audio encoder.
+ * @param encoder Encoder description, must stay valid after registration.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_encoder_register(const AI_AUDIO_ENCODER_T *encoder);
+
+/**
+ * @brief Finds the encoder of a codec type.
+ * @param codec_type AI protocol audio codec type.
+ * @return The encoder, or NULL if the codec is not available.
+ */
+const AI_AUDIO_ENCODER_T *ai_audio_encoder_find(AI_AUDIO_CODEC_TYPE codec_type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __AI_AUDIO_ENCODER_H__ */
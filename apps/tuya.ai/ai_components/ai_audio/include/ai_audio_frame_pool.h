@@ -0,0 +1,182 @@
+/**
+ * @file ai_audio_frame_pool.h
+ * @brief Provides declarations for the microphone frame pool.
+ *
+ * Captured audio is published once into a pool of fixed-size frames. Every
+ * consumer keeps its own cursor into the pool, so the frames are shared
+ * instead of being copied into one buffer per consumer. A consumer either
+ * borrows data in place (acquire/release, the frames are reference counted)
+ * or copies it out (read), the latter only when the data it wants wraps
+ * around the end of the pool. Moving a cursor to drop old data is O(1).
+ *
+ * A consumer never lags more than its max lag behind the newest frame: older
+ * frames are overwritten and the consumer is moved forward, which is counted
+ * as an overrun. A frame still borrowed by a consumer is never overwritten,
+ * new data is dropped instead.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __AI_AUDIO_FRAME_POOL_H__
+#define __AI_AUDIO_FRAME_POOL_H__
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define AI_AUDIO_FRAME_POOL_CONSUMER_MAX 4
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef void *AI_AUDIO_FRAME_POOL_T;
+
+typedef struct {
+    uint32_t seq; // sequence number of the first frame, used to release it
+    uint32_t num; // frames borrowed
+    uint8_t *data;
+    uint32_t len;
+} AI_AUDIO_FRAME_T;
+
+typedef struct {
+    uint32_t published;   // frames published
+    uint32_t dropped;     // frames dropped because the slot was still borrowed
+    uint32_t overrun;     // frames skipped by consumers lagging more than their max lag
+    uint32_t copy_bytes;  // bytes copied, publishing included
+    uint32_t borrow_cnt;  // frames handed out without a copy
+} AI_AUDIO_FRAME_POOL_STATS_T;
+
+/***********************************************************
+********************function declaration********************
+***********************************************************/
+/**
+ * @brief Creates a frame pool.
+ * @param frame_size Bytes per frame.
+ * @param frame_num Number of frames, the history kept for consumers.
+ * @param pool Output pool handle.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_frame_pool_create(uint32_t frame_size, uint32_t frame_num, AI_AUDIO_FRAME_POOL_T *pool);
+
+/**
+ * @brief Destroys a frame pool.
+ * @param pool The pool handle.
+ * @return None
+ */
+void ai_audio_frame_pool_destroy(AI_AUDIO_FRAME_POOL_T pool);
+
+/**
+ * @brief Adds a consumer, its cursor starts at the newest frame.
+ * @param pool The pool handle.
+ * @param max_lag Frames the consumer may lag behind, 0 or more than the pool holds means the whole pool.
+ * @param id Output consumer id.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_frame_pool_add_consumer(AI_AUDIO_FRAME_POOL_T pool, uint32_t max_lag, uint8_t *id);
+
+/**
+ * @brief Removes a consumer, frames it still borrows must be released first.
+ * @param pool The pool handle.
+ * @param id The consumer id.
+ * @return None
+ */
+void ai_audio_frame_pool_del_consumer(AI_AUDIO_FRAME_POOL_T pool, uint8_t id);
+
+/**
+ * @brief Publishes captured data, split into frames of the pool frame size.
+ *
+ * A frame becomes visible to the consumers once it is full.
+ *
+ * @param pool The pool handle.
+ * @param data The captured data.
+ * @param len Length of the data.
+ * @return The number of bytes accepted.
+ */
+uint32_t ai_audio_frame_pool_publish(AI_AUDIO_FRAME_POOL_T pool, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Borrows data at the consumer cursor without copying it and moves the cursor past it.
+ *
+ * The data may span several frames and start or end inside a frame. It must be given back with
+ * ai_audio_frame_pool_release(). Nothing is borrowed if the data wraps around the end of the pool,
+ * the consumer reads it with ai_audio_frame_pool_read() instead.
+ *
+ * @param pool The pool handle.
+ * @param id The consumer id.
+ * @param len Bytes to borrow.
+ * @param frame Output frame.
+ * @return OPERATE_RET - OPRT_OK on success, OPRT_RECV_DA_NOT_ENOUGH if less than len is available,
+ *         OPRT_EXCEED_UPPER_LIMIT if the data is not contiguous.
+ */
+OPERATE_RET ai_audio_frame_pool_acquire(AI_AUDIO_FRAME_POOL_T pool, uint8_t id, uint32_t len,
+                                        AI_AUDIO_FRAME_T *frame);
+
+/**
+ * @brief Gives back data borrowed by ai_audio_frame_pool_acquire().
+ * @param pool The pool handle.
+ * @param frame The borrowed frame.
+ * @return None
+ */
+void ai_audio_frame_pool_release(AI_AUDIO_FRAME_POOL_T pool, AI_AUDIO_FRAME_T *frame);
+
+/**
+ * @brief Copies data from the consumer cursor and moves the cursor past it.
+ * @param pool The pool handle.
+ * @param id The consumer id.
+ * @param buf The output buffer.
+ * @param len Size of the output buffer.
+ * @return The number of bytes copied.
+ */
+uint32_t ai_audio_frame_pool_read(AI_AUDIO_FRAME_POOL_T pool, uint8_t id, uint8_t *buf, uint32_t len);
+
+/**
+ * @brief Gets the bytes available to a consumer.
+ * @param pool The pool handle.
+ * @param id The consumer id.
+ * @return The number of bytes available.
+ */
+uint32_t ai_audio_frame_pool_available(AI_AUDIO_FRAME_POOL_T pool, uint8_t id);
+
+/**
+ * @brief Drops the oldest data of a consumer.
+ * @param pool The pool handle.
+ * @param id The consumer id.
+ * @param len Bytes to drop.
+ * @return None
+ */
+void ai_audio_frame_pool_skip(AI_AUDIO_FRAME_POOL_T pool, uint8_t id, uint32_t len);
+
+/**
+ * @brief Drops all but the newest data of a consumer.
+ * @param pool The pool handle.
+ * @param id The consumer id.
+ * @param len Bytes to keep, rounded up to whole frames.
+ * @return None
+ */
+void ai_audio_frame_pool_keep(AI_AUDIO_FRAME_POOL_T pool, uint8_t id, uint32_t len);
+
+/**
+ * @brief Drops the data of all consumers.
+ * @param pool The pool handle.
+ * @return None
+ */
+void ai_audio_frame_pool_reset(AI_AUDIO_FRAME_POOL_T pool);
+
+/**
+ * @brief Gets the pool statistics.
+ * @param pool The pool handle.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_frame_pool_get_stats(AI_AUDIO_FRAME_POOL_T pool, AI_AUDIO_FRAME_POOL_STATS_T *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __AI_AUDIO_FRAME_POOL_H__ */
@@ -14,6 +14,7 @@
 #define __AI_AUDIO_INPUT_H__
 
 #include "tuya_cloud_types.h"
+#include "ai_audio_frame_pool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -81,10 +82,32 @@ OPERATE_RET ai_audio_input_restart_asr_awake_timer(void);
 
 uint32_t ai_audio_get_input_data(uint8_t *buff, uint32_t buff_len);
 
+/**
+ * @brief Borrows uploaded input data in place, see ai_audio_frame_pool_acquire().
+ * @param len Bytes to borrow.
+ * @param frame Output frame, given back with ai_audio_put_input_frame().
+ * @return OPERATE_RET - OPRT_OK on success, or an error code if the data has to be read with ai_audio_get_input_data().
+ */
+OPERATE_RET ai_audio_get_input_frame(uint32_t len, AI_AUDIO_FRAME_T *frame);
+
+/**
+ * @brief Gives back input data borrowed by ai_audio_get_input_frame().
+ * @param frame The borrowed frame.
+ * @return None
+ */
+void ai_audio_put_input_frame(AI_AUDIO_FRAME_T *frame);
+
 uint32_t ai_audio_get_input_data_size(void);
 
 void ai_audio_discard_input_data(uint32_t discard_size);
 
+/**
+ * @brief Gets the statistics of the mic frame pool shared by the input consumers.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_input_get_frame_stats(AI_AUDIO_FRAME_POOL_STATS_T *stats);
+
 #ifdef __cplusplus
 }
 #endif
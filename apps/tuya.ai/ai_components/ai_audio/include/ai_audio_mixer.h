@@ -0,0 +1,56 @@
+/**
+ * @file ai_audio_mixer.h
+ * @brief Provides declarations for the fixed-point 16-bit PCM mixing helpers.
+ *
+ * Gains are Q12 fixed point, AI_AUDIO_GAIN_UNITY is 1.0. Samples are summed in
+ * 32 bits and saturated back to 16 bits, so overlaid streams clip instead of
+ * wrapping around.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __AI_AUDIO_MIXER_H__
+#define __AI_AUDIO_MIXER_H__
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define AI_AUDIO_GAIN_SHIFT 12
+#define AI_AUDIO_GAIN_UNITY (1 << AI_AUDIO_GAIN_SHIFT)
+// keeps the 32-bit sum of two scaled samples from overflowing
+#define AI_AUDIO_GAIN_MAX (4 * AI_AUDIO_GAIN_UNITY)
+
+/***********************************************************
+********************function declaration********************
+***********************************************************/
+/**
+ * @brief Scales PCM samples in place.
+ * @param pcm Pointer to the 16-bit PCM samples.
+ * @param samples Number of samples.
+ * @param gain Q12 gain, AI_AUDIO_GAIN_UNITY leaves the samples untouched.
+ * @return None
+ */
+void ai_audio_mixer_gain(int16_t *pcm, uint32_t samples, uint16_t gain);
+
+/**
+ * @brief Mixes src into dst in place: dst = sat(dst * dst_gain + src * src_gain).
+ * @param dst Pointer to the 16-bit PCM samples mixed into.
+ * @param dst_gain Q12 gain of dst, e.g. a ducking gain.
+ * @param src Pointer to the 16-bit PCM samples to overlay.
+ * @param src_gain Q12 gain of src.
+ * @param samples Number of samples.
+ * @return None
+ */
+void ai_audio_mixer_mix(int16_t *dst, uint16_t dst_gain, const int16_t *src, uint16_t src_gain, uint32_t samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __AI_AUDIO_MIXER_H__ */
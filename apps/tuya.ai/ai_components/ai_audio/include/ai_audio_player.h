@@ -15,6 +15,7 @@
 #define __AI_AUDIO_PLAYER_H__
 
 #include "tuya_cloud_types.h"
+#include "tuya_ai_protocol.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -53,6 +54,36 @@ typedef enum {
     AI_AUDIO_ALERT_FREE_TALK,
 } AI_AUDIO_ALERT_TYPE_E;
 
+/**
+ * Jitter buffer modes: the prebuffer depth follows the measured inter-arrival
+ * jitter of the stream, bounded per mode.
+ */
+typedef enum {
+    AI_AUDIO_PLAYER_JITTER_LOW_LATENCY = 0, // 0 ~ 200ms, 2x jitter
+    AI_AUDIO_PLAYER_JITTER_BALANCED,        // 60 ~ 500ms, 3x jitter
+    AI_AUDIO_PLAYER_JITTER_ROBUST,          // 150 ~ 1000ms, 4x jitter
+    AI_AUDIO_PLAYER_JITTER_MAX,
+} AI_AUDIO_PLAYER_JITTER_MODE_E;
+
+typedef struct {
+    uint32_t underrun_cnt;      // speaker drained before the stream ended, current stream
+    uint32_t jitter_ms;         // smoothed inter-arrival deviation
+    uint32_t target_ms;         // prebuffer depth in use
+    uint32_t depth_ms;          // mp3 data buffered ahead of the decoder
+    uint32_t added_latency_ms;  // time spent prebuffering, current stream
+    uint32_t first_sample_ms;   // from start to the first frame handed to the speaker, current stream
+} AI_AUDIO_PLAYER_STATS_T;
+
+/**
+ * Player streams that can be mixed, in priority order: a higher priority
+ * stream ducks the lower ones while it plays.
+ */
+typedef enum {
+    AI_AUDIO_PLAYER_STREAM_TTS = 0,
+    AI_AUDIO_PLAYER_STREAM_ALERT,
+    AI_AUDIO_PLAYER_STREAM_MAX,
+} AI_AUDIO_PLAYER_STREAM_E;
+
 /***********************************************************
 ********************function declaration********************
 ***********************************************************/
@@ -76,6 +107,17 @@ OPERATE_RET ai_audio_player_init(void);
  */
 OPERATE_RET ai_audio_player_start(char *id);
 
+/**
+ * @brief Starts the audio player for a stream of the given codec.
+ *
+ * @param id          The identifier for the current playback session.
+ *                    If NULL, no specific ID is set.
+ * @param codec_type  AI protocol codec of the stream, decoded by the decoder registered for it.
+ *
+ * @return            Returns OPRT_OK if the player is successfully started.
+ */
+OPERATE_RET ai_audio_player_start_codec(char *id, AI_AUDIO_CODEC_TYPE codec_type);
+
 /**
  * @brief Writes audio data to the ring buffer and sets the end-of-file flag if necessary.
  *
@@ -111,6 +153,57 @@ OPERATE_RET ai_audio_player_play_alert(AI_AUDIO_ALERT_TYPE_E type);
  */
 OPERATE_RET ai_audio_player_play_alert_syn(AI_AUDIO_ALERT_TYPE_E type);
 
+/**
+ * @brief Plays an alert over the stream being played, ducking the stream while the alert lasts.
+ *
+ * The stream keeps decoding, the alert is mixed into its frames. When nothing is playing the alert
+ * is played on its own like ai_audio_player_play_alert().
+ *
+ * @param type The type of alert to play, defined by the AI_AUDIO_ALERT_TYPE_E enum.
+ * @return OPERATE_RET - OPRT_OK if the alert is queued, otherwise an error code.
+ */
+OPERATE_RET ai_audio_player_play_alert_overlay(AI_AUDIO_ALERT_TYPE_E type);
+
+/**
+ * @brief Requests an alert to be decoded into the alert cache.
+ *
+ * The alert is decoded in the background the next time the player is idle, later plays of the
+ * alert skip the mp3 decoder.
+ *
+ * @param type The type of alert to cache, defined by the AI_AUDIO_ALERT_TYPE_E enum.
+ * @return OPERATE_RET - OPRT_OK if the alert is cached or queued, otherwise an error code.
+ */
+OPERATE_RET ai_audio_player_alert_cache_preload(AI_AUDIO_ALERT_TYPE_E type);
+
+/**
+ * @brief Sets the mixing gain of a player stream.
+ * @param stream The stream, a higher value is a higher priority.
+ * @param gain Q12 gain, AI_AUDIO_GAIN_UNITY is 1.0, clamped to AI_AUDIO_GAIN_MAX.
+ * @return OPERATE_RET - OPRT_OK on success, otherwise an error code.
+ */
+OPERATE_RET ai_audio_player_set_mix_gain(AI_AUDIO_PLAYER_STREAM_E stream, uint16_t gain);
+
+/**
+ * @brief Sets how much the tts stream is attenuated while an alert is overlaid.
+ * @param gain Q12 gain applied on top of the stream gain, clamped to AI_AUDIO_GAIN_UNITY.
+ * @return OPERATE_RET - OPRT_OK on success, otherwise an error code.
+ */
+OPERATE_RET ai_audio_player_set_duck_gain(uint16_t gain);
+
+/**
+ * @brief Selects how much the player buffers against network jitter before playing.
+ * @param mode The jitter buffer mode.
+ * @return OPERATE_RET - OPRT_OK on success, otherwise an error code.
+ */
+OPERATE_RET ai_audio_player_set_jitter_mode(AI_AUDIO_PLAYER_JITTER_MODE_E mode);
+
+/**
+ * @brief Gets the jitter buffer statistics of the player.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK on success, otherwise an error code.
+ */
+OPERATE_RET ai_audio_player_get_stats(AI_AUDIO_PLAYER_STATS_T *stats);
+
 /**
  * @brief Checks if the audio player is currently playing audio.
  *
@@ -0,0 +1,150 @@
+/**
+ * @file replay.h
+ * @brief Shared declarations of the offline replay harness of the voice pipeline.
+ *
+ * The harness runs the ai_audio sources on Linux. The os services, the audio
+ * driver, the vad and wakeup engines and the AI cloud are replaced by the
+ * stand-ins declared here, the driver in replay_main.c feeds a wav file to the
+ * mic and reports the latency, cpu and memory of every reply.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <stdio.h>
+
+#include "tuya_cloud_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define REPLAY_SAMPLE_RATE  16000
+#define REPLAY_FRAME_MS     10
+#define REPLAY_FRAME_BYTES  (REPLAY_SAMPLE_RATE / 1000 * REPLAY_FRAME_MS * 2)
+#define REPLAY_THREAD_MAX   16
+#define REPLAY_TURN_MAX     64
+#define REPLAY_NAME_LEN     24
+#define REPLAY_MIN(a, b)    ((a) < (b) ? (a) : (b))
+#define REPLAY_MAX(a, b)    ((a) > (b) ? (a) : (b))
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    const char *in_wav;      // 16 kHz mono s16 speech fed to the mic
+    const char *out_wav;     // pcm handed to the speaker, NULL to drop it
+    const char *reply_file;  // tts the cloud answers with, .mp3 or 16 kHz mono wav
+    const char *far_wav;     // far end of a near/far pair, runs only the aec over the pair, NULL for none
+    const char *arrival_file; // delay in ms of every tts chunk over the sample clock, one per line, NULL for none
+    uint32_t speed;          // 1 is real time, N feeds the mic and paces the speaker and the cloud N times faster
+    uint32_t think_ms;       // cloud time from the end of the upload to the first reply packet
+    uint32_t vad_level;      // rms of a voiced 10 ms frame
+    uint32_t heap_budget;    // heap the pipeline may use, tal_system_get_free_heap_size() is counted against it
+    uint32_t tail_ms;        // silence fed after the file so the last reply can finish
+    uint8_t work_mode;       // AI_AUDIO_WORK_VAD_FREE_TALK or an asr wakeup mode
+    uint16_t upload_codec;   // AUDIO_CODEC_PCM or the codec of a registered uplink encoder
+    uint32_t packet_ms;      // audio per uplink packet of the cloud asr, 0 keeps its default
+    int jitter_mode;         // AI_AUDIO_PLAYER_JITTER_MODE_E, -1 keeps the default of the player
+    bool is_jitter_sweep;    // one run per jitter mode, fails unless the gaps fall as the buffer grows
+    bool is_mix_bench;       // only time the mixer over the input, the pipeline is not started
+    int log_level;           // TAL_LOG_LEVEL_E, -1 mutes the pipeline
+} REPLAY_CFG_T;
+
+typedef struct {
+    SYS_TIME_T speech_end_ms;  // last voiced frame fed to the mic
+    SYS_TIME_T upload_end_ms;  // event end received by the cloud
+    SYS_TIME_T tts_start_ms;   // first tts packet sent by the cloud
+    SYS_TIME_T first_play_ms;  // first tts sample handed to the speaker
+    uint32_t start_react_us;   // vad speech to event start, wall clock
+    uint32_t end_react_us;     // vad silence to event end, wall clock
+    uint32_t upload_bytes;
+    uint32_t upload_pkts;
+    uint32_t upload_jumps;     // pcm uploads that did not follow the previous one in the mic stream
+    uint32_t upload_lost;      // pcm bytes uploaded that the mic never fed
+    uint32_t play_bytes;
+    uint32_t gap_cnt;          // the speaker drained before the reply ended
+    uint32_t gap_us;           // silence of the gaps, in mic audio time
+    bool is_break;             // the reply was cut by a chat break
+} REPLAY_TURN_T;
+
+typedef struct {
+    char name[REPLAY_NAME_LEN];
+    uint64_t cpu_us;
+    bool is_stand_in;          // cost of the harness, not of the pipeline
+    uint32_t wakeups;          // sleeps and blocking waits of a pipeline thread
+} REPLAY_CPU_T;
+
+typedef struct {
+    size_t heap_peak;
+    size_t heap_cur;
+    size_t psram_peak;
+    size_t psram_cur;
+    uint32_t alloc_cnt;
+} REPLAY_MEM_T;
+
+/***********************************************************
+********************function declaration********************
+***********************************************************/
+/* replay_os.c */
+void replay_os_init(uint32_t heap_budget, int log_level);
+
+void replay_os_cpu_add(const char *name, uint64_t cpu_us, bool is_stand_in);
+
+uint32_t replay_os_cpu_get(REPLAY_CPU_T *cpu, uint32_t num);
+
+void replay_os_mem_get(REPLAY_MEM_T *mem);
+
+uint64_t replay_os_thread_cpu_us(void);
+
+void replay_os_sleep_until(uint64_t deadline_us);
+
+uint64_t replay_os_now_us(void);
+
+/* replay_audio.c */
+OPERATE_RET replay_wav_load(const char *path, uint8_t **pcm, uint32_t *len);
+
+OPERATE_RET replay_wav_save(const char *path, const uint8_t *pcm, uint32_t len);
+
+OPERATE_RET replay_audio_init(const REPLAY_CFG_T *cfg);
+
+OPERATE_RET replay_audio_mic_start(void);
+
+bool replay_audio_mic_is_done(void);
+
+void replay_audio_play_arm(REPLAY_TURN_T *turn);
+
+void replay_audio_deinit(void);
+
+SYS_TIME_T replay_audio_last_voice_ms(void);
+
+uint64_t replay_audio_vad_flip_us(void);
+
+uint32_t replay_audio_in_ms(void);
+
+const uint8_t *replay_audio_in_pcm(uint32_t *len);
+
+bool replay_audio_is_voiced(const int16_t *pcm, uint32_t samples, uint32_t level);
+
+/* replay_cloud.c */
+OPERATE_RET replay_cloud_init(const REPLAY_CFG_T *cfg);
+
+void replay_cloud_connect(void);
+
+const uint8_t *replay_cloud_reply_get(uint32_t *len, uint16_t *codec);
+
+uint32_t replay_cloud_turns_get(REPLAY_TURN_T **turns);
+
+bool replay_cloud_is_idle(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __REPLAY_H__ */
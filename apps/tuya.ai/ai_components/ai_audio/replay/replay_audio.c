@@ -0,0 +1,573 @@
+/**
+ * @file replay_audio.c
+ * @brief File-backed stand-ins of the audio driver, the vad and the wakeup
+ * engine used by the replay harness.
+ *
+ * The mic thread hands the input wav to the callback registered with
+ * tdl_audio_open() in 10 ms frames at the sample clock, or N times faster, and
+ * keeps feeding silence once the file ends. tdl_audio_play() writes to the
+ * capture wav and blocks like a dma fed speaker. The vad is an energy gate with
+ * the speech and noise hold times of its config, the wakeup engine reports a
+ * keyword at the start of speech after a pause.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tal_api.h"
+#include "tkl_asr.h"
+#include "tkl_vad.h"
+#include "tdl_audio_manage.h"
+
+#include "replay.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+// data the speaker may hold before tdl_audio_play() blocks, like a dma ring
+#define REPLAY_SPK_QUEUE_MS  40
+#define REPLAY_ASR_UNIT_MS   20
+// silence before a voiced unit that makes it the start of a wakeup word
+#define REPLAY_ASR_GAP_MS    1500
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    const REPLAY_CFG_T *cfg;
+    uint8_t *in_pcm;
+    uint32_t in_len;
+    TDL_AUDIO_MIC_CB mic_cb;
+    pthread_t mic_tid;
+    volatile bool is_mic_done;
+    volatile bool is_mic_stop;
+    volatile SYS_TIME_T last_voice_ms;
+
+    pthread_mutex_t spk_mutex;
+    FILE *out_fp;
+    uint32_t out_len;
+    uint64_t spk_next_us;
+    REPLAY_TURN_T *turn;
+} REPLAY_AUDIO_T;
+
+typedef struct {
+    TKL_VAD_CONFIG_T cfg;
+    volatile bool is_start;
+    volatile TKL_VAD_STATUS_T status;
+    uint32_t voice_ms;
+    uint32_t noise_ms;
+    volatile uint64_t flip_us; // wall clock of the last status change
+} REPLAY_VAD_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static REPLAY_AUDIO_T s_replay_audio = {
+    .spk_mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+static REPLAY_VAD_T s_replay_vad;
+static SYS_TIME_T s_replay_asr_voice_ms;
+static char s_replay_audio_hdl[] = AUDIO_CODEC_NAME;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static void __replay_wav_put_le(uint8_t *p, uint32_t v, uint32_t n)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < n; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint32_t __replay_wav_get_le(const uint8_t *p, uint32_t n)
+{
+    uint32_t i = 0, v = 0;
+
+    for (i = 0; i < n; i++) {
+        v |= (uint32_t)p[i] << (8 * i);
+    }
+    return v;
+}
+
+static void __replay_wav_head_write(FILE *fp, uint32_t data_len)
+{
+    uint8_t head[44] = {0};
+
+    memcpy(head, "RIFF", 4);
+    __replay_wav_put_le(head + 4, 36 + data_len, 4);
+    memcpy(head + 8, "WAVEfmt ", 8);
+    __replay_wav_put_le(head + 16, 16, 4);
+    __replay_wav_put_le(head + 20, 1, 2);
+    __replay_wav_put_le(head + 22, 1, 2);
+    __replay_wav_put_le(head + 24, REPLAY_SAMPLE_RATE, 4);
+    __replay_wav_put_le(head + 28, REPLAY_SAMPLE_RATE * 2, 4);
+    __replay_wav_put_le(head + 32, 2, 2);
+    __replay_wav_put_le(head + 34, 16, 2);
+    memcpy(head + 36, "data", 4);
+    __replay_wav_put_le(head + 40, data_len, 4);
+
+    fseek(fp, 0, SEEK_SET);
+    fwrite(head, 1, sizeof(head), fp);
+}
+
+/**
+ * @brief load the samples of a 16 kHz mono 16 bit pcm wav file
+ *
+ * @param[in] path: file path
+ * @param[out] pcm: samples, released with free()
+ * @param[out] len: length of the samples in bytes
+ *
+ * @return OPRT_OK on success, an error code if the file is not such a wav
+ */
+OPERATE_RET replay_wav_load(const char *path, uint8_t **pcm, uint32_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+    uint8_t riff[12], chunk[8], fmt[16];
+    uint32_t size = 0;
+    bool is_fmt_ok = false;
+
+    if (NULL == fp) {
+        fprintf(stderr, "replay: can not open %s\n", path);
+        return OPRT_FILE_OPEN_FAILED;
+    }
+
+    if (sizeof(riff) != fread(riff, 1, sizeof(riff), fp) || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)) {
+        goto __ERR;
+    }
+
+    while (8 == fread(chunk, 1, 8, fp)) {
+        size = __replay_wav_get_le(chunk + 4, 4);
+        if (!memcmp(chunk, "fmt ", 4) && size >= sizeof(fmt)) {
+            if (sizeof(fmt) != fread(fmt, 1, sizeof(fmt), fp)) {
+                goto __ERR;
+            }
+            fseek(fp, size - sizeof(fmt) + (size & 1), SEEK_CUR);
+            is_fmt_ok = (1 == __replay_wav_get_le(fmt, 2) && 1 == __replay_wav_get_le(fmt + 2, 2) &&
+                         REPLAY_SAMPLE_RATE == __replay_wav_get_le(fmt + 4, 4) && 16 == __replay_wav_get_le(fmt + 14, 2));
+        } else if (!memcmp(chunk, "data", 4) && is_fmt_ok) {
+            *pcm = (uint8_t *)malloc(size ? size : 1);
+            *len = (uint32_t)fread(*pcm, 1, size, fp) & ~1u;
+            fclose(fp);
+            return OPRT_OK;
+        } else {
+            fseek(fp, size + (size & 1), SEEK_CUR);
+        }
+    }
+
+__ERR:
+    fprintf(stderr, "replay: %s is not a 16 kHz mono 16 bit pcm wav\n", path);
+    fclose(fp);
+    return OPRT_INVALID_PARM;
+}
+
+/**
+ * @brief write samples to a 16 kHz mono 16 bit pcm wav file
+ *
+ * @param[in] path: file path
+ * @param[in] pcm: samples
+ * @param[in] len: length of the samples in bytes
+ *
+ * @return OPRT_OK on success, an error code if the file can not be written
+ */
+OPERATE_RET replay_wav_save(const char *path, const uint8_t *pcm, uint32_t len)
+{
+    FILE *fp = fopen(path, "wb");
+    uint32_t written = 0;
+
+    if (NULL == fp) {
+        fprintf(stderr, "replay: can not create %s\n", path);
+        return OPRT_FILE_OPEN_FAILED;
+    }
+
+    __replay_wav_head_write(fp, len);
+    written = (uint32_t)fwrite(pcm, 1, len, fp);
+    fclose(fp);
+
+    return (written == len) ? OPRT_OK : OPRT_FILE_WRITE_FAILED;
+}
+
+/**
+ * @brief check if a frame is speech for the vad and for the harness
+ *
+ * @param[in] pcm: samples
+ * @param[in] samples: number of samples
+ * @param[in] level: rms a voiced frame reaches
+ *
+ * @return true if the rms of the frame reaches the level
+ */
+bool replay_audio_is_voiced(const int16_t *pcm, uint32_t samples, uint32_t level)
+{
+    uint64_t sum = 0;
+    uint32_t i = 0;
+
+    if (0 == samples) {
+        return false;
+    }
+    for (i = 0; i < samples; i++) {
+        sum += (int32_t)pcm[i] * pcm[i];
+    }
+
+    return sum >= (uint64_t)level * level * samples;
+}
+
+static void *__replay_mic_task(void *arg)
+{
+    REPLAY_AUDIO_T *audio = &s_replay_audio;
+    uint8_t silence[REPLAY_FRAME_BYTES] = {0};
+    uint64_t period_us = REPLAY_FRAME_MS * 1000 / audio->cfg->speed;
+    uint64_t next_us = replay_os_now_us();
+    uint64_t cb_us = 0, cpu_us = 0, start_us = 0;
+    uint32_t pos = 0;
+
+    pthread_setname_np(pthread_self(), "replay_mic");
+
+    while (!audio->is_mic_stop) {
+        uint8_t *frame = silence;
+
+        if (pos + REPLAY_FRAME_BYTES <= audio->in_len) {
+            frame = audio->in_pcm + pos;
+            pos += REPLAY_FRAME_BYTES;
+        } else {
+            audio->is_mic_done = true;
+        }
+
+        if (replay_audio_is_voiced((const int16_t *)frame, REPLAY_FRAME_BYTES / 2, audio->cfg->vad_level)) {
+            audio->last_voice_ms = tal_system_get_millisecond();
+        }
+
+        // the driver calls back in its own task, the time spent in the pipeline is its stage
+        start_us = replay_os_thread_cpu_us();
+        if (audio->mic_cb) {
+            audio->mic_cb(TDL_AUDIO_FRAME_FORMAT_PCM, TDL_AUDIO_STATUS_RECEIVING, frame, REPLAY_FRAME_BYTES);
+        }
+        cb_us += replay_os_thread_cpu_us() - start_us;
+
+        next_us += period_us;
+        replay_os_sleep_until(next_us);
+    }
+
+    cpu_us = replay_os_thread_cpu_us();
+    replay_os_cpu_add("mic_cb", cb_us, false);
+    replay_os_cpu_add("replay_mic", cpu_us - cb_us, true);
+
+    return NULL;
+}
+
+OPERATE_RET tdl_audio_find(char *name, TDL_AUDIO_HANDLE_T *handle)
+{
+    if (strcmp(name, s_replay_audio_hdl)) {
+        return OPRT_NOT_FOUND;
+    }
+    *handle = s_replay_audio_hdl;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tdl_audio_open(TDL_AUDIO_HANDLE_T handle, TDL_AUDIO_MIC_CB mic_cb)
+{
+    s_replay_audio.mic_cb = mic_cb;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tdl_audio_play(TDL_AUDIO_HANDLE_T handle, uint8_t *data, uint32_t len)
+{
+    REPLAY_AUDIO_T *audio = &s_replay_audio;
+    uint64_t start_us = replay_os_thread_cpu_us();
+    uint64_t now_us = replay_os_now_us();
+    uint64_t wait_us = 0;
+
+    pthread_mutex_lock(&audio->spk_mutex);
+    // the speaker drained while idle, it starts again from now
+    if (audio->spk_next_us < now_us) {
+        // drained in the middle of a reply, the listener hears a gap
+        if (audio->turn && audio->turn->first_play_ms && audio->spk_next_us) {
+            audio->turn->gap_cnt++;
+            audio->turn->gap_us += (uint32_t)(now_us - audio->spk_next_us) * audio->cfg->speed;
+        }
+        audio->spk_next_us = now_us;
+    }
+    if (audio->turn) {
+        if (0 == audio->turn->first_play_ms) {
+            audio->turn->first_play_ms = now_us / 1000;
+        }
+        audio->turn->play_bytes += len;
+    }
+    if (audio->out_fp) {
+        audio->out_len += (uint32_t)fwrite(data, 1, len, audio->out_fp);
+    }
+    audio->spk_next_us += (uint64_t)len / 2 * 1000000 / REPLAY_SAMPLE_RATE / audio->cfg->speed;
+    wait_us = audio->spk_next_us;
+    pthread_mutex_unlock(&audio->spk_mutex);
+
+    replay_os_cpu_add("replay_speaker", replay_os_thread_cpu_us() - start_us, true);
+
+    if (wait_us > (uint64_t)REPLAY_SPK_QUEUE_MS * 1000 / audio->cfg->speed) {
+        replay_os_sleep_until(wait_us - (uint64_t)REPLAY_SPK_QUEUE_MS * 1000 / audio->cfg->speed);
+    }
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tdl_audio_play_stop(TDL_AUDIO_HANDLE_T handle)
+{
+    pthread_mutex_lock(&s_replay_audio.spk_mutex);
+    s_replay_audio.spk_next_us = 0;
+    pthread_mutex_unlock(&s_replay_audio.spk_mutex);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tdl_audio_volume_set(TDL_AUDIO_HANDLE_T handle, uint8_t volume)
+{
+    return OPRT_OK;
+}
+
+OPERATE_RET tdl_audio_close(TDL_AUDIO_HANDLE_T handle)
+{
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_vad_init(TKL_VAD_CONFIG_T *config)
+{
+    memset(&s_replay_vad, 0, sizeof(s_replay_vad));
+    s_replay_vad.cfg = *config;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_vad_feed(uint8_t *data, uint32_t len)
+{
+    REPLAY_VAD_T *vad = &s_replay_vad;
+    uint32_t frame = vad->cfg.sample_rate / 1000 * vad->cfg.frame_duration_ms * 2;
+    uint32_t pos = 0;
+
+    if (false == vad->is_start || 0 == frame) {
+        return OPRT_OK;
+    }
+
+    for (pos = 0; pos + frame <= len; pos += frame) {
+        if (replay_audio_is_voiced((const int16_t *)(data + pos), frame / 2, s_replay_audio.cfg->vad_level)) {
+            vad->voice_ms += vad->cfg.frame_duration_ms;
+            vad->noise_ms = 0;
+        } else {
+            vad->noise_ms += vad->cfg.frame_duration_ms;
+            if (TKL_VAD_STATUS_NONE == vad->status) {
+                vad->voice_ms = 0;
+            }
+        }
+
+        if (TKL_VAD_STATUS_NONE == vad->status && vad->voice_ms >= (uint32_t)vad->cfg.speech_min_ms) {
+            vad->status = TKL_VAD_STATUS_SPEECH;
+            vad->flip_us = replay_os_now_us();
+        } else if (TKL_VAD_STATUS_SPEECH == vad->status && vad->noise_ms >= (uint32_t)vad->cfg.noise_min_ms) {
+            vad->status = TKL_VAD_STATUS_NONE;
+            vad->voice_ms = 0;
+            vad->flip_us = replay_os_now_us();
+        }
+    }
+
+    return OPRT_OK;
+}
+
+TKL_VAD_STATUS_T tkl_vad_get_status(void)
+{
+    return s_replay_vad.status;
+}
+
+OPERATE_RET tkl_vad_start(void)
+{
+    s_replay_vad.is_start = true;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_vad_stop(void)
+{
+    s_replay_vad.is_start = false;
+    s_replay_vad.status = TKL_VAD_STATUS_NONE;
+    s_replay_vad.voice_ms = 0;
+    s_replay_vad.noise_ms = 0;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_vad_deinit(void)
+{
+    return tkl_vad_stop();
+}
+
+OPERATE_RET tkl_asr_init(void)
+{
+    s_replay_asr_voice_ms = 0;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tkl_asr_wakeup_word_config(TKL_ASR_WAKEUP_WORD_E *wakeup_word_arr, uint8_t arr_cnt)
+{
+    return OPRT_OK;
+}
+
+uint32_t tkl_asr_get_process_uint_size(void)
+{
+    return REPLAY_SAMPLE_RATE / 1000 * REPLAY_ASR_UNIT_MS * 2;
+}
+
+TKL_ASR_WAKEUP_WORD_E tkl_asr_recognize_wakeup_word(uint8_t *data, uint32_t len)
+{
+    SYS_TIME_T now = tal_system_get_millisecond();
+    SYS_TIME_T last = s_replay_asr_voice_ms;
+
+    if (!replay_audio_is_voiced((const int16_t *)data, len / 2, s_replay_audio.cfg->vad_level)) {
+        return TKL_ASR_WAKEUP_WORD_UNKNOWN;
+    }
+    s_replay_asr_voice_ms = now;
+
+    // the input is fed faster than real time, the pause is too
+    if (0 == last || now - last >= REPLAY_ASR_GAP_MS / s_replay_audio.cfg->speed) {
+        return TKL_ASR_WAKEUP_NIHAO_TUYA;
+    }
+
+    return TKL_ASR_WAKEUP_WORD_UNKNOWN;
+}
+
+OPERATE_RET tkl_asr_deinit(void)
+{
+    return OPRT_OK;
+}
+
+/**
+ * @brief load the input and open the capture file
+ *
+ * @param[in] cfg: harness config, kept until replay_audio_deinit()
+ *
+ * @return OPRT_OK on success, an error code on failure
+ */
+OPERATE_RET replay_audio_init(const REPLAY_CFG_T *cfg)
+{
+    OPERATE_RET rt = OPRT_OK;
+    REPLAY_AUDIO_T *audio = &s_replay_audio;
+
+    audio->cfg = cfg;
+    TUYA_CALL_ERR_RETURN(replay_wav_load(cfg->in_wav, &audio->in_pcm, &audio->in_len));
+
+    if (cfg->out_wav) {
+        audio->out_fp = fopen(cfg->out_wav, "wb");
+        if (NULL == audio->out_fp) {
+            fprintf(stderr, "replay: can not create %s\n", cfg->out_wav);
+            return OPRT_FILE_OPEN_FAILED;
+        }
+        __replay_wav_head_write(audio->out_fp, 0);
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief start feeding the input to the mic callback
+ *
+ * @return OPRT_OK on success, an error code on failure
+ */
+OPERATE_RET replay_audio_mic_start(void)
+{
+    if (pthread_create(&s_replay_audio.mic_tid, NULL, __replay_mic_task, NULL)) {
+        return OPRT_OS_ADAPTER_THRD_CREAT_FAILED;
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief check if the whole input was fed
+ *
+ * @return true once the mic feeds silence
+ */
+bool replay_audio_mic_is_done(void)
+{
+    return s_replay_audio.is_mic_done;
+}
+
+/**
+ * @brief get the time of the last voiced frame fed to the mic
+ *
+ * @return the time in ms, 0 if none was fed yet
+ */
+SYS_TIME_T replay_audio_last_voice_ms(void)
+{
+    return s_replay_audio.last_voice_ms;
+}
+
+/**
+ * @brief get the time the vad status last changed, the input task reacts to it
+ *
+ * @return the wall clock in us, 0 if the status never changed
+ */
+uint64_t replay_audio_vad_flip_us(void)
+{
+    return s_replay_vad.flip_us;
+}
+
+/**
+ * @brief get the pcm the mic feeds before it turns to silence
+ *
+ * @param[out] len: length in bytes, whole mic frames
+ *
+ * @return the pcm, valid until replay_audio_deinit()
+ */
+const uint8_t *replay_audio_in_pcm(uint32_t *len)
+{
+    *len = s_replay_audio.in_len / REPLAY_FRAME_BYTES * REPLAY_FRAME_BYTES;
+
+    return s_replay_audio.in_pcm;
+}
+
+/**
+ * @brief get the length of the input
+ *
+ * @return the length in ms
+ */
+uint32_t replay_audio_in_ms(void)
+{
+    return s_replay_audio.in_len / 2 * 1000 / REPLAY_SAMPLE_RATE;
+}
+
+/**
+ * @brief account what the speaker plays from now on to a reply
+ *
+ * @param[in] turn: the reply, NULL to stop accounting
+ */
+void replay_audio_play_arm(REPLAY_TURN_T *turn)
+{
+    pthread_mutex_lock(&s_replay_audio.spk_mutex);
+    s_replay_audio.turn = turn;
+    pthread_mutex_unlock(&s_replay_audio.spk_mutex);
+}
+
+/**
+ * @brief stop the mic and complete the capture file
+ */
+void replay_audio_deinit(void)
+{
+    REPLAY_AUDIO_T *audio = &s_replay_audio;
+
+    audio->is_mic_stop = true;
+    pthread_join(audio->mic_tid, NULL);
+
+    pthread_mutex_lock(&audio->spk_mutex);
+    if (audio->out_fp) {
+        __replay_wav_head_write(audio->out_fp, audio->out_len);
+        fclose(audio->out_fp);
+        audio->out_fp = NULL;
+    }
+    audio->turn = NULL;
+    pthread_mutex_unlock(&audio->spk_mutex);
+
+    free(audio->in_pcm);
+    audio->in_pcm = NULL;
+}
@@ -0,0 +1,643 @@
+/**
+ * @file replay_cloud.c
+ * @brief Stand-in of the AI cloud for the replay harness.
+ *
+ * The biz, event and client calls of tuya_ai_basic the agent makes are served
+ * here instead of going to the cloud. Every uploaded utterance is a turn: once
+ * the event end arrives, the server thread waits the think time and answers
+ * like the cloud does, with the chat start event, the asr and nlg texts and the
+ * tts stream read from the reply file, paced at the sample clock. An arrival
+ * trace delays every chunk over its slot, a late chunk holds back the ones
+ * behind it like a stalled tcp stream. The tal event bus is served here too, so
+ * the harness can raise the mqtt connection.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tal_api.h"
+#include "tuya_iot.h"
+#include "tuya_iot_dp.h"
+
+#include "tuya_ai_biz.h"
+#include "tuya_ai_client.h"
+#include "tuya_ai_event.h"
+#include "tuya_ai_protocol.h"
+
+#include "minimp3.h"
+
+#include "replay.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define REPLAY_EVENT_SUB_MAX  16
+#define REPLAY_TTS_CHUNK_MS   60
+#define REPLAY_AI_ID_US_AUDIO 2
+#define REPLAY_AI_ID_US_TEXT  4
+#define REPLAY_AI_ID_DS_AUDIO 1
+#define REPLAY_ARRIVAL_MAX    4096
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    const char *name;
+    EVENT_SUBSCRIBE_CB cb;
+    SUBSCRIBE_TYPE_E type;
+} REPLAY_EVENT_SUB_T;
+
+typedef struct {
+    const REPLAY_CFG_T *cfg;
+    AI_SESSION_CFG_T session;
+    char session_id[AI_UUID_V4_LEN];
+    uint32_t event_seq;
+
+    uint8_t *reply;
+    uint32_t reply_len;
+    AI_AUDIO_CODEC_TYPE reply_codec;
+    uint32_t *arrival;      // the arrival trace, repeated over every reply
+    uint32_t arrival_num;
+    uint32_t arrival_pos;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t tid;
+    REPLAY_TURN_T turn[REPLAY_TURN_MAX];
+    uint32_t turn_num;
+    uint32_t turn_done;     // turns answered or given up by the server thread
+    bool is_upload;
+    bool is_up_pos;
+    uint32_t up_pos;        // offset in the mic stream the next pcm upload should start at
+    volatile bool is_break;
+    bool is_busy;
+
+    uint64_t recv_us;       // cpu the agent spent in the callbacks of the server thread
+} REPLAY_CLOUD_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static REPLAY_EVENT_SUB_T s_replay_event_sub[REPLAY_EVENT_SUB_MAX];
+static pthread_mutex_t s_replay_event_mutex = PTHREAD_MUTEX_INITIALIZER;
+static REPLAY_CLOUD_T s_replay_cloud = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+OPERATE_RET tal_event_subscribe(const char *name, const char *desc, const EVENT_SUBSCRIBE_CB cb, SUBSCRIBE_TYPE_E type)
+{
+    uint32_t i = 0;
+
+    pthread_mutex_lock(&s_replay_event_mutex);
+    for (i = 0; i < REPLAY_EVENT_SUB_MAX; i++) {
+        if (NULL == s_replay_event_sub[i].cb) {
+            s_replay_event_sub[i].name = name;
+            s_replay_event_sub[i].cb = cb;
+            s_replay_event_sub[i].type = type;
+            pthread_mutex_unlock(&s_replay_event_mutex);
+            return OPRT_OK;
+        }
+    }
+    pthread_mutex_unlock(&s_replay_event_mutex);
+
+    return OPRT_EXCEED_UPPER_LIMIT;
+}
+
+OPERATE_RET tal_event_unsubscribe(const char *name, const char *desc, EVENT_SUBSCRIBE_CB cb)
+{
+    uint32_t i = 0;
+
+    pthread_mutex_lock(&s_replay_event_mutex);
+    for (i = 0; i < REPLAY_EVENT_SUB_MAX; i++) {
+        if (cb == s_replay_event_sub[i].cb && !strcmp(name, s_replay_event_sub[i].name)) {
+            s_replay_event_sub[i].cb = NULL;
+        }
+    }
+    pthread_mutex_unlock(&s_replay_event_mutex);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_event_publish(const char *name, void *data)
+{
+    uint32_t i = 0;
+    EVENT_SUBSCRIBE_CB cb = NULL;
+
+    for (i = 0; i < REPLAY_EVENT_SUB_MAX; i++) {
+        pthread_mutex_lock(&s_replay_event_mutex);
+        cb = s_replay_event_sub[i].cb;
+        if (NULL == cb || strcmp(name, s_replay_event_sub[i].name)) {
+            pthread_mutex_unlock(&s_replay_event_mutex);
+            continue;
+        }
+        if (SUBSCRIBE_TYPE_ONETIME == s_replay_event_sub[i].type) {
+            s_replay_event_sub[i].cb = NULL;
+        }
+        pthread_mutex_unlock(&s_replay_event_mutex);
+
+        // a subscriber may subscribe or publish itself
+        cb(data);
+    }
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_client_init(void)
+{
+    // the client is connected at once, the session is created by the subscribers
+    return tal_event_publish(EVENT_AI_SESSION_NEW, NULL);
+}
+
+OPERATE_RET tuya_ai_biz_crt_session(uint32_t bizCode, AI_SESSION_CFG_T *cfg, uint8_t *attr, uint32_t attr_len,
+                                    AI_SESSION_ID id)
+{
+    memcpy(&s_replay_cloud.session, cfg, sizeof(AI_SESSION_CFG_T));
+    snprintf(s_replay_cloud.session_id, AI_UUID_V4_LEN, "replay-session");
+    snprintf(id, AI_UUID_V4_LEN, "%s", s_replay_cloud.session_id);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_biz_del_session(AI_SESSION_ID id, AI_STATUS_CODE code)
+{
+    memset(&s_replay_cloud.session, 0, sizeof(AI_SESSION_CFG_T));
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_pack_user_attrs(AI_ATTRIBUTE_T *attr, uint32_t attr_num, uint8_t **out, uint32_t *out_len)
+{
+    // nothing is read from the attributes, the caller frees NULL
+    *out = NULL;
+    *out_len = 0;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_event_start(AI_SESSION_ID sid, AI_EVENT_ID eid, uint8_t *attr, uint32_t len)
+{
+    REPLAY_CLOUD_T *cloud = &s_replay_cloud;
+
+    pthread_mutex_lock(&cloud->mutex);
+    if (cloud->turn_num >= REPLAY_TURN_MAX) {
+        pthread_mutex_unlock(&cloud->mutex);
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+    snprintf(eid, AI_UUID_V4_LEN, "replay-event-%04u", (unsigned int)++cloud->event_seq);
+    memset(&cloud->turn[cloud->turn_num], 0, sizeof(REPLAY_TURN_T));
+    cloud->turn[cloud->turn_num].start_react_us = (uint32_t)(replay_os_now_us() - replay_audio_vad_flip_us());
+    cloud->is_upload = true;
+    cloud->is_up_pos = false;
+    pthread_mutex_unlock(&cloud->mutex);
+
+    return OPRT_OK;
+}
+
+// the mic stream is the input in whole frames, then silence
+static bool __replay_cloud_mic_match(uint32_t pos, const uint8_t *data, uint32_t len)
+{
+    uint32_t in_len = 0, n = 0, i = 0;
+    const uint8_t *in = replay_audio_in_pcm(&in_len);
+
+    if (pos < in_len) {
+        n = REPLAY_MIN(len, in_len - pos);
+        if (memcmp(in + pos, data, n)) {
+            return false;
+        }
+    }
+    for (i = n; i < len; i++) {
+        if (data[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// an upload of pcm has to carry on where the previous one of the turn ended
+static void __replay_cloud_upload_check(REPLAY_TURN_T *turn, const uint8_t *data, uint32_t len)
+{
+    REPLAY_CLOUD_T *cloud = &s_replay_cloud;
+    uint32_t in_len = 0;
+    const uint8_t *in = replay_audio_in_pcm(&in_len);
+    const uint8_t *found = NULL;
+
+    if (cloud->is_up_pos && __replay_cloud_mic_match(cloud->up_pos, data, len)) {
+        cloud->up_pos += len;
+        return;
+    }
+
+    found = (const uint8_t *)memmem(in, in_len, data, len);
+    if (found) {
+        cloud->up_pos = (uint32_t)(found - in);
+    } else if (__replay_cloud_mic_match(in_len, data, len)) {
+        cloud->up_pos = in_len;
+    } else {
+        turn->upload_lost += len;
+        cloud->is_up_pos = false;
+        return;
+    }
+    // the first upload of a turn may start anywhere, the pre-roll decides
+    if (cloud->is_up_pos) {
+        turn->upload_jumps++;
+    }
+    cloud->is_up_pos = true;
+    cloud->up_pos += len;
+}
+
+OPERATE_RET tuya_ai_send_biz_pkt(uint16_t id, AI_BIZ_ATTR_INFO_T *attr, AI_PACKET_PT type, AI_BIZ_HEAD_INFO_T *head,
+                                 char *payload)
+{
+    REPLAY_CLOUD_T *cloud = &s_replay_cloud;
+
+    pthread_mutex_lock(&cloud->mutex);
+    if (REPLAY_AI_ID_DS_AUDIO == id && cloud->is_upload) {
+        cloud->turn[cloud->turn_num].upload_bytes += head->len;
+        cloud->turn[cloud->turn_num].upload_pkts++;
+        if (AUDIO_CODEC_PCM == cloud->cfg->upload_codec) {
+            __replay_cloud_upload_check(&cloud->turn[cloud->turn_num], (const uint8_t *)payload, head->len);
+        }
+    }
+    pthread_mutex_unlock(&cloud->mutex);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_biz_send_notify(uint16_t id)
+{
+    AI_BIZ_SEND_DATA_T *send = NULL;
+    AI_BIZ_ATTR_INFO_T attr;
+    AI_BIZ_HEAD_INFO_T head;
+    char *payload = NULL;
+    uint32_t idx = 0;
+
+    for (idx = 0; idx < s_replay_cloud.session.send_num; idx++) {
+        if (s_replay_cloud.session.send[idx].id == id) {
+            send = &s_replay_cloud.session.send[idx];
+            break;
+        }
+    }
+    if ((NULL == send) || (NULL == send->get_cb)) {
+        return OPRT_NOT_FOUND;
+    }
+
+    // the biz thread is not replayed, the channel is drained on the notifying thread
+    while (1) {
+        memset(&attr, 0, sizeof(attr));
+        memset(&head, 0, sizeof(head));
+        if (OPRT_OK != send->get_cb(&attr, &head, &payload)) {
+            break;
+        }
+        tuya_ai_send_biz_pkt(id, &attr, send->type, &head, payload);
+        if (send->free_cb) {
+            send->free_cb(payload);
+        }
+    }
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_event_payloads_end(AI_SESSION_ID sid, AI_EVENT_ID eid, uint8_t *attr, uint32_t len)
+{
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_event_end(AI_SESSION_ID sid, AI_EVENT_ID eid, uint8_t *attr, uint32_t len)
+{
+    REPLAY_CLOUD_T *cloud = &s_replay_cloud;
+    REPLAY_TURN_T *turn = NULL;
+
+    pthread_mutex_lock(&cloud->mutex);
+    if (false == cloud->is_upload) {
+        pthread_mutex_unlock(&cloud->mutex);
+        return OPRT_COM_ERROR;
+    }
+    cloud->is_upload = false;
+
+    turn = &cloud->turn[cloud->turn_num++];
+    turn->upload_end_ms = tal_system_get_millisecond();
+    turn->speech_end_ms = replay_audio_last_voice_ms();
+    turn->end_react_us = (uint32_t)(replay_os_now_us() - replay_audio_vad_flip_us());
+    pthread_cond_signal(&cloud->cond);
+    pthread_mutex_unlock(&cloud->mutex);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_event_chat_break(AI_SESSION_ID sid, AI_EVENT_ID eid, uint8_t *attr, uint32_t len)
+{
+    s_replay_cloud.is_break = true;
+
+    return OPRT_OK;
+}
+
+tuya_iot_client_t *tuya_iot_client_get(void)
+{
+    // no device control skill is replayed
+    return NULL;
+}
+
+int tuya_iot_dp_parse(tuya_iot_client_t *client, dp_cmd_type_t cmd_tp, cJSON *dps)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+static void __replay_cloud_recv(uint16_t id, AI_BIZ_ATTR_INFO_T *attr, AI_STREAM_TYPE stream_flag, char *data,
+                                uint32_t len)
+{
+    REPLAY_CLOUD_T *cloud = &s_replay_cloud;
+    AI_BIZ_HEAD_INFO_T head;
+    uint64_t start_us = replay_os_thread_cpu_us();
+    uint32_t i = 0;
+
+    memset(&head, 0, sizeof(head));
+    head.stream_flag = stream_flag;
+    head.value.audio.timestamp = tal_system_get_millisecond();
+    head.len = len;
+
+    for (i = 0; i < cloud->session.recv_num; i++) {
+        if (id == cloud->session.recv[i].id && cloud->session.recv[i].cb) {
+            cloud->session.recv[i].cb(attr, &head, data, cloud->session.recv[i].usr_data);
+        }
+    }
+
+    cloud->recv_us += replay_os_thread_cpu_us() - start_us;
+}
+
+static void __replay_cloud_event(AI_EVENT_TYPE type, char *event_id)
+{
+    REPLAY_CLOUD_T *cloud = &s_replay_cloud;
+    uint64_t start_us = replay_os_thread_cpu_us();
+
+    if (cloud->session.event_cb) {
+        cloud->session.event_cb(type, cloud->session_id, event_id, NULL, 0);
+    }
+
+    cloud->recv_us += replay_os_thread_cpu_us() - start_us;
+}
+
+static void __replay_cloud_text(const char *biz_type, uint8_t eof, const char *key, const char *text)
+{
+    char json[256];
+
+    snprintf(json, sizeof(json), "{\"bizId\":\"replay\",\"bizType\":\"%s\",\"eof\":%d,\"data\":{\"%s\":\"%s\"}}",
+             biz_type, eof, key, text);
+    __replay_cloud_recv(REPLAY_AI_ID_US_TEXT, NULL, AI_STREAM_ONE, json, strlen(json));
+}
+
+// the length of the next tts chunk and of the audio it holds
+static uint32_t __replay_cloud_tts_chunk(uint32_t pos, uint64_t *dur_us)
+{
+    REPLAY_CLOUD_T *cloud = &s_replay_cloud;
+    mp3dec_t dec;
+    mp3dec_frame_info_t info;
+    uint32_t len = 0;
+    int samples = 0;
+
+    if (AUDIO_CODEC_PCM == cloud->reply_codec) {
+        len = REPLAY_MIN(REPLAY_SAMPLE_RATE / 1000 * REPLAY_TTS_CHUNK_MS * 2, cloud->reply_len - pos);
+        *dur_us = (uint64_t)len / 2 * 1000000 / REPLAY_SAMPLE_RATE;
+        return len;
+    }
+
+    // whole mp3 frames, as many as fit the chunk time
+    *dur_us = 0;
+    mp3dec_init(&dec);
+    while (pos + len < cloud->reply_len && *dur_us < REPLAY_TTS_CHUNK_MS * 1000) {
+        samples = mp3dec_decode_frame(&dec, cloud->reply + pos + len, cloud->reply_len - pos - len, NULL, &info);
+        if (0 == info.frame_bytes) {
+            return cloud->reply_len - pos;
+        }
+        len += info.frame_bytes;
+        if (samples > 0 && info.hz > 0) {
+            *dur_us += (uint64_t)samples * 1000000 / info.hz;
+        }
+    }
+
+    return len;
+}
+
+static void __replay_cloud_reply(REPLAY_TURN_T *turn, uint32_t seq)
+{
+    REPLAY_CLOUD_T *cloud = &s_replay_cloud;
+    uint32_t speed = cloud->cfg->speed;
+    char event_id[AI_UUID_V4_LEN];
+    char text[64];
+    char end = 0;
+    uint32_t pos = 0, len = 0;
+    uint64_t dur_us = 0, send_us = 0, sent_us = 0;
+    uint64_t next_us = replay_os_now_us() + (uint64_t)cloud->cfg->think_ms * 1000 / speed;
+    AI_BIZ_ATTR_INFO_T attr;
+
+    replay_os_sleep_until(next_us);
+
+    snprintf(event_id, sizeof(event_id), "replay-reply-%04u", (unsigned int)seq);
+    snprintf(text, sizeof(text), "replay turn %u", (unsigned int)seq);
+    cloud->is_break = false;
+
+    __replay_cloud_event(AI_EVENT_START, event_id);
+    __replay_cloud_text("ASR", 1, "text", text);
+    __replay_cloud_text("NLG", 0, "content", text);
+    __replay_cloud_text("NLG", 1, "content", "");
+
+    memset(&attr, 0, sizeof(attr));
+    attr.flag = AI_HAS_ATTR;
+    attr.type = AI_PT_AUDIO;
+    attr.value.audio.base.codec_type = cloud->reply_codec;
+    attr.value.audio.base.sample_rate = REPLAY_SAMPLE_RATE;
+    attr.value.audio.base.channels = AUDIO_CHANNELS_MONO;
+    attr.value.audio.base.bit_depth = 16;
+
+    turn->tts_start_ms = tal_system_get_millisecond();
+    replay_audio_play_arm(turn);
+    __replay_cloud_recv(REPLAY_AI_ID_US_AUDIO, &attr, AI_STREAM_START, event_id, strlen(event_id));
+
+    // the cloud streams the tts as it is synthesized, at the sample clock
+    next_us = replay_os_now_us();
+    while (pos < cloud->reply_len && false == cloud->is_break) {
+        len = __replay_cloud_tts_chunk(pos, &dur_us);
+        // a late chunk holds back the ones behind it, they arrive in a burst
+        if (cloud->arrival_num) {
+            send_us = next_us + (uint64_t)cloud->arrival[cloud->arrival_pos++ % cloud->arrival_num] * 1000 / speed;
+            sent_us = REPLAY_MAX(sent_us, send_us);
+            replay_os_sleep_until(sent_us);
+        }
+        __replay_cloud_recv(REPLAY_AI_ID_US_AUDIO, NULL, AI_STREAM_ING, (char *)cloud->reply + pos, len);
+        pos += len;
+        next_us += dur_us / speed;
+        // the stream end follows the last chunk, the cloud does not wait for it to play
+        if (pos < cloud->reply_len) {
+            replay_os_sleep_until(REPLAY_MAX(next_us, sent_us));
+        }
+    }
+    __replay_cloud_recv(REPLAY_AI_ID_US_AUDIO, NULL, AI_STREAM_END, &end, 0);
+
+    __replay_cloud_event(AI_EVENT_END, event_id);
+    turn->is_break = cloud->is_break;
+}
+
+static void *__replay_cloud_task(void *arg)
+{
+    REPLAY_CLOUD_T *cloud = &s_replay_cloud;
+    REPLAY_TURN_T *turn = NULL;
+    uint32_t seq = 0;
+
+    pthread_setname_np(pthread_self(), "replay_cloud");
+
+    for (;;) {
+        pthread_mutex_lock(&cloud->mutex);
+        while (cloud->turn_done == cloud->turn_num) {
+            pthread_cond_wait(&cloud->cond, &cloud->mutex);
+        }
+        seq = cloud->turn_done;
+        turn = &cloud->turn[seq];
+        cloud->is_busy = true;
+        pthread_mutex_unlock(&cloud->mutex);
+
+        __replay_cloud_reply(turn, seq + 1);
+
+        pthread_mutex_lock(&cloud->mutex);
+        cloud->turn_done++;
+        cloud->is_busy = false;
+        pthread_mutex_unlock(&cloud->mutex);
+
+        replay_os_cpu_add("agent_recv", cloud->recv_us, false);
+        cloud->recv_us = 0;
+    }
+
+    return NULL;
+}
+
+static OPERATE_RET __replay_cloud_arrival_load(const char *path)
+{
+    REPLAY_CLOUD_T *cloud = &s_replay_cloud;
+    FILE *fp = fopen(path, "r");
+    char line[32];
+
+    if (NULL == fp) {
+        fprintf(stderr, "replay: can not open %s\n", path);
+        return OPRT_FILE_OPEN_FAILED;
+    }
+
+    cloud->arrival = (uint32_t *)malloc(REPLAY_ARRIVAL_MAX * sizeof(uint32_t));
+    while (cloud->arrival && cloud->arrival_num < REPLAY_ARRIVAL_MAX && fgets(line, sizeof(line), fp)) {
+        if ('#' != line[0] && '\n' != line[0]) {
+            cloud->arrival[cloud->arrival_num++] = (uint32_t)strtoul(line, NULL, 10);
+        }
+    }
+    fclose(fp);
+
+    return cloud->arrival_num ? OPRT_OK : OPRT_INVALID_PARM;
+}
+
+/**
+ * @brief load the reply and start the server thread
+ *
+ * @param[in] cfg: harness config, kept for the life of the harness
+ *
+ * @return OPRT_OK on success, an error code on failure
+ */
+OPERATE_RET replay_cloud_init(const REPLAY_CFG_T *cfg)
+{
+    OPERATE_RET rt = OPRT_OK;
+    REPLAY_CLOUD_T *cloud = &s_replay_cloud;
+    const char *ext = strrchr(cfg->reply_file, '.');
+    FILE *fp = NULL;
+    long size = 0;
+
+    cloud->cfg = cfg;
+
+    if (ext && !strcasecmp(ext, ".mp3")) {
+        fp = fopen(cfg->reply_file, "rb");
+        if (NULL == fp) {
+            fprintf(stderr, "replay: can not open %s\n", cfg->reply_file);
+            return OPRT_FILE_OPEN_FAILED;
+        }
+        fseek(fp, 0, SEEK_END);
+        size = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        cloud->reply = (uint8_t *)malloc(size > 0 ? size : 1);
+        cloud->reply_len = (uint32_t)fread(cloud->reply, 1, size > 0 ? size : 0, fp);
+        fclose(fp);
+        cloud->reply_codec = AUDIO_CODEC_MP3;
+    } else {
+        TUYA_CALL_ERR_RETURN(replay_wav_load(cfg->reply_file, &cloud->reply, &cloud->reply_len));
+        cloud->reply_codec = AUDIO_CODEC_PCM;
+    }
+    if (cfg->arrival_file) {
+        TUYA_CALL_ERR_RETURN(__replay_cloud_arrival_load(cfg->arrival_file));
+    }
+
+    if (pthread_create(&cloud->tid, NULL, __replay_cloud_task, NULL)) {
+        return OPRT_OS_ADAPTER_THRD_CREAT_FAILED;
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief raise the mqtt connection, the agent opens its session on it
+ */
+void replay_cloud_connect(void)
+{
+    tal_event_publish(EVENT_MQTT_CONNECTED, NULL);
+}
+
+/**
+ * @brief get the reply the cloud answers every turn with
+ *
+ * @param[out] len: length in bytes
+ * @param[out] codec: AUDIO_CODEC_MP3 or AUDIO_CODEC_PCM
+ *
+ * @return the coded reply
+ */
+const uint8_t *replay_cloud_reply_get(uint32_t *len, uint16_t *codec)
+{
+    *len = s_replay_cloud.reply_len;
+    *codec = s_replay_cloud.reply_codec;
+
+    return s_replay_cloud.reply;
+}
+
+/**
+ * @brief get the turns uploaded so far
+ *
+ * @param[out] turns: the turn table
+ *
+ * @return the number of turns
+ */
+uint32_t replay_cloud_turns_get(REPLAY_TURN_T **turns)
+{
+    uint32_t num = 0;
+
+    pthread_mutex_lock(&s_replay_cloud.mutex);
+    num = s_replay_cloud.turn_num;
+    *turns = s_replay_cloud.turn;
+    pthread_mutex_unlock(&s_replay_cloud.mutex);
+
+    return num;
+}
+
+/**
+ * @brief check if every uploaded turn was answered
+ *
+ * @return true if no upload or reply is in progress
+ */
+bool replay_cloud_is_idle(void)
+{
+    bool is_idle = false;
+
+    pthread_mutex_lock(&s_replay_cloud.mutex);
+    is_idle = !s_replay_cloud.is_upload && !s_replay_cloud.is_busy &&
+              s_replay_cloud.turn_done == s_replay_cloud.turn_num;
+    pthread_mutex_unlock(&s_replay_cloud.mutex);
+
+    return is_idle;
+}
@@ -0,0 +1,734 @@
+/**
+ * @file replay_main.c
+ * @brief Offline replay harness of the voice pipeline.
+ *
+ * Feeds a recorded utterance wav to the ai_audio pipeline at the mic frame
+ * clock, answers every upload with the reply file through the cloud stand-in
+ * and writes what reaches the speaker to a wav. For every reply it reports the
+ * time from the end of speech to the first tts sample on the speaker, split at
+ * the upload end and the first cloud packet, then the cpu time of every
+ * pipeline thread and the heap and psram peaks.
+ *
+ * With an uplink codec other than pcm, the encoder is first run over the whole
+ * input on its own and its cpu per second of audio and bytes on the wire are
+ * reported, the upload columns of the turns then show the encoded size. The
+ * decoder of the reply format is timed the same way over the reply, and the
+ * decode counters of the registry are reported after the run. With -x
+ * only the mixer of the player runs, over the input in 10 ms frames, and its
+ * cost per ms of audio is reported. With -f the input is the near end of a
+ * recorded near/far pair: only the echo canceller runs, the far end is its
+ * reference, and its echo reduction and cpu per frame are reported, -o then
+ * writes the cancelled near end. With -p the cloud asr sends that much audio
+ * per uplink packet, and its packet count, packet rate and the wire overhead
+ * of the packets are reported.
+ *
+ * -j sweep runs the whole replay once per jitter buffer mode of the player,
+ * each in its own process, from the lowest latency to the most robust. The
+ * harness exits non-zero if the speaker gaps do not fall as the buffer grows.
+ * arrival_wifi.txt next to this file is a trace to run it with:
+ *
+ *   ai_audio_replay -i in.wav -r reply.mp3 -a arrival_wifi.txt -j sweep -q
+ *
+ * usage: ai_audio_replay -i in.wav -r reply.mp3 [-o out.wav] [-s speed] [-t think_ms]
+ *                        [-l vad_level] [-b heap_budget] [-e tail_ms] [-m vad|asr]
+ *                        [-c pcm|adpcm] [-p packet_ms] [-a arrival.txt] [-j low|balanced|robust|sweep]
+ *                        [-f far.wav] [-x] [-v | -q]
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "tal_api.h"
+#include "tal_sw_timer.h"
+
+#include "ai_audio.h"
+#include "ai_audio_aec.h"
+#include "ai_audio_decoder.h"
+#include "ai_audio_encoder.h"
+#include "ai_audio_mixer.h"
+
+#include "replay.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define REPLAY_CPU_MAX     (REPLAY_THREAD_MAX + 8)
+#define REPLAY_POLL_MS     10
+#define REPLAY_MIX_PASSES  20
+#define REPLAY_DEC_PASSES  20
+// the mic frames are copied once into the pool, the consumers borrow them
+#define REPLAY_COPY_PER_BYTE_MAX 1.1
+// a tls 1.2 aes-gcm record: header, explicit nonce and tag
+#define REPLAY_TLS_RECORD_LEN (5 + 8 + 16)
+// what an uplink audio packet adds to its pcm on the wire at SL4
+#define REPLAY_UP_OVERHEAD                                                                                             \
+    (sizeof(AI_PACKET_HEAD_T) + AI_IV_LEN + sizeof(uint32_t) + sizeof(AI_PAYLOAD_HEAD_T) + sizeof(AI_AUDIO_HEAD_T) +   \
+     AI_GCM_TAG_LEN + AI_SIGN_LEN + REPLAY_TLS_RECORD_LEN)
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    int rt;             // exit code of the run
+    uint32_t replies;   // answered turns
+    uint32_t gap_cnt;   // speaker drained in the middle of a reply
+    uint32_t gap_us;    // silence of the gaps, in mic audio time
+    uint32_t play_ms;   // first tts packet to the first sample played, summed over the replies
+} REPLAY_SWEEP_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static REPLAY_CFG_T s_replay_cfg = {
+    .out_wav = NULL,
+    .speed = 1,
+    .think_ms = 600,
+    .vad_level = 500,
+    .heap_budget = 512 * 1024,
+    .tail_ms = 5000,
+    .work_mode = AI_AUDIO_WORK_VAD_FREE_TALK,
+    .upload_codec = AUDIO_CODEC_PCM,
+    .jitter_mode = -1,
+    .log_level = TAL_LOG_LEVEL_ERR,
+};
+static SYS_TIME_T s_replay_start_ms;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static void __replay_usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s -i in.wav -r reply.mp3|reply.wav [options]\n"
+            "  -o out.wav     write the pcm handed to the speaker\n"
+            "  -s speed       run N times faster than real time (default 1)\n"
+            "  -t think_ms    cloud time to the first reply packet (default 600)\n"
+            "  -l vad_level   rms of a voiced frame (default 500)\n"
+            "  -b bytes       heap budget of the pipeline (default 524288)\n"
+            "  -e tail_ms     silence fed after the file (default 5000)\n"
+            "  -m vad|asr     free talk on vad or on the wakeup word (default vad)\n"
+            "  -c pcm|adpcm   uplink codec (default pcm)\n"
+            "  -p packet_ms   audio per uplink packet of the cloud asr, 20 to 200\n"
+            "  -x             only run the mixer over the input and report its cost\n"
+            "  -f far.wav     only run the aec, the input is the near end and far.wav what was played\n"
+            "  -a trace.txt   delay in ms of every tts chunk over the sample clock, one per line\n"
+            "  -j low|balanced|robust  jitter buffer mode of the player\n"
+            "  -j sweep       one run per jitter mode, fails unless the gaps fall as the buffer grows\n"
+            "  -v / -q        pipeline log at debug / muted\n",
+            name);
+}
+
+static int __replay_args_parse(int argc, char **argv, REPLAY_CFG_T *cfg)
+{
+    int opt = 0;
+
+    while ((opt = getopt(argc, argv, "i:o:r:s:t:l:b:e:m:c:p:a:j:f:xvqh")) != -1) {
+        switch (opt) {
+        case 'i':
+            cfg->in_wav = optarg;
+            break;
+        case 'o':
+            cfg->out_wav = optarg;
+            break;
+        case 'r':
+            cfg->reply_file = optarg;
+            break;
+        case 's':
+            cfg->speed = (uint32_t)atoi(optarg);
+            break;
+        case 't':
+            cfg->think_ms = (uint32_t)atoi(optarg);
+            break;
+        case 'l':
+            cfg->vad_level = (uint32_t)atoi(optarg);
+            break;
+        case 'b':
+            cfg->heap_budget = (uint32_t)atoi(optarg);
+            break;
+        case 'e':
+            cfg->tail_ms = (uint32_t)atoi(optarg);
+            break;
+        case 'm':
+            cfg->work_mode = strcmp(optarg, "asr") ? AI_AUDIO_WORK_VAD_FREE_TALK : AI_AUDIO_WORK_ASR_WAKEUP_FREE_TALK;
+            break;
+        case 'c':
+            cfg->upload_codec = strcmp(optarg, "adpcm") ? AUDIO_CODEC_PCM : AUDIO_CODEC_ADPCM;
+            break;
+        case 'p':
+            cfg->packet_ms = (uint32_t)atoi(optarg);
+            break;
+        case 'a':
+            cfg->arrival_file = optarg;
+            break;
+        case 'j':
+            cfg->is_jitter_sweep = !strcmp(optarg, "sweep");
+            cfg->jitter_mode = !strcmp(optarg, "low")        ? AI_AUDIO_PLAYER_JITTER_LOW_LATENCY
+                               : !strcmp(optarg, "balanced") ? AI_AUDIO_PLAYER_JITTER_BALANCED
+                                                             : AI_AUDIO_PLAYER_JITTER_ROBUST;
+            break;
+        case 'f':
+            cfg->far_wav = optarg;
+            break;
+        case 'x':
+            cfg->is_mix_bench = true;
+            break;
+        case 'v':
+            cfg->log_level = TAL_LOG_LEVEL_DEBUG;
+            break;
+        case 'q':
+            cfg->log_level = -1;
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    // the benches do not answer, they need no reply
+    if (NULL == cfg->in_wav || 0 == cfg->speed ||
+        (NULL == cfg->reply_file && !cfg->is_mix_bench && NULL == cfg->far_wav)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+// mic time of a wall clock span, the pipeline runs speed times faster than the wav
+static uint32_t __replay_span_ms(SYS_TIME_T from, SYS_TIME_T to)
+{
+    return (uint32_t)((to - from) * s_replay_cfg.speed);
+}
+
+// position in the input of a wall clock stamp
+static uint32_t __replay_pos_ms(SYS_TIME_T ms)
+{
+    return __replay_span_ms(s_replay_start_ms, ms);
+}
+
+static void __replay_evt_inform(AI_AUDIO_EVENT_E event, uint8_t *data, uint32_t len, void *arg)
+{
+    if (AI_AUDIO_EVT_ASR_WAKEUP == event) {
+        fprintf(stdout, "[%8u ms] wakeup\n", __replay_pos_ms(tal_system_get_millisecond()));
+    }
+}
+
+static void __replay_state_inform(AI_AUDIO_STATE_E state)
+{
+    static const char *name[] = {"standby", "listen", "upload", "ai speak"};
+
+    if (state < CNTSOF(name)) {
+        fprintf(stdout, "[%8u ms] state %s\n", __replay_pos_ms(tal_system_get_millisecond()), name[state]);
+    }
+}
+
+// cpu and output of the uplink encoder over the input, fed in mic frames as the agent does
+static OPERATE_RET __replay_encoder_bench(const char *in_wav, AI_AUDIO_CODEC_TYPE codec)
+{
+    OPERATE_RET rt = OPRT_OK;
+    const AI_AUDIO_ENCODER_T *enc = ai_audio_encoder_find(codec);
+    uint8_t *pcm = NULL, *out = NULL;
+    uint32_t len = 0, pos = 0, frame = 0, out_len = 0, out_bytes = 0;
+    uint64_t start_us = 0, cpu_us = 0;
+    void *hdl = NULL;
+
+    if (NULL == enc) {
+        fprintf(stderr, "replay: no encoder of codec %u\n", codec);
+        return OPRT_NOT_SUPPORTED;
+    }
+    TUYA_CALL_ERR_RETURN(replay_wav_load(in_wav, &pcm, &len));
+    frame = enc->frame_samples ? enc->frame_samples : REPLAY_FRAME_BYTES / 2;
+    out = (uint8_t *)malloc(enc->get_max_out_len(frame));
+    TUYA_CALL_ERR_GOTO(enc->create(REPLAY_SAMPLE_RATE, AUDIO_CHANNELS_MONO, &hdl), __EXIT);
+
+    start_us = replay_os_thread_cpu_us();
+    for (pos = 0; pos + frame * 2 <= len; pos += frame * 2) {
+        TUYA_CALL_ERR_GOTO(enc->encode(hdl, (int16_t *)(pcm + pos), frame, out, enc->get_max_out_len(frame), &out_len),
+                           __EXIT);
+        out_bytes += out_len;
+    }
+    cpu_us = replay_os_thread_cpu_us() - start_us;
+
+    fprintf(stdout, "uplink %s: %.0f us cpu and %.0f bytes per second of audio, %.1f%% of pcm\n", enc->name,
+            pos ? cpu_us * (REPLAY_SAMPLE_RATE * 2.0) / pos : 0, pos ? out_bytes * (REPLAY_SAMPLE_RATE * 2.0) / pos : 0,
+            pos ? out_bytes * 100.0 / pos : 0);
+
+__EXIT:
+    if (hdl) {
+        enc->destroy(hdl);
+    }
+    free(out);
+    free(pcm);
+    return rt;
+}
+
+// the reply decoded on its own, the state the decoder allocates is its memory cost
+static OPERATE_RET __replay_decoder_bench(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint16_t codec = 0;
+    uint32_t len = 0, pos = 0, pass = 0, consumed = 0, samples = 0, out_samples = 0;
+    const uint8_t *reply = replay_cloud_reply_get(&len, &codec);
+    const AI_AUDIO_DECODER_T *dec = ai_audio_decoder_find(codec);
+    int16_t *pcm = NULL;
+    void *hdl = NULL;
+    uint64_t start_us = 0, cpu_us = 0;
+    REPLAY_MEM_T mem_before, mem_after;
+
+    if (NULL == dec) {
+        fprintf(stderr, "replay: no decoder of codec %u\n", codec);
+        return OPRT_NOT_SUPPORTED;
+    }
+    pcm = (int16_t *)malloc(AI_AUDIO_DECODER_PCM_MAX * sizeof(int16_t));
+    TUYA_CHECK_NULL_RETURN(pcm, OPRT_MALLOC_FAILED);
+
+    replay_os_mem_get(&mem_before);
+    TUYA_CALL_ERR_GOTO(dec->create(REPLAY_SAMPLE_RATE, AUDIO_CHANNELS_MONO, &hdl), __EXIT);
+    replay_os_mem_get(&mem_after);
+
+    start_us = replay_os_thread_cpu_us();
+    for (pass = 0; pass < REPLAY_DEC_PASSES; pass++) {
+        if (dec->reset) {
+            dec->reset(hdl);
+        }
+        for (pos = 0; pos < len; pos += consumed) {
+            TUYA_CALL_ERR_GOTO(dec->decode(hdl, reply + pos, len - pos, pcm, &consumed, &samples), __EXIT);
+            if (0 == consumed) {
+                break;
+            }
+            out_samples += samples;
+        }
+    }
+    cpu_us = replay_os_thread_cpu_us() - start_us;
+
+    fprintf(stdout, "tts %s: %.0f us cpu and %.0f bytes per second of audio, %zu bytes of decoder state\n",
+            dec->format, out_samples ? cpu_us * (double)REPLAY_SAMPLE_RATE / out_samples : 0,
+            out_samples ? (double)len * REPLAY_DEC_PASSES * REPLAY_SAMPLE_RATE / out_samples : 0,
+            (mem_after.heap_cur + mem_after.psram_cur) - (mem_before.heap_cur + mem_before.psram_cur));
+
+__EXIT:
+    if (hdl) {
+        dec->destroy(hdl);
+    }
+    free(pcm);
+    return rt;
+}
+
+// the input mixed with itself half a file later, like an alert over the tts
+static OPERATE_RET __replay_mixer_bench(const char *in_wav)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint8_t *pcm = NULL, *dst = NULL;
+    uint32_t len = 0, samples = 0, pos = 0, pass = 0, frame = REPLAY_FRAME_BYTES / 2;
+    uint64_t start_us = 0, duck_us = 0, unity_us = 0, gain_us = 0;
+    double audio_ms = 0;
+
+    TUYA_CALL_ERR_RETURN(replay_wav_load(in_wav, &pcm, &len));
+    samples = len / 2;
+    dst = (uint8_t *)malloc(len ? len : 1);
+    if (NULL == dst || samples < frame * 2) {
+        rt = OPRT_INVALID_PARM;
+        goto __EXIT;
+    }
+
+    for (pass = 0; pass < REPLAY_MIX_PASSES; pass++) {
+        memcpy(dst, pcm, len);
+        start_us = replay_os_thread_cpu_us();
+        for (pos = 0; pos + frame <= samples / 2; pos += frame) {
+            ai_audio_mixer_mix((int16_t *)dst + pos, AI_AUDIO_GAIN_UNITY / 4, (int16_t *)pcm + samples / 2 + pos,
+                               AI_AUDIO_GAIN_UNITY, frame);
+        }
+        duck_us += replay_os_thread_cpu_us() - start_us;
+
+        memcpy(dst, pcm, len);
+        start_us = replay_os_thread_cpu_us();
+        for (pos = 0; pos + frame <= samples / 2; pos += frame) {
+            ai_audio_mixer_mix((int16_t *)dst + pos, AI_AUDIO_GAIN_UNITY, (int16_t *)pcm + samples / 2 + pos,
+                               AI_AUDIO_GAIN_UNITY, frame);
+        }
+        unity_us += replay_os_thread_cpu_us() - start_us;
+
+        memcpy(dst, pcm, len);
+        start_us = replay_os_thread_cpu_us();
+        for (pos = 0; pos + frame <= samples / 2; pos += frame) {
+            ai_audio_mixer_gain((int16_t *)dst + pos, frame, AI_AUDIO_GAIN_UNITY / 2);
+        }
+        gain_us += replay_os_thread_cpu_us() - start_us;
+    }
+
+    audio_ms = (double)pos * REPLAY_MIX_PASSES * 1000 / REPLAY_SAMPLE_RATE;
+    fprintf(stdout, "mixer over %.0f ms of audio: ducked mix %.1f ns, unity mix %.1f ns, gain %.1f ns per ms\n",
+            audio_ms, duck_us * 1000.0 / audio_ms, unity_us * 1000.0 / audio_ms, gain_us * 1000.0 / audio_ms);
+
+__EXIT:
+    free(dst);
+    free(pcm);
+    return rt;
+}
+
+// the near end in mic frames through the aec, the far end fed to the reference as the player does
+static OPERATE_RET __replay_aec_bench(const char *near_wav, const char *far_wav, const char *out_wav)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint8_t *near = NULL, *far = NULL;
+    uint32_t near_len = 0, far_len = 0, len = 0, pos = 0, frames = 0, far_frames = 0;
+    uint64_t start_us = 0, cb_us = 0, cb_max_us = 0, task_us = 0, frame_us = 0;
+    uint64_t in_energy = 0, out_energy = 0;
+    int16_t *pcm = NULL;
+    uint32_t i = 0;
+    bool is_far = false;
+    AI_AUDIO_AEC_STATS_T stats;
+
+    TUYA_CALL_ERR_RETURN(replay_wav_load(near_wav, &near, &near_len));
+    TUYA_CALL_ERR_GOTO(replay_wav_load(far_wav, &far, &far_len), __EXIT);
+    TUYA_CALL_ERR_GOTO(ai_audio_aec_init(), __EXIT);
+
+    len = REPLAY_MIN(near_len, far_len) / REPLAY_FRAME_BYTES * REPLAY_FRAME_BYTES;
+    for (pos = 0; pos < len; pos += REPLAY_FRAME_BYTES) {
+        pcm = (int16_t *)(near + pos);
+        // echo reduction counts only frames the far end plays in
+        is_far = replay_audio_is_voiced((const int16_t *)(far + pos), REPLAY_FRAME_BYTES / 2, s_replay_cfg.vad_level);
+        if (is_far) {
+            for (i = 0; i < REPLAY_FRAME_BYTES / 2; i++) {
+                in_energy += (int32_t)pcm[i] * pcm[i];
+            }
+            far_frames++;
+        }
+
+        ai_audio_aec_ref_write((const int16_t *)(far + pos), REPLAY_FRAME_BYTES / 2);
+
+        // the mic callback cancels the echo in place, the input task runs the delay search
+        start_us = replay_os_thread_cpu_us();
+        ai_audio_aec_process(pcm, REPLAY_FRAME_BYTES / 2);
+        frame_us = replay_os_thread_cpu_us() - start_us;
+        cb_us += frame_us;
+        cb_max_us = REPLAY_MAX(cb_max_us, frame_us);
+
+        start_us = replay_os_thread_cpu_us();
+        ai_audio_aec_update();
+        task_us += replay_os_thread_cpu_us() - start_us;
+
+        if (is_far) {
+            for (i = 0; i < REPLAY_FRAME_BYTES / 2; i++) {
+                out_energy += (int32_t)pcm[i] * pcm[i];
+            }
+        }
+        frames++;
+    }
+
+    TUYA_CALL_ERR_GOTO(ai_audio_aec_get_stats(&stats), __EXIT);
+    fprintf(stdout,
+            "aec over %.1f s: %.1f us per %u ms frame in the mic callback (max %llu), %.1f us per frame in the task\n",
+            frames * REPLAY_FRAME_MS / 1000.0, frames ? (double)cb_us / frames : 0, REPLAY_FRAME_MS,
+            (unsigned long long)cb_max_us, frames ? (double)task_us / frames : 0);
+    fprintf(stdout,
+            "aec erle %.1f dB, %.1f dB less energy over %u far end frames, delay %u samples, %u adapted, "
+            "%u double talk, %u reference samples dropped\n",
+            stats.erle_db_x10 / 10.0, out_energy ? 10 * log10((double)in_energy / out_energy) : 0, far_frames,
+            stats.delay_samples, stats.adapt_frames, stats.dt_frames, stats.ref_drop);
+
+    if (out_wav) {
+        rt = replay_wav_save(out_wav, near, len);
+    }
+
+__EXIT:
+    free(far);
+    free(near);
+    return rt;
+}
+
+static int __replay_report(void)
+{
+    REPLAY_TURN_T *turn = NULL;
+    REPLAY_CPU_T cpu[REPLAY_CPU_MAX];
+    REPLAY_MEM_T mem;
+    AI_AUDIO_PIPELINE_STATS_T stats;
+    uint32_t turn_num = replay_cloud_turns_get(&turn);
+    uint32_t cpu_num = replay_os_cpu_get(cpu, REPLAY_CPU_MAX);
+    uint32_t e2e = 0, e2e_min = UINT32_MAX, e2e_max = 0, e2e_sum = 0, answered = 0;
+    uint64_t react_sum = 0;
+    uint32_t up_bytes = 0, up_jumps = 0, up_lost = 0;
+    AI_AUDIO_FRAME_POOL_STATS_T frames;
+    double copy_per_byte = 0;
+    bool is_frames_ok = true;
+    AI_AUDIO_DECODER_STATS_T dec_stats;
+    AI_CLOUD_ASR_UPLOAD_STATS_T up_stats;
+    AI_AUDIO_AEC_STATS_T aec_stats;
+    double up_sec = 0;
+    uint32_t reply_len = 0;
+    uint16_t reply_codec = 0;
+    uint32_t react_max = 0;
+    uint64_t pipe_us = 0, stand_in_us = 0;
+    uint32_t run_ms = __replay_pos_ms(tal_system_get_millisecond());
+    uint32_t i = 0;
+
+    fprintf(stdout, "\nturn  speech_end  e2e_ms  upload_ms  cloud_ms  play_ms  up_kB  pkts  gaps  gap_ms\n");
+    for (i = 0; i < turn_num; i++) {
+        if (0 == turn[i].first_play_ms) {
+            fprintf(stdout, "%4u  %10u  no reply\n", i + 1, __replay_pos_ms(turn[i].speech_end_ms));
+            continue;
+        }
+        e2e = __replay_span_ms(turn[i].speech_end_ms, turn[i].first_play_ms);
+        e2e_min = REPLAY_MIN(e2e_min, e2e);
+        e2e_max = e2e > e2e_max ? e2e : e2e_max;
+        e2e_sum += e2e;
+        answered++;
+        fprintf(stdout, "%4u  %10u  %6u  %9u  %8u  %7u  %5u  %4u  %4u  %6.1f%s\n", i + 1,
+                __replay_pos_ms(turn[i].speech_end_ms), e2e,
+                __replay_span_ms(turn[i].speech_end_ms, turn[i].upload_end_ms),
+                __replay_span_ms(turn[i].upload_end_ms, turn[i].tts_start_ms),
+                __replay_span_ms(turn[i].tts_start_ms, turn[i].first_play_ms), turn[i].upload_bytes / 1024,
+                turn[i].upload_pkts, turn[i].gap_cnt, turn[i].gap_us / 1000.0, turn[i].is_break ? "  break" : "");
+    }
+    if (answered) {
+        fprintf(stdout, "e2e ms: min %u avg %u max %u over %u replies\n", e2e_min, e2e_sum / answered, e2e_max,
+                answered);
+    }
+
+    // the input task acts on a vad change, the cloud sees it as the event start and end
+    if (turn_num && AI_AUDIO_WORK_VAD_FREE_TALK == s_replay_cfg.work_mode) {
+        for (i = 0; i < turn_num; i++) {
+            react_sum += turn[i].start_react_us + turn[i].end_react_us;
+            react_max = REPLAY_MAX(react_max, REPLAY_MAX(turn[i].start_react_us, turn[i].end_react_us));
+        }
+        fprintf(stdout, "vad to event us: avg %llu max %u over %u changes\n",
+                (unsigned long long)(react_sum / (turn_num * 2)), react_max, turn_num * 2);
+    }
+
+    // every pcm upload is looked up in the mic stream, a drop shows as a jump
+    if (turn_num && AUDIO_CODEC_PCM == s_replay_cfg.upload_codec) {
+        for (i = 0; i < turn_num; i++) {
+            up_bytes += turn[i].upload_bytes;
+            up_jumps += turn[i].upload_jumps;
+            up_lost += turn[i].upload_lost;
+        }
+        fprintf(stdout, "upload check: %u kB, %u jumps in the mic stream, %u bytes not from the mic\n",
+                up_bytes / 1024, up_jumps, up_lost);
+    }
+    // packets per second of uploaded audio, the overhead is counted against the pcm
+    if (OPRT_OK == ai_audio_cloud_asr_get_upload_stats(&up_stats) && up_stats.packets) {
+        up_sec = up_stats.bytes / (REPLAY_SAMPLE_RATE * 2.0);
+        fprintf(stdout,
+                "uplink packets: %u (%u short), %u bytes avg, %.1f packets/s, %u bytes overhead (%zu per packet), "
+                "%.1f%% of the pcm\n",
+                up_stats.packets, up_stats.flush_packets, up_stats.bytes / up_stats.packets,
+                up_sec > 0 ? up_stats.packets / up_sec : 0, (uint32_t)(up_stats.packets * REPLAY_UP_OVERHEAD),
+                REPLAY_UP_OVERHEAD, up_stats.packets * REPLAY_UP_OVERHEAD * 100.0 / up_stats.bytes);
+    }
+    replay_cloud_reply_get(&reply_len, &reply_codec);
+    if (OPRT_OK == ai_audio_decoder_get_stats(reply_codec, &dec_stats)) {
+        fprintf(stdout, "tts decoded: %u frames, %u kB in, %.1f s of audio in %.2f ms cpu, %.0f us per frame\n",
+                dec_stats.frames, dec_stats.in_bytes / 1024, dec_stats.out_samples / (double)REPLAY_SAMPLE_RATE,
+                dec_stats.decode_us / 1000.0, dec_stats.frames ? (double)dec_stats.decode_us / dec_stats.frames : 0);
+    }
+    // only a build with the software aec has one
+    if (OPRT_OK == ai_audio_aec_get_stats(&aec_stats)) {
+        fprintf(stdout, "aec: %u frames, %u adapted, %u double talk, erle %.1f dB, delay %u samples\n",
+                aec_stats.frames, aec_stats.adapt_frames, aec_stats.dt_frames, aec_stats.erle_db_x10 / 10.0,
+                aec_stats.delay_samples);
+    }
+    if (OPRT_OK == ai_audio_input_get_frame_stats(&frames)) {
+        copy_per_byte = frames.published ? (double)frames.copy_bytes / frames.published / AI_AUDIO_PCM_FRAME_SIZE : 0;
+        fprintf(stdout, "mic frames: %u published, %u dropped, %u overrun, %u borrowed, %.2f bytes copied per byte\n",
+                frames.published, frames.dropped, frames.overrun, frames.borrow_cnt, copy_per_byte);
+        if (frames.dropped || copy_per_byte > REPLAY_COPY_PER_BYTE_MAX) {
+            fprintf(stdout, "FAIL: mic frames dropped or copied more than %.1f times\n", REPLAY_COPY_PER_BYTE_MAX);
+            is_frames_ok = false;
+        }
+    }
+
+    if (OPRT_OK == ai_audio_get_pipeline_stats(&stats)) {
+        fprintf(stdout, "pipeline stats: %u turns, e2e avg %u max %u ms (wall clock), heap free min %u\n", stats.turns,
+                stats.e2e_avg_ms, stats.e2e_max_ms, stats.heap_free_min);
+    }
+
+    fprintf(stdout, "\ncpu over %u ms of mic audio\n", run_ms);
+    for (i = 0; i < cpu_num; i++) {
+        fprintf(stdout, "  %-20s %8llu us  %5.2f%%", cpu[i].name, (unsigned long long)cpu[i].cpu_us,
+                run_ms ? cpu[i].cpu_us / 10.0 / run_ms : 0);
+        // per second of mic audio, the callbacks and the stand-ins are not counted
+        if (cpu[i].wakeups) {
+            fprintf(stdout, "  %6.1f wakeups/s", cpu[i].wakeups * 1000.0 / run_ms);
+        }
+        fprintf(stdout, "%s\n", cpu[i].is_stand_in ? "  (stand-in)" : "");
+        if (cpu[i].is_stand_in) {
+            stand_in_us += cpu[i].cpu_us;
+        } else {
+            pipe_us += cpu[i].cpu_us;
+        }
+    }
+    fprintf(stdout, "  %-20s %8llu us  %5.2f%% of one core\n", "pipeline", (unsigned long long)pipe_us,
+            run_ms ? pipe_us / 10.0 / run_ms : 0);
+    fprintf(stdout, "  %-20s %8llu us\n", "stand-ins", (unsigned long long)stand_in_us);
+
+    replay_os_mem_get(&mem);
+    fprintf(stdout, "\nheap peak %zu (now %zu), psram peak %zu (now %zu), %u allocs\n", mem.heap_peak, mem.heap_cur,
+            mem.psram_peak, mem.psram_cur, mem.alloc_cnt);
+
+    return (turn_num && answered == turn_num && is_frames_ok) ? 0 : 1;
+}
+
+// the gaps of all the replies of a run
+static void __replay_sweep_fill(REPLAY_SWEEP_T *sweep)
+{
+    REPLAY_TURN_T *turn = NULL;
+    uint32_t turn_num = replay_cloud_turns_get(&turn);
+    uint32_t i = 0;
+
+    for (i = 0; i < turn_num; i++) {
+        if (0 == turn[i].first_play_ms) {
+            continue;
+        }
+        sweep->replies++;
+        sweep->gap_cnt += turn[i].gap_cnt;
+        sweep->gap_us += turn[i].gap_us;
+        sweep->play_ms += __replay_span_ms(turn[i].tts_start_ms, turn[i].first_play_ms);
+    }
+}
+
+static int __replay_run(REPLAY_SWEEP_T *sweep)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_AUDIO_CONFIG_T ai_audio_cfg;
+    uint8_t volume = 70;
+    SYS_TIME_T deadline = 0;
+
+    replay_os_init(s_replay_cfg.heap_budget, s_replay_cfg.log_level);
+    if (s_replay_cfg.far_wav) {
+        return (OPRT_OK == __replay_aec_bench(s_replay_cfg.in_wav, s_replay_cfg.far_wav, s_replay_cfg.out_wav)) ? 0 : 1;
+    }
+    TUYA_CALL_ERR_RETURN(tal_sw_timer_init());
+    tal_kv_set("spk_volume", &volume, sizeof(volume));
+
+    TUYA_CALL_ERR_RETURN(replay_audio_init(&s_replay_cfg));
+    TUYA_CALL_ERR_RETURN(replay_cloud_init(&s_replay_cfg));
+
+    ai_audio_cfg.work_mode = s_replay_cfg.work_mode;
+    ai_audio_cfg.evt_inform_cb = __replay_evt_inform;
+    ai_audio_cfg.state_inform_cb = __replay_state_inform;
+    TUYA_CALL_ERR_RETURN(ai_audio_init(&ai_audio_cfg));
+    // the player decodes on one thread, its cpu time is the cost of the frames
+    ai_audio_decoder_set_clock(replay_os_thread_cpu_us);
+    TUYA_CALL_ERR_RETURN(__replay_decoder_bench());
+    if (s_replay_cfg.packet_ms) {
+        TUYA_CALL_ERR_RETURN(ai_audio_cloud_asr_set_packet(s_replay_cfg.packet_ms, 0));
+    }
+    if (s_replay_cfg.jitter_mode >= 0) {
+        TUYA_CALL_ERR_RETURN(ai_audio_player_set_jitter_mode(s_replay_cfg.jitter_mode));
+    }
+    if (AUDIO_CODEC_PCM != s_replay_cfg.upload_codec) {
+        TUYA_CALL_ERR_RETURN(__replay_encoder_bench(s_replay_cfg.in_wav, s_replay_cfg.upload_codec));
+        TUYA_CALL_ERR_RETURN(ai_audio_agent_set_upload_codec(s_replay_cfg.upload_codec));
+    }
+
+    replay_cloud_connect();
+    TUYA_CALL_ERR_RETURN(ai_audio_set_open(true));
+    s_replay_start_ms = tal_system_get_millisecond();
+    TUYA_CALL_ERR_RETURN(replay_audio_mic_start());
+
+    while (!replay_audio_mic_is_done()) {
+        tal_system_sleep(REPLAY_POLL_MS);
+    }
+
+    // the last reply may still be on its way when the tail of silence ends
+    deadline = tal_system_get_millisecond() + s_replay_cfg.tail_ms / s_replay_cfg.speed;
+    while (tal_system_get_millisecond() < deadline &&
+           (!replay_cloud_is_idle() || ai_audio_player_is_playing())) {
+        tal_system_sleep(REPLAY_POLL_MS);
+    }
+
+    replay_audio_deinit();
+
+    rt = __replay_report();
+    if (sweep) {
+        __replay_sweep_fill(sweep);
+    }
+
+    return rt;
+}
+
+// the pipeline keeps its state in globals, each mode gets a fresh process
+static int __replay_jitter_sweep(void)
+{
+    static const char *name[] = {"low", "balanced", "robust"};
+    REPLAY_SWEEP_T res[AI_AUDIO_PLAYER_JITTER_MAX];
+    int fd[2] = {-1, -1};
+    int status = 0, rt = 0;
+    pid_t pid = 0;
+    uint32_t mode = 0;
+
+    memset(res, 0, sizeof(res));
+    for (mode = 0; mode < AI_AUDIO_PLAYER_JITTER_MAX; mode++) {
+        res[mode].rt = 1;
+        fflush(stdout);
+        if (pipe(fd)) {
+            return 1;
+        }
+        pid = fork();
+        if (pid < 0) {
+            close(fd[0]);
+            close(fd[1]);
+            return 1;
+        }
+        if (0 == pid) {
+            close(fd[0]);
+            fprintf(stdout, "\n==== jitter mode %s\n", name[mode]);
+            s_replay_cfg.jitter_mode = (int)mode;
+            res[mode].rt = __replay_run(&res[mode]);
+            fflush(stdout);
+            _exit((sizeof(res[mode]) == write(fd[1], &res[mode], sizeof(res[mode]))) ? 0 : 1);
+        }
+        close(fd[1]);
+        if (sizeof(res[mode]) != read(fd[0], &res[mode], sizeof(res[mode]))) {
+            res[mode].rt = 1;
+        }
+        close(fd[0]);
+        waitpid(pid, &status, 0);
+    }
+
+    fprintf(stdout, "\njitter mode  replies  gaps  gap_ms  play_ms avg\n");
+    for (mode = 0; mode < AI_AUDIO_PLAYER_JITTER_MAX; mode++) {
+        fprintf(stdout, "%-11s  %7u  %4u  %6.1f  %11u\n", name[mode], res[mode].replies, res[mode].gap_cnt,
+                res[mode].gap_us / 1000.0, res[mode].replies ? res[mode].play_ms / res[mode].replies : 0);
+        if (res[mode].rt) {
+            fprintf(stdout, "FAIL: the %s run did not answer every turn\n", name[mode]);
+            rt = 1;
+        }
+    }
+
+    // a deeper buffer may not add gaps, and the deepest has to remove some of those of the shallowest
+    for (mode = 1; mode < AI_AUDIO_PLAYER_JITTER_MAX; mode++) {
+        if (res[mode].gap_us > res[mode - 1].gap_us) {
+            fprintf(stdout, "FAIL: %s has more gap time than %s\n", name[mode], name[mode - 1]);
+            rt = 1;
+        }
+    }
+    if (res[AI_AUDIO_PLAYER_JITTER_MAX - 1].gap_us >= res[0].gap_us && res[0].gap_us) {
+        fprintf(stdout, "FAIL: %s removes no gap time of %s\n", name[AI_AUDIO_PLAYER_JITTER_MAX - 1], name[0]);
+        rt = 1;
+    }
+    fprintf(stdout, "jitter sweep %s\n", rt ? "failed" : "passed");
+
+    return rt;
+}
+
+int main(int argc, char **argv)
+{
+    if (__replay_args_parse(argc, argv, &s_replay_cfg)) {
+        __replay_usage(argv[0]);
+        return 2;
+    }
+
+    if (s_replay_cfg.is_mix_bench) {
+        return (OPRT_OK == __replay_mixer_bench(s_replay_cfg.in_wav)) ? 0 : 1;
+    }
+
+    if (s_replay_cfg.is_jitter_sweep) {
+        return __replay_jitter_sweep();
+    }
+
+    return __replay_run(NULL);
+}
@@ -0,0 +1,781 @@
+/**
+ * @file replay_os.c
+ * @brief Host implementation of the tal and tkl services used by the voice
+ * pipeline in the replay harness.
+ *
+ * Every allocation carries a small header with its size, so the current and
+ * the peak use of the heap and of the psram are known at any time and the free
+ * heap the pipeline reads is the budget minus the current use. Every thread
+ * keeps its name, its cpu time is read from the thread cpu clock when the
+ * report is made, and counts the times it woke up from a sleep or a wait that
+ * blocked. The software timer is the real tal_sw_timer.c running on
+ * these services.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tal_api.h"
+#include "tkl_memory.h"
+#include "tkl_thread.h"
+
+#include "replay.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define REPLAY_MEM_MAGIC_HEAP  0x48454150
+#define REPLAY_MEM_MAGIC_PSRAM 0x5053524d
+#define REPLAY_KV_MAX          8
+#define REPLAY_CPU_EXTRA_MAX   8
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+// keeps the payload 16 byte aligned
+typedef struct {
+    size_t size;
+    uint32_t magic;
+    uint32_t resv;
+} REPLAY_MEM_HEAD_T;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t cnt;
+    uint32_t max;
+} REPLAY_SEM_T;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint8_t *buf;
+    uint32_t msg_size;
+    uint32_t msg_cnt;
+    uint32_t head;
+    uint32_t used;
+} REPLAY_QUEUE_T;
+
+typedef struct {
+    pthread_t tid;
+    char name[REPLAY_NAME_LEN];
+    volatile THREAD_STATE_E state;
+    THREAD_FUNC_CB func;
+    void *args;
+    uint64_t stand_in_us; // spent in the stand-ins called by the thread
+    uint32_t wakeups;
+} REPLAY_THREAD_T;
+
+typedef struct {
+    char key[32];
+    uint8_t *value;
+    size_t len;
+} REPLAY_KV_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static pthread_mutex_t s_replay_lock = PTHREAD_MUTEX_INITIALIZER;
+static REPLAY_MEM_T s_replay_mem;
+static uint32_t s_replay_heap_budget = 512 * 1024;
+static int s_replay_log_level = TAL_LOG_LEVEL_NOTICE;
+
+static REPLAY_THREAD_T s_replay_thread[REPLAY_THREAD_MAX];
+static uint32_t s_replay_thread_num;
+static __thread REPLAY_THREAD_T *s_replay_thread_self;
+static REPLAY_CPU_T s_replay_cpu_extra[REPLAY_CPU_EXTRA_MAX];
+static uint32_t s_replay_cpu_extra_num;
+
+static REPLAY_KV_T s_replay_kv[REPLAY_KV_MAX];
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static void *__replay_mem_alloc(size_t size, uint32_t magic)
+{
+    REPLAY_MEM_HEAD_T *head = (REPLAY_MEM_HEAD_T *)malloc(sizeof(REPLAY_MEM_HEAD_T) + size);
+
+    if (NULL == head) {
+        return NULL;
+    }
+    head->size = size;
+    head->magic = magic;
+
+    pthread_mutex_lock(&s_replay_lock);
+    s_replay_mem.alloc_cnt++;
+    if (REPLAY_MEM_MAGIC_PSRAM == magic) {
+        s_replay_mem.psram_cur += size;
+        if (s_replay_mem.psram_cur > s_replay_mem.psram_peak) {
+            s_replay_mem.psram_peak = s_replay_mem.psram_cur;
+        }
+    } else {
+        s_replay_mem.heap_cur += size;
+        if (s_replay_mem.heap_cur > s_replay_mem.heap_peak) {
+            s_replay_mem.heap_peak = s_replay_mem.heap_cur;
+        }
+    }
+    pthread_mutex_unlock(&s_replay_lock);
+
+    return head + 1;
+}
+
+static void __replay_mem_free(void *ptr)
+{
+    REPLAY_MEM_HEAD_T *head = NULL;
+
+    if (NULL == ptr) {
+        return;
+    }
+    head = (REPLAY_MEM_HEAD_T *)ptr - 1;
+
+    pthread_mutex_lock(&s_replay_lock);
+    if (REPLAY_MEM_MAGIC_PSRAM == head->magic) {
+        s_replay_mem.psram_cur -= head->size;
+    } else if (REPLAY_MEM_MAGIC_HEAP == head->magic) {
+        s_replay_mem.heap_cur -= head->size;
+    } else {
+        pthread_mutex_unlock(&s_replay_lock);
+        fprintf(stderr, "replay: free of a block not allocated by the harness: %p\n", ptr);
+        abort();
+    }
+    pthread_mutex_unlock(&s_replay_lock);
+
+    head->magic = 0;
+    free(head);
+}
+
+static void *__replay_mem_realloc(void *ptr, size_t size, uint32_t magic)
+{
+    void *new_ptr = NULL;
+    size_t old_size = 0;
+
+    if (NULL == ptr) {
+        return __replay_mem_alloc(size, magic);
+    }
+
+    new_ptr = __replay_mem_alloc(size, magic);
+    if (NULL == new_ptr) {
+        return NULL;
+    }
+    old_size = ((REPLAY_MEM_HEAD_T *)ptr - 1)->size;
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    __replay_mem_free(ptr);
+
+    return new_ptr;
+}
+
+void *tkl_system_malloc(size_t size)
+{
+    return __replay_mem_alloc(size, REPLAY_MEM_MAGIC_HEAP);
+}
+
+void tkl_system_free(void *ptr)
+{
+    __replay_mem_free(ptr);
+}
+
+void *tkl_system_calloc(size_t nitems, size_t size)
+{
+    void *ptr = __replay_mem_alloc(nitems * size, REPLAY_MEM_MAGIC_HEAP);
+
+    if (ptr) {
+        memset(ptr, 0, nitems * size);
+    }
+    return ptr;
+}
+
+void *tkl_system_realloc(void *ptr, size_t size)
+{
+    return __replay_mem_realloc(ptr, size, REPLAY_MEM_MAGIC_HEAP);
+}
+
+void *tkl_system_psram_malloc(size_t size)
+{
+    return __replay_mem_alloc(size, REPLAY_MEM_MAGIC_PSRAM);
+}
+
+void tkl_system_psram_free(void *ptr)
+{
+    __replay_mem_free(ptr);
+}
+
+void *tkl_system_psram_realloc(void *ptr, size_t size)
+{
+    return __replay_mem_realloc(ptr, size, REPLAY_MEM_MAGIC_PSRAM);
+}
+
+void *tal_malloc(size_t size)
+{
+    return tkl_system_malloc(size);
+}
+
+void tal_free(void *ptr)
+{
+    tkl_system_free(ptr);
+}
+
+void *tal_calloc(size_t nitems, size_t size)
+{
+    return tkl_system_calloc(nitems, size);
+}
+
+void *tal_realloc(void *ptr, size_t size)
+{
+    return tkl_system_realloc(ptr, size);
+}
+
+int tal_system_get_free_heap_size(void)
+{
+    size_t cur = 0;
+
+    pthread_mutex_lock(&s_replay_lock);
+    cur = s_replay_mem.heap_cur;
+    pthread_mutex_unlock(&s_replay_lock);
+
+    return (cur < s_replay_heap_budget) ? (int)(s_replay_heap_budget - cur) : 0;
+}
+
+int tkl_system_get_free_heap_size(void)
+{
+    return tal_system_get_free_heap_size();
+}
+
+OPERATE_RET tal_log_print(const TAL_LOG_LEVEL_E level, const char *file, const int line, const char *fmt, ...)
+{
+    static const char *s_level_name[] = {"E", "W", "N", "I", "D", "T"};
+    va_list ap;
+    uint64_t now_us = replay_os_now_us();
+
+    if ((int)level > s_replay_log_level) {
+        return OPRT_OK;
+    }
+
+    pthread_mutex_lock(&s_replay_lock);
+    fprintf(stderr, "[%llu.%03llu %s %s:%d] ", (unsigned long long)(now_us / 1000000),
+            (unsigned long long)(now_us / 1000 % 1000), level < CNTSOF(s_level_name) ? s_level_name[level] : "?", file,
+            line);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "\n");
+    pthread_mutex_unlock(&s_replay_lock);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_mutex_create_init(MUTEX_HANDLE *handle)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutex_t *mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
+
+    if (NULL == mutex) {
+        return OPRT_MALLOC_FAILED;
+    }
+    // the rtos mutexes of the platforms can be taken again by their owner
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    *handle = mutex;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_mutex_lock(const MUTEX_HANDLE handle)
+{
+    return pthread_mutex_lock((pthread_mutex_t *)handle) ? OPRT_COM_ERROR : OPRT_OK;
+}
+
+OPERATE_RET tal_mutex_unlock(const MUTEX_HANDLE handle)
+{
+    return pthread_mutex_unlock((pthread_mutex_t *)handle) ? OPRT_COM_ERROR : OPRT_OK;
+}
+
+OPERATE_RET tal_mutex_release(const MUTEX_HANDLE handle)
+{
+    pthread_mutex_destroy((pthread_mutex_t *)handle);
+    free(handle);
+
+    return OPRT_OK;
+}
+
+static void __replay_deadline(struct timespec *ts, uint32_t timeout_ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += timeout_ms / 1000;
+    ts->tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+static void __replay_cond_init(pthread_mutex_t *mutex, pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_mutex_init(mutex, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// only the pipeline threads are counted, not the stand-ins of the harness
+static void __replay_wakeup_add(void)
+{
+    if (s_replay_thread_self) {
+        s_replay_thread_self->wakeups++;
+    }
+}
+
+OPERATE_RET tal_semaphore_create_init(SEM_HANDLE *handle, uint32_t sem_cnt, uint32_t sem_max)
+{
+    REPLAY_SEM_T *sem = (REPLAY_SEM_T *)calloc(1, sizeof(REPLAY_SEM_T));
+
+    if (NULL == sem) {
+        return OPRT_MALLOC_FAILED;
+    }
+    __replay_cond_init(&sem->mutex, &sem->cond);
+    sem->cnt = sem_cnt;
+    sem->max = sem_max;
+    *handle = sem;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_semaphore_wait(SEM_HANDLE handle, uint32_t timeout)
+{
+    REPLAY_SEM_T *sem = (REPLAY_SEM_T *)handle;
+    struct timespec ts;
+    int ret = 0;
+
+    __replay_deadline(&ts, timeout);
+
+    pthread_mutex_lock(&sem->mutex);
+    if (0 == sem->cnt) {
+        __replay_wakeup_add();
+    }
+    while (0 == sem->cnt && 0 == ret) {
+        if (SEM_WAIT_FOREVER == timeout) {
+            ret = pthread_cond_wait(&sem->cond, &sem->mutex);
+        } else {
+            ret = pthread_cond_timedwait(&sem->cond, &sem->mutex, &ts);
+        }
+    }
+    if (sem->cnt) {
+        sem->cnt--;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&sem->mutex);
+
+    return ret ? OPRT_OS_ADAPTER_SEM_WAIT_FAILED : OPRT_OK;
+}
+
+OPERATE_RET tal_semaphore_post(SEM_HANDLE handle)
+{
+    REPLAY_SEM_T *sem = (REPLAY_SEM_T *)handle;
+
+    pthread_mutex_lock(&sem->mutex);
+    if (sem->cnt < sem->max) {
+        sem->cnt++;
+    }
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->mutex);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_semaphore_release(SEM_HANDLE handle)
+{
+    REPLAY_SEM_T *sem = (REPLAY_SEM_T *)handle;
+
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->mutex);
+    free(sem);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_queue_create_init(QUEUE_HANDLE *queue, int msgsize, int msgcount)
+{
+    REPLAY_QUEUE_T *q = (REPLAY_QUEUE_T *)calloc(1, sizeof(REPLAY_QUEUE_T));
+
+    if (NULL == q) {
+        return OPRT_MALLOC_FAILED;
+    }
+    q->buf = (uint8_t *)malloc((size_t)msgsize * msgcount);
+    if (NULL == q->buf) {
+        free(q);
+        return OPRT_MALLOC_FAILED;
+    }
+    __replay_cond_init(&q->mutex, &q->cond);
+    q->msg_size = msgsize;
+    q->msg_cnt = msgcount;
+    *queue = q;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_queue_post(QUEUE_HANDLE queue, void *data, uint32_t timeout)
+{
+    REPLAY_QUEUE_T *q = (REPLAY_QUEUE_T *)queue;
+    struct timespec ts;
+    int ret = 0;
+
+    __replay_deadline(&ts, timeout);
+
+    pthread_mutex_lock(&q->mutex);
+    while (q->used == q->msg_cnt && 0 == ret) {
+        if (0 == timeout) {
+            ret = ETIMEDOUT;
+        } else if (SEM_WAIT_FOREVER == timeout) {
+            ret = pthread_cond_wait(&q->cond, &q->mutex);
+        } else {
+            ret = pthread_cond_timedwait(&q->cond, &q->mutex, &ts);
+        }
+    }
+    if (q->used < q->msg_cnt) {
+        memcpy(q->buf + ((q->head + q->used) % q->msg_cnt) * q->msg_size, data, q->msg_size);
+        q->used++;
+        ret = 0;
+        pthread_cond_broadcast(&q->cond);
+    }
+    pthread_mutex_unlock(&q->mutex);
+
+    return ret ? OPRT_OS_ADAPTER_QUEUE_SEND_FAIL : OPRT_OK;
+}
+
+OPERATE_RET tal_queue_fetch(QUEUE_HANDLE queue, void *msg, uint32_t timeout)
+{
+    REPLAY_QUEUE_T *q = (REPLAY_QUEUE_T *)queue;
+    struct timespec ts;
+    int ret = 0;
+
+    __replay_deadline(&ts, timeout);
+
+    pthread_mutex_lock(&q->mutex);
+    if (0 == q->used && 0 != timeout) {
+        __replay_wakeup_add();
+    }
+    while (0 == q->used && 0 == ret) {
+        if (0 == timeout) {
+            ret = ETIMEDOUT;
+        } else if (SEM_WAIT_FOREVER == timeout) {
+            ret = pthread_cond_wait(&q->cond, &q->mutex);
+        } else {
+            ret = pthread_cond_timedwait(&q->cond, &q->mutex, &ts);
+        }
+    }
+    if (q->used) {
+        memcpy(msg, q->buf + q->head * q->msg_size, q->msg_size);
+        q->head = (q->head + 1) % q->msg_cnt;
+        q->used--;
+        ret = 0;
+        pthread_cond_broadcast(&q->cond);
+    }
+    pthread_mutex_unlock(&q->mutex);
+
+    return ret ? OPRT_OS_ADAPTER_QUEUE_RECV_FAIL : OPRT_OK;
+}
+
+void tal_queue_free(QUEUE_HANDLE queue)
+{
+    REPLAY_QUEUE_T *q = (REPLAY_QUEUE_T *)queue;
+
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->mutex);
+    free(q->buf);
+    free(q);
+}
+
+static void *__replay_thread_entry(void *arg)
+{
+    REPLAY_THREAD_T *thread = (REPLAY_THREAD_T *)arg;
+
+    thread->tid = pthread_self();
+    s_replay_thread_self = thread;
+    pthread_setname_np(pthread_self(), thread->name);
+    thread->func(thread->args);
+    thread->state = THREAD_STATE_DELETE;
+
+    return NULL;
+}
+
+static OPERATE_RET __replay_thread_create(REPLAY_THREAD_T **handle, const char *name, THREAD_FUNC_CB func, void *args)
+{
+    REPLAY_THREAD_T *thread = NULL;
+
+    pthread_mutex_lock(&s_replay_lock);
+    if (s_replay_thread_num >= REPLAY_THREAD_MAX) {
+        pthread_mutex_unlock(&s_replay_lock);
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+    thread = &s_replay_thread[s_replay_thread_num++];
+    pthread_mutex_unlock(&s_replay_lock);
+
+    // the os copies at most 15 characters of the name
+    snprintf(thread->name, sizeof(thread->name), "%s", name ? name : "thread");
+    thread->func = func;
+    thread->args = args;
+    thread->state = THREAD_STATE_RUNNING;
+    // the new thread may look at its handle before pthread_create() returns
+    *handle = thread;
+    if (pthread_create(&thread->tid, NULL, __replay_thread_entry, thread)) {
+        thread->state = THREAD_STATE_EMPTY;
+        *handle = NULL;
+        return OPRT_OS_ADAPTER_THRD_CREAT_FAILED;
+    }
+    pthread_detach(thread->tid);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_thread_create_and_start(THREAD_HANDLE *handle, const THREAD_ENTER_CB enter, const THREAD_EXIT_CB exit,
+                                        const THREAD_FUNC_CB func, const void *func_args, const THREAD_CFG_T *cfg)
+{
+    return __replay_thread_create((REPLAY_THREAD_T **)handle, cfg ? cfg->thrdname : NULL, func, (void *)func_args);
+}
+
+OPERATE_RET tkl_thread_create_in_psram(TKL_THREAD_HANDLE *thread, const char *name, uint32_t stack_size,
+                                       uint32_t priority, const THREAD_FUNC_T func, void *const arg)
+{
+    return __replay_thread_create((REPLAY_THREAD_T **)thread, name, func, arg);
+}
+
+OPERATE_RET tal_thread_delete(const THREAD_HANDLE handle)
+{
+    // the pipeline threads run until the process ends
+    return OPRT_OK;
+}
+
+THREAD_STATE_E tal_thread_get_state(const THREAD_HANDLE handle)
+{
+    return ((REPLAY_THREAD_T *)handle)->state;
+}
+
+OPERATE_RET tal_thread_is_self(const THREAD_HANDLE handle, BOOL_T *bl)
+{
+    *bl = pthread_equal(((REPLAY_THREAD_T *)handle)->tid, pthread_self()) ? TRUE : FALSE;
+    return OPRT_OK;
+}
+
+uint64_t replay_os_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void replay_os_sleep_until(uint64_t deadline_us)
+{
+    struct timespec ts = {
+        .tv_sec = deadline_us / 1000000,
+        .tv_nsec = (deadline_us % 1000000) * 1000,
+    };
+
+    while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) {
+    }
+}
+
+uint64_t replay_os_thread_cpu_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+SYS_TIME_T tal_system_get_millisecond(void)
+{
+    return (SYS_TIME_T)(replay_os_now_us() / 1000);
+}
+
+SYS_TICK_T tal_system_get_tick_count(void)
+{
+    return (SYS_TICK_T)tal_system_get_millisecond();
+}
+
+void tal_system_sleep(uint32_t time_ms)
+{
+    __replay_wakeup_add();
+    replay_os_sleep_until(replay_os_now_us() + (uint64_t)time_ms * 1000);
+}
+
+void tal_time_get_system_time(TIME_S *pSecTime, TIME_MS *pMsTime)
+{
+    SYS_TIME_T ms = tal_system_get_millisecond();
+
+    *pSecTime = (TIME_S)(ms / 1000);
+    *pMsTime = (TIME_MS)(ms % 1000);
+}
+
+int tal_system_get_random(uint32_t range)
+{
+    return range ? (int)(rand() % range) : rand();
+}
+
+int tal_kv_set(const char *key, const uint8_t *value, size_t length)
+{
+    uint32_t i = 0;
+    REPLAY_KV_T *kv = NULL;
+
+    pthread_mutex_lock(&s_replay_lock);
+    for (i = 0; i < REPLAY_KV_MAX && NULL == kv; i++) {
+        if (s_replay_kv[i].value && !strcmp(s_replay_kv[i].key, key)) {
+            kv = &s_replay_kv[i];
+        }
+    }
+    for (i = 0; i < REPLAY_KV_MAX && NULL == kv; i++) {
+        if (NULL == s_replay_kv[i].value) {
+            kv = &s_replay_kv[i];
+        }
+    }
+    if (NULL == kv) {
+        pthread_mutex_unlock(&s_replay_lock);
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+    free(kv->value);
+    snprintf(kv->key, sizeof(kv->key), "%s", key);
+    kv->value = (uint8_t *)malloc(length);
+    memcpy(kv->value, value, length);
+    kv->len = length;
+    pthread_mutex_unlock(&s_replay_lock);
+
+    return OPRT_OK;
+}
+
+int tal_kv_get(const char *key, uint8_t **value, size_t *length)
+{
+    uint32_t i = 0;
+    uint8_t buf[64];
+    size_t len = 0;
+
+    pthread_mutex_lock(&s_replay_lock);
+    for (i = 0; i < REPLAY_KV_MAX; i++) {
+        if (s_replay_kv[i].value && !strcmp(s_replay_kv[i].key, key)) {
+            len = s_replay_kv[i].len < sizeof(buf) ? s_replay_kv[i].len : sizeof(buf);
+            memcpy(buf, s_replay_kv[i].value, len);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_replay_lock);
+
+    if (i == REPLAY_KV_MAX) {
+        return OPRT_NOT_FOUND;
+    }
+
+    // freed by tal_kv_free(), so it comes from the tracked heap like on the device, the heap takes the lock
+    *value = (uint8_t *)tal_malloc(len);
+    memcpy(*value, buf, len);
+    *length = len;
+
+    return OPRT_OK;
+}
+
+int tal_kv_free(uint8_t *value)
+{
+    tal_free(value);
+    return OPRT_OK;
+}
+
+/**
+ * @brief set the heap budget and the log level of the harness
+ *
+ * @param[in] heap_budget: heap the pipeline may use in bytes
+ * @param[in] log_level: TAL_LOG_LEVEL_E, -1 mutes the logs
+ */
+void replay_os_init(uint32_t heap_budget, int log_level)
+{
+    s_replay_heap_budget = heap_budget;
+    s_replay_log_level = log_level;
+}
+
+/**
+ * @brief account cpu time of a stage that has no thread of its own
+ *
+ * Stand-in time measured on a pipeline thread, like the speaker writing the
+ * capture file, is taken out of the time of that thread.
+ *
+ * @param[in] name: stage name, the time of the same name is summed
+ * @param[in] cpu_us: cpu time to add
+ * @param[in] is_stand_in: the time is spent by the harness
+ */
+void replay_os_cpu_add(const char *name, uint64_t cpu_us, bool is_stand_in)
+{
+    uint32_t i = 0;
+
+    pthread_mutex_lock(&s_replay_lock);
+    for (i = 0; is_stand_in && i < s_replay_thread_num; i++) {
+        if (pthread_equal(s_replay_thread[i].tid, pthread_self())) {
+            s_replay_thread[i].stand_in_us += cpu_us;
+        }
+    }
+    for (i = 0; i < s_replay_cpu_extra_num; i++) {
+        if (!strcmp(s_replay_cpu_extra[i].name, name)) {
+            break;
+        }
+    }
+    if (i == s_replay_cpu_extra_num && i < REPLAY_CPU_EXTRA_MAX) {
+        snprintf(s_replay_cpu_extra[i].name, REPLAY_NAME_LEN, "%s", name);
+        s_replay_cpu_extra[i].is_stand_in = is_stand_in;
+        s_replay_cpu_extra_num++;
+    }
+    if (i < REPLAY_CPU_EXTRA_MAX) {
+        s_replay_cpu_extra[i].cpu_us += cpu_us;
+    }
+    pthread_mutex_unlock(&s_replay_lock);
+}
+
+/**
+ * @brief get the cpu time of every pipeline thread and of every accounted stage
+ *
+ * @param[out] cpu: entries
+ * @param[in] num: size of cpu
+ *
+ * @return the number of entries
+ */
+uint32_t replay_os_cpu_get(REPLAY_CPU_T *cpu, uint32_t num)
+{
+    uint32_t i = 0, cnt = 0;
+    clockid_t clk;
+    struct timespec ts;
+
+    pthread_mutex_lock(&s_replay_lock);
+    for (i = 0; i < s_replay_thread_num && cnt < num; i++) {
+        if (THREAD_STATE_RUNNING != s_replay_thread[i].state ||
+            pthread_getcpuclockid(s_replay_thread[i].tid, &clk) || clock_gettime(clk, &ts)) {
+            continue;
+        }
+        snprintf(cpu[cnt].name, REPLAY_NAME_LEN, "%s", s_replay_thread[i].name);
+        cpu[cnt].cpu_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 - s_replay_thread[i].stand_in_us;
+        cpu[cnt].is_stand_in = false;
+        cpu[cnt].wakeups = s_replay_thread[i].wakeups;
+        cnt++;
+    }
+    for (i = 0; i < s_replay_cpu_extra_num && cnt < num; i++) {
+        cpu[cnt++] = s_replay_cpu_extra[i];
+    }
+    pthread_mutex_unlock(&s_replay_lock);
+
+    return cnt;
+}
+
+/**
+ * @brief get the heap and psram use
+ *
+ * @param[out] mem: current and peak use
+ */
+void replay_os_mem_get(REPLAY_MEM_T *mem)
+{
+    pthread_mutex_lock(&s_replay_lock);
+    *mem = s_replay_mem;
+    pthread_mutex_unlock(&s_replay_lock);
+}
@@ -0,0 +1,32 @@
+/**
+ * @file replay_platform.h
+ * @brief Declarations the platform sdk makes visible to the pipeline on the device.
+ *
+ * The pipeline calls the psram allocator of tkl_memory.h (ENABLE_EXT_RAM) and
+ * tkl_thread_create_in_psram() without including their headers, the platform
+ * build provides them. On a 64 bit host an implicit declaration truncates the
+ * returned pointer, so the harness includes this header ahead of every source.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#ifndef __REPLAY_PLATFORM_H__
+#define __REPLAY_PLATFORM_H__
+
+#include "tuya_cloud_types.h"
+#include "tkl_memory.h"
+#include "tkl_thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+OPERATE_RET tkl_thread_create_in_psram(TKL_THREAD_HANDLE *thread, const char *name, uint32_t stack_size,
+                                       uint32_t priority, const THREAD_FUNC_T func, void *const arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __REPLAY_PLATFORM_H__ */
@@ -0,0 +1,538 @@
+/**
+ * @file ai_audio_aec.c
+ * @brief Implements the software acoustic echo canceller.
+ *
+ * A time-domain NLMS filter in fixed point models the echo path from the
+ * speaker to the microphone and subtracts the estimated echo from the capture.
+ *
+ * The reference is kept in a ring indexed by a free running sample counter.
+ * Every captured sample consumes one reference sample, when the player is idle
+ * the ring is padded with silence so both sides stay on the same timeline. The
+ * echo delay on that timeline is found by cross-correlating decimated mic and
+ * reference signals, the filter window is placed just before it. The mic
+ * callback only takes a snapshot of the decimated signals, the correlation runs
+ * in the input task and its result is applied at the start of the next block.
+ *
+ * Each sample adapts 1 / AI_AUDIO_AEC_UPDATE_DIV of the taps in turn, which
+ * bounds the work done in the mic callback per block.
+ *
+ * Adaptation is frozen while the near end talks (Geigel detector), so a user
+ * speaking over the playback does not disturb the filter.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tkl_memory.h"
+#include "tal_api.h"
+
+#include "ai_audio_aec.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define AEC_SAMPLE_RATE 16000
+#define AEC_BLOCK       160 // samples processed per step, 10ms
+
+// reference history, a power of two
+#define AEC_REF_LEN  16384
+#define AEC_REF_MASK (AEC_REF_LEN - 1)
+
+#define AEC_MAX_DELAY (AI_AUDIO_AEC_MAX_DELAY_MS * (AEC_SAMPLE_RATE / 1000))
+
+// delay estimation on 2 kHz signals over a 64ms window, every 250ms
+#define AEC_DEC        8
+#define AEC_EST_LEN    128
+#define AEC_EST_LAGS   (AEC_MAX_DELAY / AEC_DEC)
+#define AEC_EST_PERIOD 25
+// decimated reference history, a power of two covering AEC_EST_LEN + AEC_EST_LAGS
+#define AEC_EST_HIST 1024
+#if (AEC_EST_HIST < AEC_EST_LEN + AEC_EST_LAGS) || (AEC_EST_HIST & (AEC_EST_HIST - 1))
+#error "AEC_EST_HIST must be a power of two covering AEC_EST_LEN + AEC_EST_LAGS, lower AI_AUDIO_AEC_MAX_DELAY_MS"
+#endif
+// the filter starts this many samples before the estimated delay to absorb the estimate error
+#define AEC_DELAY_MARGIN (4 * AEC_DEC)
+
+// weights are Q28, step size mu = 2^-AEC_MU_SHIFT
+#define AEC_W_SHIFT  28
+#define AEC_MU_SHIFT 2
+
+// no adaptation below about -66 dBFS of reference
+#define AEC_ENERGY_FLOOR ((int64_t)AI_AUDIO_AEC_TAPS * 16 * 16)
+#define AEC_ENERGY_DELTA ((int64_t)AI_AUDIO_AEC_TAPS * 64)
+
+// near end louder than max|ref| >> AEC_DT_SHIFT is taken as double talk. The classic Geigel threshold of
+// half the reference peak assumes the echo is at least 6 dB below it, a board with a louder echo path
+// sets 0 or the filter stays frozen.
+#ifndef AEC_DT_SHIFT
+#define AEC_DT_SHIFT 1
+#endif
+#define AEC_DT_HANGOVER 5
+
+#if (AI_AUDIO_AEC_UPDATE_DIV < 1) || (AI_AUDIO_AEC_TAPS % AI_AUDIO_AEC_UPDATE_DIV)
+#error "AI_AUDIO_AEC_UPDATE_DIV must divide AI_AUDIO_AEC_TAPS"
+#endif
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    MUTEX_HANDLE mutex;
+    int16_t *ref;
+    uint32_t ref_wr;
+    uint32_t ref_rd; // reference sample played together with the next mic sample, before the echo delay
+
+    int32_t w[AI_AUDIO_AEC_TAPS];
+    int16_t x[AI_AUDIO_AEC_TAPS + AEC_BLOCK]; // aligned reference of the block in progress
+
+    int16_t mic_dec[AEC_EST_LEN];
+    int16_t ref_dec[AEC_EST_HIST];
+    uint32_t dec_pos;
+    uint32_t est_cnt;
+    uint32_t delay;
+
+    // handed to the input task, the callback leaves them alone while est_ready is set
+    bool est_ready;
+    int16_t est_mic[AEC_EST_LEN];
+    int16_t est_ref[AEC_EST_LEN + AEC_EST_LAGS]; // est_ref[i + AEC_EST_LAGS - lag] lines up with est_mic[i]
+    uint32_t est_delay;                          // delay when the snapshot was taken
+    uint32_t delay_cand;                         // only used by the input task
+    bool is_delay_new;
+    uint32_t delay_new;
+
+    uint32_t dt_hold;
+    bool is_dt_seen;     // double talk since the last delay snapshot
+    bool is_delay_found; // the window is placed on an estimate, until then the detector compares the wrong samples
+    uint64_t ed_avg;
+    uint64_t ee_avg;
+
+    AI_AUDIO_AEC_STATS_T stats;
+} AI_AUDIO_AEC_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static AI_AUDIO_AEC_T *sg_aec = NULL;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static inline int16_t __aec_sat16(int32_t val)
+{
+    if (val > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (val < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)val;
+}
+
+static inline int32_t __aec_sat32(int64_t val)
+{
+    if (val > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (val < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t)val;
+}
+
+// log2 in Q8, the fraction is a linear interpolation of the mantissa
+static int32_t __aec_log2_q8(uint64_t val)
+{
+    int32_t ip = 0;
+
+    if (0 == val) {
+        return 0;
+    }
+
+    ip = 63 - __builtin_clzll(val);
+    return (ip << 8) | (int32_t)(((val << (63 - ip)) >> 55) & 0xFF);
+}
+
+// copies the decimated windows the delay search needs, called by the mic callback
+static void __aec_delay_snapshot(AI_AUDIO_AEC_T *aec)
+{
+    uint32_t i = 0, t = 0;
+
+    for (i = 0; i < AEC_EST_LEN; i++) {
+        t = aec->dec_pos - AEC_EST_LEN + i;
+        aec->est_mic[i] = aec->mic_dec[t % AEC_EST_LEN];
+    }
+    for (i = 0; i < AEC_EST_LEN + AEC_EST_LAGS; i++) {
+        t = aec->dec_pos - AEC_EST_LEN - AEC_EST_LAGS + i;
+        aec->est_ref[i] = aec->ref_dec[t % AEC_EST_HIST];
+    }
+    aec->est_delay = aec->delay;
+}
+
+// returns the new delay in samples, or -1 to keep the current one
+static int32_t __aec_delay_estimate(AI_AUDIO_AEC_T *aec)
+{
+    int64_t c = 0, best = 0, energy = 0, ref_energy = 0, score = 0;
+    uint32_t i = 0, lag = 0, best_lag = 0;
+    const int16_t *r = aec->est_ref;
+
+    for (i = 0; i < AEC_EST_LEN; i++) {
+        energy += (int32_t)aec->est_mic[i] * aec->est_mic[i];
+    }
+    // nothing to correlate while the mic is quiet
+    if (energy < (int64_t)AEC_EST_LEN * 64 * 64) {
+        return -1;
+    }
+
+    for (i = 0; i < AEC_EST_LEN; i++) {
+        ref_energy += (int32_t)r[i + AEC_EST_LAGS] * r[i + AEC_EST_LAGS];
+    }
+
+    // correlation normalized by the reference energy at each lag, speech is loud at some lags and not at others
+    for (lag = 0; lag < AEC_EST_LAGS; lag++) {
+        c = 0;
+        for (i = 0; i < AEC_EST_LEN; i++) {
+            c += (int32_t)aec->est_mic[i] * r[i + AEC_EST_LAGS - lag];
+        }
+        if (c > 0) {
+            c >>= 8;
+            score = c * c / ((ref_energy >> 8) + 1);
+            if (score > best) {
+                best = score;
+                best_lag = lag;
+            }
+        }
+        // slide the reference window one sample back for the next lag
+        ref_energy += (int32_t)r[AEC_EST_LAGS - lag - 1] * r[AEC_EST_LAGS - lag - 1] -
+                      (int32_t)r[AEC_EST_LAGS - lag + AEC_EST_LEN - 1] * r[AEC_EST_LAGS - lag + AEC_EST_LEN - 1];
+    }
+
+    if (0 == best) {
+        return -1;
+    }
+
+    // take an estimate only when it repeats, a single peak may be near-end speech
+    if (best_lag + 1 < aec->delay_cand || best_lag > aec->delay_cand + 1) {
+        aec->delay_cand = best_lag;
+        return -1;
+    }
+
+    best_lag *= AEC_DEC;
+    if (best_lag + AEC_DEC < aec->est_delay || best_lag > aec->est_delay + AEC_DEC) {
+        return (int32_t)best_lag;
+    }
+
+    return -1;
+}
+
+static void __aec_decimate(AI_AUDIO_AEC_T *aec, const int16_t *mic, uint32_t base, uint32_t samples)
+{
+    uint32_t i = 0, j = 0;
+    int32_t m = 0, r = 0;
+
+    for (i = 0; i + AEC_DEC <= samples; i += AEC_DEC) {
+        m = 0;
+        r = 0;
+        for (j = 0; j < AEC_DEC; j++) {
+            m += mic[i + j];
+            r += aec->ref[(base + i + j) & AEC_REF_MASK];
+        }
+        aec->mic_dec[aec->dec_pos % AEC_EST_LEN] = (int16_t)(m / AEC_DEC);
+        aec->ref_dec[aec->dec_pos % AEC_EST_HIST] = (int16_t)(r / AEC_DEC);
+        aec->dec_pos++;
+    }
+}
+
+// tap k models the echo shift + k samples back, a new window keeps the taps of the lags both windows cover
+// so a wrong estimate, or one taken during double talk, does not throw the converged filter away
+static void __aec_window_move(AI_AUDIO_AEC_T *aec, uint32_t delay, uint32_t delay_new)
+{
+    uint32_t shift = (delay > AEC_DELAY_MARGIN) ? delay - AEC_DELAY_MARGIN : 0;
+    uint32_t shift_new = (delay_new > AEC_DELAY_MARGIN) ? delay_new - AEC_DELAY_MARGIN : 0;
+    uint32_t d = 0;
+
+    if (shift_new >= shift + AI_AUDIO_AEC_TAPS || shift >= shift_new + AI_AUDIO_AEC_TAPS) {
+        memset(aec->w, 0, sizeof(aec->w));
+    } else if (shift_new > shift) {
+        d = shift_new - shift;
+        memmove(&aec->w[0], &aec->w[d], (AI_AUDIO_AEC_TAPS - d) * sizeof(aec->w[0]));
+        memset(&aec->w[AI_AUDIO_AEC_TAPS - d], 0, d * sizeof(aec->w[0]));
+    } else {
+        d = shift - shift_new;
+        memmove(&aec->w[d], &aec->w[0], (AI_AUDIO_AEC_TAPS - d) * sizeof(aec->w[0]));
+        memset(&aec->w[0], 0, d * sizeof(aec->w[0]));
+    }
+}
+
+static void __aec_process_block(AI_AUDIO_AEC_T *aec, int16_t *mic, uint32_t samples)
+{
+    uint32_t base = 0, start = 0, shift = 0, i = 0, k = 0;
+    int32_t max_x = 0, a = 0, e = 0;
+    int64_t acc = 0, g = 0, energy = 0;
+    uint64_t ed = 0, ee = 0;
+    bool is_adapt = false;
+    const int16_t *xi = NULL;
+
+    tal_mutex_lock(aec->mutex);
+    if (aec->ref_wr - aec->ref_rd < samples) {
+        // nothing played, the reference is silence
+        for (i = aec->ref_wr - aec->ref_rd; i < samples; i++) {
+            aec->ref[aec->ref_wr & AEC_REF_MASK] = 0;
+            aec->ref_wr++;
+        }
+    }
+    base = aec->ref_rd;
+    aec->ref_rd += samples;
+    if (aec->is_delay_new) {
+        aec->is_delay_new = false;
+        PR_DEBUG("aec delay %d -> %d", aec->delay, aec->delay_new);
+        __aec_window_move(aec, aec->delay, aec->delay_new);
+        aec->delay = aec->delay_new;
+        aec->is_delay_found = true;
+        aec->stats.delay_samples = aec->delay_new;
+    }
+    tal_mutex_unlock(aec->mutex);
+
+    __aec_decimate(aec, mic, base, samples);
+    if (++aec->est_cnt >= AEC_EST_PERIOD) {
+        tal_mutex_lock(aec->mutex);
+        // a search still running skips this period, near-end speech would pull the estimate to itself
+        if (!aec->est_ready) {
+            aec->est_cnt = 0;
+            if (!aec->is_dt_seen || !aec->is_delay_found) {
+                __aec_delay_snapshot(aec);
+                aec->est_ready = true;
+            }
+            aec->is_dt_seen = false;
+        }
+        tal_mutex_unlock(aec->mutex);
+    }
+
+    shift = (aec->delay > AEC_DELAY_MARGIN) ? aec->delay - AEC_DELAY_MARGIN : 0;
+    start = base - shift - (AI_AUDIO_AEC_TAPS - 1);
+    for (i = 0; i < AI_AUDIO_AEC_TAPS - 1 + samples; i++) {
+        aec->x[i] = aec->ref[(start + i) & AEC_REF_MASK];
+        a = (aec->x[i] < 0) ? -aec->x[i] : aec->x[i];
+        if (a > max_x) {
+            max_x = a;
+        }
+    }
+
+    aec->stats.frames++;
+    if (0 == max_x) {
+        // no echo to cancel
+        return;
+    }
+
+    for (i = 0; i < samples; i++) {
+        a = (mic[i] < 0) ? -mic[i] : mic[i];
+        if (a > (max_x >> AEC_DT_SHIFT)) {
+            aec->dt_hold = AEC_DT_HANGOVER;
+            aec->is_dt_seen = true;
+            break;
+        }
+    }
+    if (aec->dt_hold) {
+        aec->dt_hold--;
+        aec->stats.dt_frames++;
+    } else {
+        is_adapt = true;
+        aec->stats.adapt_frames++;
+    }
+
+    for (k = 0; k < AI_AUDIO_AEC_TAPS; k++) {
+        energy += (int32_t)aec->x[k] * aec->x[k];
+    }
+
+    for (i = 0; i < samples; i++) {
+        // xi[-k] is the reference k samples before the one aligned with mic[i]
+        xi = &aec->x[i + AI_AUDIO_AEC_TAPS - 1];
+
+        acc = 0;
+        for (k = 0; k < AI_AUDIO_AEC_TAPS; k++) {
+            acc += (int64_t)aec->w[k] * xi[-(int32_t)k];
+        }
+        e = __aec_sat16(mic[i] - (int32_t)(acc >> AEC_W_SHIFT));
+
+        if (is_adapt && energy > AEC_ENERGY_FLOOR) {
+            g = (int64_t)e * (1LL << (AEC_W_SHIFT - AEC_MU_SHIFT)) / (energy + AEC_ENERGY_DELTA);
+            for (k = i % AI_AUDIO_AEC_UPDATE_DIV; k < AI_AUDIO_AEC_TAPS; k += AI_AUDIO_AEC_UPDATE_DIV) {
+                aec->w[k] = __aec_sat32(aec->w[k] + g * xi[-(int32_t)k]);
+            }
+        }
+
+        if (i + 1 < samples) {
+            energy += (int32_t)xi[1] * xi[1] - (int32_t)xi[-(AI_AUDIO_AEC_TAPS - 1)] * xi[-(AI_AUDIO_AEC_TAPS - 1)];
+        }
+
+        ed += (int32_t)mic[i] * mic[i];
+        ee += (int32_t)e * e;
+        mic[i] = (int16_t)e;
+    }
+
+    if (is_adapt) {
+        aec->ed_avg = aec->ed_avg - (aec->ed_avg >> 3) + (ed >> 3);
+        aec->ee_avg = aec->ee_avg - (aec->ee_avg >> 3) + (ee >> 3);
+        // 10 * log10(x) = 3.0103 * log2(x)
+        aec->stats.erle_db_x10 =
+            (__aec_log2_q8(aec->ed_avg + 1) - __aec_log2_q8(aec->ee_avg + 1)) * 30103 / (256 * 1000);
+    }
+}
+
+/**
+ * @brief Initializes the software echo canceller.
+ * @param None
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_aec_init(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+
+    if (sg_aec) {
+        return OPRT_OK;
+    }
+
+    sg_aec = (AI_AUDIO_AEC_T *)tkl_system_psram_malloc(sizeof(AI_AUDIO_AEC_T));
+    TUYA_CHECK_NULL_RETURN(sg_aec, OPRT_MALLOC_FAILED);
+    memset(sg_aec, 0, sizeof(AI_AUDIO_AEC_T));
+
+    sg_aec->ref = (int16_t *)tkl_system_psram_malloc(AEC_REF_LEN * sizeof(int16_t));
+    TUYA_CHECK_NULL_GOTO(sg_aec->ref, __ERR);
+    memset(sg_aec->ref, 0, AEC_REF_LEN * sizeof(int16_t));
+
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&sg_aec->mutex), __ERR);
+
+    PR_DEBUG("software aec init, taps:%d", AI_AUDIO_AEC_TAPS);
+
+    return OPRT_OK;
+
+__ERR:
+    if (sg_aec->ref) {
+        tkl_system_psram_free(sg_aec->ref);
+    }
+    tkl_system_psram_free(sg_aec);
+    sg_aec = NULL;
+
+    return (OPRT_OK == rt) ? OPRT_MALLOC_FAILED : rt;
+}
+
+/**
+ * @brief Feeds the PCM handed to the speaker as the far-end reference.
+ * @param pcm The played samples.
+ * @param samples Number of samples.
+ * @return None
+ */
+void ai_audio_aec_ref_write(const int16_t *pcm, uint32_t samples)
+{
+    uint32_t i = 0, room = 0;
+
+    if (NULL == sg_aec || NULL == pcm) {
+        return;
+    }
+
+    tal_mutex_lock(sg_aec->mutex);
+    // keep the history the filter and the delay search still read
+    room = AEC_REF_LEN - AEC_MAX_DELAY - AI_AUDIO_AEC_TAPS - AEC_BLOCK - (sg_aec->ref_wr - sg_aec->ref_rd);
+    if (samples > room) {
+        sg_aec->stats.ref_drop += samples - room;
+        samples = room;
+    }
+    for (i = 0; i < samples; i++) {
+        sg_aec->ref[sg_aec->ref_wr & AEC_REF_MASK] = pcm[i];
+        sg_aec->ref_wr++;
+    }
+    tal_mutex_unlock(sg_aec->mutex);
+}
+
+/**
+ * @brief Removes the echo of the reference from captured samples, in place.
+ * @param mic The captured samples.
+ * @param samples Number of samples.
+ * @return None
+ */
+void ai_audio_aec_process(int16_t *mic, uint32_t samples)
+{
+    uint32_t n = 0;
+
+    if (NULL == sg_aec || NULL == mic) {
+        return;
+    }
+
+    while (samples) {
+        n = (samples > AEC_BLOCK) ? AEC_BLOCK : samples;
+        __aec_process_block(sg_aec, mic, n);
+        mic += n;
+        samples -= n;
+    }
+}
+
+/**
+ * @brief Runs the echo delay search on the last snapshot of the mic callback,
+ * from the input task.
+ * @param None
+ * @return None
+ */
+void ai_audio_aec_update(void)
+{
+    bool is_ready = false;
+    int32_t delay = 0;
+
+    if (NULL == sg_aec) {
+        return;
+    }
+
+    tal_mutex_lock(sg_aec->mutex);
+    is_ready = sg_aec->est_ready;
+    tal_mutex_unlock(sg_aec->mutex);
+    if (!is_ready) {
+        return;
+    }
+
+    delay = __aec_delay_estimate(sg_aec);
+
+    tal_mutex_lock(sg_aec->mutex);
+    if (delay >= 0) {
+        sg_aec->delay_new = (uint32_t)delay;
+        sg_aec->is_delay_new = true;
+    }
+    sg_aec->est_ready = false;
+    tal_mutex_unlock(sg_aec->mutex);
+}
+
+/**
+ * @brief Clears the adaptive filter and the delay estimate.
+ * @param None
+ * @return None
+ */
+void ai_audio_aec_reset(void)
+{
+    if (NULL == sg_aec) {
+        return;
+    }
+
+    tal_mutex_lock(sg_aec->mutex);
+    memset(sg_aec->w, 0, sizeof(sg_aec->w));
+    sg_aec->delay = 0;
+    sg_aec->delay_cand = 0;
+    sg_aec->is_delay_new = false;
+    sg_aec->dt_hold = 0;
+    sg_aec->is_dt_seen = false;
+    sg_aec->is_delay_found = false;
+    sg_aec->ed_avg = 0;
+    sg_aec->ee_avg = 0;
+    tal_mutex_unlock(sg_aec->mutex);
+}
+
+/**
+ * @brief Gets the echo canceller statistics.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_aec_get_stats(AI_AUDIO_AEC_STATS_T *stats)
+{
+    if (NULL == sg_aec || NULL == stats) {
+        return OPRT_INVALID_PARM;
+    }
+
+    memcpy(stats, &sg_aec->stats, sizeof(AI_AUDIO_AEC_STATS_T));
+
+    return OPRT_OK;
+}
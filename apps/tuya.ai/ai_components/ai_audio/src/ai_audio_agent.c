@@ -23,6 +23,8 @@
 
 #include "ai_audio.h"
 #include "ai_audio_debug.h"
+#include "ai_audio_encoder.h"
+#include "ai_audio_decoder.h"
 
 /***********************************************************
 ************************macro define************************
@@ -39,6 +41,10 @@
 #define TY_AI_CHAT_ID_US_AUDIO 2
 #define TY_AI_CHAT_ID_US_TEXT  4
 
+#define AI_AGENT_UPLOAD_SAMPLE_RATE 16000
+#define AI_AGENT_UPLOAD_QUEUE_MAX   100  // frames waiting for the biz thread, 2 s of 20 ms frames
+#define AI_AGENT_UPLOAD_DRAIN_MS    1000 // the upload end waits for the queued frames before its events
+
 /***********************************************************
 ***********************typedef define***********************
 ***********************************************************/
@@ -51,7 +57,38 @@ typedef struct {
     AI_AGENT_CBS_T           cbs;
     AI_AGENT_CHAT_STREAM_E   stream_status;
     bool                     is_audio_upload_first_frame;
+    AI_AUDIO_CODEC_TYPE      tts_codec;    // codec the cloud picked for the current tts stream
 } AI_AGENT_SESSION_T;
+
+typedef struct {
+    AI_AUDIO_CODEC_TYPE      codec_type;   // configured codec
+    const AI_AUDIO_ENCODER_T *enc;         // NULL when uploading pcm
+    void                    *enc_hdl;
+    uint8_t                 *out_buf;
+    uint32_t                 out_buf_len;
+    int16_t                 *pend_buf;     // tail of the last upload shorter than a frame
+    uint32_t                 pend_samples;
+    uint32_t                 in_bytes;
+    uint32_t                 out_bytes;
+} AI_AGENT_UPLOAD_ENC_T;
+
+typedef struct ai_agent_upload_pkt {
+    struct ai_agent_upload_pkt *next;
+    AI_AUDIO_CODEC_TYPE      codec_type;
+    AI_STREAM_TYPE           stream_flag;
+    SYS_TIME_T               timestamp;
+    uint32_t                 len;
+    uint8_t                  data[];
+} AI_AGENT_UPLOAD_PKT_T;
+
+// frames are sent by the biz thread once notified, the caller does not wait for the link
+typedef struct {
+    MUTEX_HANDLE             mutex;
+    SEM_HANDLE               end_sem;      // posted once the end of a stream is sent
+    AI_AGENT_UPLOAD_PKT_T   *head;
+    AI_AGENT_UPLOAD_PKT_T   *tail;
+    uint32_t                 num;
+} AI_AGENT_UPLOAD_QUEUE_T;
 // clang-format on
 /***********************************************************
 ********************function declaration********************
@@ -61,6 +98,8 @@ typedef struct {
 ***********************variable define**********************
 ***********************************************************/
 static AI_AGENT_SESSION_T sg_ai = {0};
+static AI_AGENT_UPLOAD_ENC_T sg_upload_enc = {.codec_type = AI_AGENT_UPLOAD_CODEC};
+static AI_AGENT_UPLOAD_QUEUE_T sg_upload_q = {0};
 
 /***********************************************************
 ***********************function define**********************
@@ -68,7 +107,8 @@ static AI_AGENT_SESSION_T sg_ai = {0};
 static OPERATE_RET __ai_agent_audio_recv(AI_BIZ_ATTR_INFO_T *attr, AI_BIZ_HEAD_INFO_T *head, char *data, void *usr_data)
 {
 
-    if (!head || !attr || !data) {
+    // attr is NULL for continuation fragments in stream recv mode
+    if (!head || !data) {
         PR_ERR("invalid param");
         return OPRT_COM_ERROR;
     }
@@ -82,6 +122,8 @@ static OPERATE_RET __ai_agent_audio_recv(AI_BIZ_ATTR_INFO_T *attr, AI_BIZ_HEAD_I
 
     switch (head->stream_flag) {
     case AI_STREAM_START: {
+        sg_ai.tts_codec = (attr && AI_HAS_ATTR == attr->flag) ? attr->value.audio.base.codec_type : AUDIO_CODEC_MP3;
+
         AI_AGENT_MSG_T ai_msg = {
             .type = AI_AGENT_MSG_TP_AUDIO_START,
             .data_len = len,
@@ -346,6 +388,67 @@ static OPERATE_RET __ai_agent_event_recv(AI_EVENT_TYPE type, AI_SESSION_ID sessi
     return OPRT_OK;
 }
 
+static OPERATE_RET __ai_agent_upload_get(AI_BIZ_ATTR_INFO_T *attr, AI_BIZ_HEAD_INFO_T *head, char **data)
+{
+    AI_AGENT_UPLOAD_PKT_T *pkt = NULL;
+
+    tal_mutex_lock(sg_upload_q.mutex);
+    pkt = sg_upload_q.head;
+    if (pkt) {
+        sg_upload_q.head = pkt->next;
+        if (NULL == sg_upload_q.head) {
+            sg_upload_q.tail = NULL;
+        }
+        sg_upload_q.num--;
+    }
+    tal_mutex_unlock(sg_upload_q.mutex);
+    if (NULL == pkt) {
+        return OPRT_NOT_FOUND;
+    }
+
+    attr->flag = AI_HAS_ATTR;
+    attr->type = AI_PT_AUDIO;
+    attr->value.audio.base.codec_type = pkt->codec_type;
+    attr->value.audio.base.sample_rate = AI_AGENT_UPLOAD_SAMPLE_RATE;
+    attr->value.audio.base.channels = AUDIO_CHANNELS_MONO;
+    attr->value.audio.base.bit_depth = 16;
+    head->value.audio.timestamp = pkt->timestamp;
+    head->value.audio.pts = 0;
+    head->stream_flag = pkt->stream_flag;
+    head->len = pkt->len;
+    // the end of a stream has no data, the buffer still goes back through the free cb
+    *data = (char *)pkt->data;
+
+    return OPRT_OK;
+}
+
+static void __ai_agent_upload_free(char *data)
+{
+    AI_AGENT_UPLOAD_PKT_T *pkt = (AI_AGENT_UPLOAD_PKT_T *)(data - offsetof(AI_AGENT_UPLOAD_PKT_T, data));
+
+    if (AI_STREAM_END == pkt->stream_flag) {
+        tal_semaphore_post(sg_upload_q.end_sem);
+    }
+    tal_free(pkt);
+}
+
+static void __ai_agent_upload_clear(void)
+{
+    AI_AGENT_UPLOAD_PKT_T *pkt = NULL;
+
+    tal_mutex_lock(sg_upload_q.mutex);
+    while (sg_upload_q.head) {
+        pkt = sg_upload_q.head;
+        sg_upload_q.head = pkt->next;
+        tal_free(pkt);
+    }
+    sg_upload_q.tail = NULL;
+    sg_upload_q.num = 0;
+    tal_mutex_unlock(sg_upload_q.mutex);
+    // the end of an upload that timed out may have been sent since
+    tal_semaphore_wait(sg_upload_q.end_sem, 0);
+}
+
 static OPERATE_RET __ai_agent_session_create(void)
 {
     OPERATE_RET rt = OPRT_OK;
@@ -356,8 +459,9 @@ static OPERATE_RET __ai_agent_session_create(void)
     cfg.send_num = TY_AI_CHAT_ID_DS_CNT;
     cfg.send[0].type = AI_PT_AUDIO;
     cfg.send[0].id = TY_AI_CHAT_ID_DS_AUDIO;
-    cfg.send[0].get_cb = NULL;
-    cfg.send[0].free_cb = NULL;
+    cfg.send[0].get_cb = __ai_agent_upload_get;
+    cfg.send[0].free_cb = __ai_agent_upload_free;
+    cfg.send[0].mode = AI_BIZ_SEND_NOTIFY;
     cfg.send[1].type = AI_PT_VIDEO;
     cfg.send[1].id = TY_AI_CHAT_ID_DS_VIDEO;
     cfg.send[1].get_cb = NULL;
@@ -381,11 +485,10 @@ static OPERATE_RET __ai_agent_session_create(void)
 
     cfg.event_cb = __ai_agent_event_recv;
 
-    // 支持的tts格式
-    char attr_tts_order[128] = {0};
-    snprintf(attr_tts_order, 128,
-             "{\"tts.order.supports\":[{\"format\":\"mp3\",\"container\":\"\",\"sampleRate\":16000,\"bitDepth\":\"16\","
-             "\"channels\":1}]}");
+    // 支持的tts格式, cheapest decoder first
+    char attr_tts_order[384] = {0};
+    TUYA_CALL_ERR_RETURN(ai_audio_decoder_get_tts_supports(attr_tts_order, sizeof(attr_tts_order)));
+    PR_DEBUG("tts supports: %s", attr_tts_order);
 
     AI_ATTRIBUTE_T attr[2] = {{
                                   .type = 1003,
@@ -483,6 +586,11 @@ OPERATE_RET ai_audio_agent_init(AI_AGENT_CBS_T *cbs)
         memcpy(&sg_ai.cbs, cbs, sizeof(AI_AGENT_CBS_T));
     }
 
+    if (NULL == sg_upload_q.mutex) {
+        TUYA_CALL_ERR_RETURN(tal_mutex_create_init(&sg_upload_q.mutex));
+        TUYA_CALL_ERR_RETURN(tal_semaphore_create_init(&sg_upload_q.end_sem, 0, 1));
+    }
+
     PR_DEBUG("ai session wait for mqtt connected...");
 
     tal_event_subscribe(EVENT_MQTT_CONNECTED, "ai_agent_init", __ai_agent_init, SUBSCRIBE_TYPE_ONETIME);
@@ -490,6 +598,199 @@ OPERATE_RET ai_audio_agent_init(AI_AGENT_CBS_T *cbs)
     return rt;
 }
 
+static OPERATE_RET __ai_agent_upload_send(AI_AUDIO_CODEC_TYPE codec_type, uint8_t *data, uint32_t len)
+{
+    AI_AGENT_UPLOAD_PKT_T *pkt = NULL;
+
+    if (NULL == data) {
+        len = 0;
+    }
+    pkt = (AI_AGENT_UPLOAD_PKT_T *)tal_malloc(sizeof(AI_AGENT_UPLOAD_PKT_T) + len);
+    TUYA_CHECK_NULL_RETURN(pkt, OPRT_MALLOC_FAILED);
+    pkt->next = NULL;
+    pkt->codec_type = codec_type;
+    pkt->timestamp = tal_system_get_millisecond();
+    pkt->len = len;
+    if (len) {
+        memcpy(pkt->data, data, len);
+    }
+
+    if (sg_ai.is_audio_upload_first_frame) {
+        pkt->stream_flag = AI_STREAM_START;
+        sg_ai.is_audio_upload_first_frame = false;
+    } else if (NULL == data) {
+        pkt->stream_flag = AI_STREAM_END;
+        sg_ai.is_audio_upload_first_frame = true;
+    } else {
+        pkt->stream_flag = AI_STREAM_ING;
+    }
+
+    PR_DEBUG("tuya ai upload data[%d][%d]...", pkt->stream_flag, len);
+
+    tal_mutex_lock(sg_upload_q.mutex);
+    // the link is behind, the end of the stream is still queued so the cloud sees it
+    if ((sg_upload_q.num >= AI_AGENT_UPLOAD_QUEUE_MAX) && (AI_STREAM_END != pkt->stream_flag)) {
+        tal_mutex_unlock(sg_upload_q.mutex);
+        PR_WARN("upload queue full, drop %d bytes", len);
+        tal_free(pkt);
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+    if (sg_upload_q.tail) {
+        sg_upload_q.tail->next = pkt;
+    } else {
+        sg_upload_q.head = pkt;
+    }
+    sg_upload_q.tail = pkt;
+    sg_upload_q.num++;
+    tal_mutex_unlock(sg_upload_q.mutex);
+
+    return tuya_ai_biz_send_notify(TY_AI_CHAT_ID_DS_AUDIO);
+}
+
+static void __ai_agent_upload_enc_close(void)
+{
+    if (sg_upload_enc.enc && sg_upload_enc.enc_hdl) {
+        sg_upload_enc.enc->destroy(sg_upload_enc.enc_hdl);
+    }
+    if (sg_upload_enc.out_buf) {
+        tal_free(sg_upload_enc.out_buf);
+    }
+    if (sg_upload_enc.pend_buf) {
+        tal_free(sg_upload_enc.pend_buf);
+    }
+    sg_upload_enc.enc = NULL;
+    sg_upload_enc.enc_hdl = NULL;
+    sg_upload_enc.out_buf = NULL;
+    sg_upload_enc.out_buf_len = 0;
+    sg_upload_enc.pend_buf = NULL;
+    sg_upload_enc.pend_samples = 0;
+}
+
+static void __ai_agent_upload_enc_open(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    const AI_AUDIO_ENCODER_T *enc = NULL;
+
+    sg_upload_enc.pend_samples = 0;
+    sg_upload_enc.in_bytes = 0;
+    sg_upload_enc.out_bytes = 0;
+
+    if (AUDIO_CODEC_PCM == sg_upload_enc.codec_type) {
+        __ai_agent_upload_enc_close();
+        return;
+    }
+
+    enc = ai_audio_encoder_find(sg_upload_enc.codec_type);
+    if (NULL == enc) {
+        PR_NOTICE("upload codec %d not registered, fall back to adpcm", sg_upload_enc.codec_type);
+        enc = ai_audio_encoder_find(AUDIO_CODEC_ADPCM);
+    }
+
+    // the encoder is kept across uploads, only its stream state is reset
+    if (enc == sg_upload_enc.enc) {
+        if (enc->reset) {
+            enc->reset(sg_upload_enc.enc_hdl);
+        }
+        return;
+    }
+
+    __ai_agent_upload_enc_close();
+    TUYA_CALL_ERR_GOTO(enc->create(AI_AGENT_UPLOAD_SAMPLE_RATE, AUDIO_CHANNELS_MONO, &sg_upload_enc.enc_hdl), __ERR);
+    sg_upload_enc.enc = enc;
+    if (enc->frame_samples) {
+        sg_upload_enc.pend_buf = (int16_t *)tal_malloc(enc->frame_samples * sizeof(int16_t));
+        TUYA_CHECK_NULL_GOTO(sg_upload_enc.pend_buf, __ERR);
+    }
+    PR_DEBUG("upload audio codec: %s", enc->name);
+    return;
+
+__ERR:
+    PR_ERR("open upload encoder failed, upload pcm");
+    __ai_agent_upload_enc_close();
+}
+
+static OPERATE_RET __ai_agent_upload_encode(const int16_t *pcm, uint32_t samples)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t out_len = 0;
+    uint32_t need = sg_upload_enc.enc->get_max_out_len(samples);
+
+    if (need > sg_upload_enc.out_buf_len) {
+        if (sg_upload_enc.out_buf) {
+            tal_free(sg_upload_enc.out_buf);
+        }
+        sg_upload_enc.out_buf_len = 0;
+        sg_upload_enc.out_buf = (uint8_t *)tal_malloc(need);
+        TUYA_CHECK_NULL_RETURN(sg_upload_enc.out_buf, OPRT_MALLOC_FAILED);
+        sg_upload_enc.out_buf_len = need;
+    }
+
+    TUYA_CALL_ERR_RETURN(sg_upload_enc.enc->encode(sg_upload_enc.enc_hdl, pcm, samples, sg_upload_enc.out_buf,
+                                                   sg_upload_enc.out_buf_len, &out_len));
+    sg_upload_enc.out_bytes += out_len;
+
+    return __ai_agent_upload_send(sg_upload_enc.enc->codec_type, sg_upload_enc.out_buf, out_len);
+}
+
+static OPERATE_RET __ai_agent_upload_encode_data(uint8_t *data, uint32_t len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    const int16_t *pcm = (const int16_t *)data;
+    uint32_t samples = len / sizeof(int16_t);
+    uint32_t frame = sg_upload_enc.enc->frame_samples;
+    uint32_t fill = 0;
+
+    sg_upload_enc.in_bytes += len;
+
+    if (0 == frame) {
+        return __ai_agent_upload_encode(pcm, samples);
+    }
+
+    // complete the frame left over from the last upload
+    if (sg_upload_enc.pend_samples) {
+        fill = GET_MIN_LEN(frame - sg_upload_enc.pend_samples, samples);
+        memcpy(sg_upload_enc.pend_buf + sg_upload_enc.pend_samples, pcm, fill * sizeof(int16_t));
+        sg_upload_enc.pend_samples += fill;
+        pcm += fill;
+        samples -= fill;
+        if (sg_upload_enc.pend_samples < frame) {
+            return OPRT_OK;
+        }
+        sg_upload_enc.pend_samples = 0;
+        TUYA_CALL_ERR_RETURN(__ai_agent_upload_encode(sg_upload_enc.pend_buf, frame));
+    }
+
+    // whole frames are encoded straight from the capture buffer
+    while (samples >= frame) {
+        TUYA_CALL_ERR_RETURN(__ai_agent_upload_encode(pcm, frame));
+        pcm += frame;
+        samples -= frame;
+    }
+
+    if (samples) {
+        memcpy(sg_upload_enc.pend_buf, pcm, samples * sizeof(int16_t));
+        sg_upload_enc.pend_samples = samples;
+    }
+
+    return rt;
+}
+
+static OPERATE_RET __ai_agent_upload_encode_flush(void)
+{
+    uint32_t frame = sg_upload_enc.enc->frame_samples;
+
+    if (0 == sg_upload_enc.pend_samples) {
+        return OPRT_OK;
+    }
+
+    // pad the last frame with silence
+    memset(sg_upload_enc.pend_buf + sg_upload_enc.pend_samples, 0,
+           (frame - sg_upload_enc.pend_samples) * sizeof(int16_t));
+    sg_upload_enc.pend_samples = 0;
+
+    return __ai_agent_upload_encode(sg_upload_enc.pend_buf, frame);
+}
+
 /**
  * @brief Starts the AI audio upload process.
  * @param enable_vad Flag to enable cloud vad.
@@ -532,7 +833,10 @@ OPERATE_RET ai_audio_agent_upload_start(uint8_t enable_vad)
         return rt;
     }
 
+    // frames of an upload which never got its end are not sent into the new one
+    __ai_agent_upload_clear();
     sg_ai.is_audio_upload_first_frame = true;
+    __ai_agent_upload_enc_open();
     PR_DEBUG("upload start event_id:%s", sg_ai.event_id);
 
     return rt;
@@ -552,45 +856,35 @@ OPERATE_RET ai_audio_agent_upload_data(uint8_t *data, uint32_t len)
     ai_audio_debug_data((char *)data, len);
 #endif
 
-    // send data use tuya_ai_send_biz_pkt, pcm
-    AI_BIZ_ATTR_INFO_T attr = {
-        .flag = AI_HAS_ATTR,
-        .type = AI_PT_AUDIO,
-        .value.audio =
-            {
-                .base.codec_type = AUDIO_CODEC_PCM,
-                .base.sample_rate = 16000,
-                .base.channels = AUDIO_CHANNELS_MONO,
-                .base.bit_depth = 16,
-                .option.user_len = 0,
-                .option.user_data = NULL,
-                .option.session_id_list = NULL,
-            },
-    };
-    AI_BIZ_HEAD_INFO_T head = {
-        .value.audio =
-            {
-                .timestamp = tal_system_get_millisecond(),
-                .pts = 0,
-            },
-        .len = len,
-    };
+    if (NULL == sg_upload_enc.enc) {
+        return __ai_agent_upload_send(AUDIO_CODEC_PCM, data, len);
+    }
 
-    if (sg_ai.is_audio_upload_first_frame) {
-        head.stream_flag = AI_STREAM_START;
-        sg_ai.is_audio_upload_first_frame = false;
-    } else if (NULL == data) {
-        head.stream_flag = AI_STREAM_END;
-        sg_ai.is_audio_upload_first_frame = true;
-    } else {
-        head.stream_flag = AI_STREAM_ING;
+    if (data) {
+        return __ai_agent_upload_encode_data(data, len);
     }
 
-    PR_DEBUG("tuya ai upload data[%d][%d]...", head.stream_flag, len);
+    TUYA_CALL_ERR_LOG(__ai_agent_upload_encode_flush());
+    PR_DEBUG("upload %s pcm:%u bytes, encoded:%u bytes", sg_upload_enc.enc->name, sg_upload_enc.in_bytes,
+             sg_upload_enc.out_bytes);
 
-    TUYA_CALL_ERR_RETURN(tuya_ai_send_biz_pkt(TY_AI_CHAT_ID_DS_AUDIO, &attr, AI_PT_AUDIO, &head, (char *)data));
+    return __ai_agent_upload_send(sg_upload_enc.enc->codec_type, NULL, 0);
+}
 
-    return rt;
+/**
+ * @brief Selects the codec of uploaded audio, takes effect at the next upload start.
+ * @param codec_type AUDIO_CODEC_PCM, AUDIO_CODEC_OPUS, AUDIO_CODEC_ADPCM or any registered codec.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_agent_set_upload_codec(AI_AUDIO_CODEC_TYPE codec_type)
+{
+    if (codec_type > AUDIO_CODEC_MAX || codec_type < AUDIO_CODEC_ADPCM) {
+        return OPRT_INVALID_PARM;
+    }
+
+    sg_upload_enc.codec_type = codec_type;
+
+    return OPRT_OK;
 }
 
 /**
@@ -609,6 +903,10 @@ OPERATE_RET ai_audio_agent_upload_stop(void)
 #endif
 
     TUYA_CALL_ERR_RETURN(ai_audio_agent_upload_data(NULL, 0));
+    // the payloads end event must follow the last queued frame
+    if (OPRT_OK != tal_semaphore_wait(sg_upload_q.end_sem, AI_AGENT_UPLOAD_DRAIN_MS)) {
+        PR_WARN("upload end not sent in %d ms", AI_AGENT_UPLOAD_DRAIN_MS);
+    }
 
     AI_ATTRIBUTE_T attr[] = {{
         .type = 1002,
@@ -654,3 +952,13 @@ OPERATE_RET ai_audio_agent_chat_intrrupt(void)
 
     return rt;
 }
+
+/**
+ * @brief Gets the codec of the current TTS stream, as picked by the cloud.
+ * @param None
+ * @return AI_AUDIO_CODEC_TYPE - The codec, AUDIO_CODEC_MP3 when the stream did not name one.
+ */
+AI_AUDIO_CODEC_TYPE ai_audio_agent_get_tts_codec(void)
+{
+    return sg_ai.tts_codec;
+}
@@ -20,10 +20,8 @@
 ***********************************************************/
 #define AI_AUDIO_UPLOAD_VAD_TM_MS (300 + 300)
 
-#define AI_AUDIO_RB_TIME_MS          (10 * 1000)
-#define AI_AUDIO_UPLOAD_MIN_TIME_MS  (100)
-#define AI_AUDIO_UPLOAD_BUFF_TIME_MS (100)
-#define AI_AUDIO_WAIT_ASR_TM_MS      (10 * 1000)
+#define AI_AUDIO_RB_TIME_MS     (10 * 1000)
+#define AI_AUDIO_WAIT_ASR_TM_MS (10 * 1000)
 
 #define AI_CLOUD_ASR_EVENT(event)                                                                                      \
     do {                                                                                                               \
@@ -72,6 +70,8 @@ typedef struct {
     TIMER_ID                    upload_timer_id;
     uint8_t                    *upload_buffer;
     uint32_t                    upload_buffer_len;
+    uint32_t                    packet_len;
+    AI_CLOUD_ASR_UPLOAD_STATS_T stats;
 
 } AI_AUDIO_CLOUD_ASR_T;
 // clang-format on
@@ -104,6 +104,50 @@ static void __ai_audio_wait_cloud_asr_tm_cb(TIMER_ID timer_id, void *arg)
     return;
 }
 
+// the packet size may be changed by ai_audio_cloud_asr_set_packet from another task
+static uint32_t __ai_audio_cloud_asr_get_packet_len(void)
+{
+    uint32_t packet_len = 0;
+
+    tal_mutex_lock(sg_ai_cloud_asr.mutex);
+    packet_len = sg_ai_cloud_asr.packet_len;
+    tal_mutex_unlock(sg_ai_cloud_asr.mutex);
+
+    return packet_len;
+}
+
+static uint32_t __ai_audio_cloud_asr_upload_packet(uint32_t packet_len)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t upload_len = 0;
+    AI_AUDIO_FRAME_T frame;
+
+    upload_len = GET_MIN_LEN(ai_audio_get_input_data_size(), packet_len);
+    if (0 == upload_len) {
+        return 0;
+    }
+
+    // the packet is sent straight from the mic frames, only one wrapping around the end of the pool is copied
+    if (OPRT_OK == ai_audio_get_input_frame(upload_len, &frame)) {
+        TUYA_CALL_ERR_LOG(ai_audio_agent_upload_data(frame.data, upload_len));
+        ai_audio_put_input_frame(&frame);
+    } else {
+        upload_len = ai_audio_get_input_data(sg_ai_cloud_asr.upload_buffer, upload_len);
+        if (0 == upload_len) {
+            return 0;
+        }
+        TUYA_CALL_ERR_LOG(ai_audio_agent_upload_data(sg_ai_cloud_asr.upload_buffer, upload_len));
+    }
+
+    sg_ai_cloud_asr.stats.packets++;
+    sg_ai_cloud_asr.stats.bytes += upload_len;
+    if (upload_len < packet_len) {
+        sg_ai_cloud_asr.stats.flush_packets++;
+    }
+
+    return upload_len;
+}
+
 static void __ai_audio_cloud_asr_task(void *arg)
 {
     static AI_CLOUD_ASR_STATE_E last_state;
@@ -177,24 +221,19 @@ static void __ai_audio_cloud_asr_task(void *arg)
             }
         } break;
         case AI_CLOUD_ASR_EVT_UPLOADING: {
-            uint32_t upload_len = 0;
-            uint32_t input_data_size = ai_audio_get_input_data_size();
-
-            if (false == sg_ai_cloud_asr.is_uploading) {
-                break;
-            }
+            uint32_t packet_len = __ai_audio_cloud_asr_get_packet_len();
 
-            if (input_data_size < AI_AUDIO_VOICE_FRAME_LEN_GET(AI_AUDIO_UPLOAD_MIN_TIME_MS)) {
-                // wait receive data
-                break;
+            // only full packets while speaking, a backlog such as the pre-roll after wakeup goes out at once
+            while (true == sg_ai_cloud_asr.is_uploading && ai_audio_get_input_data_size() >= packet_len) {
+                if (0 == __ai_audio_cloud_asr_upload_packet(packet_len)) {
+                    break;
+                }
             }
-
-            upload_len = ai_audio_get_input_data(sg_ai_cloud_asr.upload_buffer, sg_ai_cloud_asr.upload_buffer_len);
-            TUYA_CALL_ERR_LOG(ai_audio_agent_upload_data(sg_ai_cloud_asr.upload_buffer, upload_len));
         } break;
         case AI_CLOUD_ASR_EVT_STOP: {
             uint32_t upload_len = 0;
             uint32_t input_data_size = 0;
+            uint32_t packet_len = 0;
 
             if (false == sg_ai_cloud_asr.is_uploading) {
                 break;
@@ -202,19 +241,21 @@ static void __ai_audio_cloud_asr_task(void *arg)
 
             input_data_size = ai_audio_get_input_data_size();
 
+            packet_len = __ai_audio_cloud_asr_get_packet_len();
+
             PR_NOTICE("AI_CLOUD_ASR_UPLOAD_STATE_STOP size:%d", input_data_size);
 
+            // end of speech: flush the tail right away, the last packet may be short
             while (input_data_size) {
                 if (false == sg_ai_cloud_asr.is_uploading) {
                     break;
                 }
 
-                upload_len = ai_audio_get_input_data(sg_ai_cloud_asr.upload_buffer, sg_ai_cloud_asr.upload_buffer_len);
+                upload_len = __ai_audio_cloud_asr_upload_packet(packet_len);
                 if (0 == upload_len) {
                     break;
                 }
 
-                TUYA_CALL_ERR_LOG(ai_audio_agent_upload_data(sg_ai_cloud_asr.upload_buffer, upload_len));
                 if (input_data_size <= upload_len) {
                     break;
                 }
@@ -244,8 +285,9 @@ OPERATE_RET ai_audio_cloud_asr_init(void)
 
     memset(&sg_ai_cloud_asr, 0, sizeof(AI_AUDIO_CLOUD_ASR_T));
 
-    // upload buffer init
-    sg_ai_cloud_asr.upload_buffer_len = AI_AUDIO_VOICE_FRAME_LEN_GET(AI_AUDIO_UPLOAD_BUFF_TIME_MS);
+    // upload buffer init, sized for the longest packet so the packet size can change at runtime
+    sg_ai_cloud_asr.upload_buffer_len = AI_AUDIO_VOICE_FRAME_LEN_GET(AI_AUDIO_UPLOAD_PACKET_MAX_MS);
+    sg_ai_cloud_asr.packet_len = AI_AUDIO_VOICE_FRAME_LEN_GET(AI_AUDIO_UPLOAD_PACKET_MS);
     sg_ai_cloud_asr.upload_buffer = (uint8_t *)tkl_system_psram_malloc(sg_ai_cloud_asr.upload_buffer_len);
     TUYA_CHECK_NULL_GOTO(sg_ai_cloud_asr.upload_buffer, __ERR);
 
@@ -422,4 +464,50 @@ OPERATE_RET ai_audio_cloud_is_wait_asr(void)
     } else {
         return false;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Sets how much audio is sent per uplink packet, takes effect at the next packet.
+ * @param latency_ms Audio per packet, AI_AUDIO_UPLOAD_PACKET_MIN_MS to AI_AUDIO_UPLOAD_PACKET_MAX_MS.
+ * @param max_len Upper bound of pcm bytes per packet, 0 for no bound beyond the latency.
+ * @return OPERATE_RET - OPRT_OK if the operation is successful, otherwise an error code.
+ */
+OPERATE_RET ai_audio_cloud_asr_set_packet(uint32_t latency_ms, uint32_t max_len)
+{
+    uint32_t packet_len = 0;
+
+    if (latency_ms < AI_AUDIO_UPLOAD_PACKET_MIN_MS || latency_ms > AI_AUDIO_UPLOAD_PACKET_MAX_MS) {
+        return OPRT_INVALID_PARM;
+    }
+
+    packet_len = AI_AUDIO_VOICE_FRAME_LEN_GET(latency_ms);
+    if (max_len) {
+        // packets hold whole capture frames
+        if (max_len < AI_AUDIO_PCM_FRAME_SIZE) {
+            return OPRT_INVALID_PARM;
+        }
+        packet_len = GET_MIN_LEN(packet_len, max_len / AI_AUDIO_PCM_FRAME_SIZE * AI_AUDIO_PCM_FRAME_SIZE);
+    }
+
+    tal_mutex_lock(sg_ai_cloud_asr.mutex);
+    sg_ai_cloud_asr.packet_len = packet_len;
+    tal_mutex_unlock(sg_ai_cloud_asr.mutex);
+
+    PR_DEBUG("cloud asr packet %d ms, %d bytes", latency_ms, packet_len);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Gets the uplink packet statistics.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK if the operation is successful, otherwise an error code.
+ */
+OPERATE_RET ai_audio_cloud_asr_get_upload_stats(AI_CLOUD_ASR_UPLOAD_STATS_T *stats)
+{
+    TUYA_CHECK_NULL_RETURN(stats, OPRT_INVALID_PARM);
+
+    memcpy(stats, &sg_ai_cloud_asr.stats, sizeof(AI_CLOUD_ASR_UPLOAD_STATS_T));
+
+    return OPRT_OK;
+}
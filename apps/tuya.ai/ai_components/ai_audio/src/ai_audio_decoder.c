@@ -0,0 +1,424 @@
+/**
+ * @file ai_audio_decoder.c
+ * @brief Implements the TTS audio decoder registry and the built-in MP3 and PCM decoders.
+ *
+ * Raw PCM costs a copy to play but eight times the bandwidth of MP3, so it is
+ * only advertised to devices that declare the bandwidth for it. MP3 is decoded
+ * with minimp3.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tkl_memory.h"
+#include "tal_api.h"
+
+#include "minimp3.h"
+#include "ai_audio_decoder.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+// one mp3 frame of audio per pcm decode call
+#define AI_PCM_DECODE_FRAME 576
+
+#define AI_DECODER_CANDIDATE_NUM (AI_AUDIO_DECODER_MAX_NUM + 2)
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    AI_AUDIO_CODEC_TYPE codec_type;
+    AI_AUDIO_DECODER_STATS_T stats;
+} AI_DECODER_STATS_ENTRY_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static const AI_AUDIO_DECODER_T *sg_decoders[AI_AUDIO_DECODER_MAX_NUM] = {0};
+
+static AI_AUDIO_DECODER_PROFILE_T sg_profile = {
+    .mem_budget = AI_AUDIO_DECODER_MEM_BUDGET,
+    .bandwidth_kbps = AI_AUDIO_DECODER_BANDWIDTH_KBPS,
+};
+
+static AI_DECODER_STATS_ENTRY_T sg_stats[AI_DECODER_CANDIDATE_NUM] = {0};
+
+static uint64_t __decoder_clock_ms(void);
+static AI_AUDIO_DECODER_CLOCK_CB sg_clock_us = __decoder_clock_ms;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static OPERATE_RET __mp3_create(uint32_t sample_rate, uint8_t channels, void **handle)
+{
+    mp3dec_t *dec = (mp3dec_t *)tkl_system_psram_malloc(sizeof(mp3dec_t));
+    TUYA_CHECK_NULL_RETURN(dec, OPRT_MALLOC_FAILED);
+
+    mp3dec_init(dec);
+
+    *handle = dec;
+    return OPRT_OK;
+}
+
+static OPERATE_RET __mp3_decode(void *handle, const uint8_t *in, uint32_t in_len, int16_t *pcm, uint32_t *consumed,
+                                uint32_t *samples)
+{
+    mp3dec_frame_info_t info;
+    int ret = 0;
+
+    ret = mp3dec_decode_frame((mp3dec_t *)handle, in, in_len, (mp3d_sample_t *)pcm, &info);
+
+    // no samples but frame bytes: an id3 tag or garbage in front of the next frame was skipped
+    *consumed = info.frame_bytes;
+    *samples = (ret > 0) ? ret : 0;
+
+    return OPRT_OK;
+}
+
+static uint32_t __mp3_probe_kbps(void *handle, const uint8_t *in, uint32_t in_len)
+{
+    mp3dec_frame_info_t info;
+
+    // parse the frame head only, no pcm output
+    if (mp3dec_decode_frame((mp3dec_t *)handle, in, in_len, NULL, &info) > 0) {
+        return info.bitrate_kbps;
+    }
+
+    return 0;
+}
+
+static void __mp3_reset(void *handle)
+{
+    mp3dec_init((mp3dec_t *)handle);
+}
+
+static void __mp3_destroy(void *handle)
+{
+    tkl_system_psram_free(handle);
+}
+
+static OPERATE_RET __pcm_create(uint32_t sample_rate, uint8_t channels, void **handle)
+{
+    // stateless
+    *handle = NULL;
+    return OPRT_OK;
+}
+
+static OPERATE_RET __pcm_decode(void *handle, const uint8_t *in, uint32_t in_len, int16_t *pcm, uint32_t *consumed,
+                                uint32_t *samples)
+{
+    uint32_t n = in_len / sizeof(int16_t);
+
+    if (n > AI_PCM_DECODE_FRAME) {
+        n = AI_PCM_DECODE_FRAME;
+    }
+
+    memcpy(pcm, in, n * sizeof(int16_t));
+
+    *consumed = n * sizeof(int16_t);
+    *samples = n;
+
+    return OPRT_OK;
+}
+
+static void __pcm_destroy(void *handle)
+{
+    return;
+}
+
+static const AI_AUDIO_DECODER_T sg_mp3_decoder = {
+    .codec_type = AUDIO_CODEC_MP3,
+    .format = "mp3",
+    .container = "",
+    .cpu_cost = 20,
+    .mem_size = sizeof(mp3dec_t),
+    .bitrate_kbps = 32,
+    .create = __mp3_create,
+    .decode = __mp3_decode,
+    .probe_kbps = __mp3_probe_kbps,
+    .reset = __mp3_reset,
+    .destroy = __mp3_destroy,
+};
+
+static const AI_AUDIO_DECODER_T sg_pcm_decoder = {
+    .codec_type = AUDIO_CODEC_PCM,
+    .format = "pcm",
+    .container = "",
+    .cpu_cost = 1,
+    .mem_size = 0,
+    .bitrate_kbps = AI_AUDIO_DECODER_SAMPLE_RATE * 16 / 1000,
+    .create = __pcm_create,
+    .decode = __pcm_decode,
+    .probe_kbps = NULL,
+    .reset = NULL,
+    .destroy = __pcm_destroy,
+};
+
+static uint64_t __decoder_clock_ms(void)
+{
+    return (uint64_t)tal_system_get_millisecond() * 1000;
+}
+
+static AI_AUDIO_DECODER_STATS_T *__decoder_stats_get(AI_AUDIO_CODEC_TYPE codec_type)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < AI_DECODER_CANDIDATE_NUM; i++) {
+        if (sg_stats[i].codec_type == codec_type) {
+            return &sg_stats[i].stats;
+        }
+        if (0 == sg_stats[i].codec_type) {
+            sg_stats[i].codec_type = codec_type;
+            return &sg_stats[i].stats;
+        }
+    }
+
+    return NULL;
+}
+
+static bool __decoder_fits(const AI_AUDIO_DECODER_T *decoder)
+{
+    if (sg_profile.mem_budget && decoder->mem_size > sg_profile.mem_budget) {
+        return false;
+    }
+
+    if (sg_profile.bandwidth_kbps && decoder->bitrate_kbps > sg_profile.bandwidth_kbps) {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Registers a TTS audio decoder.
+ * @param decoder Decoder description, must stay valid after registration.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_decoder_register(const AI_AUDIO_DECODER_T *decoder)
+{
+    uint32_t i = 0;
+
+    TUYA_CHECK_NULL_RETURN(decoder, OPRT_INVALID_PARM);
+    if (!decoder->format || !decoder->container || !decoder->create || !decoder->decode || !decoder->destroy) {
+        return OPRT_INVALID_PARM;
+    }
+
+    for (i = 0; i < AI_AUDIO_DECODER_MAX_NUM; i++) {
+        if (NULL == sg_decoders[i] || sg_decoders[i]->codec_type == decoder->codec_type) {
+            sg_decoders[i] = decoder;
+            PR_DEBUG("audio decoder %s registered", decoder->format);
+            return OPRT_OK;
+        }
+    }
+
+    return OPRT_EXCEED_UPPER_LIMIT;
+}
+
+/**
+ * @brief Finds the decoder of a codec type.
+ * @param codec_type AI protocol audio codec type.
+ * @return The decoder, or NULL if the codec is not available.
+ */
+const AI_AUDIO_DECODER_T *ai_audio_decoder_find(AI_AUDIO_CODEC_TYPE codec_type)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < AI_AUDIO_DECODER_MAX_NUM; i++) {
+        if (sg_decoders[i] && sg_decoders[i]->codec_type == codec_type) {
+            return sg_decoders[i];
+        }
+    }
+
+    // a registered decoder overrides the built-in one
+    if (AUDIO_CODEC_MP3 == codec_type) {
+        return &sg_mp3_decoder;
+    }
+    if (AUDIO_CODEC_PCM == codec_type) {
+        return &sg_pcm_decoder;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Sets the memory and bandwidth profile decoders are selected by, takes effect at the next session.
+ * @param profile The device profile.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_decoder_set_profile(const AI_AUDIO_DECODER_PROFILE_T *profile)
+{
+    TUYA_CHECK_NULL_RETURN(profile, OPRT_INVALID_PARM);
+
+    memcpy(&sg_profile, profile, sizeof(AI_AUDIO_DECODER_PROFILE_T));
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Lists the decoders that fit the profile, cheapest first.
+ * @param list Output decoders.
+ * @param num Size of the list.
+ * @return The number of decoders listed.
+ */
+uint32_t ai_audio_decoder_select(const AI_AUDIO_DECODER_T **list, uint32_t num)
+{
+    const AI_AUDIO_DECODER_T *cand[AI_DECODER_CANDIDATE_NUM];
+    const AI_AUDIO_DECODER_T *dec = NULL;
+    uint32_t cnt = 0, i = 0, j = 0;
+
+    if (NULL == list || 0 == num) {
+        return 0;
+    }
+
+    for (i = 0; i < AI_AUDIO_DECODER_MAX_NUM; i++) {
+        if (sg_decoders[i] && __decoder_fits(sg_decoders[i])) {
+            cand[cnt++] = sg_decoders[i];
+        }
+    }
+    // built-in decoders not overridden by a registered one
+    if (&sg_mp3_decoder == ai_audio_decoder_find(AUDIO_CODEC_MP3) && __decoder_fits(&sg_mp3_decoder)) {
+        cand[cnt++] = &sg_mp3_decoder;
+    }
+    if (&sg_pcm_decoder == ai_audio_decoder_find(AUDIO_CODEC_PCM) && __decoder_fits(&sg_pcm_decoder)) {
+        cand[cnt++] = &sg_pcm_decoder;
+    }
+
+    // insertion sort by cost, a handful of entries
+    for (i = 1; i < cnt; i++) {
+        dec = cand[i];
+        for (j = i; j > 0 && cand[j - 1]->cpu_cost > dec->cpu_cost; j--) {
+            cand[j] = cand[j - 1];
+        }
+        cand[j] = dec;
+    }
+
+    if (cnt > num) {
+        cnt = num;
+    }
+    memcpy(list, cand, cnt * sizeof(cand[0]));
+
+    return cnt;
+}
+
+/**
+ * @brief Builds the tts.order.supports attribute from the selected decoders.
+ *
+ * MP3 is advertised when no decoder fits the profile, the cloud always needs one format.
+ *
+ * @param buf The output buffer.
+ * @param len Size of the output buffer.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_decoder_get_tts_supports(char *buf, uint32_t len)
+{
+    const AI_AUDIO_DECODER_T *list[AI_DECODER_CANDIDATE_NUM];
+    uint32_t cnt = 0, i = 0;
+    int pos = 0, n = 0;
+
+    if (NULL == buf || 0 == len) {
+        return OPRT_INVALID_PARM;
+    }
+
+    cnt = ai_audio_decoder_select(list, CNTSOF(list));
+    if (0 == cnt) {
+        list[cnt++] = &sg_mp3_decoder;
+    }
+
+    pos = snprintf(buf, len, "{\"tts.order.supports\":[");
+    for (i = 0; i < cnt && pos < (int)len; i++) {
+        n = snprintf(buf + pos, len - pos,
+                     "%s{\"format\":\"%s\",\"container\":\"%s\",\"sampleRate\":%d,\"bitDepth\":\"16\",\"channels\":1}",
+                     i ? "," : "", list[i]->format, list[i]->container, AI_AUDIO_DECODER_SAMPLE_RATE);
+        // the least preferred formats are left out when the buffer is short, keeping room for the end
+        if (i > 0 && pos + n + 2 >= (int)len) {
+            PR_NOTICE("tts supports truncated to %d formats", i);
+            break;
+        }
+        pos += n;
+    }
+    if (pos < (int)len) {
+        pos += snprintf(buf + pos, len - pos, "]}");
+    }
+
+    if (pos >= (int)len) {
+        PR_ERR("tts supports too long for %d bytes", len);
+        return OPRT_BUFFER_NOT_ENOUGH;
+    }
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Decodes one frame and accounts its cost to the decoder statistics.
+ * @param decoder The decoder.
+ * @param handle Handle created by the decoder.
+ * @param in Coded data.
+ * @param in_len Length of the coded data.
+ * @param pcm Output pcm, holds AI_AUDIO_DECODER_PCM_MAX samples.
+ * @param consumed Output bytes of in used.
+ * @param samples Output samples written to pcm.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_decoder_decode(const AI_AUDIO_DECODER_T *decoder, void *handle, const uint8_t *in,
+                                    uint32_t in_len, int16_t *pcm, uint32_t *consumed, uint32_t *samples)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_AUDIO_DECODER_STATS_T *stats = NULL;
+    uint64_t start = 0;
+
+    if (NULL == decoder || NULL == in || NULL == pcm || NULL == consumed || NULL == samples) {
+        return OPRT_INVALID_PARM;
+    }
+
+    *consumed = 0;
+    *samples = 0;
+
+    start = sg_clock_us();
+    rt = decoder->decode(handle, in, in_len, pcm, consumed, samples);
+
+    stats = __decoder_stats_get(decoder->codec_type);
+    if (stats) {
+        stats->decode_us += sg_clock_us() - start;
+        stats->in_bytes += *consumed;
+        if (*samples) {
+            stats->frames++;
+            stats->out_samples += *samples;
+        }
+    }
+
+    return rt;
+}
+
+/**
+ * @brief Sets the clock the decode cost is measured on.
+ * @param now_us The clock, NULL for the millisecond clock.
+ * @return None
+ */
+void ai_audio_decoder_set_clock(AI_AUDIO_DECODER_CLOCK_CB now_us)
+{
+    sg_clock_us = now_us ? now_us : __decoder_clock_ms;
+}
+
+/**
+ * @brief Gets the decode cost statistics of a codec.
+ * @param codec_type AI protocol audio codec type.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_decoder_get_stats(AI_AUDIO_CODEC_TYPE codec_type, AI_AUDIO_DECODER_STATS_T *stats)
+{
+    uint32_t i = 0;
+
+    TUYA_CHECK_NULL_RETURN(stats, OPRT_INVALID_PARM);
+
+    for (i = 0; i < AI_DECODER_CANDIDATE_NUM; i++) {
+        if (sg_stats[i].codec_type == codec_type) {
+            memcpy(stats, &sg_stats[i].stats, sizeof(AI_AUDIO_DECODER_STATS_T));
+            return OPRT_OK;
+        }
+    }
+
+    memset(stats, 0, sizeof(AI_AUDIO_DECODER_STATS_T));
+
+    return OPRT_OK;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file ai_audio_encoder.c
+ * @brief Implements the uplink audio encoder registry and the IMA-ADPCM encoder.
+ *
+ * IMA-ADPCM packs every 16-bit sample into 4 bits, a quarter of the PCM
+ * bandwidth for very little CPU. Each encoded block starts with the encoder
+ * state so the receiver can decode any packet on its own, followed by the
+ * nibbles of all samples, low nibble first.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tal_api.h"
+
+#include "ai_audio_encoder.h"
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    int32_t predictor;
+    int32_t index;
+} AI_ADPCM_STATE_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static const int16_t sg_adpcm_step_tbl[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+    544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+    9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t sg_adpcm_index_tbl[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+static const AI_AUDIO_ENCODER_T *sg_encoders[AI_AUDIO_ENCODER_MAX_NUM] = {0};
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static uint8_t __adpcm_encode_sample(AI_ADPCM_STATE_T *st, int16_t sample)
+{
+    int32_t step = sg_adpcm_step_tbl[st->index];
+    int32_t diff = sample - st->predictor;
+    int32_t delta = step >> 3;
+    uint8_t code = 0;
+
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        code |= 2;
+        diff -= step;
+        delta += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        code |= 1;
+        delta += step;
+    }
+
+    // track the value the decoder will reconstruct
+    st->predictor += (code & 8) ? -delta : delta;
+    if (st->predictor > 32767) {
+        st->predictor = 32767;
+    } else if (st->predictor < -32768) {
+        st->predictor = -32768;
+    }
+
+    st->index += sg_adpcm_index_tbl[code & 7];
+    if (st->index < 0) {
+        st->index = 0;
+    } else if (st->index > 88) {
+        st->index = 88;
+    }
+
+    return code;
+}
+
+static uint32_t __adpcm_get_max_out_len(uint32_t samples)
+{
+    return AI_AUDIO_ADPCM_HEAD_LEN + (samples + 1) / 2;
+}
+
+static OPERATE_RET __adpcm_create(uint32_t sample_rate, uint8_t channels, void **handle)
+{
+    if (channels != AUDIO_CHANNELS_MONO) {
+        PR_ERR("adpcm only supports mono, channels:%d", channels);
+        return OPRT_NOT_SUPPORTED;
+    }
+
+    AI_ADPCM_STATE_T *st = (AI_ADPCM_STATE_T *)tal_malloc(sizeof(AI_ADPCM_STATE_T));
+    TUYA_CHECK_NULL_RETURN(st, OPRT_MALLOC_FAILED);
+    memset(st, 0, sizeof(AI_ADPCM_STATE_T));
+
+    *handle = st;
+    return OPRT_OK;
+}
+
+static OPERATE_RET __adpcm_encode(void *handle, const int16_t *pcm, uint32_t samples, uint8_t *out,
+                                  uint32_t out_size, uint32_t *out_len)
+{
+    AI_ADPCM_STATE_T *st = (AI_ADPCM_STATE_T *)handle;
+    uint32_t i = 0, need = __adpcm_get_max_out_len(samples);
+    uint8_t *p = out + AI_AUDIO_ADPCM_HEAD_LEN;
+
+    if (out_size < need) {
+        return OPRT_BUFFER_NOT_ENOUGH;
+    }
+
+    out[0] = (uint8_t)(st->predictor & 0xFF);
+    out[1] = (uint8_t)((st->predictor >> 8) & 0xFF);
+    out[2] = (uint8_t)st->index;
+    out[3] = 0;
+
+    for (i = 0; i + 1 < samples; i += 2) {
+        uint8_t lo = __adpcm_encode_sample(st, pcm[i]);
+        uint8_t hi = __adpcm_encode_sample(st, pcm[i + 1]);
+        *p++ = lo | (hi << 4);
+    }
+    // an odd tail sample leaves the high nibble zero
+    if (i < samples) {
+        *p++ = __adpcm_encode_sample(st, pcm[i]);
+    }
+
+    *out_len = need;
+    return OPRT_OK;
+}
+
+static void __adpcm_reset(void *handle)
+{
+    memset(handle, 0, sizeof(AI_ADPCM_STATE_T));
+}
+
+static void __adpcm_destroy(void *handle)
+{
+    tal_free(handle);
+}
+
+static const AI_AUDIO_ENCODER_T sg_adpcm_encoder = {
+    .codec_type = AUDIO_CODEC_ADPCM,
+    .name = "ima-adpcm",
+    .frame_samples = 0,
+    .get_max_out_len = __adpcm_get_max_out_len,
+    .create = __adpcm_create,
+    .encode = __adpcm_encode,
+    .reset = __adpcm_reset,
+    .destroy = __adpcm_destroy,
+};
+
+/**
+ * @brief Registers an uplink audio encoder.
+ * @param encoder Encoder description, must stay valid after registration.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_encoder_register(const AI_AUDIO_ENCODER_T *encoder)
+{
+    uint32_t i = 0;
+
+    TUYA_CHECK_NULL_RETURN(encoder, OPRT_INVALID_PARM);
+    if (!encoder->create || !encoder->encode || !encoder->get_max_out_len || !encoder->destroy) {
+        return OPRT_INVALID_PARM;
+    }
+
+    for (i = 0; i < AI_AUDIO_ENCODER_MAX_NUM; i++) {
+        if (NULL == sg_encoders[i] || sg_encoders[i]->codec_type == encoder->codec_type) {
+            sg_encoders[i] = encoder;
+            PR_DEBUG("audio encoder %s registered", encoder->name);
+            return OPRT_OK;
+        }
+    }
+
+    return OPRT_EXCEED_UPPER_LIMIT;
+}
+
+/**
+ * @brief Finds the encoder of a codec type.
+ * @param codec_type AI protocol audio codec type.
+ * @return The encoder, or NULL if the codec is not available.
+ */
+const AI_AUDIO_ENCODER_T *ai_audio_encoder_find(AI_AUDIO_CODEC_TYPE codec_type)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < AI_AUDIO_ENCODER_MAX_NUM; i++) {
+        if (sg_encoders[i] && sg_encoders[i]->codec_type == codec_type) {
+            return sg_encoders[i];
+        }
+    }
+
+    // a registered encoder overrides the built-in one
+    if (AUDIO_CODEC_ADPCM == codec_type) {
+        return &sg_adpcm_encoder;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,486 @@
+/**
+ * @file ai_audio_frame_pool.c
+ * @brief Implements the microphone frame pool.
+ *
+ * Frames live in one array used as a ring and are identified by a free
+ * running sequence number, the slot of a frame is its sequence number modulo
+ * the frame count. The frame being filled by the publisher is not visible to
+ * the consumers, so at most frame_num - 1 frames of history are kept.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "tkl_memory.h"
+#include "tal_api.h"
+
+#include "ai_audio_frame_pool.h"
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    bool is_used;
+    uint32_t cursor; // sequence number of the next frame to consume
+    uint32_t offset; // bytes of the cursor frame already read
+    uint32_t max_lag;
+} AI_FRAME_POOL_CONSUMER_T;
+
+typedef struct {
+    MUTEX_HANDLE mutex;
+    uint32_t frame_size;
+    uint32_t frame_num;
+    uint8_t *data;
+    uint8_t *ref; // borrow count per slot
+    uint32_t head; // sequence number of the frame being filled
+    uint32_t fill;
+    AI_FRAME_POOL_CONSUMER_T consumer[AI_AUDIO_FRAME_POOL_CONSUMER_MAX];
+    AI_AUDIO_FRAME_POOL_STATS_T stats;
+} AI_FRAME_POOL_T;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static AI_FRAME_POOL_CONSUMER_T *__frame_pool_get_consumer(AI_FRAME_POOL_T *fp, uint8_t id)
+{
+    if (NULL == fp || id >= AI_AUDIO_FRAME_POOL_CONSUMER_MAX || !fp->consumer[id].is_used) {
+        return NULL;
+    }
+
+    return &fp->consumer[id];
+}
+
+static void __frame_pool_limit_lag(AI_FRAME_POOL_T *fp)
+{
+    AI_FRAME_POOL_CONSUMER_T *c = NULL;
+    uint32_t i = 0, lag = 0;
+
+    for (i = 0; i < AI_AUDIO_FRAME_POOL_CONSUMER_MAX; i++) {
+        c = &fp->consumer[i];
+        if (!c->is_used) {
+            continue;
+        }
+        lag = fp->head - c->cursor;
+        if (lag > c->max_lag) {
+            fp->stats.overrun += lag - c->max_lag;
+            c->cursor = fp->head - c->max_lag;
+            c->offset = 0;
+        }
+    }
+}
+
+/**
+ * @brief Creates a frame pool.
+ * @param frame_size Bytes per frame.
+ * @param frame_num Number of frames, the history kept for consumers.
+ * @param pool Output pool handle.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_frame_pool_create(uint32_t frame_size, uint32_t frame_num, AI_AUDIO_FRAME_POOL_T *pool)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_FRAME_POOL_T *fp = NULL;
+
+    if (NULL == pool || 0 == frame_size || frame_num < 2) {
+        return OPRT_INVALID_PARM;
+    }
+
+    fp = (AI_FRAME_POOL_T *)tkl_system_psram_malloc(sizeof(AI_FRAME_POOL_T));
+    TUYA_CHECK_NULL_RETURN(fp, OPRT_MALLOC_FAILED);
+    memset(fp, 0, sizeof(AI_FRAME_POOL_T));
+
+    fp->frame_size = frame_size;
+    fp->frame_num = frame_num;
+
+    fp->data = (uint8_t *)tkl_system_psram_malloc(frame_size * frame_num);
+    TUYA_CHECK_NULL_GOTO(fp->data, __ERR);
+    fp->ref = (uint8_t *)tkl_system_psram_malloc(frame_num);
+    TUYA_CHECK_NULL_GOTO(fp->ref, __ERR);
+    memset(fp->ref, 0, frame_num);
+
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&fp->mutex), __ERR);
+
+    *pool = fp;
+
+    return OPRT_OK;
+
+__ERR:
+    ai_audio_frame_pool_destroy(fp);
+
+    return (OPRT_OK == rt) ? OPRT_MALLOC_FAILED : rt;
+}
+
+/**
+ * @brief Destroys a frame pool.
+ * @param pool The pool handle.
+ * @return None
+ */
+void ai_audio_frame_pool_destroy(AI_AUDIO_FRAME_POOL_T pool)
+{
+    AI_FRAME_POOL_T *fp = (AI_FRAME_POOL_T *)pool;
+
+    if (NULL == fp) {
+        return;
+    }
+
+    if (fp->mutex) {
+        tal_mutex_release(fp->mutex);
+    }
+    if (fp->ref) {
+        tkl_system_psram_free(fp->ref);
+    }
+    if (fp->data) {
+        tkl_system_psram_free(fp->data);
+    }
+    tkl_system_psram_free(fp);
+}
+
+/**
+ * @brief Adds a consumer, its cursor starts at the newest frame.
+ * @param pool The pool handle.
+ * @param max_lag Frames the consumer may lag behind, 0 or more than the pool holds means the whole pool.
+ * @param id Output consumer id.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_frame_pool_add_consumer(AI_AUDIO_FRAME_POOL_T pool, uint32_t max_lag, uint8_t *id)
+{
+    AI_FRAME_POOL_T *fp = (AI_FRAME_POOL_T *)pool;
+    uint8_t i = 0;
+
+    if (NULL == fp || NULL == id) {
+        return OPRT_INVALID_PARM;
+    }
+
+    // the slot of the frame being filled is not readable
+    if (0 == max_lag || max_lag > fp->frame_num - 1) {
+        max_lag = fp->frame_num - 1;
+    }
+
+    tal_mutex_lock(fp->mutex);
+    for (i = 0; i < AI_AUDIO_FRAME_POOL_CONSUMER_MAX; i++) {
+        if (!fp->consumer[i].is_used) {
+            fp->consumer[i].is_used = true;
+            fp->consumer[i].cursor = fp->head;
+            fp->consumer[i].offset = 0;
+            fp->consumer[i].max_lag = max_lag;
+            tal_mutex_unlock(fp->mutex);
+            *id = i;
+            return OPRT_OK;
+        }
+    }
+    tal_mutex_unlock(fp->mutex);
+
+    return OPRT_EXCEED_UPPER_LIMIT;
+}
+
+/**
+ * @brief Removes a consumer, frames it still borrows must be released first.
+ * @param pool The pool handle.
+ * @param id The consumer id.
+ * @return None
+ */
+void ai_audio_frame_pool_del_consumer(AI_AUDIO_FRAME_POOL_T pool, uint8_t id)
+{
+    AI_FRAME_POOL_T *fp = (AI_FRAME_POOL_T *)pool;
+
+    if (NULL == __frame_pool_get_consumer(fp, id)) {
+        return;
+    }
+
+    tal_mutex_lock(fp->mutex);
+    fp->consumer[id].is_used = false;
+    tal_mutex_unlock(fp->mutex);
+}
+
+/**
+ * @brief Publishes captured data, split into frames of the pool frame size.
+ *
+ * A frame becomes visible to the consumers once it is full.
+ *
+ * @param pool The pool handle.
+ * @param data The captured data.
+ * @param len Length of the data.
+ * @return The number of bytes accepted.
+ */
+uint32_t ai_audio_frame_pool_publish(AI_AUDIO_FRAME_POOL_T pool, const uint8_t *data, uint32_t len)
+{
+    AI_FRAME_POOL_T *fp = (AI_FRAME_POOL_T *)pool;
+    uint32_t done = 0, n = 0, slot = 0;
+
+    if (NULL == fp || NULL == data) {
+        return 0;
+    }
+
+    tal_mutex_lock(fp->mutex);
+    while (done < len) {
+        slot = fp->head % fp->frame_num;
+        if (0 == fp->fill) {
+            if (fp->ref[slot]) {
+                // the oldest frame is still borrowed, the new data has nowhere to go
+                fp->stats.dropped += (len - done + fp->frame_size - 1) / fp->frame_size;
+                break;
+            }
+            // the slot is about to be overwritten, move the consumers still pointing at it
+            __frame_pool_limit_lag(fp);
+        }
+
+        n = fp->frame_size - fp->fill;
+        if (n > len - done) {
+            n = len - done;
+        }
+        memcpy(fp->data + slot * fp->frame_size + fp->fill, data + done, n);
+        fp->fill += n;
+        done += n;
+
+        if (fp->fill == fp->frame_size) {
+            fp->head++;
+            fp->fill = 0;
+            fp->stats.published++;
+        }
+    }
+    fp->stats.copy_bytes += done;
+    tal_mutex_unlock(fp->mutex);
+
+    return done;
+}
+
+/**
+ * @brief Borrows data at the consumer cursor without copying it and moves the cursor past it.
+ *
+ * The data may span several frames and start or end inside a frame. It must be given back with
+ * ai_audio_frame_pool_release(). Nothing is borrowed if the data wraps around the end of the pool,
+ * the consumer reads it with ai_audio_frame_pool_read() instead.
+ *
+ * @param pool The pool handle.
+ * @param id The consumer id.
+ * @param len Bytes to borrow.
+ * @param frame Output frame.
+ * @return OPERATE_RET - OPRT_OK on success, OPRT_RECV_DA_NOT_ENOUGH if less than len is available,
+ *         OPRT_EXCEED_UPPER_LIMIT if the data is not contiguous.
+ */
+OPERATE_RET ai_audio_frame_pool_acquire(AI_AUDIO_FRAME_POOL_T pool, uint8_t id, uint32_t len,
+                                        AI_AUDIO_FRAME_T *frame)
+{
+    AI_FRAME_POOL_T *fp = (AI_FRAME_POOL_T *)pool;
+    AI_FRAME_POOL_CONSUMER_T *c = __frame_pool_get_consumer(fp, id);
+    uint32_t slot = 0, end = 0, i = 0;
+
+    if (NULL == c || NULL == frame || 0 == len) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(fp->mutex);
+    if ((fp->head - c->cursor) * fp->frame_size - c->offset < len) {
+        tal_mutex_unlock(fp->mutex);
+        return OPRT_RECV_DA_NOT_ENOUGH;
+    }
+
+    slot = c->cursor % fp->frame_num;
+    end = c->offset + len;
+    if (slot * fp->frame_size + end > fp->frame_num * fp->frame_size) {
+        tal_mutex_unlock(fp->mutex);
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+
+    frame->seq = c->cursor;
+    frame->num = (end + fp->frame_size - 1) / fp->frame_size;
+    frame->data = fp->data + slot * fp->frame_size + c->offset;
+    frame->len = len;
+    for (i = 0; i < frame->num; i++) {
+        fp->ref[slot + i]++;
+    }
+    fp->stats.borrow_cnt += frame->num;
+
+    c->cursor += end / fp->frame_size;
+    c->offset = end % fp->frame_size;
+    tal_mutex_unlock(fp->mutex);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Gives back data borrowed by ai_audio_frame_pool_acquire().
+ * @param pool The pool handle.
+ * @param frame The borrowed frame.
+ * @return None
+ */
+void ai_audio_frame_pool_release(AI_AUDIO_FRAME_POOL_T pool, AI_AUDIO_FRAME_T *frame)
+{
+    AI_FRAME_POOL_T *fp = (AI_FRAME_POOL_T *)pool;
+    uint32_t slot = 0, i = 0;
+
+    if (NULL == fp || NULL == frame || NULL == frame->data) {
+        return;
+    }
+
+    slot = frame->seq % fp->frame_num;
+
+    tal_mutex_lock(fp->mutex);
+    for (i = 0; i < frame->num; i++) {
+        if (fp->ref[slot + i]) {
+            fp->ref[slot + i]--;
+        }
+    }
+    tal_mutex_unlock(fp->mutex);
+
+    frame->data = NULL;
+}
+
+/**
+ * @brief Copies data from the consumer cursor and moves the cursor past it.
+ * @param pool The pool handle.
+ * @param id The consumer id.
+ * @param buf The output buffer.
+ * @param len Size of the output buffer.
+ * @return The number of bytes copied.
+ */
+uint32_t ai_audio_frame_pool_read(AI_AUDIO_FRAME_POOL_T pool, uint8_t id, uint8_t *buf, uint32_t len)
+{
+    AI_FRAME_POOL_T *fp = (AI_FRAME_POOL_T *)pool;
+    AI_FRAME_POOL_CONSUMER_T *c = __frame_pool_get_consumer(fp, id);
+    uint32_t done = 0, n = 0, slot = 0;
+
+    if (NULL == c || NULL == buf) {
+        return 0;
+    }
+
+    tal_mutex_lock(fp->mutex);
+    while (done < len && c->cursor != fp->head) {
+        slot = c->cursor % fp->frame_num;
+        n = fp->frame_size - c->offset;
+        if (n > len - done) {
+            n = len - done;
+        }
+        memcpy(buf + done, fp->data + slot * fp->frame_size + c->offset, n);
+        done += n;
+        c->offset += n;
+        if (c->offset == fp->frame_size) {
+            c->cursor++;
+            c->offset = 0;
+        }
+    }
+    fp->stats.copy_bytes += done;
+    tal_mutex_unlock(fp->mutex);
+
+    return done;
+}
+
+/**
+ * @brief Gets the bytes available to a consumer.
+ * @param pool The pool handle.
+ * @param id The consumer id.
+ * @return The number of bytes available.
+ */
+uint32_t ai_audio_frame_pool_available(AI_AUDIO_FRAME_POOL_T pool, uint8_t id)
+{
+    AI_FRAME_POOL_T *fp = (AI_FRAME_POOL_T *)pool;
+    AI_FRAME_POOL_CONSUMER_T *c = __frame_pool_get_consumer(fp, id);
+    uint32_t avail = 0;
+
+    if (NULL == c) {
+        return 0;
+    }
+
+    tal_mutex_lock(fp->mutex);
+    avail = (fp->head - c->cursor) * fp->frame_size - c->offset;
+    tal_mutex_unlock(fp->mutex);
+
+    return avail;
+}
+
+/**
+ * @brief Drops the oldest data of a consumer.
+ * @param pool The pool handle.
+ * @param id The consumer id.
+ * @param len Bytes to drop.
+ * @return None
+ */
+void ai_audio_frame_pool_skip(AI_AUDIO_FRAME_POOL_T pool, uint8_t id, uint32_t len)
+{
+    AI_FRAME_POOL_T *fp = (AI_FRAME_POOL_T *)pool;
+    AI_FRAME_POOL_CONSUMER_T *c = __frame_pool_get_consumer(fp, id);
+    uint32_t avail = 0;
+
+    if (NULL == c) {
+        return;
+    }
+
+    tal_mutex_lock(fp->mutex);
+    avail = (fp->head - c->cursor) * fp->frame_size - c->offset;
+    if (len > avail) {
+        len = avail;
+    }
+    len += c->offset;
+    c->cursor += len / fp->frame_size;
+    c->offset = len % fp->frame_size;
+    tal_mutex_unlock(fp->mutex);
+}
+
+/**
+ * @brief Drops all but the newest data of a consumer.
+ * @param pool The pool handle.
+ * @param id The consumer id.
+ * @param len Bytes to keep, rounded up to whole frames.
+ * @return None
+ */
+void ai_audio_frame_pool_keep(AI_AUDIO_FRAME_POOL_T pool, uint8_t id, uint32_t len)
+{
+    AI_FRAME_POOL_T *fp = (AI_FRAME_POOL_T *)pool;
+    AI_FRAME_POOL_CONSUMER_T *c = __frame_pool_get_consumer(fp, id);
+    uint32_t frames = 0;
+
+    if (NULL == c) {
+        return;
+    }
+
+    frames = (len + fp->frame_size - 1) / fp->frame_size;
+
+    tal_mutex_lock(fp->mutex);
+    if (fp->head - c->cursor > frames) {
+        c->cursor = fp->head - frames;
+        c->offset = 0;
+    }
+    tal_mutex_unlock(fp->mutex);
+}
+
+/**
+ * @brief Drops the data of all consumers.
+ * @param pool The pool handle.
+ * @return None
+ */
+void ai_audio_frame_pool_reset(AI_AUDIO_FRAME_POOL_T pool)
+{
+    AI_FRAME_POOL_T *fp = (AI_FRAME_POOL_T *)pool;
+    uint32_t i = 0;
+
+    if (NULL == fp) {
+        return;
+    }
+
+    tal_mutex_lock(fp->mutex);
+    for (i = 0; i < AI_AUDIO_FRAME_POOL_CONSUMER_MAX; i++) {
+        fp->consumer[i].cursor = fp->head;
+        fp->consumer[i].offset = 0;
+    }
+    tal_mutex_unlock(fp->mutex);
+}
+
+/**
+ * @brief Gets the pool statistics.
+ * @param pool The pool handle.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_frame_pool_get_stats(AI_AUDIO_FRAME_POOL_T pool, AI_AUDIO_FRAME_POOL_STATS_T *stats)
+{
+    AI_FRAME_POOL_T *fp = (AI_FRAME_POOL_T *)pool;
+
+    if (NULL == fp || NULL == stats) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(fp->mutex);
+    memcpy(stats, &fp->stats, sizeof(AI_AUDIO_FRAME_POOL_STATS_T));
+    tal_mutex_unlock(fp->mutex);
+
+    return OPRT_OK;
+}
@@ -21,13 +21,15 @@
 #include "tdl_audio_manage.h"
 
 #include "tal_api.h"
-#include "tuya_ringbuf.h"
 
 #include "ai_audio.h"
+#include "ai_audio_frame_pool.h"
+#include "ai_audio_aec.h"
 /***********************************************************
 ************************macro define************************
 ***********************************************************/
 #define AI_AUDIO_INPUT_RB_TIME_MS (10 * 1000)
+#define AI_AUDIO_INPUT_FRAME_NUM  (AI_AUDIO_INPUT_RB_TIME_MS / AI_AUDIO_PCM_FRAME_TM_MS + 1)
 #define AI_AUDIO_VAD_ACITVE_TM_MS (300)
 
 #define ASR_PROCE_UNIT_NUM    30
@@ -40,8 +42,7 @@ typedef struct {
     bool                is_wakeup;
     bool                is_need_inform_wakeup_stop;
     TIMER_ID            wakeup_timer_id;
-    MUTEX_HANDLE        rb_mutex;
-    TUYA_RINGBUFF_T     feed_ringbuff;
+    uint8_t             consumer_id;
     uint32_t            buff_len;
 }AI_AUDIO_INPUT_ASR_T;
 
@@ -53,8 +54,13 @@ typedef struct {
     AI_AUDIO_INPUT_STATE_E         state;
     AI_AUDIO_INPUT_VALID_METHOD_E  method;
 
-    TUYA_RINGBUFF_T                ringbuff_hdl;
-    MUTEX_HANDLE                   rb_mutex;
+    // every mic frame is stored once, the uploader and the wakeup asr read it through their own cursors
+    AI_AUDIO_FRAME_POOL_T          frame_pool;
+    uint8_t                        upload_id;
+
+    SEM_HANDLE                     frame_sem;     // posted by the mic callback for every full frame
+    uint32_t                       unnotify_len;  // bytes written since the last post
+    bool                           is_play_muted;
 
     AI_AUDIO_INPUT_ASR_T           asr;  
 
@@ -91,11 +97,20 @@ static AI_AUDIO_INPUT_INFO_T sg_audio_input;
 /***********************************************************
 ***********************function define**********************
 ***********************************************************/
+static void __ai_audio_input_notify(void)
+{
+    sg_audio_input.unnotify_len = 0;
+    if (sg_audio_input.frame_sem) {
+        tal_semaphore_post(sg_audio_input.frame_sem);
+    }
+}
+
 static void __ai_audio_asr_wakeup_timeout(TIMER_ID timer_id, void *arg)
 {
     PR_NOTICE("asr wakeup timeout");
     sg_audio_input.asr.is_wakeup = false;
     sg_audio_input.asr.is_need_inform_wakeup_stop = true;
+    __ai_audio_input_notify();
 }
 
 static OPERATE_RET __ai_audio_asr_init(void)
@@ -111,10 +126,11 @@ static OPERATE_RET __ai_audio_asr_init(void)
 
     sg_audio_input.asr.buff_len = tkl_asr_get_process_uint_size() * ASR_PROCE_UNIT_NUM;
     PR_DEBUG("sg_audio_input.asr.buff_len:%d", sg_audio_input.asr.buff_len);
-    TUYA_CALL_ERR_GOTO(tuya_ring_buff_create(sg_audio_input.asr.buff_len + tkl_asr_get_process_uint_size(),
-                                             OVERFLOW_PSRAM_STOP_TYPE, &sg_audio_input.asr.feed_ringbuff),
+    TUYA_CALL_ERR_GOTO(ai_audio_frame_pool_add_consumer(sg_audio_input.frame_pool,
+                                                        (sg_audio_input.asr.buff_len + AI_AUDIO_PCM_FRAME_SIZE - 1) /
+                                                            AI_AUDIO_PCM_FRAME_SIZE,
+                                                        &sg_audio_input.asr.consumer_id),
                        __ASR_INIT_ERR);
-    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&sg_audio_input.asr.rb_mutex), __ASR_INIT_ERR);
 
     return OPRT_OK;
 
@@ -126,16 +142,6 @@ __ASR_INIT_ERR:
         sg_audio_input.asr.wakeup_timer_id = NULL;
     }
 
-    if (sg_audio_input.asr.feed_ringbuff) {
-        tuya_ring_buff_free(sg_audio_input.asr.feed_ringbuff);
-        sg_audio_input.asr.feed_ringbuff = NULL;
-    }
-
-    if (sg_audio_input.asr.rb_mutex) {
-        tal_mutex_release(sg_audio_input.asr.rb_mutex);
-        sg_audio_input.asr.rb_mutex = NULL;
-    }
-
     return rt;
 }
 
@@ -147,33 +153,19 @@ static __attribute__((unused)) OPERATE_RET __ai_audio_asr_deinit(void)
 
     TUYA_CALL_ERR_LOG(tal_sw_timer_delete(sg_audio_input.asr.wakeup_timer_id));
 
-    TUYA_CALL_ERR_LOG(tal_mutex_lock(sg_audio_input.asr.rb_mutex));
-    TUYA_CALL_ERR_LOG(tuya_ring_buff_free(sg_audio_input.asr.feed_ringbuff));
-    sg_audio_input.asr.feed_ringbuff = NULL;
-    TUYA_CALL_ERR_LOG(tal_mutex_unlock(sg_audio_input.asr.rb_mutex));
-
-    TUYA_CALL_ERR_LOG(tal_mutex_release(sg_audio_input.asr.rb_mutex));
-    sg_audio_input.asr.rb_mutex = NULL;
+    ai_audio_frame_pool_del_consumer(sg_audio_input.frame_pool, sg_audio_input.asr.consumer_id);
 
     return OPRT_OK;
 }
 
-static void __ai_audio_asr_feed(void *data, uint32_t len)
+static void __ai_audio_asr_feed(void)
 {
-    tal_mutex_lock(sg_audio_input.asr.rb_mutex);
-
+    // the frame is already in the pool, only the pre-roll of the asr cursor is trimmed
     if (TKL_VAD_STATUS_NONE == tkl_vad_get_status()) {
-        uint32_t rb_used_size = tuya_ring_buff_used_size_get(sg_audio_input.asr.feed_ringbuff);
-        if (rb_used_size > AI_AUDIO_VOICE_FRAME_LEN_GET(AI_AUDIO_VAD_ACITVE_TM_MS)) {
-            uint32_t discard_size = rb_used_size - AI_AUDIO_VOICE_FRAME_LEN_GET(AI_AUDIO_VAD_ACITVE_TM_MS);
-            tuya_ring_buff_discard(sg_audio_input.asr.feed_ringbuff, discard_size);
-        }
+        ai_audio_frame_pool_keep(sg_audio_input.frame_pool, sg_audio_input.asr.consumer_id,
+                                 AI_AUDIO_VOICE_FRAME_LEN_GET(AI_AUDIO_VAD_ACITVE_TM_MS));
     }
 
-    tuya_ring_buff_write(sg_audio_input.asr.feed_ringbuff, data, len);
-
-    tal_mutex_unlock(sg_audio_input.asr.rb_mutex);
-
     return;
 }
 
@@ -182,34 +174,42 @@ static TKL_ASR_WAKEUP_WORD_E __asr_recognize_wakeup_keyword(void)
     uint32_t i = 0, fc = 0;
     TKL_ASR_WAKEUP_WORD_E wakeup_word = TKL_ASR_WAKEUP_WORD_UNKNOWN;
     uint32_t uint_size = 0, feed_size = 0;
+    AI_AUDIO_FRAME_T frame;
+    uint8_t *p_buf = NULL;
 
     uint_size = tkl_asr_get_process_uint_size();
-    tal_mutex_lock(sg_audio_input.asr.rb_mutex);
-    feed_size = tuya_ring_buff_used_size_get(sg_audio_input.asr.feed_ringbuff);
-    tal_mutex_unlock(sg_audio_input.asr.rb_mutex);
+    feed_size = ai_audio_frame_pool_available(sg_audio_input.frame_pool, sg_audio_input.asr.consumer_id);
     if (feed_size < uint_size) {
         return TKL_ASR_WAKEUP_WORD_UNKNOWN;
     }
 
-    uint8_t *p_buf = tkl_system_psram_malloc(uint_size);
-    if (NULL == p_buf) {
-        PR_ERR("malloc fail");
-        return TKL_ASR_WAKEUP_WORD_UNKNOWN;
-    }
-
     fc = feed_size / uint_size;
     for (i = 0; i < fc; i++) {
-        tal_mutex_lock(sg_audio_input.asr.rb_mutex);
-        tuya_ring_buff_read(sg_audio_input.asr.feed_ringbuff, p_buf, uint_size);
-        tal_mutex_unlock(sg_audio_input.asr.rb_mutex);
+        // the unit is recognized in place, only a unit wrapping around the end of the pool is copied
+        if (OPRT_OK ==
+            ai_audio_frame_pool_acquire(sg_audio_input.frame_pool, sg_audio_input.asr.consumer_id, uint_size, &frame)) {
+            wakeup_word = tkl_asr_recognize_wakeup_word(frame.data, uint_size);
+            ai_audio_frame_pool_release(sg_audio_input.frame_pool, &frame);
+        } else {
+            if (NULL == p_buf) {
+                p_buf = tkl_system_psram_malloc(uint_size);
+                if (NULL == p_buf) {
+                    PR_ERR("malloc fail");
+                    break;
+                }
+            }
+            ai_audio_frame_pool_read(sg_audio_input.frame_pool, sg_audio_input.asr.consumer_id, p_buf, uint_size);
+            wakeup_word = tkl_asr_recognize_wakeup_word(p_buf, uint_size);
+        }
 
-        wakeup_word = tkl_asr_recognize_wakeup_word(p_buf, uint_size);
         if (wakeup_word != TKL_ASR_WAKEUP_WORD_UNKNOWN) {
             break;
         }
     }
 
-    tkl_system_psram_free(p_buf);
+    if (p_buf) {
+        tkl_system_psram_free(p_buf);
+    }
 
     return wakeup_word;
 }
@@ -254,7 +254,7 @@ static void __ai_audio_detect_valid_data_feed(AI_AUDIO_INPUT_VALID_METHOD_E meth
     } else if (AI_AUDIO_INPUT_VALID_METHOD_ASR == method) {
         tkl_vad_feed(data, len);
 
-        __ai_audio_asr_feed(data, len);
+        __ai_audio_asr_feed();
     } else {
         ;
     }
@@ -262,9 +262,7 @@ static void __ai_audio_detect_valid_data_feed(AI_AUDIO_INPUT_VALID_METHOD_E meth
 
 static OPERATE_RET __ai_audio_input_rb_reset(void)
 {
-    tal_mutex_lock(sg_audio_input.rb_mutex);
-    tuya_ring_buff_reset(sg_audio_input.ringbuff_hdl);
-    tal_mutex_unlock(sg_audio_input.rb_mutex);
+    ai_audio_frame_pool_keep(sg_audio_input.frame_pool, sg_audio_input.upload_id, 0);
 
     return OPRT_OK;
 }
@@ -369,22 +367,37 @@ static void __ai_audio_get_input_frame(TDL_AUDIO_FRAME_FORMAT_E type, TDL_AUDIO_
 {
 #if defined(ENABLE_AUDIO_AEC) && (ENABLE_AUDIO_AEC == 1)
 
+#elif defined(AI_AUDIO_SW_AEC) && (AI_AUDIO_SW_AEC == 1)
+    // the echo is removed in software, the vad keeps running so the user can talk over the playback
+    ai_audio_aec_process((int16_t *)data, len / sizeof(int16_t));
 #else
     if (true == ai_audio_player_is_playing()) {
         tkl_vad_stop();
+        // let the task see the vad stop once, then stay asleep while playing
+        if (false == sg_audio_input.is_play_muted) {
+            sg_audio_input.is_play_muted = true;
+            __ai_audio_input_notify();
+        }
         return;
     } else {
         tkl_vad_start();
+        sg_audio_input.is_play_muted = false;
     }
 #endif
 
+    // published once, the consumers read the pool instead of getting their own copy
+    ai_audio_frame_pool_publish(sg_audio_input.frame_pool, data, len);
+
     if (true == sg_audio_input.is_enable_get_valid_data) {
         __ai_audio_detect_valid_data_feed(sg_audio_input.method, (uint8_t *)data, len);
+    } else if (AI_AUDIO_INPUT_VALID_METHOD_ASR == sg_audio_input.method) {
+        ai_audio_frame_pool_keep(sg_audio_input.frame_pool, sg_audio_input.asr.consumer_id, 0);
     }
 
-    tal_mutex_lock(sg_audio_input.rb_mutex);
-    tuya_ring_buff_write(sg_audio_input.ringbuff_hdl, data, len);
-    tal_mutex_unlock(sg_audio_input.rb_mutex);
+    sg_audio_input.unnotify_len += len;
+    if (sg_audio_input.unnotify_len >= AI_AUDIO_PCM_FRAME_SIZE) {
+        __ai_audio_input_notify();
+    }
 
     return;
 }
@@ -396,9 +409,16 @@ static void __ai_audio_handle_frame_task(void *arg)
     AI_AUDIO_INPUT_STATE_E last_state = AI_AUDIO_INPUT_STATE_IDLE;
 
     while (1) {
-        rb_used_sz = tuya_ring_buff_used_size_get(sg_audio_input.ringbuff_hdl);
+        // the semaphore is binary: frames arriving while the task is busy are handled in one pass
+        tal_semaphore_wait_forever(sg_audio_input.frame_sem);
+
+#if !(defined(ENABLE_AUDIO_AEC) && (ENABLE_AUDIO_AEC == 1)) && (defined(AI_AUDIO_SW_AEC) && (AI_AUDIO_SW_AEC == 1))
+        // the delay search is too heavy for the mic callback
+        ai_audio_aec_update();
+#endif
+
+        rb_used_sz = ai_audio_frame_pool_available(sg_audio_input.frame_pool, sg_audio_input.upload_id);
         if (0 == rb_used_sz) {
-            tal_system_sleep(10);
             continue;
         }
 
@@ -427,8 +447,6 @@ static void __ai_audio_handle_frame_task(void *arg)
         if ((event != AI_AUDIO_INPUT_EVT_NONE) && sg_audio_input_inform_cb) {
             sg_audio_input_inform_cb(event, NULL);
         }
-
-        tal_system_sleep(10);
     }
 }
 
@@ -487,9 +505,14 @@ OPERATE_RET ai_audio_input_init(AI_AUDIO_INPUT_CFG_T *cfg, AI_AUDIO_INOUT_INFORM
         return OPRT_OK;
     }
 
-    TUYA_CALL_ERR_RETURN(tuya_ring_buff_create(AI_AUDIO_VOICE_FRAME_LEN_GET(AI_AUDIO_INPUT_RB_TIME_MS) + 1,
-                                               OVERFLOW_PSRAM_STOP_TYPE, &sg_audio_input.ringbuff_hdl));
-    TUYA_CALL_ERR_RETURN(tal_mutex_create_init(&sg_audio_input.rb_mutex));
+    TUYA_CALL_ERR_RETURN(
+        ai_audio_frame_pool_create(AI_AUDIO_PCM_FRAME_SIZE, AI_AUDIO_INPUT_FRAME_NUM, &sg_audio_input.frame_pool));
+    TUYA_CALL_ERR_RETURN(ai_audio_frame_pool_add_consumer(sg_audio_input.frame_pool, 0, &sg_audio_input.upload_id));
+    TUYA_CALL_ERR_RETURN(tal_semaphore_create_init(&sg_audio_input.frame_sem, 0, 1));
+
+#if !(defined(ENABLE_AUDIO_AEC) && (ENABLE_AUDIO_AEC == 1)) && (defined(AI_AUDIO_SW_AEC) && (AI_AUDIO_SW_AEC == 1))
+    TUYA_CALL_ERR_RETURN(ai_audio_aec_init());
+#endif
 
     TUYA_CALL_ERR_RETURN(__ai_audio_input_set_method(cfg->get_valid_data_method));
 
@@ -549,6 +572,7 @@ OPERATE_RET ai_audio_input_manual_open_get_valid_data(bool is_open)
     }
 
     sg_audio_input.is_manual_get_valid_data = is_open;
+    __ai_audio_input_notify();
 
     return OPRT_OK;
 }
@@ -571,6 +595,7 @@ OPERATE_RET ai_audio_input_stop_asr_awake(void)
 
     sg_audio_input.asr.is_wakeup = false;
     sg_audio_input.asr.is_need_inform_wakeup_stop = true;
+    __ai_audio_input_notify();
 
     PR_NOTICE("ai audio needs to be awakened again by the wake-up word");
 
@@ -598,33 +623,50 @@ OPERATE_RET ai_audio_input_restart_asr_awake_timer(void)
 
 uint32_t ai_audio_get_input_data(uint8_t *buff, uint32_t buff_len)
 {
-    uint32_t read_len = 0;
-
     if (NULL == buff || 0 == buff_len) {
         return 0;
     }
 
-    tal_mutex_lock(sg_audio_input.rb_mutex);
-    read_len = tuya_ring_buff_read(sg_audio_input.ringbuff_hdl, buff, buff_len);
-    tal_mutex_unlock(sg_audio_input.rb_mutex);
-
-    return read_len;
+    return ai_audio_frame_pool_read(sg_audio_input.frame_pool, sg_audio_input.upload_id, buff, buff_len);
 }
 
-uint32_t ai_audio_get_input_data_size(void)
+/**
+ * @brief Borrows uploaded input data in place, see ai_audio_frame_pool_acquire().
+ * @param len Bytes to borrow.
+ * @param frame Output frame, given back with ai_audio_put_input_frame().
+ * @return OPERATE_RET - OPRT_OK on success, or an error code if the data has to be read with ai_audio_get_input_data().
+ */
+OPERATE_RET ai_audio_get_input_frame(uint32_t len, AI_AUDIO_FRAME_T *frame)
 {
-    uint32_t rb_used_size = 0;
+    return ai_audio_frame_pool_acquire(sg_audio_input.frame_pool, sg_audio_input.upload_id, len, frame);
+}
 
-    tal_mutex_lock(sg_audio_input.rb_mutex);
-    rb_used_size = tuya_ring_buff_used_size_get(sg_audio_input.ringbuff_hdl);
-    tal_mutex_unlock(sg_audio_input.rb_mutex);
+/**
+ * @brief Gives back input data borrowed by ai_audio_get_input_frame().
+ * @param frame The borrowed frame.
+ * @return None
+ */
+void ai_audio_put_input_frame(AI_AUDIO_FRAME_T *frame)
+{
+    ai_audio_frame_pool_release(sg_audio_input.frame_pool, frame);
+}
 
-    return rb_used_size;
+uint32_t ai_audio_get_input_data_size(void)
+{
+    return ai_audio_frame_pool_available(sg_audio_input.frame_pool, sg_audio_input.upload_id);
 }
 
 void ai_audio_discard_input_data(uint32_t discard_size)
 {
-    tal_mutex_lock(sg_audio_input.rb_mutex);
-    tuya_ring_buff_discard(sg_audio_input.ringbuff_hdl, discard_size);
-    tal_mutex_unlock(sg_audio_input.rb_mutex);
-}
\ No newline at end of file
+    ai_audio_frame_pool_skip(sg_audio_input.frame_pool, sg_audio_input.upload_id, discard_size);
+}
+
+/**
+ * @brief Gets the statistics of the mic frame pool shared by the input consumers.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK on success, or an error code on failure.
+ */
+OPERATE_RET ai_audio_input_get_frame_stats(AI_AUDIO_FRAME_POOL_STATS_T *stats)
+{
+    return ai_audio_frame_pool_get_stats(sg_audio_input.frame_pool, stats);
+}
@@ -20,6 +20,7 @@
 
 #include "tal_api.h"
 #include "ai_audio.h"
+#include "ai_audio_decoder.h"
 
 /***********************************************************
 ************************macro define************************
@@ -44,6 +45,13 @@ typedef struct {
     TIMER_ID state_tm;
     AI_AUDIO_EVT_INFORM_CB evt_inform_cb;
     AI_AUDIO_STATE_INFORM_CB state_inform_cb;
+
+    // a reply is measured from the end of speech to its first sample on the speaker
+    bool is_turn_pending;
+    SYS_TIME_T speech_end_ms;
+    SYS_TIME_T tts_start_ms;
+    uint64_t e2e_sum_ms;
+    AI_AUDIO_PIPELINE_STATS_T stats;
 } AI_AUDIO_INFO_T;
 
 /***********************************************************
@@ -60,6 +68,46 @@ AI_AUDIO_INFO_T sg_ai_audio = {
 /***********************************************************
 ***********************function define**********************
 ***********************************************************/
+static void __ai_audio_pipeline_update(void)
+{
+    AI_AUDIO_PIPELINE_STATS_T *stats = &sg_ai_audio.stats;
+    AI_AUDIO_PLAYER_STATS_T player_stats;
+    AI_CLOUD_ASR_UPLOAD_STATS_T upload_stats;
+    AI_AUDIO_DECODER_STATS_T dec_stats;
+    uint32_t heap = (uint32_t)tal_system_get_free_heap_size();
+    uint32_t e2e = 0;
+
+    if (0 == stats->heap_free_min || heap < stats->heap_free_min) {
+        stats->heap_free_min = heap;
+    }
+
+    if (false == sg_ai_audio.is_turn_pending || sg_ai_audio.tts_start_ms < sg_ai_audio.speech_end_ms) {
+        return;
+    }
+
+    ai_audio_player_get_stats(&player_stats);
+    if (0 == player_stats.first_sample_ms) {
+        // the reply is still prebuffering
+        return;
+    }
+    sg_ai_audio.is_turn_pending = false;
+
+    e2e = (uint32_t)(sg_ai_audio.tts_start_ms - sg_ai_audio.speech_end_ms) + player_stats.first_sample_ms;
+    stats->turns++;
+    stats->e2e_last_ms = e2e;
+    if (e2e > stats->e2e_max_ms) {
+        stats->e2e_max_ms = e2e;
+    }
+    sg_ai_audio.e2e_sum_ms += e2e;
+    stats->e2e_avg_ms = (uint32_t)(sg_ai_audio.e2e_sum_ms / stats->turns);
+
+    ai_audio_cloud_asr_get_upload_stats(&upload_stats);
+    ai_audio_decoder_get_stats(ai_audio_agent_get_tts_codec(), &dec_stats);
+    PR_NOTICE("reply e2e:%dms (cloud:%dms, player:%dms), upload:%d pkts, tts decode:%dus/%d samples, heap min:%d",
+              e2e, (uint32_t)(sg_ai_audio.tts_start_ms - sg_ai_audio.speech_end_ms), player_stats.first_sample_ms,
+              upload_stats.packets, (uint32_t)dec_stats.decode_us, dec_stats.out_samples, stats->heap_free_min);
+}
+
 static void __ai_audio_agent_event_cb(AI_EVENT_TYPE event, AI_EVENT_ID event_id)
 {
     PR_DEBUG("__ai_audio_agent_event_cb event: %d", event);
@@ -105,7 +153,7 @@ static void __ai_audio_agent_msg_cb(AI_AGENT_MSG_T *msg)
         }
     } break;
     case AI_AGENT_MSG_TP_AUDIO_START: {
-        // Prepare to play mp3
+        // Prepare to play the tts stream in the codec the cloud picked
         if (ai_audio_player_is_playing()) {
             PR_DEBUG("player is playing, stop it first");
             ai_audio_player_stop();
@@ -121,7 +169,8 @@ static void __ai_audio_agent_msg_cb(AI_AGENT_MSG_T *msg)
             event_id[msg->data_len] = '\0';
         }
 
-        ai_audio_player_start(event_id);
+        sg_ai_audio.tts_start_ms = tal_system_get_millisecond();
+        ai_audio_player_start_codec(event_id, ai_audio_agent_get_tts_codec());
 
         sg_ai_audio.state = AI_AUDIO_STATE_AI_SPEAK;
     } break;
@@ -182,6 +231,8 @@ static void __ai_audio_input_inform_handle(AI_AUDIO_INPUT_EVENT_E event, void *a
         }
     } break;
     case AI_AUDIO_INPUT_EVT_GET_VALID_VOICE_STOP: {
+        sg_ai_audio.speech_end_ms = tal_system_get_millisecond();
+        sg_ai_audio.is_turn_pending = true;
         ai_audio_cloud_asr_stop();
 
         if (AI_AUDIO_WORK_ASR_WAKEUP_SINGLE_TALK == sg_ai_audio.work_mode) {
@@ -216,6 +267,8 @@ static void __inform_state_tm_cb(TIMER_ID timer_id, void *arg)
 {
     static AI_AUDIO_STATE_E s_last_state = AI_AUDIO_STATE_MAX;
 
+    __ai_audio_pipeline_update();
+
     if (AI_AUDIO_STATE_AI_SPEAK == sg_ai_audio.state) {
         if (false == ai_audio_player_is_playing()) {
             if (sg_ai_audio.work_mode == AI_AUDIO_WORK_VAD_FREE_TALK ||
@@ -427,4 +480,18 @@ OPERATE_RET ai_audio_set_wakeup(void)
 AI_AUDIO_STATE_E ai_audio_get_state(void)
 {
     return sg_ai_audio.state;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Gets the end-to-end latency and memory statistics of the voice pipeline.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK if the operation is successful, otherwise an error code.
+ */
+OPERATE_RET ai_audio_get_pipeline_stats(AI_AUDIO_PIPELINE_STATS_T *stats)
+{
+    TUYA_CHECK_NULL_RETURN(stats, OPRT_INVALID_PARM);
+
+    memcpy(stats, &sg_ai_audio.stats, sizeof(AI_AUDIO_PIPELINE_STATS_T));
+
+    return OPRT_OK;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file ai_audio_mixer.c
+ * @brief Implements the fixed-point 16-bit PCM mixing helpers.
+ *
+ * Only integer multiply, add and shift are used so the mix stays cheap on
+ * MCUs without an FPU.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include "ai_audio_mixer.h"
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static inline int16_t __ai_audio_sat16(int32_t val)
+{
+    if (val > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (val < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)val;
+}
+
+/**
+ * @brief Scales PCM samples in place.
+ * @param pcm Pointer to the 16-bit PCM samples.
+ * @param samples Number of samples.
+ * @param gain Q12 gain, AI_AUDIO_GAIN_UNITY leaves the samples untouched.
+ * @return None
+ */
+void ai_audio_mixer_gain(int16_t *pcm, uint32_t samples, uint16_t gain)
+{
+    uint32_t i = 0;
+
+    if (NULL == pcm || AI_AUDIO_GAIN_UNITY == gain) {
+        return;
+    }
+
+    for (i = 0; i < samples; i++) {
+        pcm[i] = __ai_audio_sat16(((int32_t)pcm[i] * gain) >> AI_AUDIO_GAIN_SHIFT);
+    }
+}
+
+/**
+ * @brief Mixes src into dst in place: dst = sat(dst * dst_gain + src * src_gain).
+ * @param dst Pointer to the 16-bit PCM samples mixed into.
+ * @param dst_gain Q12 gain of dst, e.g. a ducking gain.
+ * @param src Pointer to the 16-bit PCM samples to overlay.
+ * @param src_gain Q12 gain of src.
+ * @param samples Number of samples.
+ * @return None
+ */
+void ai_audio_mixer_mix(int16_t *dst, uint16_t dst_gain, const int16_t *src, uint16_t src_gain, uint32_t samples)
+{
+    uint32_t i = 0;
+
+    if (NULL == dst || NULL == src) {
+        return;
+    }
+
+    if (AI_AUDIO_GAIN_UNITY == dst_gain && AI_AUDIO_GAIN_UNITY == src_gain) {
+        for (i = 0; i < samples; i++) {
+            dst[i] = __ai_audio_sat16((int32_t)dst[i] + src[i]);
+        }
+        return;
+    }
+
+    for (i = 0; i < samples; i++) {
+        dst[i] = __ai_audio_sat16(((int32_t)dst[i] * dst_gain + (int32_t)src[i] * src_gain) >> AI_AUDIO_GAIN_SHIFT);
+    }
+}
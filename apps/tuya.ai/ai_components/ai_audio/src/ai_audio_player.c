@@ -23,6 +23,9 @@
 #include "ai_media_alert.h"
 #include "minimp3_ex.h"
 #include "ai_audio.h"
+#include "ai_audio_mixer.h"
+#include "ai_audio_aec.h"
+#include "ai_audio_decoder.h"
 
 /***********************************************************
 ************************macro define************************
@@ -38,6 +41,33 @@
 #define MP3_PCM_SIZE_MAX           (MAX_NSAMP * MAX_NCHAN * MAX_NGRAN * 2)
 #define PLAYING_NO_DATA_TIMEOUT_MS (5 * 1000)
 
+// the raw buffer holds several frames so the unread tail is moved down only once per buffer wrap
+#define MP3_RAW_BUF_SIZE (MAINBUF_SIZE * 4)
+
+// pcm frames decoded ahead of the speaker
+#ifndef AI_PLAYER_DECODE_AHEAD_NUM
+#define AI_PLAYER_DECODE_AHEAD_NUM 4
+#endif
+
+#ifndef AI_PLAYER_JITTER_MODE
+#define AI_PLAYER_JITTER_MODE AI_AUDIO_PLAYER_JITTER_LOW_LATENCY
+#endif
+
+// gain of the tts stream while an alert is overlaid, Q12
+#ifndef AI_PLAYER_DUCK_GAIN
+#define AI_PLAYER_DUCK_GAIN (AI_AUDIO_GAIN_UNITY / 4)
+#endif
+
+// psram budget of the decoded alert cache, alerts that do not fit are decoded on every play
+#ifndef AI_PLAYER_ALERT_CACHE_SIZE
+#define AI_PLAYER_ALERT_CACHE_SIZE (128 * 1024)
+#endif
+
+#define AI_PLAYER_ALERT_NUM (AI_AUDIO_ALERT_FREE_TALK + 1)
+
+// samples copied per pcm slot when playing a cached alert
+#define AI_PLAYER_PCM_SRC_FRAME (MAX_NSAMP * MAX_NGRAN)
+
 #define AI_AUDIO_PLAYER_STAT_CHANGE(last_stat, new_stat)                                                               \
     do {                                                                                                               \
         if (last_stat != new_stat) {                                                                                   \
@@ -48,6 +78,65 @@
 /***********************************************************
 ***********************typedef define***********************
 ***********************************************************/
+typedef struct {
+    uint8_t *buf;
+    uint32_t len;
+    uint32_t gen;
+} AI_PLAYER_PCM_SLOT_T;
+
+typedef struct {
+    uint16_t min_ms;
+    uint16_t max_ms;
+    uint8_t jitter_mult;
+} AI_PLAYER_JITTER_CFG_T;
+
+typedef struct {
+    AI_AUDIO_PLAYER_JITTER_MODE_E mode;
+    bool is_prebuffering;
+    SYS_TIME_T prebuf_start;
+    SYS_TIME_T last_arrival; // 0 before the first data of a stream
+    int32_t gap_avg_ms;
+    uint32_t jitter_ms;
+    uint32_t target_ms;
+    uint32_t depth_ms;
+    uint32_t bitrate_kbps; // from the first frame head, 0 when unknown
+    uint32_t added_latency_ms;
+} AI_PLAYER_JITTER_T;
+
+// an alert mixed over the playing stream, decoded frame by frame with its own decoder
+typedef struct {
+    bool is_active;
+    const uint8_t *src;
+    uint32_t src_len;
+    uint32_t src_pos;
+    mp3dec_t *dec;
+    int16_t *pcm_buf;
+    const int16_t *pcm; // the decoded frame in pcm_buf, or the whole alert when it is cached
+    uint32_t pcm_samples;
+    uint32_t pcm_pos;
+} AI_PLAYER_OVERLAY_T;
+
+typedef enum {
+    AI_PLAYER_ALERT_CACHE_EMPTY = 0,
+    AI_PLAYER_ALERT_CACHE_PENDING, // waiting for the player to go idle
+    AI_PLAYER_ALERT_CACHE_FILLING,
+    AI_PLAYER_ALERT_CACHE_READY,
+    AI_PLAYER_ALERT_CACHE_SKIP, // over budget or out of memory
+} AI_PLAYER_ALERT_CACHE_STATE_E;
+
+typedef struct {
+    AI_PLAYER_ALERT_CACHE_STATE_E state;
+    int16_t *pcm;
+    uint32_t samples;
+    uint32_t fill;
+    uint32_t src_pos;
+} AI_PLAYER_ALERT_CACHE_T;
+
+typedef struct {
+    mp3dec_t dec;
+    mp3d_sample_t pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
+} AI_PLAYER_ALERT_DECODER_T;
+
 typedef struct {
     bool is_playing;
     bool is_writing;
@@ -56,6 +145,8 @@ typedef struct {
     TDL_AUDIO_HANDLE_T audio_hdl;
     MUTEX_HANDLE mutex;
     THREAD_HANDLE thrd_hdl;
+    THREAD_HANDLE out_thrd_hdl;
+    SEM_HANDLE wake_sem; // new data, state change or a free pcm slot for the decode task
 
     char *id;
     TUYA_RINGBUFF_T rb_hdl;
@@ -63,13 +154,42 @@ typedef struct {
     uint8_t is_eof;
     TIMER_ID tm_id;
 
-    mp3dec_t *mp3_dec;
-    mp3dec_frame_info_t mp3_frame_info;
+    // tts stream decoder, mp3_raw buffers the coded stream of any codec
+    AI_AUDIO_CODEC_TYPE codec_type; // codec of the stream being started
+    const AI_AUDIO_DECODER_T *dec;
+    void *dec_hdl;
     uint8_t *mp3_raw;
-    uint8_t *mp3_raw_head;
-    uint32_t mp3_raw_used_len;
-    uint8_t *mp3_pcm; // mp3 decode to pcm buffer
-
+    uint32_t mp3_raw_rd; // read cursor of the decoder
+    uint32_t mp3_raw_wr; // end of the buffered mp3 data
+
+    // decoded pcm queue, written by the decode task and played by the output task
+    AI_PLAYER_PCM_SLOT_T pcm_slot[AI_PLAYER_DECODE_AHEAD_NUM];
+    uint32_t pcm_wr;
+    uint32_t pcm_rd;
+    uint32_t pcm_used;
+    uint32_t pcm_gen; // bumped on stop, queued frames of an older generation are dropped
+    MUTEX_HANDLE pcm_mutex;
+    SEM_HANDLE pcm_sem;
+    uint32_t underrun_cnt;
+
+    AI_PLAYER_JITTER_T jb;
+
+    AI_PLAYER_OVERLAY_T overlay;
+    uint16_t gain[AI_AUDIO_PLAYER_STREAM_MAX];
+    uint16_t duck_gain;
+
+    // alerts decoded once while the player is idle and played without the mp3 decoder
+    AI_PLAYER_ALERT_CACHE_T alert_cache[AI_PLAYER_ALERT_NUM];
+    uint32_t alert_cache_used;
+    AI_PLAYER_ALERT_DECODER_T *alert_dec; // only allocated while an alert is being cached
+
+    // cached alert being played, replaces the mp3 stream
+    const int16_t *pcm_src;
+    uint32_t pcm_src_samples;
+    uint32_t pcm_src_pos;
+
+    SYS_TIME_T start_ms;
+    uint32_t first_sample_ms; // from ai_audio_player_start() to the first frame handed to the speaker
 } APP_PLAYER_T;
 
 /***********************************************************
@@ -81,103 +201,614 @@ typedef struct {
 ***********************************************************/
 static APP_PLAYER_T sg_player;
 
+static const AI_PLAYER_JITTER_CFG_T sg_jitter_cfg[AI_AUDIO_PLAYER_JITTER_MAX] = {
+    {0, 200, 2},
+    {60, 500, 3},
+    {150, 1000, 4},
+};
+
 /***********************************************************
 ***********************function define**********************
 ***********************************************************/
+static void __ai_audio_player_wakeup(void)
+{
+    if (sg_player.wake_sem) {
+        tal_semaphore_post(sg_player.wake_sem);
+    }
+}
+
+static uint32_t __ai_audio_player_pcm_used(void)
+{
+    uint32_t used = 0;
+
+    tal_mutex_lock(sg_player.pcm_mutex);
+    used = sg_player.pcm_used;
+    tal_mutex_unlock(sg_player.pcm_mutex);
+
+    return used;
+}
+
+static void __ai_audio_player_pcm_flush(void)
+{
+    // queued frames are dropped by the output task when it sees the new generation
+    tal_mutex_lock(sg_player.pcm_mutex);
+    sg_player.pcm_gen++;
+    tal_mutex_unlock(sg_player.pcm_mutex);
+}
+
 static OPERATE_RET __ai_audio_player_mp3_start(void)
 {
     OPERATE_RET rt = OPRT_OK;
+    const AI_AUDIO_DECODER_T *dec = ai_audio_decoder_find(sg_player.codec_type);
 
-    if (NULL == sg_player.mp3_dec) {
-        sg_player.mp3_dec = (mp3dec_t *)tkl_system_psram_malloc(sizeof(mp3dec_t));
-        if (NULL == sg_player.mp3_dec) {
-            PR_ERR("malloc mp3dec_t failed");
-            return OPRT_MALLOC_FAILED;
-        }
+    if (NULL == dec) {
+        PR_ERR("no decoder for tts codec %d", sg_player.codec_type);
+        return OPRT_NOT_SUPPORTED;
+    }
 
-        mp3dec_init(sg_player.mp3_dec);
+    // the decoder is kept across streams of the same codec, only its stream state is reset
+    if (dec != sg_player.dec) {
+        if (sg_player.dec) {
+            sg_player.dec->destroy(sg_player.dec_hdl);
+            sg_player.dec = NULL;
+            sg_player.dec_hdl = NULL;
+        }
+        TUYA_CALL_ERR_RETURN(
+            dec->create(AI_AUDIO_DECODER_SAMPLE_RATE, AUDIO_CHANNELS_MONO, &sg_player.dec_hdl));
+        sg_player.dec = dec;
+        PR_DEBUG("tts decoder: %s", dec->format);
+    } else if (dec->reset) {
+        dec->reset(sg_player.dec_hdl);
     }
 
-    sg_player.mp3_raw_used_len = 0;
+    sg_player.mp3_raw_rd = 0;
+    sg_player.mp3_raw_wr = 0;
+    sg_player.underrun_cnt = 0;
+
+    // the jitter estimate is kept across streams, the network does not change with the reply
+    sg_player.jb.is_prebuffering = true;
+    sg_player.jb.prebuf_start = tal_system_get_millisecond();
+    sg_player.jb.bitrate_kbps = 0;
+    sg_player.jb.added_latency_ms = 0;
 
     return rt;
 }
 
+static void __ai_audio_player_mp3_fill(void)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+    uint32_t room = MP3_RAW_BUF_SIZE - ctx->mp3_raw_wr;
+
+    // keep a whole frame of room behind the buffered data, moving only the unread tail
+    if (room < MAINBUF_SIZE && ctx->mp3_raw_rd > 0) {
+        memmove(ctx->mp3_raw, ctx->mp3_raw + ctx->mp3_raw_rd, ctx->mp3_raw_wr - ctx->mp3_raw_rd);
+        ctx->mp3_raw_wr -= ctx->mp3_raw_rd;
+        ctx->mp3_raw_rd = 0;
+        room = MP3_RAW_BUF_SIZE - ctx->mp3_raw_wr;
+    }
+
+    if (0 == room) {
+        return;
+    }
+
+    tal_mutex_lock(ctx->spk_rb_mutex);
+    ctx->mp3_raw_wr += tuya_ring_buff_read(ctx->rb_hdl, ctx->mp3_raw + ctx->mp3_raw_wr, room);
+    tal_mutex_unlock(ctx->spk_rb_mutex);
+}
+
+static void __ai_audio_player_jitter_update(void)
+{
+    AI_PLAYER_JITTER_T *jb = &sg_player.jb;
+    const AI_PLAYER_JITTER_CFG_T *cfg = &sg_jitter_cfg[jb->mode];
+    SYS_TIME_T now = tal_system_get_millisecond();
+    int32_t gap = 0, dev = 0;
+
+    if (jb->last_arrival) {
+        gap = (int32_t)(now - jb->last_arrival);
+        dev = gap - jb->gap_avg_ms;
+        jb->gap_avg_ms += dev / 8;
+        dev = (dev < 0) ? -dev : dev;
+        jb->jitter_ms += (dev - (int32_t)jb->jitter_ms) / 16;
+    }
+    jb->last_arrival = now;
+
+    jb->target_ms = jb->jitter_ms * cfg->jitter_mult;
+    if (jb->target_ms < cfg->min_ms) {
+        jb->target_ms = cfg->min_ms;
+    } else if (jb->target_ms > cfg->max_ms) {
+        jb->target_ms = cfg->max_ms;
+    }
+}
+
+static bool __ai_audio_player_prebuffer_ready(void)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+    AI_PLAYER_JITTER_T *jb = &ctx->jb;
+
+    if (0 == jb->target_ms || ctx->is_eof) {
+        return true;
+    }
+
+    __ai_audio_player_mp3_fill();
+    uint32_t raw_len = ctx->mp3_raw_wr - ctx->mp3_raw_rd;
+
+    if (0 == jb->bitrate_kbps && raw_len > 0) {
+        if (ctx->dec->probe_kbps) {
+            jb->bitrate_kbps = ctx->dec->probe_kbps(ctx->dec_hdl, ctx->mp3_raw + ctx->mp3_raw_rd, raw_len);
+        } else {
+            jb->bitrate_kbps = ctx->dec->bitrate_kbps;
+        }
+    }
+
+    if (0 == jb->bitrate_kbps) {
+        // no frame head yet, wait until the raw buffer is full
+        jb->depth_ms = 0;
+        return (raw_len >= MP3_RAW_BUF_SIZE);
+    }
+
+    tal_mutex_lock(ctx->spk_rb_mutex);
+    uint32_t buffered = raw_len + tuya_ring_buff_used_size_get(ctx->rb_hdl);
+    tal_mutex_unlock(ctx->spk_rb_mutex);
+
+    jb->depth_ms = buffered * 8 / jb->bitrate_kbps;
+
+    return (jb->depth_ms >= jb->target_ms);
+}
+
+static void __ai_audio_player_pcm_commit(AI_PLAYER_PCM_SLOT_T *slot, uint32_t samples)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+
+    tal_mutex_lock(ctx->pcm_mutex);
+    slot->len = samples * 2;
+    slot->gen = ctx->pcm_gen;
+    ctx->pcm_wr = (ctx->pcm_wr + 1) % AI_PLAYER_DECODE_AHEAD_NUM;
+    ctx->pcm_used++;
+    tal_mutex_unlock(ctx->pcm_mutex);
+
+    tal_semaphore_post(ctx->pcm_sem);
+}
+
+static bool __ai_audio_player_overlay_decode(void)
+{
+    AI_PLAYER_OVERLAY_T *ov = &sg_player.overlay;
+    mp3dec_frame_info_t info;
+    int samples = 0;
+
+    while (ov->src_pos < ov->src_len) {
+        samples = mp3dec_decode_frame(ov->dec, ov->src + ov->src_pos, ov->src_len - ov->src_pos,
+                                      (mp3d_sample_t *)ov->pcm_buf, &info);
+        if (0 == info.frame_bytes) {
+            break;
+        }
+        ov->src_pos += info.frame_bytes;
+        if (samples > 0) {
+            ov->pcm = ov->pcm_buf;
+            ov->pcm_samples = samples;
+            ov->pcm_pos = 0;
+            return true;
+        }
+    }
+
+    ov->is_active = false;
+    return false;
+}
+
+/**
+ * @brief Applies the stream gains to a decoded frame and mixes the overlaid alert into it.
+ * @param pcm The decoded frame, silence for an alert-only frame.
+ * @param samples Number of samples in the frame.
+ * @return The number of alert samples mixed in.
+ */
+static uint32_t __ai_audio_player_overlay_mix(int16_t *pcm, uint32_t samples)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+    AI_PLAYER_OVERLAY_T *ov = &ctx->overlay;
+    uint16_t tts_gain = ctx->gain[AI_AUDIO_PLAYER_STREAM_TTS];
+    uint32_t done = 0, n = 0;
+
+    if (!ov->is_active) {
+        ai_audio_mixer_gain(pcm, samples, tts_gain);
+        return 0;
+    }
+
+    // the lower priority stream is ducked while the alert plays over it
+    uint16_t duck_gain = (uint16_t)(((uint32_t)tts_gain * ctx->duck_gain) >> AI_AUDIO_GAIN_SHIFT);
+
+    while (done < samples) {
+        if (ov->pcm_pos >= ov->pcm_samples && !__ai_audio_player_overlay_decode()) {
+            // the alert ended inside this frame
+            ai_audio_mixer_gain(pcm + done, samples - done, tts_gain);
+            break;
+        }
+        n = GET_MIN_LEN(samples - done, ov->pcm_samples - ov->pcm_pos);
+        ai_audio_mixer_mix(pcm + done, duck_gain, ov->pcm + ov->pcm_pos, ctx->gain[AI_AUDIO_PLAYER_STREAM_ALERT], n);
+        ov->pcm_pos += n;
+        done += n;
+    }
+
+    return done;
+}
+
+static OPERATE_RET __ai_audio_player_overlay_playing(void)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+    AI_PLAYER_OVERLAY_T *ov = &ctx->overlay;
+    AI_PLAYER_PCM_SLOT_T *slot = NULL;
+    uint32_t samples = MAX_NSAMP, done = 0;
+
+    if (!ov->is_active) {
+        return OPRT_RECV_DA_NOT_ENOUGH;
+    }
+
+    if (__ai_audio_player_pcm_used() >= AI_PLAYER_DECODE_AHEAD_NUM) {
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+
+    // the tts stream has no frame ready, play the alert over silence. A cached alert is
+    // held whole, so it is played a slot at a time
+    if (ov->pcm_pos < ov->pcm_samples) {
+        samples = GET_MIN_LEN(ov->pcm_samples - ov->pcm_pos, AI_PLAYER_PCM_SRC_FRAME);
+    }
+    slot = &ctx->pcm_slot[ctx->pcm_wr];
+    memset(slot->buf, 0, samples * 2);
+    done = __ai_audio_player_overlay_mix((int16_t *)slot->buf, samples);
+    if (0 == done) {
+        return OPRT_RECV_DA_NOT_ENOUGH;
+    }
+
+    __ai_audio_player_pcm_commit(slot, done);
+
+    return OPRT_OK;
+}
+
 static OPERATE_RET __ai_audio_player_mp3_playing(void)
 {
-    OPERATE_RET rt = OPRT_OK;
     APP_PLAYER_T *ctx = &sg_player;
+    AI_PLAYER_PCM_SLOT_T *slot = NULL;
+    uint32_t consumed = 0, samples = 0;
 
-    if (NULL == ctx->mp3_dec) {
-        PR_ERR("mp3 decoder is NULL");
+    if (NULL == ctx->dec) {
+        PR_ERR("tts decoder is NULL");
         return OPRT_COM_ERROR;
     }
 
-    tal_mutex_lock(sg_player.spk_rb_mutex);
-    uint32_t rb_used_len = tuya_ring_buff_used_size_get(ctx->rb_hdl);
-    tal_mutex_unlock(sg_player.spk_rb_mutex);
-    if (0 == rb_used_len && 0 == ctx->mp3_raw_used_len) {
-        // PR_DEBUG("mp3 data is empty");
-        rt = OPRT_RECV_DA_NOT_ENOUGH;
-        goto __EXIT;
+    if (__ai_audio_player_pcm_used() >= AI_PLAYER_DECODE_AHEAD_NUM) {
+        // decoded far enough ahead, wait for the speaker
+        return OPRT_EXCEED_UPPER_LIMIT;
     }
 
-    if (NULL != ctx->mp3_raw_head && ctx->mp3_raw_used_len > 0 && ctx->mp3_raw_head != ctx->mp3_raw) {
-        // PR_DEBUG("move data, offset=%d, used_len=%d", ctx->mp3_raw_head - ctx->mp3_raw, ctx->mp3_raw_used_len);
-        memmove(ctx->mp3_raw, ctx->mp3_raw_head, ctx->mp3_raw_used_len);
+    if (ctx->mp3_raw_wr - ctx->mp3_raw_rd < MAINBUF_SIZE) {
+        __ai_audio_player_mp3_fill();
     }
-    ctx->mp3_raw_head = ctx->mp3_raw;
 
-    // read new data
-    if (rb_used_len > 0 && ctx->mp3_raw_used_len < MAINBUF_SIZE) {
-        uint32_t read_len = ((MAINBUF_SIZE - ctx->mp3_raw_used_len) > rb_used_len)
-                                ? rb_used_len
-                                : (MAINBUF_SIZE - ctx->mp3_raw_used_len);
+    uint32_t raw_len = ctx->mp3_raw_wr - ctx->mp3_raw_rd;
+    if (0 == raw_len) {
+        return OPRT_RECV_DA_NOT_ENOUGH;
+    }
 
-        tal_mutex_lock(sg_player.spk_rb_mutex);
-        uint32_t rt_len = tuya_ring_buff_read(ctx->rb_hdl, ctx->mp3_raw + ctx->mp3_raw_used_len, read_len);
-        tal_mutex_unlock(sg_player.spk_rb_mutex);
-        //  PR_DEBUG("read_len=%d rt_len: %d", read_len, rt_len);
+    // only the decode task writes the slot at pcm_wr, the output task never reads it before it is queued
+    slot = &ctx->pcm_slot[ctx->pcm_wr];
+    ai_audio_decoder_decode(ctx->dec, ctx->dec_hdl, ctx->mp3_raw + ctx->mp3_raw_rd, raw_len, (int16_t *)slot->buf,
+                            &consumed, &samples);
+    if (samples == 0) {
+        if (consumed > 0) {
+            // skipped id3 tag or garbage in front of the next frame
+            ctx->mp3_raw_rd += consumed;
+            return OPRT_OK;
+        }
+        if (ctx->is_eof) {
+            tal_mutex_lock(ctx->spk_rb_mutex);
+            uint32_t rb_used_len = tuya_ring_buff_used_size_get(ctx->rb_hdl);
+            tal_mutex_unlock(ctx->spk_rb_mutex);
+            if (0 == rb_used_len) {
+                // the stream ends with a broken frame, nothing more will come to complete it
+                ctx->mp3_raw_rd = 0;
+                ctx->mp3_raw_wr = 0;
+            }
+        }
+        // partial frame, keep it until the rest arrives
+        return OPRT_RECV_DA_NOT_ENOUGH;
+    }
 
-        ctx->mp3_raw_used_len += rt_len;
+    ctx->mp3_raw_rd += consumed;
+    if (ctx->mp3_raw_rd == ctx->mp3_raw_wr) {
+        ctx->mp3_raw_rd = 0;
+        ctx->mp3_raw_wr = 0;
     }
 
-    int samples = mp3dec_decode_frame(ctx->mp3_dec, ctx->mp3_raw_head, ctx->mp3_raw_used_len,
-                                      (mp3d_sample_t *)ctx->mp3_pcm, &ctx->mp3_frame_info);
-    if (samples == 0) {
-        ctx->mp3_raw_used_len = 0;
-        ctx->mp3_raw_head = ctx->mp3_raw;
-        rt = OPRT_COM_ERROR;
-        goto __EXIT;
+    __ai_audio_player_overlay_mix((int16_t *)slot->buf, samples);
+    __ai_audio_player_pcm_commit(slot, samples);
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __ai_audio_player_pcm_src_playing(void)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+    AI_PLAYER_PCM_SLOT_T *slot = NULL;
+
+    if (__ai_audio_player_pcm_used() >= AI_PLAYER_DECODE_AHEAD_NUM) {
+        return OPRT_EXCEED_UPPER_LIMIT;
     }
 
-    ctx->mp3_raw_used_len -= ctx->mp3_frame_info.frame_bytes;
-    ctx->mp3_raw_head += ctx->mp3_frame_info.frame_bytes;
+    if (ctx->pcm_src_pos >= ctx->pcm_src_samples) {
+        return OPRT_RECV_DA_NOT_ENOUGH;
+    }
 
-    tdl_audio_play(ctx->audio_hdl, ctx->mp3_pcm, samples * 2);
+    uint32_t samples = GET_MIN_LEN(ctx->pcm_src_samples - ctx->pcm_src_pos, AI_PLAYER_PCM_SRC_FRAME);
 
-__EXIT:
-    return rt;
+    slot = &ctx->pcm_slot[ctx->pcm_wr];
+    memcpy(slot->buf, ctx->pcm_src + ctx->pcm_src_pos, samples * 2);
+    ctx->pcm_src_pos += samples;
+
+    __ai_audio_player_overlay_mix((int16_t *)slot->buf, samples);
+    __ai_audio_player_pcm_commit(slot, samples);
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __ai_audio_player_alert_get(AI_AUDIO_ALERT_TYPE_E type, const uint8_t **data, uint32_t *len)
+{
+    const uint8_t *src = NULL;
+    uint32_t src_len = 0;
+
+    switch (type) {
+    case AI_AUDIO_ALERT_POWER_ON:
+        src = media_src_power_on;
+        src_len = sizeof(media_src_power_on);
+        break;
+    case AI_AUDIO_ALERT_NOT_ACTIVE:
+        src = media_src_not_active;
+        src_len = sizeof(media_src_not_active);
+        break;
+    case AI_AUDIO_ALERT_NETWORK_CFG:
+        src = media_src_netcfg_mode;
+        src_len = sizeof(media_src_netcfg_mode);
+        break;
+    case AI_AUDIO_ALERT_NETWORK_CONNECTED:
+        src = media_src_network_conencted;
+        src_len = sizeof(media_src_network_conencted);
+        break;
+    case AI_AUDIO_ALERT_NETWORK_FAIL:
+        src = media_src_network_fail;
+        src_len = sizeof(media_src_network_fail);
+        break;
+    case AI_AUDIO_ALERT_NETWORK_DISCONNECT:
+        src = media_src_network_disconnect;
+        src_len = sizeof(media_src_network_disconnect);
+        break;
+    case AI_AUDIO_ALERT_BATTERY_LOW:
+        src = media_src_battery_low;
+        src_len = sizeof(media_src_battery_low);
+        break;
+    case AI_AUDIO_ALERT_PLEASE_AGAIN:
+        src = media_src_please_again;
+        src_len = sizeof(media_src_please_again);
+        break;
+    case AI_AUDIO_ALERT_WAKEUP:
+        src = media_src_wakeup;
+        src_len = sizeof(media_src_wakeup);
+        break;
+    case AI_AUDIO_ALERT_LONG_KEY_TALK:
+        src = media_src_long_press_dialogue;
+        src_len = sizeof(media_src_long_press_dialogue);
+        break;
+    case AI_AUDIO_ALERT_KEY_TALK:
+        src = media_src_key_dialogue;
+        src_len = sizeof(media_src_key_dialogue);
+        break;
+    case AI_AUDIO_ALERT_WAKEUP_TALK:
+        src = media_src_wake_dialogue;
+        src_len = sizeof(media_src_wake_dialogue);
+        break;
+    case AI_AUDIO_ALERT_FREE_TALK:
+        src = media_src_free_dialogue;
+        src_len = sizeof(media_src_free_dialogue);
+        break;
+    default:
+        return OPRT_NOT_FOUND;
+    }
+
+    *data = src;
+    *len = src_len;
+
+    return OPRT_OK;
+}
+
+static bool __ai_audio_player_alert_cache_get(AI_AUDIO_ALERT_TYPE_E type, const int16_t **pcm, uint32_t *samples)
+{
+    AI_PLAYER_ALERT_CACHE_T *entry = NULL;
+
+    if (type >= AI_PLAYER_ALERT_NUM) {
+        return false;
+    }
+
+    entry = &sg_player.alert_cache[type];
+    if (AI_PLAYER_ALERT_CACHE_READY == entry->state) {
+        if (pcm) {
+            *pcm = entry->pcm;
+        }
+        if (samples) {
+            *samples = entry->samples;
+        }
+        return true;
+    }
+
+    // a miss queues the alert, it is decoded the next time the player is idle
+    if (AI_PLAYER_ALERT_CACHE_EMPTY == entry->state) {
+        entry->state = AI_PLAYER_ALERT_CACHE_PENDING;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Does one step of decoding the queued alerts into the cache, called while the player is idle.
+ * @return true if there is more work to do, false if no alert is waiting.
+ */
+static bool __ai_audio_player_alert_cache_step(void)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+    AI_PLAYER_ALERT_CACHE_T *entry = NULL;
+    mp3dec_frame_info_t info;
+    const uint8_t *src = NULL;
+    uint32_t src_len = 0, i = 0;
+    int samples = 0;
+
+    for (i = 0; i < AI_PLAYER_ALERT_NUM; i++) {
+        if (AI_PLAYER_ALERT_CACHE_FILLING == ctx->alert_cache[i].state) {
+            entry = &ctx->alert_cache[i];
+            break;
+        }
+        if (NULL == entry && AI_PLAYER_ALERT_CACHE_PENDING == ctx->alert_cache[i].state) {
+            entry = &ctx->alert_cache[i];
+        }
+    }
+
+    if (NULL == entry) {
+        if (ctx->alert_dec) {
+            tkl_system_psram_free(ctx->alert_dec);
+            ctx->alert_dec = NULL;
+        }
+        return false;
+    }
+
+    i = (uint32_t)(entry - ctx->alert_cache);
+    __ai_audio_player_alert_get((AI_AUDIO_ALERT_TYPE_E)i, &src, &src_len);
+
+    if (NULL == ctx->alert_dec) {
+        ctx->alert_dec = (AI_PLAYER_ALERT_DECODER_T *)tkl_system_psram_malloc(sizeof(AI_PLAYER_ALERT_DECODER_T));
+        if (NULL == ctx->alert_dec) {
+            PR_ERR("malloc alert decoder failed");
+            entry->state = AI_PLAYER_ALERT_CACHE_SKIP;
+            return true;
+        }
+    }
+
+    if (AI_PLAYER_ALERT_CACHE_PENDING == entry->state) {
+        uint32_t total = 0, pos = 0;
+
+        // walk the frame heads to size the pcm buffer, no pcm output
+        mp3dec_init(&ctx->alert_dec->dec);
+        while (pos < src_len) {
+            samples = mp3dec_decode_frame(&ctx->alert_dec->dec, src + pos, src_len - pos, NULL, &info);
+            if (0 == info.frame_bytes) {
+                break;
+            }
+            pos += info.frame_bytes;
+            total += samples * info.channels;
+        }
+
+        if (0 == total || ctx->alert_cache_used + total * 2 > AI_PLAYER_ALERT_CACHE_SIZE) {
+            PR_NOTICE("alert %d not cached, pcm:%d, cache used:%d", i, total * 2, ctx->alert_cache_used);
+            entry->state = AI_PLAYER_ALERT_CACHE_SKIP;
+            return true;
+        }
+
+        entry->pcm = (int16_t *)tkl_system_psram_malloc(total * 2);
+        if (NULL == entry->pcm) {
+            PR_ERR("malloc alert %d cache failed", i);
+            entry->state = AI_PLAYER_ALERT_CACHE_SKIP;
+            return true;
+        }
+        ctx->alert_cache_used += total * 2;
+
+        mp3dec_init(&ctx->alert_dec->dec);
+        entry->samples = total;
+        entry->fill = 0;
+        entry->src_pos = 0;
+        entry->state = AI_PLAYER_ALERT_CACHE_FILLING;
+        return true;
+    }
+
+    // one frame per step, a play request only waits for the frame in progress
+    if (entry->src_pos < src_len) {
+        samples = mp3dec_decode_frame(&ctx->alert_dec->dec, src + entry->src_pos, src_len - entry->src_pos,
+                                      ctx->alert_dec->pcm, &info);
+        if (info.frame_bytes > 0) {
+            uint32_t n = GET_MIN_LEN((uint32_t)samples * info.channels, entry->samples - entry->fill);
+
+            memcpy(entry->pcm + entry->fill, ctx->alert_dec->pcm, n * 2);
+            entry->fill += n;
+            entry->src_pos += info.frame_bytes;
+            return true;
+        }
+    }
+
+    entry->samples = entry->fill;
+    entry->state = AI_PLAYER_ALERT_CACHE_READY;
+    PR_DEBUG("alert %d cached, pcm:%d, cache used:%d", i, entry->samples * 2, ctx->alert_cache_used);
+
+    return true;
+}
+
+static void __ai_audio_player_out_task(void *arg)
+{
+    APP_PLAYER_T *ctx = &sg_player;
+    AI_PLAYER_PCM_SLOT_T *slot = NULL;
+    bool is_valid = false;
+
+    for (;;) {
+        tal_semaphore_wait_forever(ctx->pcm_sem);
+
+        tal_mutex_lock(ctx->pcm_mutex);
+        slot = &ctx->pcm_slot[ctx->pcm_rd];
+        is_valid = (slot->gen == ctx->pcm_gen);
+        tal_mutex_unlock(ctx->pcm_mutex);
+
+        if (is_valid) {
+            tal_mutex_lock(ctx->pcm_mutex);
+            if (0 == ctx->first_sample_ms) {
+                ctx->first_sample_ms = (uint32_t)(tal_system_get_millisecond() - ctx->start_ms);
+            }
+            tal_mutex_unlock(ctx->pcm_mutex);
+
+#if defined(AI_AUDIO_SW_AEC) && (AI_AUDIO_SW_AEC == 1)
+            // the far-end reference of the echo canceller, a no-op when it is not initialized
+            ai_audio_aec_ref_write((const int16_t *)slot->buf, slot->len / sizeof(int16_t));
+#endif
+            tdl_audio_play(ctx->audio_hdl, slot->buf, slot->len);
+        }
+
+        tal_mutex_lock(ctx->pcm_mutex);
+        ctx->pcm_rd = (ctx->pcm_rd + 1) % AI_PLAYER_DECODE_AHEAD_NUM;
+        ctx->pcm_used--;
+        if (0 == ctx->pcm_used && is_valid && !ctx->is_eof) {
+            // the speaker drained before the next frame was decoded
+            ctx->underrun_cnt++;
+        }
+        tal_mutex_unlock(ctx->pcm_mutex);
+
+        __ai_audio_player_wakeup();
+    }
 }
 
 static OPERATE_RET __ai_audio_player_mp3_init(void)
 {
-    OPERATE_RET rt = OPRT_OK;
+    uint32_t i = 0;
 
     PR_DEBUG("app player mp3 init...");
 
-    sg_player.mp3_raw = (uint8_t *)tkl_system_psram_malloc(MAINBUF_SIZE);
+    sg_player.mp3_raw = (uint8_t *)tkl_system_psram_malloc(MP3_RAW_BUF_SIZE);
     TUYA_CHECK_NULL_GOTO(sg_player.mp3_raw, __ERR);
 
-    sg_player.mp3_pcm = (uint8_t *)tkl_system_psram_malloc(MP3_PCM_SIZE_MAX);
-    TUYA_CHECK_NULL_GOTO(sg_player.mp3_pcm, __ERR);
+    for (i = 0; i < AI_PLAYER_DECODE_AHEAD_NUM; i++) {
+        sg_player.pcm_slot[i].buf = (uint8_t *)tkl_system_psram_malloc(MP3_PCM_SIZE_MAX);
+        TUYA_CHECK_NULL_GOTO(sg_player.pcm_slot[i].buf, __ERR);
+    }
 
-    return rt;
+    sg_player.overlay.pcm_buf = (int16_t *)tkl_system_psram_malloc(MP3_PCM_SIZE_MAX);
+    TUYA_CHECK_NULL_GOTO(sg_player.overlay.pcm_buf, __ERR);
+
+    return OPRT_OK;
 
 __ERR:
-    if (sg_player.mp3_pcm) {
-        tkl_system_psram_free(sg_player.mp3_pcm);
-        sg_player.mp3_pcm = NULL;
+    for (i = 0; i < AI_PLAYER_DECODE_AHEAD_NUM; i++) {
+        if (sg_player.pcm_slot[i].buf) {
+            tkl_system_psram_free(sg_player.pcm_slot[i].buf);
+            sg_player.pcm_slot[i].buf = NULL;
+        }
     }
 
     if (sg_player.mp3_raw) {
@@ -185,6 +816,11 @@ __ERR:
         sg_player.mp3_raw = NULL;
     }
 
+    if (sg_player.overlay.pcm_buf) {
+        tkl_system_psram_free(sg_player.overlay.pcm_buf);
+        sg_player.overlay.pcm_buf = NULL;
+    }
+
     return OPRT_COM_ERROR;
 }
 
@@ -193,6 +829,7 @@ static void __ai_audio_player_task(void *arg)
     OPERATE_RET rt = OPRT_OK;
     APP_PLAYER_T *ctx = &sg_player;
     static AI_AUDIO_PLAYER_STATE_E last_state = 0xFF;
+    bool is_busy = false;
 
     ctx->stat = AI_AUDIO_PLAYER_STAT_IDLE;
 
@@ -201,6 +838,7 @@ static void __ai_audio_player_task(void *arg)
 
         AI_AUDIO_PLAYER_STAT_CHANGE(last_state, ctx->stat);
         last_state = ctx->stat;
+        is_busy = false;
 
         switch (ctx->stat) {
         case AI_AUDIO_PLAYER_STAT_IDLE: {
@@ -208,6 +846,12 @@ static void __ai_audio_player_task(void *arg)
                 tal_sw_timer_stop(ctx->tm_id);
             }
             ctx->is_eof = 0;
+            ctx->overlay.is_active = false;
+            ctx->pcm_src = NULL;
+            // decode the requested alerts into the cache while nothing plays
+            if (__ai_audio_player_alert_cache_step()) {
+                is_busy = true;
+            }
         } break;
         case AI_AUDIO_PLAYER_STAT_START: {
             rt = __ai_audio_player_mp3_start();
@@ -216,22 +860,68 @@ static void __ai_audio_player_task(void *arg)
             } else {
                 ctx->stat = AI_AUDIO_PLAYER_STAT_PLAY;
             }
+            is_busy = true;
         } break;
         case AI_AUDIO_PLAYER_STAT_PLAY: {
+            if (ctx->pcm_src) {
+                if (tal_sw_timer_is_running(ctx->tm_id)) {
+                    tal_sw_timer_stop(ctx->tm_id);
+                }
+                if (OPRT_OK == __ai_audio_player_pcm_src_playing()) {
+                    is_busy = true;
+                } else if (ctx->pcm_src_pos >= ctx->pcm_src_samples && !ctx->overlay.is_active &&
+                           0 == __ai_audio_player_pcm_used()) {
+                    PR_DEBUG("app player end, cached alert, first sample:%dms", ctx->first_sample_ms);
+                    ctx->stat = AI_AUDIO_PLAYER_STAT_FINISH;
+                    is_busy = true;
+                }
+                break;
+            }
+
+            if (ctx->jb.is_prebuffering) {
+                if (false == __ai_audio_player_prebuffer_ready()) {
+                    if (0 == ctx->jb.depth_ms && !tal_sw_timer_is_running(ctx->tm_id)) {
+                        tal_sw_timer_start(ctx->tm_id, PLAYING_NO_DATA_TIMEOUT_MS, TAL_TIMER_ONCE);
+                    }
+                    // an overlaid alert is not held back by the tts prebuffer
+                    if (OPRT_OK == __ai_audio_player_overlay_playing()) {
+                        is_busy = true;
+                    }
+                    break;
+                }
+                ctx->jb.is_prebuffering = false;
+                ctx->jb.added_latency_ms += (uint32_t)(tal_system_get_millisecond() - ctx->jb.prebuf_start);
+            }
+
             rt = __ai_audio_player_mp3_playing();
             if (OPRT_RECV_DA_NOT_ENOUGH == rt) {
-                tal_sw_timer_start(ctx->tm_id, PLAYING_NO_DATA_TIMEOUT_MS, TAL_TIMER_ONCE);
+                if (!tal_sw_timer_is_running(ctx->tm_id)) {
+                    tal_sw_timer_start(ctx->tm_id, PLAYING_NO_DATA_TIMEOUT_MS, TAL_TIMER_ONCE);
+                }
+                if (!ctx->is_eof && 0 == __ai_audio_player_pcm_used()) {
+                    // starved mid-stream, rebuild the prebuffer before playing on
+                    ctx->jb.is_prebuffering = true;
+                    ctx->jb.prebuf_start = tal_system_get_millisecond();
+                }
+                if (OPRT_OK == __ai_audio_player_overlay_playing()) {
+                    is_busy = true;
+                }
             } else if (OPRT_OK == rt) {
                 if (tal_sw_timer_is_running(ctx->tm_id)) {
                     tal_sw_timer_stop(ctx->tm_id);
                 }
+                // keep decoding until the pcm queue is full
+                is_busy = true;
             }
             tal_mutex_lock(ctx->spk_rb_mutex);
             uint32_t rb_used_len = tuya_ring_buff_used_size_get(ctx->rb_hdl);
             tal_mutex_unlock(ctx->spk_rb_mutex);
-            if (rb_used_len == 0 && 0 == ctx->mp3_raw_used_len && ctx->is_eof) {
-                PR_DEBUG("app player end");
+            if (rb_used_len == 0 && ctx->mp3_raw_wr == ctx->mp3_raw_rd && ctx->is_eof && !ctx->overlay.is_active &&
+                0 == __ai_audio_player_pcm_used()) {
+                PR_DEBUG("app player end, underrun:%d, prebuffer:%dms, first sample:%dms", ctx->underrun_cnt,
+                         ctx->jb.added_latency_ms, ctx->first_sample_ms);
                 ctx->stat = AI_AUDIO_PLAYER_STAT_FINISH;
+                is_busy = true;
             }
         } break;
         case AI_AUDIO_PLAYER_STAT_FINISH: {
@@ -240,6 +930,8 @@ static void __ai_audio_player_task(void *arg)
             ctx->is_playing = false;
             ctx->stat = AI_AUDIO_PLAYER_STAT_IDLE;
             ctx->is_eof = 0;
+            ctx->overlay.is_active = false;
+            ctx->pcm_src = NULL;
         } break;
         case AI_AUDIO_PLAYER_STAT_PAUSE:
             // do nothing
@@ -250,7 +942,10 @@ static void __ai_audio_player_task(void *arg)
 
         tal_mutex_unlock(sg_player.mutex);
 
-        tal_system_sleep(10);
+        if (!is_busy) {
+            // writers, state changes and the output task post the semaphore
+            tal_semaphore_wait_forever(ctx->wake_sem);
+        }
     }
 }
 
@@ -260,6 +955,7 @@ static void __app_playing_tm_cb(TIMER_ID timer_id, void *arg)
     tal_mutex_lock(sg_player.mutex);
     sg_player.stat = AI_AUDIO_PLAYER_STAT_FINISH;
     tal_mutex_unlock(sg_player.mutex);
+    __ai_audio_player_wakeup();
     return;
 }
 
@@ -291,6 +987,10 @@ OPERATE_RET ai_audio_player_init(void)
     OPERATE_RET rt = OPRT_OK;
 
     memset(&sg_player, 0, sizeof(APP_PLAYER_T));
+    sg_player.jb.mode = AI_PLAYER_JITTER_MODE;
+    sg_player.gain[AI_AUDIO_PLAYER_STREAM_TTS] = AI_AUDIO_GAIN_UNITY;
+    sg_player.gain[AI_AUDIO_PLAYER_STREAM_ALERT] = AI_AUDIO_GAIN_UNITY;
+    sg_player.duck_gain = AI_PLAYER_DUCK_GAIN;
 
     PR_DEBUG("app player init...");
 
@@ -298,6 +998,9 @@ OPERATE_RET ai_audio_player_init(void)
 
     // create mutex
     TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&sg_player.mutex), __ERR);
+    TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&sg_player.pcm_mutex), __ERR);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&sg_player.wake_sem, 0, 1), __ERR);
+    TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&sg_player.pcm_sem, 0, AI_PLAYER_DECODE_AHEAD_NUM), __ERR);
 
     TUYA_CALL_ERR_GOTO(tal_sw_timer_create(__app_playing_tm_cb, NULL, &sg_player.tm_id), __ERR);
 
@@ -312,6 +1015,12 @@ OPERATE_RET ai_audio_player_init(void)
     TUYA_CALL_ERR_GOTO(tkl_thread_create_in_psram(&sg_player.thrd_hdl, "ai_player", 1024 * 4, THREAD_PRIO_1,
                                                   __ai_audio_player_task, NULL),
                        __ERR);
+    TUYA_CALL_ERR_GOTO(tkl_thread_create_in_psram(&sg_player.out_thrd_hdl, "ai_player_out", 1024 * 2, THREAD_PRIO_1,
+                                                  __ai_audio_player_out_task, NULL),
+                       __ERR);
+
+    // the wakeup tone is played when latency matters most, have it decoded before the first wakeup
+    ai_audio_player_alert_cache_preload(AI_AUDIO_ALERT_WAKEUP);
 
     PR_DEBUG("app player init success");
 
@@ -328,6 +1037,21 @@ __ERR:
         sg_player.spk_rb_mutex = NULL;
     }
 
+    if (sg_player.pcm_mutex) {
+        tal_mutex_release(sg_player.pcm_mutex);
+        sg_player.pcm_mutex = NULL;
+    }
+
+    if (sg_player.wake_sem) {
+        tal_semaphore_release(sg_player.wake_sem);
+        sg_player.wake_sem = NULL;
+    }
+
+    if (sg_player.pcm_sem) {
+        tal_semaphore_release(sg_player.pcm_sem);
+        sg_player.pcm_sem = NULL;
+    }
+
     if (sg_player.rb_hdl) {
         tuya_ring_buff_free(sg_player.rb_hdl);
         sg_player.rb_hdl = NULL;
@@ -346,6 +1070,20 @@ __ERR:
  * @return          Returns OPRT_OK if the player is successfully started.
  */
 OPERATE_RET ai_audio_player_start(char *id)
+{
+    return ai_audio_player_start_codec(id, AUDIO_CODEC_MP3);
+}
+
+/**
+ * @brief Starts the audio player for a stream of the given codec.
+ *
+ * @param id          The identifier for the current playback session.
+ *                    If NULL, no specific ID is set.
+ * @param codec_type  AI protocol codec of the stream, decoded by the decoder registered for it.
+ *
+ * @return            Returns OPRT_OK if the player is successfully started.
+ */
+OPERATE_RET ai_audio_player_start_codec(char *id, AI_AUDIO_CODEC_TYPE codec_type)
 {
     tal_mutex_lock(sg_player.mutex);
 
@@ -369,9 +1107,18 @@ OPERATE_RET ai_audio_player_start(char *id)
     }
 
     sg_player.is_playing = true;
+    sg_player.codec_type = codec_type;
     sg_player.stat = AI_AUDIO_PLAYER_STAT_START;
 
+    tal_mutex_lock(sg_player.pcm_mutex);
+    sg_player.start_ms = tal_system_get_millisecond();
+    sg_player.first_sample_ms = 0;
+    tal_mutex_unlock(sg_player.pcm_mutex);
+    // the gap to the previous reply is not network jitter
+    sg_player.jb.last_arrival = 0;
+
     tal_mutex_unlock(sg_player.mutex);
+    __ai_audio_player_wakeup();
 
     PR_NOTICE("ai audio player start");
 
@@ -405,6 +1152,10 @@ OPERATE_RET ai_audio_player_data_write(char *id, uint8_t *data, uint32_t len, ui
         return OPRT_INVALID_PARM;
     }
 
+    if (NULL != data && len > 0) {
+        __ai_audio_player_jitter_update();
+    }
+
     if (NULL != data && len > 0) {
         while ((alreay_write_len < len) &&
                (AI_AUDIO_PLAYER_STAT_PLAY == sg_player.stat || AI_AUDIO_PLAYER_STAT_START == sg_player.stat)) {
@@ -428,12 +1179,14 @@ OPERATE_RET ai_audio_player_data_write(char *id, uint8_t *data, uint32_t len, ui
             tal_mutex_unlock(sg_player.spk_rb_mutex);
 
             alreay_write_len += write_len;
+            __ai_audio_player_wakeup();
         };
         sg_player.is_writing = false;
     }
 
     sg_player.is_eof = is_eof;
     tal_mutex_unlock(sg_player.mutex);
+    __ai_audio_player_wakeup();
 
     return OPRT_OK;
 }
@@ -472,12 +1225,16 @@ OPERATE_RET ai_audio_player_stop(void)
     tuya_ring_buff_reset(sg_player.rb_hdl);
     tal_mutex_unlock(sg_player.spk_rb_mutex);
 
+    __ai_audio_player_pcm_flush();
     tdl_audio_play_stop(sg_player.audio_hdl);
 
+    sg_player.overlay.is_active = false;
+    sg_player.pcm_src = NULL;
     sg_player.is_playing = false;
     sg_player.stat = AI_AUDIO_PLAYER_STAT_IDLE;
 
     tal_mutex_unlock(sg_player.mutex);
+    __ai_audio_player_wakeup();
 
     PR_NOTICE("ai audio player stop");
 
@@ -494,63 +1251,152 @@ OPERATE_RET ai_audio_player_play_alert(AI_AUDIO_ALERT_TYPE_E type)
 {
     OPERATE_RET rt = OPRT_OK;
     char alert_id[64] = {0};
+    const uint8_t *data = NULL;
+    uint32_t len = 0;
+
+    const int16_t *pcm = NULL;
+    uint32_t samples = 0;
 
     snprintf(alert_id, sizeof(alert_id), "alert_%d", type);
 
     ai_audio_player_start(alert_id);
 
-    switch (type) {
-    case AI_AUDIO_ALERT_POWER_ON: {
-        rt = ai_audio_player_data_write(alert_id, (uint8_t *)media_src_power_on, sizeof(media_src_power_on), 1);
-    } break;
-    case AI_AUDIO_ALERT_NOT_ACTIVE: {
-        rt = ai_audio_player_data_write(alert_id, (uint8_t *)media_src_not_active, sizeof(media_src_not_active), 1);
-    } break;
-    case AI_AUDIO_ALERT_NETWORK_CFG: {
-        rt = ai_audio_player_data_write(alert_id, (uint8_t *)media_src_netcfg_mode, sizeof(media_src_netcfg_mode), 1);
-    } break;
-    case AI_AUDIO_ALERT_NETWORK_CONNECTED: {
-        rt = ai_audio_player_data_write(alert_id, (uint8_t *)media_src_network_conencted,
-                                        sizeof(media_src_network_conencted), 1);
-    } break;
-    case AI_AUDIO_ALERT_NETWORK_FAIL: {
-        rt = ai_audio_player_data_write(alert_id, (uint8_t *)media_src_network_fail, sizeof(media_src_network_fail), 1);
-    } break;
-    case AI_AUDIO_ALERT_NETWORK_DISCONNECT: {
-        rt = ai_audio_player_data_write(alert_id, (uint8_t *)media_src_network_disconnect,
-                                        sizeof(media_src_network_disconnect), 1);
-    } break;
-    case AI_AUDIO_ALERT_BATTERY_LOW: {
-        rt = ai_audio_player_data_write(alert_id, (uint8_t *)media_src_battery_low, sizeof(media_src_battery_low), 1);
-    } break;
-    case AI_AUDIO_ALERT_PLEASE_AGAIN: {
-        rt = ai_audio_player_data_write(alert_id, (uint8_t *)media_src_please_again, sizeof(media_src_please_again), 1);
-    } break;
-    case AI_AUDIO_ALERT_WAKEUP: {
-        rt = ai_audio_player_data_write(alert_id, (uint8_t *)media_src_wakeup, sizeof(media_src_wakeup), 1);
-    } break;
-    case AI_AUDIO_ALERT_LONG_KEY_TALK: {
-        rt = ai_audio_player_data_write(alert_id, (uint8_t *)media_src_long_press_dialogue,
-                                        sizeof(media_src_long_press_dialogue), 1);
-    } break;
-    case AI_AUDIO_ALERT_KEY_TALK: {
-        rt = ai_audio_player_data_write(alert_id, (uint8_t *)media_src_key_dialogue, sizeof(media_src_key_dialogue), 1);
-    } break;
-    case AI_AUDIO_ALERT_WAKEUP_TALK: {
-        rt = ai_audio_player_data_write(alert_id, (uint8_t *)media_src_wake_dialogue, sizeof(media_src_wake_dialogue),
-                                        1);
-    } break;
-    case AI_AUDIO_ALERT_FREE_TALK: {
-        rt = ai_audio_player_data_write(alert_id, (uint8_t *)media_src_free_dialogue, sizeof(media_src_free_dialogue),
-                                        1);
-    } break;
-    default:
-        break;
+    if (OPRT_OK != __ai_audio_player_alert_get(type, &data, &len)) {
+        return rt;
     }
 
+    tal_mutex_lock(sg_player.mutex);
+    if (true == __ai_audio_player_alert_cache_get(type, &pcm, &samples)) {
+        if ((AI_AUDIO_PLAYER_STAT_PLAY == sg_player.stat || AI_AUDIO_PLAYER_STAT_START == sg_player.stat) &&
+            __app_player_compare_id(alert_id, sg_player.id)) {
+            sg_player.pcm_src = pcm;
+            sg_player.pcm_src_samples = samples;
+            sg_player.pcm_src_pos = 0;
+            sg_player.is_eof = 1;
+        }
+        tal_mutex_unlock(sg_player.mutex);
+        __ai_audio_player_wakeup();
+        return rt;
+    }
+    tal_mutex_unlock(sg_player.mutex);
+
+    rt = ai_audio_player_data_write(alert_id, (uint8_t *)data, len, 1);
+
+    return rt;
+}
+
+/**
+ * @brief Plays an alert over the stream being played, ducking the stream while the alert lasts.
+ *
+ * The stream keeps decoding, the alert is mixed into its frames. When nothing is playing the alert
+ * is played on its own like ai_audio_player_play_alert().
+ *
+ * @param type The type of alert to play, defined by the AI_AUDIO_ALERT_TYPE_E enum.
+ * @return OPERATE_RET - OPRT_OK if the alert is queued, otherwise an error code.
+ */
+OPERATE_RET ai_audio_player_play_alert_overlay(AI_AUDIO_ALERT_TYPE_E type)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_PLAYER_OVERLAY_T *ov = &sg_player.overlay;
+    const uint8_t *data = NULL;
+    uint32_t len = 0;
+
+    TUYA_CALL_ERR_RETURN(__ai_audio_player_alert_get(type, &data, &len));
+
+    tal_mutex_lock(sg_player.mutex);
+
+    if (AI_AUDIO_PLAYER_STAT_PLAY != sg_player.stat && AI_AUDIO_PLAYER_STAT_START != sg_player.stat) {
+        tal_mutex_unlock(sg_player.mutex);
+        return ai_audio_player_play_alert(type);
+    }
+
+    if (NULL == ov->dec) {
+        ov->dec = (mp3dec_t *)tkl_system_psram_malloc(sizeof(mp3dec_t));
+        if (NULL == ov->dec) {
+            tal_mutex_unlock(sg_player.mutex);
+            PR_ERR("malloc overlay mp3dec_t failed");
+            return OPRT_MALLOC_FAILED;
+        }
+    }
+
+    // a new alert replaces the one still playing
+    mp3dec_init(ov->dec);
+    ov->src = data;
+    ov->src_len = len;
+    ov->src_pos = 0;
+    ov->pcm_samples = 0;
+    ov->pcm_pos = 0;
+    ov->is_active = true;
+
+    if (true == __ai_audio_player_alert_cache_get(type, &ov->pcm, &ov->pcm_samples)) {
+        // nothing left to decode once the cached pcm is mixed in
+        ov->src_pos = ov->src_len;
+    }
+
+    tal_mutex_unlock(sg_player.mutex);
+    __ai_audio_player_wakeup();
+
+    return rt;
+}
+
+/**
+ * @brief Requests an alert to be decoded into the alert cache.
+ *
+ * The alert is decoded in the background the next time the player is idle, later plays of the
+ * alert skip the mp3 decoder.
+ *
+ * @param type The type of alert to cache, defined by the AI_AUDIO_ALERT_TYPE_E enum.
+ * @return OPERATE_RET - OPRT_OK if the alert is cached or queued, otherwise an error code.
+ */
+OPERATE_RET ai_audio_player_alert_cache_preload(AI_AUDIO_ALERT_TYPE_E type)
+{
+    OPERATE_RET rt = OPRT_OK;
+    const uint8_t *data = NULL;
+    uint32_t len = 0;
+
+    TUYA_CALL_ERR_RETURN(__ai_audio_player_alert_get(type, &data, &len));
+
+    tal_mutex_lock(sg_player.mutex);
+    __ai_audio_player_alert_cache_get(type, NULL, NULL);
+    tal_mutex_unlock(sg_player.mutex);
+    __ai_audio_player_wakeup();
+
     return rt;
 }
 
+/**
+ * @brief Sets the mixing gain of a player stream.
+ * @param stream The stream, a higher value is a higher priority.
+ * @param gain Q12 gain, AI_AUDIO_GAIN_UNITY is 1.0, clamped to AI_AUDIO_GAIN_MAX.
+ * @return OPERATE_RET - OPRT_OK on success, otherwise an error code.
+ */
+OPERATE_RET ai_audio_player_set_mix_gain(AI_AUDIO_PLAYER_STREAM_E stream, uint16_t gain)
+{
+    if (stream >= AI_AUDIO_PLAYER_STREAM_MAX) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(sg_player.mutex);
+    sg_player.gain[stream] = GET_MIN_LEN(gain, AI_AUDIO_GAIN_MAX);
+    tal_mutex_unlock(sg_player.mutex);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Sets how much the tts stream is attenuated while an alert is overlaid.
+ * @param gain Q12 gain applied on top of the stream gain, clamped to AI_AUDIO_GAIN_UNITY.
+ * @return OPERATE_RET - OPRT_OK on success, otherwise an error code.
+ */
+OPERATE_RET ai_audio_player_set_duck_gain(uint16_t gain)
+{
+    tal_mutex_lock(sg_player.mutex);
+    sg_player.duck_gain = GET_MIN_LEN(gain, AI_AUDIO_GAIN_UNITY);
+    tal_mutex_unlock(sg_player.mutex);
+
+    return OPRT_OK;
+}
+
 /**
  * @brief Plays an alert sound synchronously based on the specified alert type.
  * @param type The type of alert to play, defined by the AI_AUDIO_ALERT_TYPE_E enum.
@@ -567,6 +1413,48 @@ OPERATE_RET ai_audio_player_play_alert_syn(AI_AUDIO_ALERT_TYPE_E type)
     return OPRT_OK;
 }
 
+/**
+ * @brief Selects how much the player buffers against network jitter before playing.
+ * @param mode The jitter buffer mode.
+ * @return OPERATE_RET - OPRT_OK on success, otherwise an error code.
+ */
+OPERATE_RET ai_audio_player_set_jitter_mode(AI_AUDIO_PLAYER_JITTER_MODE_E mode)
+{
+    if (mode >= AI_AUDIO_PLAYER_JITTER_MAX) {
+        return OPRT_INVALID_PARM;
+    }
+
+    tal_mutex_lock(sg_player.mutex);
+    sg_player.jb.mode = mode;
+    tal_mutex_unlock(sg_player.mutex);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Gets the jitter buffer statistics of the player.
+ * @param stats Output statistics.
+ * @return OPERATE_RET - OPRT_OK on success, otherwise an error code.
+ */
+OPERATE_RET ai_audio_player_get_stats(AI_AUDIO_PLAYER_STATS_T *stats)
+{
+    TUYA_CHECK_NULL_RETURN(stats, OPRT_INVALID_PARM);
+
+    tal_mutex_lock(sg_player.mutex);
+    stats->jitter_ms = sg_player.jb.jitter_ms;
+    stats->target_ms = sg_player.jb.target_ms;
+    stats->depth_ms = sg_player.jb.depth_ms;
+    stats->first_sample_ms = sg_player.first_sample_ms;
+    stats->added_latency_ms = sg_player.jb.added_latency_ms;
+    tal_mutex_unlock(sg_player.mutex);
+
+    tal_mutex_lock(sg_player.pcm_mutex);
+    stats->underrun_cnt = sg_player.underrun_cnt;
+    tal_mutex_unlock(sg_player.pcm_mutex);
+
+    return OPRT_OK;
+}
+
 /**
  * @brief Checks if the audio player is currently playing audio.
  *
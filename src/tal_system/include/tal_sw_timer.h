@@ -27,6 +27,7 @@
 #define __TAL_SW_TIMER_H__
 
 #include "tuya_cloud_types.h"
+#include "tal_workqueue.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -43,6 +44,9 @@ typedef enum {
     TAL_TIMER_CYCLE,
 } TIMER_TYPE;
 
+// histogram buckets, bucket 0 counts under 1ms and bucket n counts [2^(n-1), 2^n) ms, the last one is open
+#define TAL_SW_TIMER_HIST_NUM 8
+
 /***********************************************************************
  ********************* struct ******************************************
  **********************************************************************/
@@ -51,6 +55,18 @@ typedef void *TIMER_ID;
 
 typedef void (*TAL_TIMER_CB)(TIMER_ID timer_id, void *arg);
 
+// called after a callback ran longer than the budget
+typedef void (*TAL_TIMER_SLOW_CB)(TIMER_ID timer_id, TAL_TIMER_CB cb, TIME_MS run_ms);
+
+typedef struct {
+    uint32_t fire_cnt;
+    uint32_t miss_cnt;                            // expiries skipped while the offloaded callback was still queued
+    TIME_MS run_max;                              // longest callback, ms
+    TIME_MS late_max;                             // latest callback start after the expire time, ms
+    uint16_t run_hist[TAL_SW_TIMER_HIST_NUM];     // callback duration
+    uint16_t late_hist[TAL_SW_TIMER_HIST_NUM];    // callback start after the expire time, slack included
+} TAL_SW_TIMER_STATS_T;
+
 /***********************************************************************
  ********************* variable ****************************************
  **********************************************************************/
@@ -145,6 +161,40 @@ OPERATE_RET tal_sw_timer_remain_time_get(TIMER_ID timer_id, uint32_t *remain_tim
  */
 OPERATE_RET tal_sw_timer_start(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE timer_type);
 
+/**
+ * @brief Start the software timer with a slack
+ *
+ * @param[in] timer_id: timer id
+ * @param[in] time_ms: timer running cycle
+ * @param[in] timer_type: timer type
+ * @param[in] slack_ms: how late the timer may fire
+ *
+ * @note This API is used for starting a timer that can fire up to slack_ms
+ * late. The timer thread wakes up at the latest time that meets the slack of
+ * every timer and fires all timers expired by then together, so periodic
+ * timers with similar periods share wakeups. tal_sw_timer_start starts a timer
+ * without slack.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_start_with_slack(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE timer_type,
+                                          TIME_MS slack_ms);
+
+/**
+ * @brief Get the time to the next wakeup the software timers need
+ *
+ * @param[out] wakeup_ms: ms until the timer thread has to run,
+ * SEM_WAIT_FOREVER when no timer is running
+ *
+ * @note This API is used by the low power code to sleep as long as the
+ * timers allow.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_get_next_wakeup(TIME_MS *wakeup_ms);
+
 /**
  * @brief Trigger the software timer
  *
@@ -157,6 +207,49 @@ OPERATE_RET tal_sw_timer_start(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE ti
  */
 OPERATE_RET tal_sw_timer_trigger(TIMER_ID timer_id);
 
+/**
+ * @brief Run the callback of the software timer on a workqueue
+ *
+ * @param[in] timer_id: timer id
+ * @param[in] workq: the workqueue, NULL to run the callback on the timer
+ * thread
+ *
+ * @note This API is used for timers whose callback may block, such as a
+ * flash write or a synchronous publish, so they do not delay the other
+ * timers. Callbacks on the timer thread must be short.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_set_workqueue(TIMER_ID timer_id, WORKQUEUE_HANDLE workq);
+
+/**
+ * @brief Set the budget of the timer callbacks
+ *
+ * @param[in] budget_ms: longest run of a callback, 0 to disable the check
+ * @param[in] slow_cb: called after a callback ran longer, NULL to log a
+ * warning instead
+ *
+ * @note This API is used for finding the callbacks that delay other timers.
+ * The budget and the hook are global, they apply to every timer, inline or
+ * offloaded, and a later call replaces them.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_set_slow_cb(TIME_MS budget_ms, TAL_TIMER_SLOW_CB slow_cb);
+
+/**
+ * @brief Get the callback statistics of the software timer
+ *
+ * @param[in] timer_id: timer id
+ * @param[out] stats: callback duration and lateness histograms
+ *
+ * @return OPRT_OK on success, OPRT_NOT_SUPPORTED without
+ * ENABLE_SW_TIMER_STATS. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_get_stats(TIMER_ID timer_id, TAL_SW_TIMER_STATS_T *stats);
+
 /**
  * @brief Release all resource of the software timer
  *
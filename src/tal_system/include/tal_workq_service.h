@@ -34,7 +34,12 @@ typedef enum {
     /**
      * high priority workqueue (block operations are not allowed)
      */
-    WORKQ_HIGHTPRI
+    WORKQ_HIGHTPRI,
+    /**
+     * workqueue with several threads (block operations are allowed), works
+     * run concurrently. Same as WORKQ_SYSTEM when WORK_QUEUE_POOL_WORKERS is 0
+     */
+    WORKQ_POOL
 } WORKQ_SERVICE_E;
 
 /**
@@ -78,6 +83,34 @@ OPERATE_RET tal_workq_schedule(WORKQ_SERVICE_E service, WORKQUEUE_CB cb, void *d
  */
 OPERATE_RET tal_workq_schedule_instant(WORKQ_SERVICE_E service, WORKQUEUE_CB cb, void *data);
 
+/**
+ * @brief put work task in workqueue, the works of a key run one after another
+ * in the order they were put
+ *
+ * @param[in] service the workqueue service
+ * @param[in] key the serialization key
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workq_schedule_ordered(WORKQ_SERVICE_E service, uint32_t key, WORKQUEUE_CB cb, void *data);
+
+/**
+ * @brief put work task in workqueue with a priority and a deadline
+ *
+ * @param[in] service the workqueue service
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ * @param[in] option priority and deadline of the work
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workq_schedule_with_option(WORKQ_SERVICE_E service, WORKQUEUE_CB cb, void *data,
+                                           const WORK_OPTION_T *option);
+
 /**
  * @brief cancel work task in workqueue
  *
@@ -39,11 +39,29 @@ typedef struct {
 } WORK_ITEM_T;
 typedef BOOL_T (*WORKQUEUE_TRAVERSE_CB)(WORK_ITEM_T *item, void *ctx);
 
+typedef enum {
+    WORK_PRIO_HIGH,
+    WORK_PRIO_NORMAL,
+    WORK_PRIO_LOW,
+    WORK_PRIO_MAX,
+} WORK_PRIO_E;
+
+typedef struct {
+    WORK_PRIO_E prio;
+    TIME_MS deadline; // ms after scheduling the work has to start by, 0 for none
+    BOOL_T drop_late; // skip the work when it would start after its deadline
+} WORK_OPTION_T;
+
+typedef struct {
+    uint32_t deadline_miss; // works started after their deadline, dropped ones included
+    uint32_t deadline_drop; // late works skipped
+} WORKQUEUE_STATS_T;
+
 /**
  * @brief create and initialize a workqueue which runs in thread context
  *
  * @param[in] queue_len the maximum number of items that the workqueue can
- * contain
+ * contain, see tal_workqueue_set_capacity
  * @param[in] thread_cfg thread param
  * @param[out] handle the workqueue handle
  *
@@ -52,6 +70,26 @@ typedef BOOL_T (*WORKQUEUE_TRAVERSE_CB)(WORK_ITEM_T *item, void *ctx);
  */
 OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_cfg, WORKQUEUE_HANDLE *handle);
 
+/**
+ * @brief create and initialize a workqueue served by several threads
+ *
+ * @param[in] queue_len the maximum number of items the workqueue can contain,
+ * shared by the workers
+ * @param[in] worker_num number of worker threads
+ * @param[in] thread_cfg thread param of every worker, the worker index is
+ * appended to the name
+ * @param[out] handle the workqueue handle
+ *
+ * @note Works run concurrently, a worker out of work takes the works queued
+ * on the busy ones. Use tal_workqueue_schedule_ordered for works that must
+ * not run concurrently or out of order.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_create_pool(const uint16_t queue_len, const uint8_t worker_num, THREAD_CFG_T *thread_cfg,
+                                      WORKQUEUE_HANDLE *handle);
+
 /**
  * @brief put work task in workqueue
  *
@@ -76,6 +114,42 @@ OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, voi
  */
 OPERATE_RET tal_workqueue_schedule_instant(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data);
 
+/**
+ * @brief put work task in workqueue with a priority and a deadline
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ * @param[in] option priority and deadline of the work
+ *
+ * @note Works of a higher priority are dequeued first. Within a priority,
+ * works with a deadline go earliest deadline first and before the works
+ * without one, those run in the order they were put. Instant works go before
+ * high ones.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_schedule_with_option(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data,
+                                               const WORK_OPTION_T *option);
+
+/**
+ * @brief put work task in workqueue, the works of a key run one after another
+ * in the order they were put
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] key the serialization key
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ *
+ * @note Works of different keys may share a worker and are then serialized
+ * too.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_schedule_ordered(WORKQUEUE_HANDLE handle, uint32_t key, WORKQUEUE_CB cb, void *data);
+
 /**
  * @brief cancel work task in workqueue
  *
@@ -109,6 +183,29 @@ OPERATE_RET tal_workqueue_traverse(WORKQUEUE_HANDLE handle, WORKQUEUE_TRAVERSE_C
  */
 uint16_t tal_workqueue_get_num(WORKQUEUE_HANDLE handle);
 
+/**
+ * @brief set how many items the workqueue can contain
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] queue_len the maximum number of items, items already queued
+ * above it are kept
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_set_capacity(WORKQUEUE_HANDLE handle, uint16_t queue_len);
+
+/**
+ * @brief get the deadline statistics of the workqueue
+ *
+ * @param[in] handle the workqueue handle
+ * @param[out] stats the statistics
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_get_stats(WORKQUEUE_HANDLE handle, WORKQUEUE_STATS_T *stats);
+
 /**
  * @brief release the workqueue
  *
@@ -12,6 +12,17 @@
 #define STACK_SIZE_TIMERQ (4 * 1024)
 #endif
 
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+// 4 levels of 64 slots, a slot is 1ms, 64ms, 4.1s and 262s long, about 4.6 hours in all.
+// Timers further out wait in the last level and are placed again when they get there
+#define TIMER_WHEEL_BITS   6
+#define TIMER_WHEEL_SLOTS  (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK   (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SPAN(level) ((uint64_t)1 << (TIMER_WHEEL_BITS * (level)))
+#define TIMER_WHEEL_NONE   0xFF
+#endif
+
 typedef struct {
     LIST_HEAD node;
 
@@ -20,12 +31,26 @@ typedef struct {
 
     uint64_t expire_time;
     TIME_MS interval;
+    TIME_MS slack; // the timer may fire up to slack ms after expire_time, to share a wakeup with other timers
     BOOL_T is_running;
     TIMER_ID timer_id;
     TIMER_TYPE type;
+    WORKQUEUE_HANDLE workq; // NULL runs the callback on the timer thread
+    uint32_t in_cb;         // callbacks picked and not finished yet, a deleted timer is freed after the last
+    BOOL_T is_deleted;
+    BOOL_T work_pending; // the callback is queued on workq and has not started yet
+#if defined(ENABLE_SW_TIMER_STATS) && (ENABLE_SW_TIMER_STATS == 1)
+    uint64_t due_time; // expire time of the callback picked last
+    TAL_SW_TIMER_STATS_T stats;
+#endif
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+    uint8_t wheel_level; // TIMER_WHEEL_NONE when not in a wheel slot
+    uint8_t wheel_slot;
+#endif
 } TIMER_T;
 
 typedef struct {
+    // sorted by expire time. With the timing wheel it only holds the timers due to fire
     LIST_HEAD list_active;
     LIST_HEAD list_standby;
     MUTEX_HANDLE mutex;
@@ -36,10 +61,259 @@ typedef struct {
     THREAD_HANDLE thread;
     SEM_HANDLE sem;
     TAL_TIMER_CB last_cb; // used to debug which cb is blocked
+    uint32_t wakeup_cnt;
+    TIME_MS cb_budget; // 0 for no check
+    TAL_TIMER_SLOW_CB slow_cb;
+
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+    LIST_HEAD wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t wheel_map[TIMER_WHEEL_LEVELS]; // bit set for every slot that is not empty
+    uint64_t wheel_clk;                     // first ms not processed yet
+#endif
 } SW_TIMER_MGR_T;
 
 static SW_TIMER_MGR_T s_timer_mgr;
 
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+static void __timer_wheel_init(uint64_t nowMS)
+{
+    uint32_t level = 0, slot = 0;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            INIT_LIST_HEAD(&(s_timer_mgr.wheel[level][slot]));
+        }
+        s_timer_mgr.wheel_map[level] = 0;
+    }
+    s_timer_mgr.wheel_clk = nowMS;
+}
+
+static void __timer_wheel_add(TIMER_T *timer)
+{
+    uint64_t expire = timer->expire_time;
+    uint64_t delta = 0;
+    uint32_t level = 0, slot = 0;
+
+    // already due, fired by the next dispatch
+    if (expire < s_timer_mgr.wheel_clk) {
+        expire = s_timer_mgr.wheel_clk;
+    }
+
+    delta = expire - s_timer_mgr.wheel_clk;
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+        if (delta < TIMER_WHEEL_SPAN(level + 1)) {
+            break;
+        }
+    }
+    if (delta >= TIMER_WHEEL_SPAN(TIMER_WHEEL_LEVELS)) {
+        expire = s_timer_mgr.wheel_clk + TIMER_WHEEL_SPAN(TIMER_WHEEL_LEVELS) - 1;
+    }
+
+    slot = (expire >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    tuya_list_add_tail(&(timer->node), &(s_timer_mgr.wheel[level][slot]));
+    s_timer_mgr.wheel_map[level] |= (uint64_t)1 << slot;
+    timer->wheel_level = level;
+    timer->wheel_slot = slot;
+}
+
+static void __timer_wheel_del(TIMER_T *timer)
+{
+    tuya_list_del(&(timer->node));
+
+    if (TIMER_WHEEL_NONE != timer->wheel_level) {
+        if (tuya_list_empty(&(s_timer_mgr.wheel[timer->wheel_level][timer->wheel_slot]))) {
+            s_timer_mgr.wheel_map[timer->wheel_level] &= ~((uint64_t)1 << timer->wheel_slot);
+        }
+        timer->wheel_level = TIMER_WHEEL_NONE;
+    }
+}
+
+/**
+ * @brief the slots of a level that hold timers, in time order
+ *
+ * @param[in] level: wheel level
+ * @param[out] base: index of the first slot of the level starting at or after the clock
+ *
+ * @return the occupancy map rotated so that bit n is slot base + n
+ */
+static uint64_t __timer_wheel_map(uint32_t level, uint64_t *base)
+{
+    uint64_t map = s_timer_mgr.wheel_map[level];
+    uint32_t cur = 0;
+
+    *base = (s_timer_mgr.wheel_clk + TIMER_WHEEL_SPAN(level) - 1) >> (TIMER_WHEEL_BITS * level);
+    cur = *base & TIMER_WHEEL_MASK;
+    if (cur) {
+        map = (map >> cur) | (map << (TIMER_WHEEL_SLOTS - cur));
+    }
+
+    return map;
+}
+
+/**
+ * @brief earliest time the wheel has work, a level 0 slot to fire or a slot of
+ * a higher level to cascade
+ *
+ * @param[out] time: the time in ms
+ *
+ * @return TRUE if the wheel holds any timer
+ */
+static BOOL_T __timer_wheel_next_event(uint64_t *time)
+{
+    uint64_t map = 0, base = 0, event = 0;
+    uint32_t level = 0, ahead = 0;
+    BOOL_T found = FALSE;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        map = __timer_wheel_map(level, &base);
+        if (0 == map) {
+            continue;
+        }
+        ahead = __builtin_ctzll(map);
+
+        event = (base + ahead) << (TIMER_WHEEL_BITS * level);
+        if (!found || event < *time) {
+            *time = event;
+            found = TRUE;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * @brief move the timers due by now to list_active, cascading the slots of
+ * the higher levels on the way. Only the times with work are visited
+ *
+ * @param[in] nowMS: current time in ms
+ *
+ * @return void
+ */
+static void __timer_wheel_advance(uint64_t nowMS)
+{
+    uint64_t event = 0;
+    uint32_t level = 0, slot = 0;
+    LIST_HEAD *head = NULL;
+    TIMER_T *timer = NULL;
+
+    while (__timer_wheel_next_event(&event) && event <= nowMS) {
+        s_timer_mgr.wheel_clk = event;
+
+        // from the top, so timers cascaded down to level 0 fire at this same time
+        for (level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+            if (event & (TIMER_WHEEL_SPAN(level) - 1)) {
+                continue;
+            }
+            slot = (event >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+            head = &(s_timer_mgr.wheel[level][slot]);
+            while (!tuya_list_empty(head)) {
+                timer = tuya_list_entry(head->next, TIMER_T, node);
+                __timer_wheel_del(timer);
+                __timer_wheel_add(timer);
+            }
+        }
+
+        head = &(s_timer_mgr.wheel[0][event & TIMER_WHEEL_MASK]);
+        while (!tuya_list_empty(head)) {
+            timer = tuya_list_entry(head->next, TIMER_T, node);
+            __timer_wheel_del(timer);
+            tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_active));
+        }
+
+        s_timer_mgr.wheel_clk = event + 1;
+    }
+
+    if (s_timer_mgr.wheel_clk <= nowMS) {
+        s_timer_mgr.wheel_clk = nowMS + 1;
+    }
+}
+
+static void __timer_attach(TIMER_T *timer)
+{
+    __timer_wheel_del(timer);
+    __timer_wheel_add(timer);
+}
+
+static void __timer_detach(TIMER_T *timer)
+{
+    __timer_wheel_del(timer);
+}
+
+/**
+ * @brief latest time the timer thread may wake up and still meet the slack of
+ * every timer. The timers whose expire time has passed by then fire together
+ *
+ * @param[out] time: the time in ms
+ *
+ * @return TRUE if any timer is waiting
+ */
+static BOOL_T __timer_next_wakeup(uint64_t *time)
+{
+    uint64_t deadline = UINT64_MAX, map = 0, base = 0, expire = 0;
+    uint32_t level = 0, ahead = 0;
+    struct tuya_list_head *p = NULL;
+    TIMER_T *timer = NULL;
+
+    // a slot only holds timers expiring at or after its start, so slots starting past the deadline are skipped
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        map = __timer_wheel_map(level, &base);
+        while (map) {
+            ahead = __builtin_ctzll(map);
+            if (((base + ahead) << (TIMER_WHEEL_BITS * level)) >= deadline) {
+                break;
+            }
+
+            tuya_list_for_each(p, &(s_timer_mgr.wheel[level][(base + ahead) & TIMER_WHEEL_MASK]))
+            {
+                timer = tuya_list_entry(p, TIMER_T, node);
+                // already due timers wait for the next dispatch, see __timer_wheel_add
+                expire = timer->expire_time;
+                if (expire < s_timer_mgr.wheel_clk) {
+                    expire = s_timer_mgr.wheel_clk;
+                }
+                if (expire + timer->slack < deadline) {
+                    deadline = expire + timer->slack;
+                }
+            }
+            map &= map - 1;
+        }
+    }
+
+    if (UINT64_MAX == deadline) {
+        return FALSE;
+    }
+
+    *time = deadline;
+    return TRUE;
+}
+
+/**
+ * @brief take the first timer due to fire
+ *
+ * @param[in] nowMS: current time in ms
+ * @param[out] next_expired: time to the next expiry, kept when none is due
+ *
+ * @return the timer, or NULL if none is due
+ */
+static TIMER_T *__timer_first_due(uint64_t nowMS, SYS_TIME_T *next_expired)
+{
+    uint64_t wakeup = 0;
+
+    if (tuya_list_empty(&(s_timer_mgr.list_active))) {
+        __timer_wheel_advance(nowMS);
+    }
+
+    if (!tuya_list_empty(&(s_timer_mgr.list_active))) {
+        return tuya_list_entry(s_timer_mgr.list_active.next, TIMER_T, node);
+    }
+
+    if (__timer_next_wakeup(&wakeup)) {
+        *next_expired = wakeup - nowMS;
+    }
+
+    return NULL;
+}
+#else
 static void __timer_attach(TIMER_T *timer)
 {
     tuya_list_del(&(timer->node));
@@ -65,13 +339,213 @@ static void __timer_attach(TIMER_T *timer)
     }
 }
 
-static void __timer_dump(void)
+static void __timer_detach(TIMER_T *timer)
 {
+    tuya_list_del(&(timer->node));
+}
+
+static BOOL_T __timer_next_wakeup(uint64_t *time)
+{
+    uint64_t deadline = UINT64_MAX;
     struct tuya_list_head *p = NULL;
     TIMER_T *timer = NULL;
+
+    tuya_list_for_each(p, &(s_timer_mgr.list_active))
+    {
+        timer = tuya_list_entry(p, TIMER_T, node);
+        if (timer->expire_time >= deadline) {
+            break;
+        }
+        if (timer->expire_time + timer->slack < deadline) {
+            deadline = timer->expire_time + timer->slack;
+        }
+    }
+
+    if (UINT64_MAX == deadline) {
+        return FALSE;
+    }
+
+    *time = deadline;
+    return TRUE;
+}
+
+static TIMER_T *__timer_first_due(uint64_t nowMS, SYS_TIME_T *next_expired)
+{
+    TIMER_T *timer = NULL;
+    uint64_t wakeup = 0;
+
+    if (tuya_list_empty(&(s_timer_mgr.list_active))) {
+        return NULL;
+    }
+
+    timer = tuya_list_entry(s_timer_mgr.list_active.next, TIMER_T, node);
+    if (timer->expire_time > nowMS) {
+        __timer_next_wakeup(&wakeup);
+        *next_expired = wakeup - nowMS;
+        return NULL;
+    }
+
+    return timer;
+}
+#endif
+
+#if defined(ENABLE_SW_TIMER_STATS) && (ENABLE_SW_TIMER_STATS == 1)
+static void __timer_hist_add(uint16_t *hist, TIME_MS ms)
+{
+    uint32_t idx = 0;
+
+    while (ms && idx < TAL_SW_TIMER_HIST_NUM - 1) {
+        ms >>= 1;
+        idx++;
+    }
+
+    if (hist[idx] < UINT16_MAX) {
+        hist[idx]++;
+    }
+}
+#endif
+
+/**
+ * @brief account a callback picked to run, called with the mutex held
+ *
+ * @param[in] timer: the timer
+ * @param[in] nowMS: current time in ms
+ *
+ * @return void
+ */
+static void __timer_cb_start(TIMER_T *timer, uint64_t nowMS)
+{
+#if defined(ENABLE_SW_TIMER_STATS) && (ENABLE_SW_TIMER_STATS == 1)
+    TIME_MS late = 0;
+
+    // triggered timers expire at 0 and are not late
+    if (timer->due_time && nowMS > timer->due_time) {
+        late = (TIME_MS)(nowMS - timer->due_time);
+    }
+
+    timer->stats.fire_cnt++;
+    if (late > timer->stats.late_max) {
+        timer->stats.late_max = late;
+    }
+    __timer_hist_add(timer->stats.late_hist, late);
+#endif
+}
+
+/**
+ * @brief account a callback that finished, called with the mutex held
+ *
+ * @param[in] timer: the timer
+ * @param[in] run_ms: how long the callback ran
+ *
+ * @return TRUE if the timer was deleted meanwhile and has to be freed
+ */
+static BOOL_T __timer_cb_done(TIMER_T *timer, TIME_MS run_ms)
+{
+#if defined(ENABLE_SW_TIMER_STATS) && (ENABLE_SW_TIMER_STATS == 1)
+    if (run_ms > timer->stats.run_max) {
+        timer->stats.run_max = run_ms;
+    }
+    __timer_hist_add(timer->stats.run_hist, run_ms);
+#endif
+
+    timer->in_cb--;
+
+    return (timer->is_deleted && 0 == timer->in_cb);
+}
+
+/**
+ * @brief run a timer callback and check it against the budget
+ *
+ * @param[in] timer: the timer
+ * @param[in] timer_cb: its callback
+ *
+ * @return how long the callback ran, in ms
+ */
+static TIME_MS __timer_cb_run(TIMER_T *timer, TAL_TIMER_CB timer_cb)
+{
+    TIMER_ID timer_id = timer->timer_id;
+    TAL_TIMER_SLOW_CB slow_cb = s_timer_mgr.slow_cb;
+    TIME_MS budget = s_timer_mgr.cb_budget;
+    SYS_TIME_T start = tal_system_get_millisecond();
+    TIME_MS run_ms = 0;
+
+    timer_cb(timer_id, timer->data);
+    run_ms = (TIME_MS)(tal_system_get_millisecond() - start);
+
+    if (budget && run_ms > budget) {
+        if (slow_cb) {
+            slow_cb(timer_id, timer_cb, run_ms);
+        } else {
+            PR_WARN("timer %p cb %p ran %dms, budget %dms", timer_id, timer_cb, run_ms, budget);
+        }
+    }
+
+    return run_ms;
+}
+
+// runs the callback of a timer offloaded with tal_sw_timer_set_workqueue
+static void __timer_work_cb(void *data)
+{
+    TIMER_T *timer = (TIMER_T *)data;
+    TAL_TIMER_CB timer_cb = NULL;
+    TIME_MS run_ms = 0;
+    BOOL_T release = FALSE;
+    TIME_S secTime = 0;
+    TIME_MS msTime = 0;
+
+    tal_time_get_system_time(&secTime, &msTime);
+
+    tal_mutex_lock(s_timer_mgr.mutex);
+    // work_pending is cleared when the timer was stopped after the callback was queued
+    if (!timer->is_deleted && timer->work_pending) {
+        timer_cb = timer->cb;
+        __timer_cb_start(timer, (uint64_t)secTime * 1000 + (uint64_t)msTime);
+    }
+    timer->work_pending = FALSE;
+    tal_mutex_unlock(s_timer_mgr.mutex);
+
+    if (timer_cb) {
+        run_ms = __timer_cb_run(timer, timer_cb);
+    }
+
+    tal_mutex_lock(s_timer_mgr.mutex);
+    release = __timer_cb_done(timer, run_ms);
+    tal_mutex_unlock(s_timer_mgr.mutex);
+
+    if (release) {
+        tal_free(timer);
+    }
+}
+
+static void __timer_dump_node(TIMER_T *timer)
+{
     TAL_TIMER_CB *cb = NULL;
     TIMER_ID *timer_id = NULL;
 
+    cb = &(timer->cb);
+    if (timer->data) {
+        timer_id = timer->data;
+        if (*timer_id == timer->timer_id) {
+            cb = (TAL_TIMER_CB *)((char *)timer->data + sizeof(TIMER_ID));
+        }
+    }
+    PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
+#if defined(ENABLE_SW_TIMER_STATS) && (ENABLE_SW_TIMER_STATS == 1)
+    uint16_t *run = timer->stats.run_hist;
+    uint16_t *late = timer->stats.late_hist;
+    PR_NOTICE("  fire:%d miss:%d run max:%d hist:%d %d %d %d %d %d %d %d late max:%d hist:%d %d %d %d %d %d %d %d",
+              timer->stats.fire_cnt, timer->stats.miss_cnt, timer->stats.run_max, run[0], run[1], run[2], run[3], run[4], run[5], run[6],
+              run[7], timer->stats.late_max, late[0], late[1], late[2], late[3], late[4], late[5], late[6], late[7]);
+#endif
+}
+
+static void __timer_dump(void)
+{
+    struct tuya_list_head *p = NULL;
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+    uint32_t level = 0, slot = 0;
+#endif
+
     TIME_S nowSecTime = 0;
     TIME_MS nowMsTime = 0;
 
@@ -85,32 +559,27 @@ static void __timer_dump(void)
 
     tal_mutex_lock(s_timer_mgr.mutex);
 
+    PR_NOTICE("thread wakeups:%d", s_timer_mgr.wakeup_cnt);
     PR_NOTICE("running timers count:%d", s_timer_mgr.running_cnt);
     tuya_list_for_each(p, &(s_timer_mgr.list_active))
     {
-        timer = tuya_list_entry(p, TIMER_T, node);
-        cb = &(timer->cb);
-        if (timer->data) {
-            timer_id = timer->data;
-            if (*timer_id == timer->timer_id) {
-                cb = (TAL_TIMER_CB *)((char *)timer->data + sizeof(TIMER_ID));
+        __timer_dump_node(tuya_list_entry(p, TIMER_T, node));
+    }
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            tuya_list_for_each(p, &(s_timer_mgr.wheel[level][slot]))
+            {
+                __timer_dump_node(tuya_list_entry(p, TIMER_T, node));
             }
         }
-        PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
     }
+#endif
 
     PR_NOTICE("standby timers count:%d", s_timer_mgr.total_cnt - s_timer_mgr.running_cnt);
     tuya_list_for_each(p, &(s_timer_mgr.list_standby))
     {
-        timer = tuya_list_entry(p, TIMER_T, node);
-        cb = &(timer->cb);
-        if (timer->data) {
-            timer_id = timer->data;
-            if (*timer_id == timer->timer_id) {
-                cb = (TAL_TIMER_CB *)((char *)timer->data + sizeof(TIMER_ID));
-            }
-        }
-        PR_NOTICE("%08x %d %d %p", timer->timer_id, timer->type, timer->interval, *cb);
+        __timer_dump_node(tuya_list_entry(p, TIMER_T, node));
     }
 
     tal_mutex_unlock(s_timer_mgr.mutex);
@@ -122,10 +591,14 @@ static void __timer_dispatch(SYS_TIME_T *next_expired)
     TIME_MS nowMsTime = 0;
     uint64_t nowMS = 0;
     TIMER_T *timer = NULL;
+    TIMER_T *last = NULL;
+    TIMER_T *release = NULL;
     TAL_TIMER_CB timer_cb = NULL;
-    struct tuya_list_head *p = NULL;
+    WORKQUEUE_HANDLE workq = NULL;
+    TIME_MS run_ms = 0;
 
     *next_expired = SEM_WAIT_FOREVER;
+    s_timer_mgr.wakeup_cnt++;
 
     do {
         tal_time_get_system_time(&nowSecTime, &nowMsTime);
@@ -133,40 +606,70 @@ static void __timer_dispatch(SYS_TIME_T *next_expired)
 
         tal_mutex_lock(s_timer_mgr.mutex);
 
-        timer_cb = NULL;
-        tuya_list_for_each(p, &(s_timer_mgr.list_active))
-        {
-            timer = tuya_list_entry(p, TIMER_T, node);
+        // the callback run in the previous loop is accounted under the same lock
+        release = NULL;
+        if (last && __timer_cb_done(last, run_ms)) {
+            release = last;
+        }
+        last = NULL;
 
-            if (timer->expire_time > nowMS) {
-                p = &(s_timer_mgr.list_active);
-                *next_expired = timer->expire_time - nowMS;
+        timer_cb = NULL;
+        timer = __timer_first_due(nowMS, next_expired);
+        if (timer) {
+            workq = timer->workq;
+            if (workq && timer->work_pending) {
+                // the callback of a previous expiry is still queued and covers this one
+#if defined(ENABLE_SW_TIMER_STATS) && (ENABLE_SW_TIMER_STATS == 1)
+                timer->stats.miss_cnt++;
+#endif
             } else {
                 timer_cb = timer->cb;
-
-                if (TAL_TIMER_ONCE == timer->type) {
-                    timer->is_running = FALSE;
-                    s_timer_mgr.running_cnt--;
-                    tuya_list_del(&(timer->node));
-                    tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_standby));
+                timer->in_cb++;
+#if defined(ENABLE_SW_TIMER_STATS) && (ENABLE_SW_TIMER_STATS == 1)
+                timer->due_time = timer->expire_time;
+#endif
+                if (workq) {
+                    timer->work_pending = TRUE;
                 } else {
-                    timer->expire_time = nowMS + timer->interval;
-                    __timer_attach(timer);
+                    __timer_cb_start(timer, nowMS);
                 }
             }
 
-            break;
+            if (TAL_TIMER_ONCE == timer->type) {
+                timer->is_running = FALSE;
+                s_timer_mgr.running_cnt--;
+                __timer_detach(timer);
+                tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_standby));
+            } else {
+                timer->expire_time = nowMS + timer->interval;
+                __timer_attach(timer);
+            }
         }
 
         tal_mutex_unlock(s_timer_mgr.mutex);
 
+        if (release) {
+            tal_free(release);
+        }
+
+        if (timer_cb && workq) {
+            if (OPRT_OK == tal_workqueue_schedule(workq, __timer_work_cb, timer)) {
+                continue;
+            }
+            PR_ERR("timer %p offload failed, run inline", timer->timer_id);
+            tal_mutex_lock(s_timer_mgr.mutex);
+            timer->work_pending = FALSE;
+            __timer_cb_start(timer, nowMS);
+            tal_mutex_unlock(s_timer_mgr.mutex);
+        }
+
         if (timer_cb) {
             s_timer_mgr.last_cb = timer_cb;
-            timer_cb(timer->timer_id, timer->data);
-            timer_cb = NULL;
+            run_ms = __timer_cb_run(timer, timer_cb);
             s_timer_mgr.last_cb = NULL;
+            last = timer;
         }
-    } while (p != &(s_timer_mgr.list_active));
+    } while (timer);
 }
 
 static void __timer_thread_cb(void *data)
@@ -204,6 +707,13 @@ OPERATE_RET tal_sw_timer_init(void)
     INIT_LIST_HEAD(&(s_timer_mgr.list_active));
     INIT_LIST_HEAD(&(s_timer_mgr.list_standby));
 
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+    TIME_S secTime = 0;
+    TIME_MS msTime = 0;
+    tal_time_get_system_time(&secTime, &msTime);
+    __timer_wheel_init((uint64_t)secTime * 1000 + (uint64_t)msTime);
+#endif
+
     THREAD_CFG_T thread_cfg = {.stackDepth = STACK_SIZE_TIMERQ, .priority = THREAD_PRIO_0, .thrdname = "sys_timer"};
 
     op_ret = tal_thread_create_and_start(&s_timer_mgr.thread, NULL, NULL, __timer_thread_cb, NULL, &thread_cfg);
@@ -240,6 +750,9 @@ OPERATE_RET tal_sw_timer_create(TAL_TIMER_CB func, void *arg, TIMER_ID *timer_id
     timer->cb = func;
     timer->data = arg;
     timer->timer_id = (TIMER_ID)timer;
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+    timer->wheel_level = TIMER_WHEEL_NONE;
+#endif
 
     tal_mutex_lock(s_timer_mgr.mutex);
     s_timer_mgr.total_cnt++;
@@ -268,16 +781,22 @@ OPERATE_RET tal_sw_timer_delete(TIMER_ID timer_id)
     }
 
     TIMER_T *timer = (TIMER_T *)timer_id;
+    BOOL_T release = FALSE;
 
     tal_mutex_lock(s_timer_mgr.mutex);
-    tuya_list_del(&(timer->node));
+    __timer_detach(timer);
     s_timer_mgr.total_cnt--;
     if (timer->is_running) {
         s_timer_mgr.running_cnt--;
     }
+    // a callback still pending or running frees the timer when it is done
+    timer->is_deleted = TRUE;
+    release = (0 == timer->in_cb);
     tal_mutex_unlock(s_timer_mgr.mutex);
     tal_semaphore_post(s_timer_mgr.sem);
-    tal_free(timer);
+    if (release) {
+        tal_free(timer);
+    }
 
     return OPRT_OK;
 }
@@ -305,9 +824,11 @@ OPERATE_RET tal_sw_timer_stop(TIMER_ID timer_id)
         timer->is_running = FALSE;
 
         s_timer_mgr.running_cnt--;
-        tuya_list_del(&(timer->node));
+        __timer_detach(timer);
         tuya_list_add_tail(&(timer->node), &(s_timer_mgr.list_standby));
     }
+    // a callback already queued on the workqueue is skipped
+    timer->work_pending = FALSE;
     tal_mutex_unlock(s_timer_mgr.mutex);
     tal_semaphore_post(s_timer_mgr.sem);
 
@@ -389,6 +910,26 @@ OPERATE_RET tal_sw_timer_remain_time_get(TIMER_ID timer_id, uint32_t *remain_tim
  * tuya_error_code.h
  */
 OPERATE_RET tal_sw_timer_start(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE timer_type)
+{
+    return tal_sw_timer_start_with_slack(timer_id, time_ms, timer_type, 0);
+}
+
+/**
+ * @brief Start the software timer with a slack
+ *
+ * @param[in] timer_id: timer id
+ * @param[in] time_ms: timer running cycle
+ * @param[in] timer_type: timer type
+ * @param[in] slack_ms: how late the timer may fire
+ *
+ * @note This API is used for starting a timer that can share a wakeup of the
+ * timer thread with other timers.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_start_with_slack(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE timer_type,
+                                          TIME_MS slack_ms)
 {
     if (NULL == timer_id) {
         return OPRT_INVALID_PARM;
@@ -412,6 +953,7 @@ OPERATE_RET tal_sw_timer_start(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE ti
     }
 
     timer->type = timer_type;
+    timer->slack = slack_ms;
     timer->expire_time = (uint64_t)secTime * 1000 + (uint64_t)msTime + timer->interval;
     __timer_attach(timer);
 
@@ -421,6 +963,48 @@ OPERATE_RET tal_sw_timer_start(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE ti
     return OPRT_OK;
 }
 
+/**
+ * @brief Get the time to the next wakeup the software timers need
+ *
+ * @param[out] wakeup_ms: ms until the timer thread has to run,
+ * SEM_WAIT_FOREVER when no timer is running
+ *
+ * @note This API is used by the low power code to sleep as long as the
+ * timers allow.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_get_next_wakeup(TIME_MS *wakeup_ms)
+{
+    if (NULL == wakeup_ms) {
+        return OPRT_INVALID_PARM;
+    }
+
+    uint64_t nowMS = 0;
+    uint64_t wakeup = 0;
+    TIME_S secTime = 0;
+    TIME_MS msTime = 0;
+    tal_time_get_system_time(&secTime, &msTime);
+    nowMS = (uint64_t)secTime * 1000 + (uint64_t)msTime;
+
+    *wakeup_ms = SEM_WAIT_FOREVER;
+
+    tal_mutex_lock(s_timer_mgr.mutex);
+    if (__timer_next_wakeup(&wakeup)) {
+        *wakeup_ms = (wakeup > nowMS) ? (TIME_MS)(wakeup - nowMS) : 0;
+    }
+#if defined(ENABLE_SW_TIMER_WHEEL) && (ENABLE_SW_TIMER_WHEEL == 1)
+    // fired timers wait in list_active for the thread
+    if (!tuya_list_empty(&(s_timer_mgr.list_active))) {
+        *wakeup_ms = 0;
+    }
+#endif
+    tal_mutex_unlock(s_timer_mgr.mutex);
+
+    return OPRT_OK;
+}
+
 /**
  * @brief Trigger the software timer
  *
@@ -442,7 +1026,7 @@ OPERATE_RET tal_sw_timer_trigger(TIMER_ID timer_id)
     tal_mutex_lock(s_timer_mgr.mutex);
     timer->expire_time = 0;
     if (timer->is_running) {
-        tuya_list_del(&(timer->node));
+        __timer_detach(timer);
         tuya_list_add(&(timer->node), &(s_timer_mgr.list_active));
     }
     tal_mutex_unlock(s_timer_mgr.mutex);
@@ -451,6 +1035,86 @@ OPERATE_RET tal_sw_timer_trigger(TIMER_ID timer_id)
     return OPRT_OK;
 }
 
+/**
+ * @brief Run the callback of the software timer on a workqueue
+ *
+ * @param[in] timer_id: timer id
+ * @param[in] workq: the workqueue, NULL to run the callback on the timer
+ * thread
+ *
+ * @note This API is used for timers whose callback may block, so they do not
+ * delay the other timers.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_set_workqueue(TIMER_ID timer_id, WORKQUEUE_HANDLE workq)
+{
+    if (NULL == timer_id) {
+        return OPRT_INVALID_PARM;
+    }
+
+    TIMER_T *timer = (TIMER_T *)timer_id;
+
+    tal_mutex_lock(s_timer_mgr.mutex);
+    timer->workq = workq;
+    tal_mutex_unlock(s_timer_mgr.mutex);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Set the budget of the timer callbacks
+ *
+ * @param[in] budget_ms: longest run of a callback, 0 to disable the check
+ * @param[in] slow_cb: called after a callback ran longer, NULL to log a
+ * warning instead
+ *
+ * @note This API is used for finding the callbacks that delay other timers.
+ * The budget and the hook are global, they apply to every timer, inline or
+ * offloaded, and a later call replaces them.
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_set_slow_cb(TIME_MS budget_ms, TAL_TIMER_SLOW_CB slow_cb)
+{
+    tal_mutex_lock(s_timer_mgr.mutex);
+    s_timer_mgr.cb_budget = budget_ms;
+    s_timer_mgr.slow_cb = slow_cb;
+    tal_mutex_unlock(s_timer_mgr.mutex);
+
+    return OPRT_OK;
+}
+
+/**
+ * @brief Get the callback statistics of the software timer
+ *
+ * @param[in] timer_id: timer id
+ * @param[out] stats: callback duration and lateness histograms
+ *
+ * @return OPRT_OK on success, OPRT_NOT_SUPPORTED without
+ * ENABLE_SW_TIMER_STATS. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tal_sw_timer_get_stats(TIMER_ID timer_id, TAL_SW_TIMER_STATS_T *stats)
+{
+    if (NULL == timer_id || NULL == stats) {
+        return OPRT_INVALID_PARM;
+    }
+
+#if defined(ENABLE_SW_TIMER_STATS) && (ENABLE_SW_TIMER_STATS == 1)
+    TIMER_T *timer = (TIMER_T *)timer_id;
+
+    tal_mutex_lock(s_timer_mgr.mutex);
+    *stats = timer->stats;
+    tal_mutex_unlock(s_timer_mgr.mutex);
+
+    return OPRT_OK;
+#else
+    return OPRT_NOT_SUPPORTED;
+#endif
+}
+
 /**
  * @brief Release all resource of the software timer
  *
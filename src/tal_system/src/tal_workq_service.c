@@ -49,8 +49,13 @@
 #define STACK_SIZE_MSG_QUEUE (4 * 1024)
 #endif
 
+#ifndef WORK_QUEUE_POOL_WORKERS
+#define WORK_QUEUE_POOL_WORKERS 0
+#endif
+
 static WORKQUEUE_HANDLE wq_system;
 static WORKQUEUE_HANDLE wq_highpri;
+static WORKQUEUE_HANDLE wq_pool;
 
 /**
  * @brief init ty work queue
@@ -83,6 +88,18 @@ OPERATE_RET tal_workq_init(void)
     thread_cfg.thrdname = "wq_highpri";
     TUYA_CALL_ERR_GOTO(tal_workqueue_create(MAX_NODE_NUM_MSG_QUEUE, &thread_cfg, &wq_highpri), ERR_EXIT);
 
+#if WORK_QUEUE_POOL_WORKERS > 0
+    thread_cfg.priority = THREAD_PRIO_2;
+    thread_cfg.stackDepth = STACK_SIZE_WORK_QUEUE;
+#if defined(TUYA_SECURITY_LEVEL) && (TUYA_SECURITY_LEVEL >= TUYA_SL_1)
+    thread_cfg.stackDepth += 1024;
+#endif
+    thread_cfg.thrdname = "wq_pool";
+    TUYA_CALL_ERR_GOTO(
+        tal_workqueue_create_pool(MAX_NODE_NUM_WORK_QUEUE, WORK_QUEUE_POOL_WORKERS, &thread_cfg, &wq_pool),
+        ERR_EXIT);
+#endif
+
     return OPRT_OK;
 
 ERR_EXIT:
@@ -96,6 +113,11 @@ ERR_EXIT:
         wq_highpri = NULL;
     }
 
+    if (wq_pool) {
+        tal_workqueue_release(wq_pool);
+        wq_pool = NULL;
+    }
+
     return rt;
 }
 
@@ -114,6 +136,8 @@ WORKQUEUE_HANDLE tal_workq_get_handle(WORKQ_SERVICE_E service)
         handle = wq_system;
     } else if (WORKQ_HIGHTPRI == service) {
         handle = wq_highpri;
+    } else if (WORKQ_POOL == service) {
+        handle = wq_pool ? wq_pool : wq_system;
     }
 
     return handle;
@@ -151,6 +175,40 @@ OPERATE_RET tal_workq_schedule_instant(WORKQ_SERVICE_E service, WORKQUEUE_CB cb,
     return tal_workqueue_schedule_instant(tal_workq_get_handle(service), cb, data);
 }
 
+/**
+ * @brief put work task in workqueue, the works of a key run one after another
+ * in the order they were put
+ *
+ * @param[in] service the workqueue service
+ * @param[in] key the serialization key
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workq_schedule_ordered(WORKQ_SERVICE_E service, uint32_t key, WORKQUEUE_CB cb, void *data)
+{
+    return tal_workqueue_schedule_ordered(tal_workq_get_handle(service), key, cb, data);
+}
+
+/**
+ * @brief put work task in workqueue with a priority and a deadline
+ *
+ * @param[in] service the workqueue service
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ * @param[in] option priority and deadline of the work
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workq_schedule_with_option(WORKQ_SERVICE_E service, WORKQUEUE_CB cb, void *data,
+                                           const WORK_OPTION_T *option)
+{
+    return tal_workqueue_schedule_with_option(tal_workq_get_handle(service), cb, data, option);
+}
+
 /**
  * @brief cancel work task in workqueue
  *
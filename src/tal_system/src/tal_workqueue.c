@@ -17,6 +17,22 @@
  * - Synchronization mechanisms to ensure thread-safe operation and task
  * execution.
  *
+ * A workqueue is served by one or more worker threads. Every worker has its own
+ * queue. A worker out of work steals the oldest unordered item queued on the
+ * others, so one blocking item does not stall the rest. Ordered items are
+ * queued to the worker selected by their key and are never stolen. The queues
+ * of all workers share one mutex, a stolen item leaves the queue it was taken
+ * from and a worker always tries to steal before it blocks.
+ *
+ * The items live in slots allocated when the workqueue is created or its
+ * capacity grows, scheduling takes a free slot and a worker gives it back
+ * before running the item, so scheduling does not allocate.
+ *
+ * Each worker keeps a queue per priority and runs the highest priority first.
+ * Within a priority, works with a deadline are ordered earliest deadline first
+ * and go before the works without one, which keep their fifo order. Works
+ * started after their deadline are counted and can be dropped.
+ *
  * The implementation leverages Tuya's infrastructure components, such as
  * queues, threads, and semaphores, to provide a robust and efficient work queue
  * system. It is designed to handle tasks of varying priorities, ensuring that
@@ -31,45 +47,207 @@
  *
  */
 
-#include "tuya_queue.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "tuya_list.h"
 #include "tal_log.h"
 #include "tal_memory.h"
+#include "tal_mutex.h"
 #include "tal_thread.h"
 #include "tal_system.h"
 #include "tal_semaphore.h"
 #include "tal_workqueue.h"
 #include "tal_sw_timer.h"
 
+// the semaphore of a worker counts wakeups, not items: items can be stolen and idle workers are woken to steal
+#define WORKQUEUE_SEM_MAX 0xFFFF
+
+typedef struct {
+    LIST_HEAD node;
+    WORK_ITEM_T item;
+    BOOL_T ordered; // runs on the worker it was queued to, never stolen
+    BOOL_T instant; // stays in front of its priority
+    BOOL_T drop_late;
+    TIME_MS deadline; // ms after queue_time the work has to start by, 0 for none
+    SYS_TIME_T queue_time;
+} WORK_ENTRY_T;
+
+// one allocation of item slots
+typedef struct work_slab {
+    struct work_slab *next;
+    WORK_ENTRY_T entry[];
+} WORK_SLAB_T;
+
+typedef struct tal_workqueue TAL_WORKQUEUE_T;
+
 typedef struct {
-    TUYA_QUEUE_HANDLE queue;
+    LIST_HEAD queue[WORK_PRIO_MAX]; // one queue per priority, earliest deadline first
+    uint32_t queued;                // items in the queues
     THREAD_HANDLE thread;
     SEM_HANDLE sem;
     WORKQUEUE_CB last_cb; // used to debug which cb is blocked
-} TAL_WORKQUEUE_T;
+    BOOL_T busy;          // holds an item, protected by the workqueue mutex
+    uint8_t id;
+    uint32_t deadline_miss; // protected by the workqueue mutex
+    uint32_t deadline_drop;
+    TAL_WORKQUEUE_T *workqueue;
+} TAL_WORKER_T;
+
+struct tal_workqueue {
+    MUTEX_HANDLE mutex; // protects the queues of every worker and the free slots
+    uint16_t capacity;  // items the workqueue can contain, shared by the workers
+    uint16_t slot_num;  // slots allocated, at least the capacity
+    uint32_t queued;    // items in the queues of every worker
+    LIST_HEAD free;     // slots not holding an item
+    WORK_SLAB_T *slab;
+    uint8_t worker_num;
+    TAL_WORKER_T worker[];
+};
+
+// allocate num more slots, called with the mutex held or before the workers run
+static OPERATE_RET __work_slab_add(TAL_WORKQUEUE_T *workqueue, uint16_t num)
+{
+    WORK_SLAB_T *slab = NULL;
+    uint16_t i = 0;
 
-static void __work_thread_cb(void *data)
+    slab = (WORK_SLAB_T *)tal_malloc(sizeof(WORK_SLAB_T) + num * sizeof(WORK_ENTRY_T));
+    if (NULL == slab) {
+        return OPRT_MALLOC_FAILED;
+    }
+    for (i = 0; i < num; i++) {
+        tuya_list_add_tail(&slab->entry[i].node, &workqueue->free);
+    }
+    slab->next = workqueue->slab;
+    workqueue->slab = slab;
+    workqueue->slot_num += num;
+
+    return OPRT_OK;
+}
+
+static void __work_slab_free(TAL_WORKQUEUE_T *workqueue)
 {
-    OPERATE_RET op_ret = OPRT_OK;
-    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)data;
-    WORK_ITEM_T work_item = {0};
+    WORK_SLAB_T *slab = NULL;
 
-    while (THREAD_STATE_RUNNING == tal_thread_get_state(workqueue->thread)) {
-        op_ret = tal_semaphore_wait(workqueue->sem, SEM_WAIT_FOREVER);
-        if (OPRT_OK != op_ret) {
-            tal_system_sleep(10);
-            continue;
+    while (NULL != (slab = workqueue->slab)) {
+        workqueue->slab = slab->next;
+        tal_free(slab);
+    }
+}
+
+// remove a queued item and give its slot back, called with the mutex held
+static void __work_unlink(TAL_WORKER_T *worker, WORK_ENTRY_T *entry)
+{
+    tuya_list_del(&entry->node);
+    worker->queued--;
+    worker->workqueue->queued--;
+    tuya_list_add(&entry->node, &worker->workqueue->free);
+}
+
+// copy out the oldest item of the highest priority, called with the mutex held
+static BOOL_T __work_take(TAL_WORKER_T *worker, WORK_ENTRY_T *out)
+{
+    WORK_ENTRY_T *entry = NULL;
+    uint8_t prio = 0;
+
+    for (prio = 0; prio < WORK_PRIO_MAX; prio++) {
+        if (!tuya_list_empty(&worker->queue[prio])) {
+            entry = tuya_list_entry(worker->queue[prio].next, WORK_ENTRY_T, node);
+            *out = *entry;
+            __work_unlink(worker, entry);
+            return TRUE;
         }
+    }
 
-        op_ret = tuya_queue_output(workqueue->queue, &work_item);
+    return FALSE;
+}
+
+/**
+ * @brief copy out the oldest unordered item of the highest priority queued on
+ * another worker, called with the mutex held
+ *
+ * @param[in] worker the idle worker
+ * @param[out] out the stolen item
+ *
+ * @return TRUE if an item was stolen
+ */
+static BOOL_T __work_steal(TAL_WORKER_T *worker, WORK_ENTRY_T *out)
+{
+    TAL_WORKQUEUE_T *workqueue = worker->workqueue;
+    TAL_WORKER_T *victim = NULL;
+    WORK_ENTRY_T *entry = NULL;
+    LIST_HEAD *pos = NULL;
+    uint8_t prio = 0, i = 0;
+
+    for (prio = 0; prio < WORK_PRIO_MAX; prio++) {
+        for (i = 1; i < workqueue->worker_num; i++) {
+            victim = &workqueue->worker[(worker->id + i) % workqueue->worker_num];
+            tuya_list_for_each(pos, &victim->queue[prio])
+            {
+                entry = tuya_list_entry(pos, WORK_ENTRY_T, node);
+                if (!entry->ordered) {
+                    *out = *entry;
+                    __work_unlink(victim, entry);
+                    return TRUE;
+                }
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+// count a work starting after its deadline, TRUE if it is to be dropped. Called with the mutex held
+static BOOL_T __work_check_late(TAL_WORKER_T *worker, WORK_ENTRY_T *entry)
+{
+    if (entry->deadline && (tal_system_get_millisecond() - entry->queue_time > entry->deadline)) {
+        worker->deadline_miss++;
+        if (entry->drop_late) {
+            worker->deadline_drop++;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void __work_run(TAL_WORKER_T *worker, WORK_ENTRY_T *entry)
+{
+    worker->last_cb = entry->item.cb;
+    entry->item.cb(entry->item.data);
+    worker->last_cb = NULL;
+}
+
+static void __work_thread_cb(void *data)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+    TAL_WORKER_T *worker = (TAL_WORKER_T *)data;
+    TAL_WORKQUEUE_T *workqueue = worker->workqueue;
+    WORK_ENTRY_T entry;
+    BOOL_T found = FALSE, is_drop = FALSE;
+
+    while (THREAD_STATE_RUNNING == tal_thread_get_state(worker->thread)) {
+        op_ret = tal_semaphore_wait(worker->sem, SEM_WAIT_FOREVER);
         if (OPRT_OK != op_ret) {
             tal_system_sleep(10);
             continue;
         }
 
-        if (work_item.cb) {
-            workqueue->last_cb = work_item.cb;
-            work_item.cb(work_item.data);
-            workqueue->last_cb = NULL;
+        // own work first, then help the busy workers with their unordered items before blocking again
+        while (THREAD_STATE_RUNNING == tal_thread_get_state(worker->thread)) {
+            tal_mutex_lock(workqueue->mutex);
+            found = __work_take(worker, &entry) || __work_steal(worker, &entry);
+            worker->busy = found;
+            is_drop = found && __work_check_late(worker, &entry);
+            tal_mutex_unlock(workqueue->mutex);
+            if (!found) {
+                break;
+            }
+            if (is_drop) {
+                continue;
+            }
+
+            __work_run(worker, &entry);
         }
     }
 }
@@ -97,6 +275,165 @@ static BOOL_T __work_cancel_traverse(void *item, void *ctx)
     return TRUE;
 }
 
+// an idle worker with nothing queued, else the worker with the fewest items. Called with the mutex held
+static TAL_WORKER_T *__work_pick_worker(TAL_WORKQUEUE_T *workqueue)
+{
+    TAL_WORKER_T *worker = NULL;
+    TAL_WORKER_T *best = &workqueue->worker[0];
+    uint8_t i = 0;
+
+    for (i = 0; i < workqueue->worker_num; i++) {
+        worker = &workqueue->worker[i];
+        if (!worker->busy && (0 == worker->queued)) {
+            return worker;
+        }
+        if (worker->queued < best->queued) {
+            best = worker;
+        }
+    }
+
+    return best;
+}
+
+// an idle worker other than the one the item went to, it steals the item if it gets there first
+static TAL_WORKER_T *__work_pick_thief(TAL_WORKQUEUE_T *workqueue, TAL_WORKER_T *owner)
+{
+    TAL_WORKER_T *worker = NULL;
+    uint8_t i = 0;
+
+    for (i = 0; i < workqueue->worker_num; i++) {
+        worker = &workqueue->worker[i];
+        if ((worker != owner) && !worker->busy && (0 == worker->queued)) {
+            return worker;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief insert an item in its priority queue, instant ones in front, then
+ * earliest deadline first, then the ones without deadline in fifo order.
+ * Called with the mutex held
+ *
+ * @param[in] queue the priority queue
+ * @param[in] entry the item, queue_time set
+ */
+static void __work_insert(LIST_HEAD *queue, WORK_ENTRY_T *entry)
+{
+    WORK_ENTRY_T *prev = NULL;
+    LIST_HEAD *pos = NULL;
+    int64_t prev_left = 0;
+
+    if (entry->instant) {
+        tuya_list_add(&entry->node, queue);
+        return;
+    }
+    if (0 == entry->deadline) {
+        tuya_list_add_tail(&entry->node, queue);
+        return;
+    }
+
+    // walk back to the last item due no later, the queue is mostly short
+    for (pos = queue->prev; pos != queue; pos = pos->prev) {
+        prev = tuya_list_entry(pos, WORK_ENTRY_T, node);
+        if (prev->instant) {
+            break;
+        }
+        if (prev->deadline) {
+            // what is left of its deadline at the queue time of the new item, negative when late
+            prev_left = (int64_t)prev->deadline - (int64_t)(SYS_TIME_T)(entry->queue_time - prev->queue_time);
+            if (prev_left <= (int64_t)entry->deadline) {
+                break;
+            }
+        }
+    }
+    tuya_list_add(&entry->node, pos);
+}
+
+/**
+ * @brief queue an item
+ *
+ * @param[in] workqueue the workqueue
+ * @param[in] worker the worker of an ordered item, NULL to pick one
+ * @param[in] src the item
+ * @param[in] prio the priority
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+static OPERATE_RET __work_enqueue(TAL_WORKQUEUE_T *workqueue, TAL_WORKER_T *worker, WORK_ENTRY_T *src,
+                                  WORK_PRIO_E prio)
+{
+    WORK_ENTRY_T *entry = NULL;
+    TAL_WORKER_T *thief = NULL;
+    SYS_TIME_T queue_time = tal_system_get_millisecond();
+
+    tal_mutex_lock(workqueue->mutex);
+    if ((workqueue->queued >= workqueue->capacity) || tuya_list_empty(&workqueue->free)) {
+        tal_mutex_unlock(workqueue->mutex);
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+    if (NULL == worker) {
+        worker = __work_pick_worker(workqueue);
+    }
+    entry = tuya_list_entry(workqueue->free.next, WORK_ENTRY_T, node);
+    tuya_list_del(&entry->node);
+    *entry = *src;
+    entry->queue_time = queue_time;
+    __work_insert(&worker->queue[prio], entry);
+    worker->queued++;
+    workqueue->queued++;
+    if (worker->busy && !entry->ordered) {
+        thief = __work_pick_thief(workqueue, worker);
+    }
+    tal_mutex_unlock(workqueue->mutex);
+
+    tal_semaphore_post(worker->sem);
+    if (thief) {
+        tal_semaphore_post(thief->sem);
+    }
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __work_worker_deinit(TAL_WORKER_T *worker)
+{
+    OPERATE_RET op_ret = OPRT_OK;
+    WORK_ENTRY_T entry;
+    uint32_t count = 1;
+
+    if (worker->thread) {
+        op_ret = tal_thread_delete(worker->thread);
+        if (OPRT_OK != op_ret) {
+            return op_ret;
+        }
+
+        tal_semaphore_post(worker->sem);
+
+        while (THREAD_STATE_DELETE != tal_thread_get_state(worker->thread)) {
+            tal_system_sleep(10);
+            if ((count++) % 500 == 0) {
+                PR_NOTICE("%p still running", worker->thread);
+            }
+        }
+    }
+
+    if (worker->sem) {
+        tal_semaphore_release(worker->sem);
+    }
+
+    // the other workers can still steal until they are stopped, the slots are freed with the workqueue
+    tal_mutex_lock(worker->workqueue->mutex);
+    while (__work_take(worker, &entry)) {
+        continue;
+    }
+    tal_mutex_unlock(worker->workqueue->mutex);
+
+    return OPRT_OK;
+}
+
+
 /**
  * @brief create and initialize a workqueue which runs in thread context
  *
@@ -109,41 +446,102 @@ static BOOL_T __work_cancel_traverse(void *item, void *ctx)
  * tuya_error_code.h
  */
 OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_cfg, WORKQUEUE_HANDLE *handle)
+{
+    return tal_workqueue_create_pool(queue_len, 1, thread_cfg, handle);
+}
+
+/**
+ * @brief create and initialize a workqueue served by several threads
+ *
+ * @param[in] queue_len the maximum number of items the workqueue can contain,
+ * shared by the workers
+ * @param[in] worker_num number of worker threads
+ * @param[in] thread_cfg thread param of every worker, the worker index is
+ * appended to the name
+ * @param[out] handle the workqueue handle
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_create_pool(const uint16_t queue_len, const uint8_t worker_num, THREAD_CFG_T *thread_cfg,
+                                      WORKQUEUE_HANDLE *handle)
 {
     OPERATE_RET op_ret = OPRT_OK;
     TAL_WORKQUEUE_T *workqueue = NULL;
+    TAL_WORKER_T *worker = NULL;
+    THREAD_CFG_T worker_cfg;
+    char name[16];
+    uint8_t i = 0, prio = 0;
 
-    if ((0 == queue_len) || (NULL == thread_cfg) || (NULL == handle)) {
+    if ((0 == queue_len) || (0 == worker_num) || (NULL == thread_cfg) || (NULL == handle)) {
         return OPRT_INVALID_PARM;
     }
 
-    workqueue = (TAL_WORKQUEUE_T *)tal_calloc(1, sizeof(TAL_WORKQUEUE_T));
+    workqueue = (TAL_WORKQUEUE_T *)tal_calloc(1, sizeof(TAL_WORKQUEUE_T) + worker_num * sizeof(TAL_WORKER_T));
     if (NULL == workqueue) {
         return OPRT_MALLOC_FAILED;
     }
+    workqueue->worker_num = worker_num;
+    workqueue->capacity = queue_len;
+    INIT_LIST_HEAD(&workqueue->free);
+
+    for (i = 0; i < worker_num; i++) {
+        worker = &workqueue->worker[i];
+        worker->id = i;
+        worker->workqueue = workqueue;
+        for (prio = 0; prio < WORK_PRIO_MAX; prio++) {
+            INIT_LIST_HEAD(&worker->queue[prio]);
+        }
+    }
 
-    op_ret = tuya_queue_create(queue_len, sizeof(WORK_ITEM_T), &workqueue->queue);
+    op_ret = __work_slab_add(workqueue, queue_len);
     if (OPRT_OK != op_ret) {
         tal_free(workqueue);
         return op_ret;
     }
 
-    op_ret = tal_semaphore_create_init(&workqueue->sem, 0, queue_len);
+    op_ret = tal_mutex_create_init(&workqueue->mutex);
     if (OPRT_OK != op_ret) {
-        tuya_queue_release(workqueue->queue);
+        __work_slab_free(workqueue);
         tal_free(workqueue);
         return op_ret;
     }
 
-    op_ret = tal_thread_create_and_start(&workqueue->thread, NULL, NULL, __work_thread_cb, workqueue, thread_cfg);
-    if (OPRT_OK != op_ret) {
-        tal_semaphore_release(workqueue->sem);
-        tuya_queue_release(workqueue->queue);
-        tal_free(workqueue);
-    } else {
-        *handle = workqueue;
+    for (i = 0; i < worker_num; i++) {
+        worker = &workqueue->worker[i];
+        op_ret = tal_semaphore_create_init(&worker->sem, 0, WORKQUEUE_SEM_MAX);
+        if (OPRT_OK != op_ret) {
+            goto __EXIT;
+        }
+    }
+
+    // the queues are complete before any worker can steal from them
+    for (i = 0; i < worker_num; i++) {
+        worker = &workqueue->worker[i];
+        worker_cfg = *thread_cfg;
+        if (worker_num > 1) {
+            snprintf(name, sizeof(name), "%s%d", thread_cfg->thrdname, i);
+            worker_cfg.thrdname = name;
+        }
+
+        op_ret = tal_thread_create_and_start(&worker->thread, NULL, NULL, __work_thread_cb, worker, &worker_cfg);
+        if (OPRT_OK != op_ret) {
+            goto __EXIT;
+        }
     }
 
+    *handle = workqueue;
+
+    return OPRT_OK;
+
+__EXIT:
+    for (i = 0; i < worker_num; i++) {
+        __work_worker_deinit(&workqueue->worker[i]);
+    }
+    tal_mutex_release(workqueue->mutex);
+    __work_slab_free(workqueue);
+    tal_free(workqueue);
+
     return op_ret;
 }
 
@@ -159,21 +557,14 @@ OPERATE_RET tal_workqueue_create(const uint16_t queue_len, THREAD_CFG_T *thread_
  */
 OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data)
 {
-    OPERATE_RET op_ret = OPRT_OK;
-
     if ((NULL == handle) || (NULL == cb)) {
         return OPRT_INVALID_PARM;
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    WORK_ITEM_T work_item = {.cb = cb, .data = data};
-
-    op_ret = tuya_queue_input(workqueue->queue, &work_item);
-    if (OPRT_OK == op_ret) {
-        op_ret = tal_semaphore_post(workqueue->sem);
-    }
+    WORK_ENTRY_T entry = {.item = {.cb = cb, .data = data}};
 
-    return op_ret;
+    return __work_enqueue(workqueue, NULL, &entry, WORK_PRIO_NORMAL);
 }
 
 /**
@@ -188,21 +579,63 @@ OPERATE_RET tal_workqueue_schedule(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, voi
  */
 OPERATE_RET tal_workqueue_schedule_instant(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data)
 {
-    OPERATE_RET op_ret = OPRT_OK;
-
     if ((NULL == handle) || (NULL == cb)) {
         return OPRT_INVALID_PARM;
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    WORK_ITEM_T work_item = {.cb = cb, .data = data};
+    WORK_ENTRY_T entry = {.item = {.cb = cb, .data = data}, .instant = TRUE};
 
-    op_ret = tuya_queue_input_instant(workqueue->queue, &work_item);
-    if (OPRT_OK == op_ret) {
-        op_ret = tal_semaphore_post(workqueue->sem);
+    return __work_enqueue(workqueue, NULL, &entry, WORK_PRIO_HIGH);
+}
+
+/**
+ * @brief put work task in workqueue with a priority and a deadline
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ * @param[in] option priority and deadline of the work
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_schedule_with_option(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void *data,
+                                               const WORK_OPTION_T *option)
+{
+    if ((NULL == handle) || (NULL == cb) || (NULL == option) || (option->prio >= WORK_PRIO_MAX)) {
+        return OPRT_INVALID_PARM;
     }
 
-    return op_ret;
+    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    WORK_ENTRY_T entry = {
+        .item = {.cb = cb, .data = data}, .drop_late = option->drop_late, .deadline = option->deadline};
+
+    return __work_enqueue(workqueue, NULL, &entry, option->prio);
+}
+
+/**
+ * @brief put work task in workqueue, the works of a key run one after another
+ * in the order they were put
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] key the serialization key
+ * @param[in] cb the work callback
+ * @param[in] data the work data
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_schedule_ordered(WORKQUEUE_HANDLE handle, uint32_t key, WORKQUEUE_CB cb, void *data)
+{
+    if ((NULL == handle) || (NULL == cb)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    WORK_ENTRY_T entry = {.item = {.cb = cb, .data = data}, .ordered = TRUE};
+
+    return __work_enqueue(workqueue, &workqueue->worker[key % workqueue->worker_num], &entry, WORK_PRIO_NORMAL);
 }
 
 /**
@@ -221,10 +654,9 @@ OPERATE_RET tal_workqueue_cancel(WORKQUEUE_HANDLE handle, WORKQUEUE_CB cb, void
         return OPRT_INVALID_PARM;
     }
 
-    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
     WORK_ITEM_T work_item = {.cb = cb, .data = data};
 
-    return tuya_queue_traverse(workqueue->queue, __work_cancel_traverse, &work_item);
+    return tal_workqueue_traverse(handle, (WORKQUEUE_TRAVERSE_CB)__work_cancel_traverse, &work_item);
 }
 
 /**
@@ -244,7 +676,33 @@ OPERATE_RET tal_workqueue_traverse(WORKQUEUE_HANDLE handle, WORKQUEUE_TRAVERSE_C
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    return tuya_queue_traverse(workqueue->queue, (TRAVERSE_CB)cb, ctx);
+    TAL_WORKER_T *worker = NULL;
+    WORK_ENTRY_T *entry = NULL;
+    LIST_HEAD *pos = NULL, *n = NULL;
+    uint8_t i = 0, prio = 0;
+
+    tal_mutex_lock(workqueue->mutex);
+    for (prio = 0; prio < WORK_PRIO_MAX; prio++) {
+        for (i = 0; i < workqueue->worker_num; i++) {
+            worker = &workqueue->worker[i];
+            tuya_list_for_each_safe(pos, n, &worker->queue[prio])
+            {
+                entry = tuya_list_entry(pos, WORK_ENTRY_T, node);
+                if (!cb(&entry->item, ctx)) {
+                    goto __EXIT;
+                }
+                // the callback canceled the item, it leaves the queue and stops counting toward the capacity
+                if (NULL == entry->item.cb) {
+                    __work_unlink(worker, entry);
+                }
+            }
+        }
+    }
+
+__EXIT:
+    tal_mutex_unlock(workqueue->mutex);
+
+    return OPRT_OK;
 }
 
 /**
@@ -261,12 +719,83 @@ uint16_t tal_workqueue_get_num(WORKQUEUE_HANDLE handle)
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    TAL_WORKER_T *worker = NULL;
+    uint32_t num = 0;
+    uint8_t i = 0;
+
+    for (i = 0; i < workqueue->worker_num; i++) {
+        worker = &workqueue->worker[i];
+        if (worker->last_cb) {
+            PR_NOTICE("%p:last_cb %p", worker->thread, worker->last_cb);
+        }
+    }
+
+    tal_mutex_lock(workqueue->mutex);
+    num = workqueue->queued;
+    tal_mutex_unlock(workqueue->mutex);
+
+    return num;
+}
+
+/**
+ * @brief set how many items the workqueue can contain
+ *
+ * @param[in] handle the workqueue handle
+ * @param[in] queue_len the maximum number of items, items already queued
+ * above it are kept
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_set_capacity(WORKQUEUE_HANDLE handle, uint16_t queue_len)
+{
+    if ((NULL == handle) || (0 == queue_len)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    OPERATE_RET op_ret = OPRT_OK;
+    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+
+    // the slots are kept when the capacity shrinks, it can grow back without allocating
+    tal_mutex_lock(workqueue->mutex);
+    if (queue_len > workqueue->slot_num) {
+        op_ret = __work_slab_add(workqueue, queue_len - workqueue->slot_num);
+    }
+    if (OPRT_OK == op_ret) {
+        workqueue->capacity = queue_len;
+    }
+    tal_mutex_unlock(workqueue->mutex);
+
+    return op_ret;
+}
+
+/**
+ * @brief get the deadline statistics of the workqueue
+ *
+ * @param[in] handle the workqueue handle
+ * @param[out] stats the statistics
+ *
+ * @return OPRT_OK on success. Others on error, please refer to
+ * tuya_error_code.h
+ */
+OPERATE_RET tal_workqueue_get_stats(WORKQUEUE_HANDLE handle, WORKQUEUE_STATS_T *stats)
+{
+    if ((NULL == handle) || (NULL == stats)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    uint8_t i = 0;
 
-    if (workqueue->last_cb) {
-        PR_NOTICE("%p:last_cb %p", workqueue->thread, workqueue->last_cb);
+    memset(stats, 0, sizeof(WORKQUEUE_STATS_T));
+    tal_mutex_lock(workqueue->mutex);
+    for (i = 0; i < workqueue->worker_num; i++) {
+        stats->deadline_miss += workqueue->worker[i].deadline_miss;
+        stats->deadline_drop += workqueue->worker[i].deadline_drop;
     }
+    tal_mutex_unlock(workqueue->mutex);
 
-    return tuya_queue_get_used_num(workqueue->queue);
+    return OPRT_OK;
 }
 
 /**
@@ -284,25 +813,17 @@ OPERATE_RET tal_workqueue_release(WORKQUEUE_HANDLE handle)
     }
 
     OPERATE_RET op_ret = OPRT_OK;
-    uint32_t count = 1;
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
+    uint8_t i = 0;
 
-    op_ret = tal_thread_delete(workqueue->thread);
-    if (OPRT_OK != op_ret) {
-        return op_ret;
-    }
-
-    tal_semaphore_post(workqueue->sem);
-
-    while (THREAD_STATE_DELETE != tal_thread_get_state(workqueue->thread)) {
-        tal_system_sleep(10);
-        if ((count++) % 500 == 0) {
-            PR_NOTICE("%p still running", workqueue->thread);
+    for (i = 0; i < workqueue->worker_num; i++) {
+        op_ret = __work_worker_deinit(&workqueue->worker[i]);
+        if (OPRT_OK != op_ret) {
+            return op_ret;
         }
     }
-
-    tuya_queue_release(workqueue->queue);
-    tal_semaphore_release(workqueue->sem);
+    tal_mutex_release(workqueue->mutex);
+    __work_slab_free(workqueue);
     tal_free(workqueue);
 
     return OPRT_OK;
@@ -313,7 +834,7 @@ OPERATE_RET tal_workqueue_release(WORKQUEUE_HANDLE handle)
  *
  * @param[in] handle the workqueue handle
  *
- * @return thread handle
+ * @return thread handle, the first worker of a workqueue with several threads
  */
 THREAD_HANDLE tal_workqueue_get_thread(WORKQUEUE_HANDLE handle)
 {
@@ -322,7 +843,7 @@ THREAD_HANDLE tal_workqueue_get_thread(WORKQUEUE_HANDLE handle)
     }
 
     TAL_WORKQUEUE_T *workqueue = (TAL_WORKQUEUE_T *)handle;
-    return workqueue->thread;
+    return workqueue->worker[0].thread;
 }
 
 typedef struct {
@@ -0,0 +1,278 @@
+/**
+ * @file ut_tal_stub.c
+ * @brief Host implementation of the tal system services used by the tal_system
+ * unit tests.
+ *
+ * Memory, mutex, semaphore, thread and time services on top of libc and
+ * pthread, so the units under test run on the build machine without a platform
+ * port. Threads follow the tal_thread state model: tal_thread_delete() asks the
+ * thread to stop and the state turns to THREAD_STATE_DELETE once its function
+ * returned.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tal_log.h"
+#include "tal_memory.h"
+#include "tal_mutex.h"
+#include "tal_semaphore.h"
+#include "tal_system.h"
+#include "tal_thread.h"
+#include "tal_time_service.h"
+#include "tkl_memory.h"
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t cnt;
+    uint32_t max;
+} UT_SEM_T;
+
+typedef struct {
+    pthread_t tid;
+    volatile THREAD_STATE_E state;
+    THREAD_FUNC_CB func;
+    void *args;
+} UT_THREAD_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+// logs above this level are not printed, -1 mutes the errors a test causes on purpose
+int ut_tal_log_level = TAL_LOG_LEVEL_WARN;
+// tal_malloc and tal_calloc calls, for the tests that count the allocations of a call
+uint32_t ut_tal_malloc_cnt = 0;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+void *tkl_system_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void tkl_system_free(void *ptr)
+{
+    free(ptr);
+}
+
+void *tal_malloc(size_t size)
+{
+    __atomic_add_fetch(&ut_tal_malloc_cnt, 1, __ATOMIC_RELAXED);
+    return malloc(size);
+}
+
+void tal_free(void *ptr)
+{
+    free(ptr);
+}
+
+void *tal_calloc(size_t nitems, size_t size)
+{
+    __atomic_add_fetch(&ut_tal_malloc_cnt, 1, __ATOMIC_RELAXED);
+    return calloc(nitems, size);
+}
+
+OPERATE_RET tal_log_print(const TAL_LOG_LEVEL_E level, const char *file, const int line, const char *fmt, ...)
+{
+    va_list ap;
+
+    // keep the test output readable, only errors and warnings are shown by default
+    if ((int)level > ut_tal_log_level) {
+        return OPRT_OK;
+    }
+
+    fprintf(stderr, "[%s:%d] ", file, line);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "\n");
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_mutex_create_init(MUTEX_HANDLE *handle)
+{
+    pthread_mutex_t *mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
+
+    if (NULL == mutex) {
+        return OPRT_MALLOC_FAILED;
+    }
+    pthread_mutex_init(mutex, NULL);
+    *handle = mutex;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_mutex_lock(const MUTEX_HANDLE handle)
+{
+    return pthread_mutex_lock((pthread_mutex_t *)handle) ? OPRT_COM_ERROR : OPRT_OK;
+}
+
+OPERATE_RET tal_mutex_unlock(const MUTEX_HANDLE handle)
+{
+    return pthread_mutex_unlock((pthread_mutex_t *)handle) ? OPRT_COM_ERROR : OPRT_OK;
+}
+
+OPERATE_RET tal_mutex_release(const MUTEX_HANDLE handle)
+{
+    pthread_mutex_destroy((pthread_mutex_t *)handle);
+    free(handle);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_semaphore_create_init(SEM_HANDLE *handle, uint32_t sem_cnt, uint32_t sem_max)
+{
+    UT_SEM_T *sem = (UT_SEM_T *)calloc(1, sizeof(UT_SEM_T));
+
+    if (NULL == sem) {
+        return OPRT_MALLOC_FAILED;
+    }
+    pthread_mutex_init(&sem->mutex, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    sem->cnt = sem_cnt;
+    sem->max = sem_max;
+    *handle = sem;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_semaphore_wait(SEM_HANDLE handle, uint32_t timeout)
+{
+    UT_SEM_T *sem = (UT_SEM_T *)handle;
+    struct timespec ts;
+    int ret = 0;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    if (SEM_WAIT_FOREVER != timeout) {
+        ts.tv_sec += timeout / 1000;
+        ts.tv_nsec += (long)(timeout % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&sem->mutex);
+    while ((0 == sem->cnt) && (ETIMEDOUT != ret)) {
+        if (SEM_WAIT_FOREVER == timeout) {
+            pthread_cond_wait(&sem->cond, &sem->mutex);
+        } else {
+            ret = pthread_cond_timedwait(&sem->cond, &sem->mutex, &ts);
+        }
+    }
+    if (sem->cnt) {
+        sem->cnt--;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&sem->mutex);
+
+    return ret ? OPRT_OS_ADAPTER_SEM_WAIT_FAILED : OPRT_OK;
+}
+
+OPERATE_RET tal_semaphore_post(SEM_HANDLE handle)
+{
+    UT_SEM_T *sem = (UT_SEM_T *)handle;
+
+    pthread_mutex_lock(&sem->mutex);
+    if (sem->cnt < sem->max) {
+        sem->cnt++;
+    }
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->mutex);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_semaphore_release(SEM_HANDLE handle)
+{
+    UT_SEM_T *sem = (UT_SEM_T *)handle;
+
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->mutex);
+    free(sem);
+
+    return OPRT_OK;
+}
+
+static void *__ut_thread_entry(void *arg)
+{
+    UT_THREAD_T *thread = (UT_THREAD_T *)arg;
+
+    thread->func(thread->args);
+    __atomic_store_n(&thread->state, THREAD_STATE_DELETE, __ATOMIC_RELEASE);
+
+    return NULL;
+}
+
+OPERATE_RET tal_thread_create_and_start(THREAD_HANDLE *handle, const THREAD_ENTER_CB enter, const THREAD_EXIT_CB exit,
+                                        const THREAD_FUNC_CB func, const void *func_args, const THREAD_CFG_T *cfg)
+{
+    UT_THREAD_T *thread = (UT_THREAD_T *)calloc(1, sizeof(UT_THREAD_T));
+
+    if (NULL == thread) {
+        return OPRT_MALLOC_FAILED;
+    }
+    thread->state = THREAD_STATE_RUNNING;
+    thread->func = func;
+    thread->args = (void *)func_args;
+    // set before the thread runs, it reads its own handle
+    *handle = thread;
+
+    if (pthread_create(&thread->tid, NULL, __ut_thread_entry, thread)) {
+        *handle = NULL;
+        free(thread);
+        return OPRT_COM_ERROR;
+    }
+    pthread_detach(thread->tid);
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tal_thread_delete(const THREAD_HANDLE handle)
+{
+    UT_THREAD_T *thread = (UT_THREAD_T *)handle;
+
+    // freed lazily like tal_thread, the owner may still poll the state
+    __atomic_store_n(&thread->state, THREAD_STATE_STOP, __ATOMIC_RELEASE);
+
+    return OPRT_OK;
+}
+
+THREAD_STATE_E tal_thread_get_state(const THREAD_HANDLE handle)
+{
+    return __atomic_load_n(&((UT_THREAD_T *)handle)->state, __ATOMIC_ACQUIRE);
+}
+
+SYS_TIME_T tal_system_get_millisecond(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (SYS_TIME_T)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void tal_system_sleep(uint32_t time_ms)
+{
+    usleep(time_ms * 1000);
+}
+
+void tal_time_get_system_time(TIME_S *pSecTime, TIME_MS *pMsTime)
+{
+    SYS_TIME_T now = tal_system_get_millisecond();
+
+    *pSecTime = now / 1000;
+    *pMsTime = now % 1000;
+}
@@ -0,0 +1,631 @@
+/**
+ * @file ut_tal_sw_timer.cpp
+ * @brief Unit tests of the software timer: expiry on every level of the timing
+ * wheel and across its cascades, and slack coalescing, on both backends. A
+ * benchmark compares their start, restart and stop cost and the firing delay.
+ * Callback offload to a workqueue, the slow callback hook and the callback
+ * statistics are tested on the timing wheel build.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "tal_semaphore.h"
+#include "tal_system.h"
+#include "tal_workqueue.h"
+#include "ut_tal_sw_timer.h"
+
+typedef struct {
+    TIMER_ID id;
+    bool is_running;
+    bool is_cycle;
+    TIME_MS interval;
+    TIME_MS slack;
+    uint64_t expire;
+    uint32_t fire_cnt;
+    uint32_t err_cnt; // fired early, late, or while stopped
+} UT_TIMER_T;
+
+// every test runs on the timing wheel and on the sorted list
+class SwTimerTest : public ::testing::TestWithParam<const UT_SW_TIMER_BACKEND_T *> {
+protected:
+    const UT_SW_TIMER_BACKEND_T *be = GetParam();
+    std::vector<UT_TIMER_T> timers;
+    SYS_TIME_T next = SEM_WAIT_FOREVER; // the wakeup the timer thread asked for
+
+    static void timer_cb(TIMER_ID timer_id, void *arg)
+    {
+        UT_TIMER_T *t = (UT_TIMER_T *)arg;
+        uint64_t now = ut_timer_clock();
+
+        if (!t->is_running || now < t->expire || now > t->expire + t->slack) {
+            t->err_cnt++;
+        }
+        t->fire_cnt++;
+        if (t->is_cycle) {
+            t->expire = now + t->interval;
+        } else {
+            t->is_running = false;
+        }
+    }
+
+    void SetUp() override
+    {
+        ASSERT_EQ(OPRT_OK, be->init());
+    }
+
+    void TearDown() override
+    {
+        for (auto &t : timers) {
+            be->del(t.id);
+        }
+        // the timers are freed at the next dispatch
+        be->dispatch();
+        EXPECT_EQ(0, be->get_num());
+    }
+
+    void create(size_t num)
+    {
+        timers.resize(num);
+        for (auto &t : timers) {
+            memset(&t, 0, sizeof(t));
+            ASSERT_EQ(OPRT_OK, be->create(timer_cb, &t, &t.id));
+        }
+    }
+
+    void start(UT_TIMER_T &t, TIME_MS interval, bool is_cycle, TIME_MS slack = 0)
+    {
+        t.is_running = true;
+        t.is_cycle = is_cycle;
+        t.interval = interval;
+        t.slack = slack;
+        t.expire = ut_timer_clock() + interval;
+        ASSERT_EQ(OPRT_OK, be->start(t.id, interval, is_cycle ? TAL_TIMER_CYCLE : TAL_TIMER_ONCE, slack));
+        wake();
+    }
+
+    void stop(UT_TIMER_T &t)
+    {
+        t.is_running = false;
+        be->stop(t.id);
+        wake();
+    }
+
+    // start and stop post the semaphore of the timer thread, it dispatches at once
+    void wake(void)
+    {
+        next = be->dispatch();
+        check_wakeup(next);
+    }
+
+    // the next wakeup must not pass the latest time any running timer may fire
+    void check_wakeup(SYS_TIME_T next)
+    {
+        uint64_t latest = UINT64_MAX;
+        TIME_MS wakeup = 0;
+
+        for (auto &t : timers) {
+            if (t.is_running && t.expire + t.slack < latest) {
+                latest = t.expire + t.slack;
+            }
+        }
+
+        if (UINT64_MAX == latest) {
+            EXPECT_EQ((SYS_TIME_T)SEM_WAIT_FOREVER, next);
+        } else {
+            ASSERT_NE((SYS_TIME_T)SEM_WAIT_FOREVER, next);
+            EXPECT_LE(ut_timer_clock() + next, latest);
+        }
+
+        EXPECT_EQ(OPRT_OK, be->get_next_wakeup(&wakeup));
+        EXPECT_EQ((TIME_MS)next, wakeup);
+    }
+
+    // wake up when the timer thread would until the time has passed
+    void run_until(uint64_t end)
+    {
+        while (SEM_WAIT_FOREVER != next && ut_timer_clock() + next <= end) {
+            ut_timer_clock_advance(next);
+            wake();
+        }
+        ut_timer_clock_advance(end - ut_timer_clock());
+        // the thread sleeps on, the wakeup moved closer
+        if (SEM_WAIT_FOREVER != next) {
+            wake();
+        }
+    }
+};
+
+// one timer per slot length and across every level boundary, including past the last level
+TEST_P(SwTimerTest, OnceFiresOnTimeOnEveryLevel)
+{
+    const TIME_MS intervals[] = {1,       63,      64,      65,       4095,     4096,     4097,    262143,
+                                 262144,  262145,  1000000, 16777215, 16777216, 16777217, 40000000};
+
+    create(CNTSOF(intervals));
+    for (size_t i = 0; i < timers.size(); i++) {
+        start(timers[i], intervals[i], false);
+    }
+
+    run_until(ut_timer_clock() + 40000001);
+
+    for (size_t i = 0; i < timers.size(); i++) {
+        EXPECT_EQ(1u, timers[i].fire_cnt) << "interval " << intervals[i];
+        EXPECT_EQ(0u, timers[i].err_cnt) << "interval " << intervals[i];
+    }
+}
+
+TEST_P(SwTimerTest, CycleKeepsPeriodAcrossCascades)
+{
+    const TIME_MS intervals[] = {7, 100, 5000, 300000};
+    const uint64_t span = 3600000;
+
+    create(CNTSOF(intervals));
+    for (size_t i = 0; i < timers.size(); i++) {
+        start(timers[i], intervals[i], true);
+    }
+
+    run_until(ut_timer_clock() + span);
+
+    for (size_t i = 0; i < timers.size(); i++) {
+        EXPECT_EQ(span / intervals[i], timers[i].fire_cnt) << "interval " << intervals[i];
+        EXPECT_EQ(0u, timers[i].err_cnt) << "interval " << intervals[i];
+    }
+}
+
+// random start, stop and clock jumps against the model kept in UT_TIMER_T
+TEST_P(SwTimerTest, RandomStartStopMatchesModel)
+{
+    uint64_t step = 0;
+    uint32_t fire_cnt = 0;
+
+    srand(1);
+    create(200);
+
+    for (int i = 0; i < 50000; i++) {
+        UT_TIMER_T &t = timers[rand() % timers.size()];
+        int op = rand() % 100;
+
+        if (op < 10) {
+            // mostly short timers, some far beyond the last wheel level
+            TIME_MS interval = (0 == rand() % 4) ? rand() % 40000000 + 1 : rand() % 5000 + 1;
+            start(t, interval, rand() % 2);
+        } else if (op < 13) {
+            stop(t);
+        } else {
+            // an early wakeup by another post, or the one the thread asked for
+            step = (0 == rand() % 8) ? rand() % 2000000 : rand() % 50;
+            if (SEM_WAIT_FOREVER != next && next < step) {
+                step = next;
+            }
+            ut_timer_clock_advance(step);
+            wake();
+        }
+    }
+
+    for (auto &t : timers) {
+        EXPECT_EQ(0u, t.err_cnt);
+        if (t.is_running) {
+            EXPECT_GT(t.expire, ut_timer_clock());
+        }
+        fire_cnt += t.fire_cnt;
+    }
+    EXPECT_GT(fire_cnt, 0u);
+}
+
+// an early timer with slack waits for a later one, both fire in one wakeup
+TEST_P(SwTimerTest, SlackSharesWakeup)
+{
+    uint64_t start_ms = 0;
+    uint32_t wakeup_cnt = 0;
+    TIME_MS wakeup = 0;
+
+    create(2);
+    start(timers[0], 1000, false, 200);
+    start(timers[1], 1100, false);
+
+    EXPECT_EQ(OPRT_OK, be->get_next_wakeup(&wakeup));
+    EXPECT_EQ(1100u, wakeup);
+
+    start_ms = ut_timer_clock();
+    wakeup_cnt = be->wakeup_cnt();
+    run_until(start_ms + 2000);
+
+    EXPECT_EQ(1u, timers[0].fire_cnt);
+    EXPECT_EQ(1u, timers[1].fire_cnt);
+    EXPECT_EQ(0u, timers[0].err_cnt);
+    EXPECT_EQ(1u, be->wakeup_cnt() - wakeup_cnt);
+}
+
+// slack never lets a timer fire before its expiry or after expiry + slack
+TEST_P(SwTimerTest, SlackExpiryStaysInWindow)
+{
+    uint64_t step = 0;
+
+    srand(2);
+    create(300);
+
+    for (int i = 0; i < 50000; i++) {
+        UT_TIMER_T &t = timers[rand() % timers.size()];
+        int op = rand() % 100;
+
+        if (op < 10) {
+            TIME_MS interval = rand() % 20000 + 1;
+            start(t, interval, rand() % 2, rand() % (interval / 2 + 1));
+        } else if (op < 13) {
+            stop(t);
+        }
+
+        // the thread wakes up when it asked to, or earlier for another post
+        step = rand() % 3000;
+        if (SEM_WAIT_FOREVER != next && next < step) {
+            step = next;
+        }
+        ut_timer_clock_advance(step);
+        wake();
+    }
+
+    for (auto &t : timers) {
+        EXPECT_EQ(0u, t.err_cnt);
+    }
+}
+
+// periodic timers with 10% slack need fewer wakeups than without
+TEST_P(SwTimerTest, SlackReducesPeriodicWakeups)
+{
+    // led blink, key scan, audio health, wifi rssi, dp sync, heap monitor, mqtt keepalive, time sync
+    const TIME_MS periods[] = {500, 1000, 2000, 3000, 5000, 10000, 30000, 60000};
+    const uint32_t run_min = 10;
+    uint32_t wakeups[2] = {0};
+
+    create(CNTSOF(periods));
+    for (int with_slack = 0; with_slack < 2; with_slack++) {
+        for (size_t i = 0; i < timers.size(); i++) {
+            // spread the phases like timers started at different times
+            run_until(ut_timer_clock() + 37 * (i + 1));
+            start(timers[i], periods[i], true, with_slack ? periods[i] / 10 : 0);
+        }
+
+        uint32_t wakeup_cnt = be->wakeup_cnt();
+        run_until(ut_timer_clock() + run_min * 60000);
+        wakeups[with_slack] = be->wakeup_cnt() - wakeup_cnt;
+
+        for (auto &t : timers) {
+            EXPECT_EQ(0u, t.err_cnt);
+            stop(t);
+        }
+    }
+
+    printf("[ sw timer ] %s, %zu periodic timers: %u wakeups/min exact, %u with 10%% slack\n", be->name, timers.size(),
+           wakeups[0] / run_min, wakeups[1] / run_min);
+    RecordProperty("wakeups_per_min", (int)(wakeups[0] / run_min));
+    RecordProperty("slack_wakeups_per_min", (int)(wakeups[1] / run_min));
+    EXPECT_LT(wakeups[1], wakeups[0]);
+}
+
+INSTANTIATE_TEST_SUITE_P(Backend, SwTimerTest, ::testing::Values(&ut_sw_timer_wheel, &ut_sw_timer_list),
+                         [](const ::testing::TestParamInfo<const UT_SW_TIMER_BACKEND_T *> &info) {
+                             return std::string(info.param->name);
+                         });
+
+typedef std::chrono::steady_clock UT_CLOCK;
+
+typedef struct {
+    double start_ns;   // per start of a stopped timer
+    double restart_ns; // per start of a running timer
+    double stop_ns;
+    double delay_p50_us; // from the wakeup of the timer thread to the callback
+    double delay_p99_us;
+    uint32_t fire_cnt;
+} UT_BENCH_RESULT_T;
+
+static UT_CLOCK::time_point s_bench_wake;
+static std::vector<double> s_bench_delay;
+
+static void bench_cb(TIMER_ID timer_id, void *arg)
+{
+    s_bench_delay.push_back(std::chrono::duration<double, std::micro>(UT_CLOCK::now() - s_bench_wake).count());
+}
+
+static double ns_per_op(UT_CLOCK::time_point begin, size_t num)
+{
+    return std::chrono::duration<double, std::nano>(UT_CLOCK::now() - begin).count() / num;
+}
+
+// start, restart and stop num cyclic timers of 1 ms to 60 s, then let them fire for 10 s of the timer clock
+static void bench_backend(const UT_SW_TIMER_BACKEND_T *be, size_t num, UT_BENCH_RESULT_T *result)
+{
+    std::vector<TIMER_ID> ids(num);
+    std::vector<TIME_MS> intervals(num);
+    UT_CLOCK::time_point begin;
+    SYS_TIME_T next = 0;
+    uint64_t end = 0;
+
+    ASSERT_EQ(OPRT_OK, be->init());
+    srand(3);
+    for (size_t i = 0; i < num; i++) {
+        ASSERT_EQ(OPRT_OK, be->create(bench_cb, NULL, &ids[i]));
+        intervals[i] = rand() % 60000 + 1;
+    }
+
+    begin = UT_CLOCK::now();
+    for (size_t i = 0; i < num; i++) {
+        be->start(ids[i], intervals[i], TAL_TIMER_CYCLE, 0);
+    }
+    result->start_ns = ns_per_op(begin, num);
+
+    begin = UT_CLOCK::now();
+    for (size_t i = 0; i < num; i++) {
+        be->start(ids[i], intervals[num - 1 - i], TAL_TIMER_CYCLE, 0);
+    }
+    result->restart_ns = ns_per_op(begin, num);
+
+    begin = UT_CLOCK::now();
+    for (size_t i = 0; i < num; i++) {
+        be->stop(ids[i]);
+    }
+    result->stop_ns = ns_per_op(begin, num);
+
+    for (size_t i = 0; i < num; i++) {
+        be->start(ids[i], intervals[i], TAL_TIMER_CYCLE, 0);
+    }
+    s_bench_delay.clear();
+    next = be->dispatch();
+    end = ut_timer_clock() + 10000;
+    while (SEM_WAIT_FOREVER != next && ut_timer_clock() + next <= end) {
+        ut_timer_clock_advance(next);
+        s_bench_wake = UT_CLOCK::now();
+        next = be->dispatch();
+    }
+    ut_timer_clock_advance(end - ut_timer_clock());
+
+    result->fire_cnt = s_bench_delay.size();
+    std::sort(s_bench_delay.begin(), s_bench_delay.end());
+    if (!s_bench_delay.empty()) {
+        result->delay_p50_us = s_bench_delay[(s_bench_delay.size() - 1) / 2];
+        result->delay_p99_us = s_bench_delay[(s_bench_delay.size() - 1) * 99 / 100];
+    }
+
+    for (auto id : ids) {
+        be->del(id);
+    }
+    be->dispatch();
+    EXPECT_EQ(0, be->get_num());
+}
+
+class SwTimerBench : public ::testing::TestWithParam<size_t> {
+};
+
+// the same timers on both backends, the wheel start does not grow with the number of timers
+TEST_P(SwTimerBench, StartStopAndFiringDelay)
+{
+    const UT_SW_TIMER_BACKEND_T *backend[] = {&ut_sw_timer_list, &ut_sw_timer_wheel};
+    UT_BENCH_RESULT_T result[2] = {0};
+    size_t num = GetParam();
+
+    for (int i = 0; i < 2; i++) {
+        bench_backend(backend[i], num, &result[i]);
+        printf("[ sw timer ] %-5s %5zu timers: start %6.0f ns, restart %6.0f ns, stop %4.0f ns, "
+               "%u fires, delay p50 %.2f us p99 %.2f us\n",
+               backend[i]->name, num, result[i].start_ns, result[i].restart_ns, result[i].stop_ns, result[i].fire_cnt,
+               result[i].delay_p50_us, result[i].delay_p99_us);
+        RecordProperty(std::string(backend[i]->name) + "_start_ns", (int)result[i].start_ns);
+        RecordProperty(std::string(backend[i]->name) + "_delay_p99_ns", (int)(result[i].delay_p99_us * 1000));
+    }
+
+    EXPECT_EQ(result[0].fire_cnt, result[1].fire_cnt);
+    if (num >= 10000) {
+        EXPECT_LT(result[1].start_ns, result[0].start_ns);
+        EXPECT_LT(result[1].restart_ns, result[0].restart_ns);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Timers, SwTimerBench, ::testing::Values(10, 1000, 10000));
+
+static std::atomic<int> s_cb_cnt;
+static std::atomic<bool> s_cb_off_thread; // a callback ran on another thread than the test
+static std::atomic<bool> s_gate_open;
+static std::atomic<bool> s_gate_in;
+static pthread_t s_test_thread;
+static TIME_MS s_cb_run_ms; // how far a callback moves the timer clock, like a callback that long
+static TIMER_ID s_slow_id;
+static TAL_TIMER_CB s_slow_cb;
+static TIME_MS s_slow_run_ms;
+static int s_slow_cnt;
+
+static void offload_cb(TIMER_ID timer_id, void *arg)
+{
+    if (!pthread_equal(pthread_self(), s_test_thread)) {
+        s_cb_off_thread = true;
+    }
+    ut_timer_clock_advance(s_cb_run_ms);
+    s_cb_cnt++;
+}
+
+static void slow_hook(TIMER_ID timer_id, TAL_TIMER_CB cb, TIME_MS run_ms)
+{
+    s_slow_id = timer_id;
+    s_slow_cb = cb;
+    s_slow_run_ms = run_ms;
+    s_slow_cnt++;
+}
+
+// holds the workqueue until the test opens the gate
+static void gate_cb(void *data)
+{
+    s_gate_in = true;
+    while (!s_gate_open) {
+        tal_system_sleep(1);
+    }
+}
+
+class SwTimerOffloadTest : public ::testing::Test {
+protected:
+    const UT_SW_TIMER_BACKEND_T *be = &ut_sw_timer_wheel;
+    WORKQUEUE_HANDLE wq = NULL;
+    TIMER_ID id = NULL;
+
+    void SetUp() override
+    {
+        THREAD_CFG_T cfg = {.stackDepth = 4096, .priority = THREAD_PRIO_2, .thrdname = (char *)"ut_tmq"};
+
+        s_cb_cnt = 0;
+        s_cb_off_thread = false;
+        s_gate_open = false;
+        s_gate_in = false;
+        s_test_thread = pthread_self();
+        s_cb_run_ms = 0;
+        s_slow_cnt = 0;
+        ASSERT_EQ(OPRT_OK, tal_sw_timer_init());
+        ASSERT_EQ(OPRT_OK, tal_workqueue_create(16, &cfg, &wq));
+        ASSERT_EQ(OPRT_OK, tal_sw_timer_create(offload_cb, NULL, &id));
+    }
+
+    void TearDown() override
+    {
+        s_gate_open = true;
+        tal_sw_timer_set_slow_cb(0, NULL);
+        tal_sw_timer_delete(id);
+        be->dispatch();
+        EXPECT_EQ(OPRT_OK, tal_workqueue_release(wq));
+        EXPECT_EQ(0, tal_sw_timer_get_num());
+    }
+
+    // move the clock to the expiry and let the timer thread run
+    void expire(TIME_MS ms)
+    {
+        ut_timer_clock_advance(ms);
+        be->dispatch();
+    }
+
+    void block_workqueue(void)
+    {
+        ASSERT_EQ(OPRT_OK, tal_workqueue_schedule(wq, gate_cb, NULL));
+        for (int i = 0; i < 2000 && !s_gate_in; i++) {
+            tal_system_sleep(1);
+        }
+        ASSERT_TRUE(s_gate_in);
+    }
+
+    void wait_cb(int cnt)
+    {
+        for (int i = 0; i < 2000 && s_cb_cnt < cnt; i++) {
+            tal_system_sleep(1);
+        }
+        ASSERT_EQ(cnt, s_cb_cnt);
+    }
+};
+
+TEST_F(SwTimerOffloadTest, CallbackRunsOnWorkqueue)
+{
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_set_workqueue(id, wq));
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_start(id, 100, TAL_TIMER_CYCLE));
+    be->dispatch();
+
+    expire(100);
+    wait_cb(1);
+    EXPECT_TRUE(s_cb_off_thread);
+
+    // back on the timer thread
+    s_cb_off_thread = false;
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_set_workqueue(id, NULL));
+    expire(100);
+    EXPECT_EQ(2, s_cb_cnt);
+    EXPECT_FALSE(s_cb_off_thread);
+}
+
+// while the offloaded callback waits in the queue, later expiries only count as missed
+TEST_F(SwTimerOffloadTest, OneQueuedCallbackPerTimer)
+{
+    TAL_SW_TIMER_STATS_T stats;
+
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_set_workqueue(id, wq));
+    block_workqueue();
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_start(id, 10, TAL_TIMER_CYCLE));
+    be->dispatch();
+
+    for (int i = 0; i < 5; i++) {
+        expire(10);
+    }
+    EXPECT_EQ(1, tal_workqueue_get_num(wq));
+
+    s_gate_open = true;
+    wait_cb(1);
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_get_stats(id, &stats));
+    EXPECT_EQ(1u, stats.fire_cnt);
+    EXPECT_EQ(4u, stats.miss_cnt);
+    // it started 40ms after the expiry it was queued for, in the [32, 64) ms bucket
+    EXPECT_EQ(40u, stats.late_max);
+    EXPECT_EQ(1u, stats.late_hist[6]);
+
+    expire(10);
+    wait_cb(2);
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_get_stats(id, &stats));
+    EXPECT_EQ(2u, stats.fire_cnt);
+    EXPECT_EQ(4u, stats.miss_cnt);
+}
+
+// a callback queued before the timer stopped does not run
+TEST_F(SwTimerOffloadTest, StopDropsQueuedCallback)
+{
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_set_workqueue(id, wq));
+    block_workqueue();
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_start(id, 10, TAL_TIMER_ONCE));
+    be->dispatch();
+    expire(10);
+    EXPECT_EQ(1, tal_workqueue_get_num(wq));
+
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_stop(id));
+    s_gate_open = true;
+    for (int i = 0; i < 2000 && tal_workqueue_get_num(wq); i++) {
+        tal_system_sleep(1);
+    }
+    tal_system_sleep(10);
+    EXPECT_EQ(0, s_cb_cnt);
+}
+
+TEST_F(SwTimerOffloadTest, SlowCallbackHookAndRunHistogram)
+{
+    TAL_SW_TIMER_STATS_T stats;
+
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_set_slow_cb(5, slow_hook));
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_start(id, 100, TAL_TIMER_CYCLE));
+    be->dispatch();
+
+    // within the budget
+    s_cb_run_ms = 3;
+    expire(100);
+    EXPECT_EQ(0, s_slow_cnt);
+
+    s_cb_run_ms = 20;
+    expire(97);
+    EXPECT_EQ(1, s_slow_cnt);
+    EXPECT_EQ(id, s_slow_id);
+    EXPECT_EQ((TAL_TIMER_CB)offload_cb, s_slow_cb);
+    EXPECT_EQ(20u, s_slow_run_ms);
+
+    // the hook also covers offloaded callbacks
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_set_workqueue(id, wq));
+    expire(80);
+    wait_cb(3);
+    for (int i = 0; i < 2000 && s_slow_cnt < 2; i++) {
+        tal_system_sleep(1);
+    }
+    EXPECT_EQ(2, s_slow_cnt);
+
+    ASSERT_EQ(OPRT_OK, tal_sw_timer_get_stats(id, &stats));
+    EXPECT_EQ(3u, stats.fire_cnt);
+    EXPECT_EQ(20u, stats.run_max);
+    // 3ms in [2, 4), 20ms twice in [16, 32)
+    EXPECT_EQ(1u, stats.run_hist[2]);
+    EXPECT_EQ(2u, stats.run_hist[5]);
+}
@@ -0,0 +1,46 @@
+/**
+ * @file ut_tal_sw_timer.h
+ * @brief The software timer backends built for the unit tests.
+ *
+ * The timer module is built twice, with the timing wheel and with the sorted
+ * list, see ut_tal_sw_timer_wb.c and ut_tal_sw_timer_list.c. The tests reach
+ * each build through its table and share one timer clock.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#ifndef __UT_TAL_SW_TIMER_H__
+#define __UT_TAL_SW_TIMER_H__
+
+#include "tal_sw_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char *name;
+    OPERATE_RET (*init)(void);
+    OPERATE_RET (*create)(TAL_TIMER_CB func, void *arg, TIMER_ID *timer_id);
+    OPERATE_RET (*del)(TIMER_ID timer_id);
+    OPERATE_RET (*start)(TIMER_ID timer_id, TIME_MS time_ms, TIMER_TYPE timer_type, TIME_MS slack_ms);
+    OPERATE_RET (*stop)(TIMER_ID timer_id);
+    OPERATE_RET (*get_next_wakeup)(TIME_MS *wakeup_ms);
+    int (*get_num)(void);
+    // run the expired timers like the timer thread after a wakeup, returns ms until the next wakeup
+    SYS_TIME_T (*dispatch)(void);
+    // how many times the timer thread woke up
+    uint32_t (*wakeup_cnt)(void);
+} UT_SW_TIMER_BACKEND_T;
+
+extern const UT_SW_TIMER_BACKEND_T ut_sw_timer_wheel;
+extern const UT_SW_TIMER_BACKEND_T ut_sw_timer_list;
+
+uint64_t ut_timer_clock(void);
+void ut_timer_clock_advance(uint64_t ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UT_TAL_SW_TIMER_H__ */
@@ -0,0 +1,63 @@
+/**
+ * @file ut_tal_sw_timer_list.c
+ * @brief Whitebox build of the software timer with the sorted list backend.
+ *
+ * Same as ut_tal_sw_timer_wb.c without the timing wheel. The public functions
+ * are renamed so both builds link into one test, the clock and the thread
+ * stand-in are the ones of ut_tal_sw_timer_wb.c.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#define tal_time_get_system_time    ut_timer_get_system_time
+#define tal_system_get_millisecond  ut_timer_get_millisecond
+#define tal_thread_create_and_start ut_timer_thread_create
+
+#define tal_sw_timer_init             ut_list_sw_timer_init
+#define tal_sw_timer_create           ut_list_sw_timer_create
+#define tal_sw_timer_delete           ut_list_sw_timer_delete
+#define tal_sw_timer_stop             ut_list_sw_timer_stop
+#define tal_sw_timer_is_running       ut_list_sw_timer_is_running
+#define tal_sw_timer_remain_time_get  ut_list_sw_timer_remain_time_get
+#define tal_sw_timer_start            ut_list_sw_timer_start
+#define tal_sw_timer_start_with_slack ut_list_sw_timer_start_with_slack
+#define tal_sw_timer_get_next_wakeup  ut_list_sw_timer_get_next_wakeup
+#define tal_sw_timer_trigger          ut_list_sw_timer_trigger
+#define tal_sw_timer_set_workqueue    ut_list_sw_timer_set_workqueue
+#define tal_sw_timer_set_slow_cb      ut_list_sw_timer_set_slow_cb
+#define tal_sw_timer_get_stats        ut_list_sw_timer_get_stats
+#define tal_sw_timer_release          ut_list_sw_timer_release
+#define tal_sw_timer_get_num          ut_list_sw_timer_get_num
+#define tal_sw_timer_dump             ut_list_sw_timer_dump
+
+#include "../src/tal_sw_timer.c"
+#include "ut_tal_sw_timer.h"
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static SYS_TIME_T __ut_timer_dispatch(void)
+{
+    SYS_TIME_T next_expired = SEM_WAIT_FOREVER;
+
+    __timer_dispatch(&next_expired);
+    return next_expired;
+}
+
+static uint32_t __ut_timer_wakeup_cnt(void)
+{
+    return s_timer_mgr.wakeup_cnt;
+}
+
+const UT_SW_TIMER_BACKEND_T ut_sw_timer_list = {
+    .name = "list",
+    .init = tal_sw_timer_init,
+    .create = tal_sw_timer_create,
+    .del = tal_sw_timer_delete,
+    .start = tal_sw_timer_start_with_slack,
+    .stop = tal_sw_timer_stop,
+    .get_next_wakeup = tal_sw_timer_get_next_wakeup,
+    .get_num = tal_sw_timer_get_num,
+    .dispatch = __ut_timer_dispatch,
+    .wakeup_cnt = __ut_timer_wakeup_cnt,
+};
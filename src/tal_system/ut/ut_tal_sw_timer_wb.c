@@ -0,0 +1,94 @@
+/**
+ * @file ut_tal_sw_timer_wb.c
+ * @brief Whitebox build of the software timer for the unit tests.
+ *
+ * The timer module is compiled with a clock the test sets and without its
+ * thread. The test plays the thread: it moves the clock to the next wakeup and
+ * runs the dispatch, so every expiry can be checked to the millisecond.
+ *
+ * This is the timing wheel build, it keeps the tal_sw_timer names and also
+ * serves the workqueue. The clock is shared with ut_tal_sw_timer_list.c.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#define tal_time_get_system_time    ut_timer_get_system_time
+#define tal_system_get_millisecond  ut_timer_get_millisecond
+#define tal_thread_create_and_start ut_timer_thread_create
+
+#include "../src/tal_sw_timer.c"
+#include "ut_tal_sw_timer.h"
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static uint64_t s_ut_clock = 5000;
+static int s_ut_thread;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+void ut_timer_get_system_time(TIME_S *pSecTime, TIME_MS *pMsTime)
+{
+    *pSecTime = s_ut_clock / 1000;
+    *pMsTime = s_ut_clock % 1000;
+}
+
+SYS_TIME_T ut_timer_get_millisecond(void)
+{
+    return (SYS_TIME_T)s_ut_clock;
+}
+
+OPERATE_RET ut_timer_thread_create(THREAD_HANDLE *handle, const THREAD_ENTER_CB enter, const THREAD_EXIT_CB exit,
+                                   const THREAD_FUNC_CB func, const void *func_args, const THREAD_CFG_T *cfg)
+{
+    // never started, the test dispatches
+    *handle = &s_ut_thread;
+    return OPRT_OK;
+}
+
+/**
+ * @brief current time of the timer clock
+ *
+ * @return the time in ms
+ */
+uint64_t ut_timer_clock(void)
+{
+    return s_ut_clock;
+}
+
+/**
+ * @brief move the timer clock forward
+ *
+ * @param[in] ms: the time to add
+ */
+void ut_timer_clock_advance(uint64_t ms)
+{
+    s_ut_clock += ms;
+}
+
+static SYS_TIME_T __ut_timer_dispatch(void)
+{
+    SYS_TIME_T next_expired = SEM_WAIT_FOREVER;
+
+    __timer_dispatch(&next_expired);
+    return next_expired;
+}
+
+static uint32_t __ut_timer_wakeup_cnt(void)
+{
+    return s_timer_mgr.wakeup_cnt;
+}
+
+const UT_SW_TIMER_BACKEND_T ut_sw_timer_wheel = {
+    .name = "wheel",
+    .init = tal_sw_timer_init,
+    .create = tal_sw_timer_create,
+    .del = tal_sw_timer_delete,
+    .start = tal_sw_timer_start_with_slack,
+    .stop = tal_sw_timer_stop,
+    .get_next_wakeup = tal_sw_timer_get_next_wakeup,
+    .get_num = tal_sw_timer_get_num,
+    .dispatch = __ut_timer_dispatch,
+    .wakeup_cnt = __ut_timer_wakeup_cnt,
+};
@@ -0,0 +1,403 @@
+/**
+ * @file ut_tal_workqueue.cpp
+ * @brief Unit tests of the workqueue: priority and deadline ordering,
+ * drop_late, capacity, work stealing between the workers of a pool, and the
+ * latency of the pool and of high priority works under load.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "tal_system.h"
+#include "tal_workqueue.h"
+
+extern "C" uint32_t ut_tal_malloc_cnt;
+
+// the runs of every test are recorded here, a test has at most one workqueue
+static std::mutex s_run_mutex;
+static std::vector<int> s_run_order;
+static std::atomic<bool> s_gate_open;
+static std::atomic<int> s_gate_cnt;
+
+static void record_cb(void *data)
+{
+    std::lock_guard<std::mutex> lock(s_run_mutex);
+    s_run_order.push_back((int)(intptr_t)data);
+}
+
+// holds the worker until the test opens the gate
+static void gate_cb(void *data)
+{
+    s_gate_cnt++;
+    while (!s_gate_open) {
+        tal_system_sleep(1);
+    }
+}
+
+class WorkqueueTest : public ::testing::Test {
+protected:
+    WORKQUEUE_HANDLE wq = NULL;
+
+    void SetUp() override
+    {
+        s_run_order.clear();
+        s_gate_open = false;
+        s_gate_cnt = 0;
+    }
+
+    void TearDown() override
+    {
+        s_gate_open = true;
+        if (wq) {
+            EXPECT_EQ(OPRT_OK, tal_workqueue_release(wq));
+        }
+    }
+
+    void create(uint16_t queue_len, uint8_t worker_num)
+    {
+        THREAD_CFG_T cfg = {.stackDepth = 4096, .priority = THREAD_PRIO_2, .thrdname = (char *)"ut_wq"};
+
+        if (1 == worker_num) {
+            ASSERT_EQ(OPRT_OK, tal_workqueue_create(queue_len, &cfg, &wq));
+        } else {
+            ASSERT_EQ(OPRT_OK, tal_workqueue_create_pool(queue_len, worker_num, &cfg, &wq));
+        }
+    }
+
+    // occupy the given number of workers
+    void block_workers(int num)
+    {
+        for (int i = 0; i < num; i++) {
+            ASSERT_EQ(OPRT_OK, tal_workqueue_schedule(wq, gate_cb, NULL));
+        }
+        wait_for([&] { return s_gate_cnt == num; });
+    }
+
+    void wait_for(std::function<bool(void)> cond)
+    {
+        for (int i = 0; i < 2000 && !cond(); i++) {
+            tal_system_sleep(1);
+        }
+        ASSERT_TRUE(cond());
+    }
+
+    void wait_idle(size_t runs)
+    {
+        wait_for([&] {
+            std::lock_guard<std::mutex> lock(s_run_mutex);
+            return (0 == tal_workqueue_get_num(wq)) && (s_run_order.size() >= runs);
+        });
+    }
+
+    OPERATE_RET schedule(int tag, WORK_PRIO_E prio, TIME_MS deadline = 0, BOOL_T drop_late = FALSE)
+    {
+        WORK_OPTION_T option = {.prio = prio, .deadline = deadline, .drop_late = drop_late};
+
+        return tal_workqueue_schedule_with_option(wq, record_cb, (void *)(intptr_t)tag, &option);
+    }
+};
+
+TEST_F(WorkqueueTest, HigherPriorityRunsFirst)
+{
+    create(16, 1);
+    block_workers(1);
+
+    EXPECT_EQ(OPRT_OK, schedule(1, WORK_PRIO_LOW));
+    EXPECT_EQ(OPRT_OK, schedule(2, WORK_PRIO_NORMAL));
+    EXPECT_EQ(OPRT_OK, schedule(3, WORK_PRIO_HIGH));
+    EXPECT_EQ(OPRT_OK, schedule(4, WORK_PRIO_LOW));
+    EXPECT_EQ(OPRT_OK, schedule(5, WORK_PRIO_NORMAL));
+    EXPECT_EQ(OPRT_OK, tal_workqueue_schedule(wq, record_cb, (void *)6));
+    // instant goes in front of the other high priority works
+    EXPECT_EQ(OPRT_OK, tal_workqueue_schedule_instant(wq, record_cb, (void *)7));
+
+    s_gate_open = true;
+    wait_idle(7);
+
+    EXPECT_EQ(std::vector<int>({7, 3, 2, 5, 6, 1, 4}), s_run_order);
+}
+
+// within a priority the works with a deadline go earliest deadline first, the others keep their order behind them
+TEST_F(WorkqueueTest, DeadlineOrdersWithinPriority)
+{
+    create(16, 1);
+    block_workers(1);
+
+    EXPECT_EQ(OPRT_OK, schedule(1, WORK_PRIO_NORMAL));
+    EXPECT_EQ(OPRT_OK, schedule(2, WORK_PRIO_NORMAL, 3000));
+    EXPECT_EQ(OPRT_OK, schedule(3, WORK_PRIO_NORMAL, 1000));
+    EXPECT_EQ(OPRT_OK, schedule(4, WORK_PRIO_NORMAL));
+    EXPECT_EQ(OPRT_OK, schedule(5, WORK_PRIO_NORMAL, 1000));
+    EXPECT_EQ(OPRT_OK, schedule(6, WORK_PRIO_LOW, 10));
+    EXPECT_EQ(OPRT_OK, schedule(7, WORK_PRIO_NORMAL, 2000));
+
+    s_gate_open = true;
+    wait_idle(7);
+
+    EXPECT_EQ(std::vector<int>({3, 5, 7, 2, 1, 4, 6}), s_run_order);
+}
+
+TEST_F(WorkqueueTest, LateWorkIsCountedAndDropped)
+{
+    WORKQUEUE_STATS_T stats;
+
+    create(16, 1);
+    block_workers(1);
+
+    EXPECT_EQ(OPRT_OK, schedule(1, WORK_PRIO_NORMAL, 10, TRUE));
+    EXPECT_EQ(OPRT_OK, schedule(2, WORK_PRIO_NORMAL, 10, FALSE));
+    EXPECT_EQ(OPRT_OK, schedule(3, WORK_PRIO_NORMAL, 5000, TRUE));
+    EXPECT_EQ(OPRT_OK, schedule(4, WORK_PRIO_NORMAL));
+
+    tal_system_sleep(50);
+    s_gate_open = true;
+    wait_idle(3);
+
+    // the late work kept by drop_late FALSE still runs in order
+    EXPECT_EQ(std::vector<int>({2, 3, 4}), s_run_order);
+    EXPECT_EQ(OPRT_OK, tal_workqueue_get_stats(wq, &stats));
+    EXPECT_EQ(2u, stats.deadline_miss);
+    EXPECT_EQ(1u, stats.deadline_drop);
+}
+
+TEST_F(WorkqueueTest, CapacityRejectsAndCancelFreesSlots)
+{
+    create(4, 1);
+    block_workers(1);
+
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(OPRT_OK, schedule(i, WORK_PRIO_NORMAL));
+    }
+    EXPECT_EQ(OPRT_EXCEED_UPPER_LIMIT, schedule(4, WORK_PRIO_NORMAL));
+    EXPECT_EQ(4, tal_workqueue_get_num(wq));
+
+    EXPECT_EQ(OPRT_OK, tal_workqueue_cancel(wq, NULL, (void *)1));
+    EXPECT_EQ(3, tal_workqueue_get_num(wq));
+    EXPECT_EQ(OPRT_OK, schedule(5, WORK_PRIO_NORMAL));
+
+    EXPECT_EQ(OPRT_OK, tal_workqueue_set_capacity(wq, 8));
+    EXPECT_EQ(OPRT_OK, schedule(6, WORK_PRIO_NORMAL));
+
+    s_gate_open = true;
+    wait_idle(5);
+
+    EXPECT_EQ(std::vector<int>({0, 2, 3, 5, 6}), s_run_order);
+}
+
+// an idle worker takes the unordered works queued behind a blocked one, ordered works wait for their worker
+TEST_F(WorkqueueTest, IdleWorkerStealsUnorderedWork)
+{
+    create(32, 2);
+
+    ASSERT_EQ(OPRT_OK, tal_workqueue_schedule_ordered(wq, 0, gate_cb, NULL));
+    wait_for([] { return 1 == s_gate_cnt; });
+
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(OPRT_OK, tal_workqueue_schedule_ordered(wq, 0, record_cb, (void *)(intptr_t)(100 + i)));
+    }
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(OPRT_OK, schedule(i, WORK_PRIO_NORMAL));
+    }
+
+    wait_for([] {
+        std::lock_guard<std::mutex> lock(s_run_mutex);
+        return 10 == s_run_order.size();
+    });
+    EXPECT_EQ(3, tal_workqueue_get_num(wq));
+
+    s_gate_open = true;
+    wait_idle(13);
+
+    // the works of a key keep their order
+    EXPECT_EQ(std::vector<int>({100, 101, 102}), std::vector<int>(s_run_order.begin() + 10, s_run_order.end()));
+}
+
+TEST_F(WorkqueueTest, PoolRunsEveryWorkOnce)
+{
+    const int num = 2000;
+    std::vector<int> cnt(num, 0);
+
+    create(num, 4);
+    for (int i = 0; i < num; i++) {
+        ASSERT_EQ(OPRT_OK, schedule(i, (WORK_PRIO_E)(i % WORK_PRIO_MAX)));
+    }
+    wait_idle(num);
+
+    for (int tag : s_run_order) {
+        cnt[tag]++;
+    }
+    EXPECT_EQ(std::vector<int>(num, 1), cnt);
+}
+
+// the capacity covers the items queued on every worker, a full worker does not reject work its siblings can take
+TEST_F(WorkqueueTest, PoolCapacityIsShared)
+{
+    create(4, 2);
+    block_workers(2);
+
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(OPRT_OK, schedule(i, WORK_PRIO_NORMAL));
+    }
+    EXPECT_EQ(OPRT_EXCEED_UPPER_LIMIT, schedule(4, WORK_PRIO_NORMAL));
+    EXPECT_EQ(OPRT_EXCEED_UPPER_LIMIT, tal_workqueue_schedule_ordered(wq, 1, record_cb, (void *)5));
+    EXPECT_EQ(4, tal_workqueue_get_num(wq));
+
+    s_gate_open = true;
+    wait_idle(4);
+}
+
+// the slots are allocated up front, scheduling and running do not allocate
+TEST_F(WorkqueueTest, ScheduleDoesNotAllocate)
+{
+    create(64, 2);
+    block_workers(2);
+
+    uint32_t malloc_cnt = ut_tal_malloc_cnt;
+    for (int i = 0; i < 64; i++) {
+        ASSERT_EQ(OPRT_OK, schedule(i, (WORK_PRIO_E)(i % WORK_PRIO_MAX)));
+    }
+    s_gate_open = true;
+    wait_idle(64);
+    for (int i = 0; i < 64; i++) {
+        ASSERT_EQ(OPRT_OK, schedule(i, WORK_PRIO_NORMAL));
+    }
+    wait_idle(128);
+
+    EXPECT_EQ(0u, ut_tal_malloc_cnt - malloc_cnt);
+}
+
+typedef std::chrono::steady_clock UT_CLOCK;
+
+typedef struct {
+    UT_CLOCK::time_point queue;
+    UT_CLOCK::time_point start;
+    UT_CLOCK::time_point end;
+    bool is_long;
+} UT_BENCH_ITEM_T;
+
+// a long item blocks like a kv write, a short one spins like a dp parse
+static void bench_cb(void *data)
+{
+    UT_BENCH_ITEM_T *item = (UT_BENCH_ITEM_T *)data;
+
+    item->start = UT_CLOCK::now();
+    if (item->is_long) {
+        tal_system_sleep(2);
+    } else {
+        while (UT_CLOCK::now() - item->start < std::chrono::microseconds(20)) {
+        }
+    }
+    item->end = UT_CLOCK::now();
+}
+
+static double us_between(UT_CLOCK::time_point from, UT_CLOCK::time_point to)
+{
+    return std::chrono::duration<double, std::micro>(to - from).count();
+}
+
+// the p-th percentile of the wait from scheduling to start
+static double wait_percentile(std::vector<UT_BENCH_ITEM_T> &items, double p)
+{
+    std::vector<double> wait;
+
+    for (auto &item : items) {
+        wait.push_back(us_between(item.queue, item.start));
+    }
+    std::sort(wait.begin(), wait.end());
+
+    return wait[(size_t)(p * (wait.size() - 1))];
+}
+
+// the same paced mix of short and long items on the single thread queue and on a pool of 4
+TEST_F(WorkqueueTest, PoolBeatsSingleThreadOnMixedWork)
+{
+    const int num = 2000;
+    const char *name[] = {"single", "pool 4"};
+    double p99[2] = {0};
+
+    for (int pool = 0; pool < 2; pool++) {
+        std::vector<UT_BENCH_ITEM_T> items(num);
+
+        create(num, pool ? 4 : 1);
+        UT_CLOCK::time_point begin = UT_CLOCK::now();
+        for (int i = 0; i < num; i++) {
+            items[i].is_long = (0 == i % 20);
+            // one item every 100 us, 5% of them take 2 ms
+            std::this_thread::sleep_until(begin + std::chrono::microseconds(100 * i));
+            items[i].queue = UT_CLOCK::now();
+            ASSERT_EQ(OPRT_OK, tal_workqueue_schedule(wq, bench_cb, &items[i]));
+        }
+        for (int i = 0; i < 5000 && tal_workqueue_get_num(wq); i++) {
+            tal_system_sleep(1);
+        }
+        ASSERT_EQ(OPRT_OK, tal_workqueue_release(wq));
+        wq = NULL;
+
+        UT_CLOCK::time_point end = begin;
+        for (auto &item : items) {
+            end = std::max(end, item.end);
+        }
+        p99[pool] = wait_percentile(items, 0.99);
+        printf("[ workqueue] %s: %.0f items/s, wait p50 %.0f us p99 %.0f us\n", name[pool],
+               num * 1e6 / us_between(begin, end), wait_percentile(items, 0.5), p99[pool]);
+        RecordProperty(pool ? "pool_p99_us" : "single_p99_us", (int)p99[pool]);
+    }
+
+    EXPECT_LT(p99[1], p99[0]);
+}
+
+// a low priority item of the backlog, a bulk job like a log upload
+static void bulk_cb(void *data)
+{
+    UT_CLOCK::time_point start = UT_CLOCK::now();
+
+    while (UT_CLOCK::now() - start < std::chrono::microseconds(200)) {
+    }
+}
+
+// urgent items scheduled into a queue kept full of 200 us low priority works wait for the running one only
+TEST_F(WorkqueueTest, HighPriorityTailLatencyUnderLoad)
+{
+    const int num = 200;
+    const WORK_PRIO_E urgent_prio[] = {WORK_PRIO_HIGH, WORK_PRIO_LOW};
+    double p99[2] = {0};
+
+    for (int run = 0; run < 2; run++) {
+        std::vector<UT_BENCH_ITEM_T> items(num);
+        WORK_OPTION_T urgent = {.prio = urgent_prio[run], .deadline = 0, .drop_late = FALSE};
+        WORK_OPTION_T bulk = {.prio = WORK_PRIO_LOW, .deadline = 0, .drop_late = FALSE};
+
+        create(256, 1);
+        for (int i = 0; i < num; i++) {
+            // keep 200 bulk works, 40 ms of work, queued
+            while (tal_workqueue_get_num(wq) < 200) {
+                ASSERT_EQ(OPRT_OK, tal_workqueue_schedule_with_option(wq, bulk_cb, NULL, &bulk));
+            }
+            items[i].queue = UT_CLOCK::now();
+            ASSERT_EQ(OPRT_OK, tal_workqueue_schedule_with_option(wq, bench_cb, &items[i], &urgent));
+            tal_system_sleep(2);
+        }
+        for (int i = 0; i < 5000 && tal_workqueue_get_num(wq); i++) {
+            tal_system_sleep(1);
+        }
+        ASSERT_EQ(OPRT_OK, tal_workqueue_release(wq));
+        wq = NULL;
+
+        p99[run] = wait_percentile(items, 0.99);
+        printf("[ workqueue] urgent %s behind 200 bulk works: wait p50 %.0f us p99 %.0f us\n",
+               run ? "low, fifo" : "high", wait_percentile(items, 0.5), p99[run]);
+        RecordProperty(run ? "fifo_p99_us" : "high_p99_us", (int)p99[run]);
+    }
+
+    // the running bulk work is 200 us, the rest is the scheduling of the host
+    EXPECT_LT(p99[0], 5000);
+    EXPECT_LT(p99[0] * 4, p99[1]);
+}
@@ -0,0 +1,302 @@
+/**
+ * @file ut_tuya_ringbuf.cpp
+ * @brief Unit tests of the ring buffer: wraparound against a model, the
+ * reserve/commit and peek_contiguous/release calls, and one producer with one
+ * consumer running without a lock.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "tuya_ringbuf.h"
+
+class RingbufTest : public ::testing::Test {
+protected:
+    TUYA_RINGBUFF_T rb = NULL;
+
+    void create(uint32_t len)
+    {
+        ASSERT_EQ(OPRT_OK, tuya_ring_buff_create(len, OVERFLOW_STOP_TYPE, &rb));
+    }
+
+    void TearDown() override
+    {
+        if (rb) {
+            EXPECT_EQ(OPRT_OK, tuya_ring_buff_free(rb));
+        }
+    }
+};
+
+// the producer writes this sequence and the consumer checks it, the period does not divide the buffer lengths
+static inline uint8_t seq_byte(uint64_t pos)
+{
+    return (uint8_t)(pos % 251);
+}
+
+TEST_F(RingbufTest, KeepsOneByteFree)
+{
+    uint8_t data[32] = {0};
+
+    create(16);
+    EXPECT_EQ(15u, tuya_ring_buff_free_size_get(rb));
+    EXPECT_EQ(15u, tuya_ring_buff_write(rb, data, sizeof(data)));
+    EXPECT_EQ(0u, tuya_ring_buff_free_size_get(rb));
+    EXPECT_EQ(15u, tuya_ring_buff_used_size_get(rb));
+    EXPECT_EQ(0u, tuya_ring_buff_write(rb, data, 1));
+
+    EXPECT_EQ(15u, tuya_ring_buff_read(rb, data, sizeof(data)));
+    EXPECT_EQ(0u, tuya_ring_buff_used_size_get(rb));
+    EXPECT_EQ(0u, tuya_ring_buff_read(rb, data, 1));
+}
+
+TEST_F(RingbufTest, RejectsBadParams)
+{
+    TUYA_RINGBUFF_T tmp = NULL;
+    uint8_t data[4] = {0};
+    void *ptr = NULL;
+
+    EXPECT_EQ(OPRT_INVALID_PARM, tuya_ring_buff_create(0, OVERFLOW_STOP_TYPE, &tmp));
+    EXPECT_EQ(OPRT_NOT_SUPPORTED, tuya_ring_buff_create(16, OVERFLOW_COVERAGE_TYPE, &tmp));
+    EXPECT_EQ(OPRT_INVALID_PARM, tuya_ring_buff_free(NULL));
+    EXPECT_EQ(0u, tuya_ring_buff_write(NULL, data, sizeof(data)));
+    EXPECT_EQ(0u, tuya_ring_buff_read(NULL, data, sizeof(data)));
+    EXPECT_EQ(0u, tuya_ring_buff_write_reserve(NULL, &ptr, sizeof(data)));
+    EXPECT_EQ(0u, tuya_ring_buff_peek_contiguous(NULL, &ptr));
+}
+
+// every call at every position of the buffer, checked against a byte queue
+TEST_F(RingbufTest, RandomOpsMatchModel)
+{
+    const uint32_t len = 37;
+    std::deque<uint8_t> model;
+    uint8_t data[64];
+    uint64_t wr_pos = 0;
+
+    srand(3);
+    create(len);
+
+    for (int i = 0; i < 200000; i++) {
+        uint32_t n = rand() % (len + 5) + 1;
+        uint32_t ret = 0;
+        void *ptr = NULL;
+
+        switch (rand() % 6) {
+        case 0:
+            for (uint32_t j = 0; j < n; j++) {
+                data[j] = seq_byte(wr_pos + j);
+            }
+            ret = tuya_ring_buff_write(rb, data, n);
+            ASSERT_EQ(std::min<size_t>(n, len - 1 - model.size()), ret);
+            for (uint32_t j = 0; j < ret; j++) {
+                model.push_back(seq_byte(wr_pos++));
+            }
+            break;
+        case 1:
+            // peek leaves the data
+            ret = tuya_ring_buff_peek(rb, data, n);
+            ASSERT_EQ(std::min<size_t>(n, model.size()), ret);
+            for (uint32_t j = 0; j < ret; j++) {
+                ASSERT_EQ(model[j], data[j]);
+            }
+            break;
+        case 2:
+            ret = tuya_ring_buff_read(rb, data, n);
+            ASSERT_EQ(std::min<size_t>(n, model.size()), ret);
+            for (uint32_t j = 0; j < ret; j++) {
+                ASSERT_EQ(model[j], data[j]);
+            }
+            model.erase(model.begin(), model.begin() + ret);
+            break;
+        case 3: {
+            // the reserved area stops at the buffer end, a part of it is committed
+            uint32_t free_len = len - 1 - model.size();
+            ret = tuya_ring_buff_write_reserve(rb, &ptr, n);
+            ASSERT_LE(ret, std::min(n, free_len));
+            ASSERT_TRUE(ret > 0 || 0 == free_len);
+            uint32_t fill = ret ? rand() % ret + 1 : 0;
+            for (uint32_t j = 0; j < fill; j++) {
+                ((uint8_t *)ptr)[j] = seq_byte(wr_pos + j);
+            }
+            ASSERT_EQ(fill, tuya_ring_buff_write_commit(rb, fill));
+            for (uint32_t j = 0; j < fill; j++) {
+                model.push_back(seq_byte(wr_pos++));
+            }
+            break;
+        }
+        case 4: {
+            ret = tuya_ring_buff_peek_contiguous(rb, &ptr);
+            ASSERT_LE(ret, model.size());
+            ASSERT_TRUE(ret > 0 || model.empty());
+            for (uint32_t j = 0; j < ret; j++) {
+                ASSERT_EQ(model[j], ((uint8_t *)ptr)[j]);
+            }
+            uint32_t drop = ret ? rand() % ret + 1 : 0;
+            ASSERT_EQ(drop, tuya_ring_buff_release(rb, drop));
+            model.erase(model.begin(), model.begin() + drop);
+            break;
+        }
+        default:
+            // release more than there is
+            ret = tuya_ring_buff_release(rb, n);
+            ASSERT_EQ(std::min<size_t>(n, model.size()), ret);
+            model.erase(model.begin(), model.begin() + ret);
+            break;
+        }
+
+        ASSERT_EQ(model.size(), tuya_ring_buff_used_size_get(rb));
+        ASSERT_EQ(len - 1 - model.size(), tuya_ring_buff_free_size_get(rb));
+    }
+}
+
+// the zero-copy calls cut at the buffer end, the rest comes on the next call
+TEST_F(RingbufTest, ContiguousCallsSplitAtTheEnd)
+{
+    uint8_t data[16] = {0};
+    void *ptr = NULL;
+    void *base = NULL;
+
+    create(16);
+    ASSERT_EQ(15u, tuya_ring_buff_write_reserve(rb, &base, 32));
+    ASSERT_EQ(10u, tuya_ring_buff_write_commit(rb, 10));
+    ASSERT_EQ(10u, tuya_ring_buff_read(rb, data, 10));
+
+    // in and out at 10: 6 bytes to the end, then 9 from the start
+    EXPECT_EQ(6u, tuya_ring_buff_write_reserve(rb, &ptr, 15));
+    EXPECT_EQ((uint8_t *)base + 10, ptr);
+    EXPECT_EQ(6u, tuya_ring_buff_write_commit(rb, 15));
+    EXPECT_EQ(9u, tuya_ring_buff_write_reserve(rb, &ptr, 15));
+    EXPECT_EQ(base, ptr);
+    EXPECT_EQ(9u, tuya_ring_buff_write_commit(rb, 9));
+    EXPECT_EQ(0u, tuya_ring_buff_free_size_get(rb));
+
+    EXPECT_EQ(6u, tuya_ring_buff_peek_contiguous(rb, &ptr));
+    EXPECT_EQ((uint8_t *)base + 10, ptr);
+    EXPECT_EQ(6u, tuya_ring_buff_release(rb, 6));
+    EXPECT_EQ(9u, tuya_ring_buff_peek_contiguous(rb, &ptr));
+    EXPECT_EQ(base, ptr);
+    EXPECT_EQ(9u, tuya_ring_buff_release(rb, 9));
+    EXPECT_EQ(0u, tuya_ring_buff_peek_contiguous(rb, &ptr));
+}
+
+#define UT_SEQ_PERIOD    251
+#define UT_SPSC_CHUNK_MAX 2048
+
+// the sequence from any position, so a chunk is written with one copy and checked with one compare
+static const std::vector<uint8_t> &seq_table(void)
+{
+    static std::vector<uint8_t> table;
+
+    if (table.empty()) {
+        for (uint32_t i = 0; i < UT_SEQ_PERIOD + UT_SPSC_CHUNK_MAX; i++) {
+            table.push_back(seq_byte(i));
+        }
+    }
+    return table;
+}
+
+// moves the bytes from a producer to a consumer thread, no lock is taken on the buffer
+static void spsc_run(TUYA_RINGBUFF_T rb, uint64_t total, bool zero_copy, uint32_t max_chunk, uint64_t *err_cnt)
+{
+    const uint8_t *seq = seq_table().data();
+
+    std::thread producer([=] {
+        uint64_t pos = 0;
+        uint32_t seed = 7;
+
+        while (pos < total) {
+            uint32_t n = (uint32_t)std::min<uint64_t>(rand_r(&seed) % max_chunk + 1, total - pos);
+            uint32_t ret = 0;
+            void *ptr = NULL;
+
+            if (zero_copy) {
+                ret = tuya_ring_buff_write_reserve(rb, &ptr, n);
+                memcpy(ptr, &seq[pos % UT_SEQ_PERIOD], ret);
+                tuya_ring_buff_write_commit(rb, ret);
+            } else {
+                ret = tuya_ring_buff_write(rb, &seq[pos % UT_SEQ_PERIOD], n);
+            }
+            pos += ret;
+            if (0 == ret) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<uint8_t> data(max_chunk);
+    uint64_t pos = 0;
+    uint32_t seed = 11;
+
+    while (pos < total) {
+        uint32_t ret = 0;
+        uint8_t *ptr = NULL;
+
+        if (zero_copy) {
+            ret = tuya_ring_buff_peek_contiguous(rb, (void **)&ptr);
+            ret = std::min(ret, rand_r(&seed) % max_chunk + 1);
+        } else {
+            ret = tuya_ring_buff_read(rb, data.data(), rand_r(&seed) % max_chunk + 1);
+            ptr = data.data();
+        }
+        if (memcmp(ptr, &seq[pos % UT_SEQ_PERIOD], ret)) {
+            (*err_cnt)++;
+        }
+        if (zero_copy) {
+            tuya_ring_buff_release(rb, ret);
+        }
+        pos += ret;
+        if (0 == ret) {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+}
+
+// an odd length and chunks up to the buffer size wrap the indices on almost every call
+TEST_F(RingbufTest, SpscCopyKeepsOrder)
+{
+    uint64_t err_cnt = 0;
+
+    create(97);
+    spsc_run(rb, 16 << 20, false, 97, &err_cnt);
+
+    EXPECT_EQ(0u, err_cnt);
+    EXPECT_EQ(0u, tuya_ring_buff_used_size_get(rb));
+}
+
+TEST_F(RingbufTest, SpscZeroCopyKeepsOrder)
+{
+    uint64_t err_cnt = 0;
+
+    create(97);
+    spsc_run(rb, 16 << 20, true, 97, &err_cnt);
+
+    EXPECT_EQ(0u, err_cnt);
+    EXPECT_EQ(0u, tuya_ring_buff_used_size_get(rb));
+}
+
+// reports the transfer rate of both call styles with a buffer the size of an audio ring
+TEST_F(RingbufTest, SpscThroughput)
+{
+    const uint64_t total = 512 << 20;
+    const char *name[] = {"copy", "zero copy"};
+
+    create(16 * 1024);
+    for (int zero_copy = 0; zero_copy < 2; zero_copy++) {
+        uint64_t err_cnt = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        spsc_run(rb, total, zero_copy, UT_SPSC_CHUNK_MAX, &err_cnt);
+
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        EXPECT_EQ(0u, err_cnt);
+        printf("[ ringbuf  ] %s: %.0f MB/s\n", name[zero_copy], total / sec / (1 << 20));
+        RecordProperty(zero_copy ? "zero_copy_mbps" : "copy_mbps", (int)(total / sec / (1 << 20)));
+    }
+}
@@ -9,7 +9,7 @@
  * AI sessions with thread-safe operations.
  *
  * Key features include:
- * - AI session management with configurable maximum session limit
+ * - AI session management with runtime configurable maximum session limit
  * - Asynchronous task scheduling with configurable delay
  * - Thread-safe operations using mutex and event mechanisms
  * - Integration with Tuya AI client and protocol layers
@@ -120,6 +120,10 @@ typedef void (*AI_BIZ_SEND_FREE_CB)(char *data);
  */
 typedef OPERATE_RET (*AI_BIZ_RECV_CB)(AI_BIZ_ATTR_INFO_T *attr, AI_BIZ_HEAD_INFO_T *head, char *data, void *usr_data);
 
+typedef uint8_t AI_BIZ_SEND_MODE;
+#define AI_BIZ_SEND_POLL   0x00 // get_cb is polled every AI_BIZ_TASK_DELAY
+#define AI_BIZ_SEND_NOTIFY 0x01 // get_cb is drained after tuya_ai_biz_send_notify
+
 typedef struct {
     /** send packet type */
     AI_PACKET_PT type;
@@ -129,6 +133,8 @@ typedef struct {
     AI_BIZ_SEND_GET_CB get_cb;
     /** send channel free cb */
     AI_BIZ_SEND_FREE_CB free_cb;
+    /** send channel schedule mode */
+    AI_BIZ_SEND_MODE mode;
 } AI_BIZ_SEND_DATA_T;
 
 typedef struct {
@@ -177,6 +183,18 @@ OPERATE_RET tuya_ai_biz_crt_session(uint32_t bizCode, AI_SESSION_CFG_T *cfg, uin
  */
 OPERATE_RET tuya_ai_biz_del_session(AI_SESSION_ID id, AI_STATUS_CODE code);
 
+/**
+ * @brief set the max num of concurrent sessions
+ *
+ * @param[in] num session max num, AI_SESSION_MAX_NUM is used by default
+ *
+ * @note must be called before biz init, the session table is not resized
+ * once it is allocated
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_biz_set_session_num(uint32_t num);
+
 /**
  * @brief send ai biz packet
  *
@@ -191,6 +209,15 @@ OPERATE_RET tuya_ai_biz_del_session(AI_SESSION_ID id, AI_STATUS_CODE code);
 OPERATE_RET tuya_ai_send_biz_pkt(uint16_t id, AI_BIZ_ATTR_INFO_T *attr, AI_PACKET_PT type, AI_BIZ_HEAD_INFO_T *head,
                                  char *payload);
 
+/**
+ * @brief notify the biz thread that data of a send channel is ready
+ *
+ * @param[in] id send channel id, the channel mode should be AI_BIZ_SEND_NOTIFY
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_biz_send_notify(uint16_t id);
+
 /**
  * @brief get send id
  *
@@ -273,6 +273,28 @@ typedef struct {
     uint8_t reserve;
 } AI_PACKET_HEAD_T;
 
+typedef struct {
+    char *data;
+    uint32_t len;
+} AI_SEND_SEG_T;
+
+// stats class: 0 control packets, then video/audio/image/file/text/event
+#define AI_STATS_CLASS_NUM   (AI_PT_EVENT - AI_PT_VIDEO + 2)
+#define AI_STATS_LAT_BUCKETS 12 // bucket 0: <1ms, bucket n: [2^(n-1), 2^n) ms, last bucket: all above
+
+typedef struct {
+    uint32_t pkts;
+    uint64_t bytes;
+    uint32_t allocs;
+    uint32_t lat_hist[AI_STATS_LAT_BUCKETS];
+} AI_STATS_ITEM_T;
+
+typedef struct {
+    SYS_TIME_T start_ms;
+    AI_STATS_ITEM_T send[AI_STATS_CLASS_NUM];
+    AI_STATS_ITEM_T recv[AI_STATS_CLASS_NUM];
+} AI_PROTO_STATS_T;
+
 typedef struct {
     AI_PACKET_PT type;
     uint32_t count;
@@ -280,6 +302,8 @@ typedef struct {
 	uint32_t total_len;
     uint32_t len;
     char *data;
+    uint32_t seg_num;   // if not 0, data is gathered from segs instead of data
+    AI_SEND_SEG_T *segs;
 } AI_SEND_PACKET_T;
 
 typedef struct {
@@ -424,6 +448,8 @@ OPERATE_RET tuya_ai_basic_conn_close(AI_STATUS_CODE code);
  * @param[out] out packet data
  * @param[out] out_len packet data length
  * @param[out] out_frag packet fragment flag
+ * @note
+ * out is valid until the next read, release it by tuya_ai_basic_pkt_free
  *
  * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
  */
@@ -441,10 +467,21 @@ OPERATE_RET tuya_ai_basic_ping(void);
  *
  * @param[in] info packet info
  *
+ * @note with ENABLE_AI_SEND_QUEUE, an image/file packet which needs more than
+ * one fragment is copied to the send queue and OPRT_OK only means queued.
+ * OPRT_EXCEED_UPPER_LIMIT is returned when the queue is full, retry later.
+ *
  * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
  */
 OPERATE_RET tuya_ai_basic_pkt_send(AI_SEND_PACKET_T *info);
 
+/**
+ * @brief get the bytes of image/file data waiting in the send queue
+ *
+ * @return queued size, always 0 without ENABLE_AI_SEND_QUEUE
+ */
+uint32_t tuya_ai_basic_get_send_queue_size(void);
+
 /**
  * @brief send ai packet fragment
  *
@@ -567,6 +604,18 @@ OPERATE_RET tuya_ai_basic_image(AI_IMAGE_ATTR_T *image, char *data, uint32_t len
  */
 OPERATE_RET tuya_ai_basic_file(AI_FILE_ATTR_T *file, char *data, uint32_t len);
 
+/**
+ * @brief send stream packet gathered from segments
+ *
+ * @param[in] type packet type, support video/audio/image/file/text
+ * @param[in] attr packet attr matched with type, can be NULL except image/file
+ * @param[in] segs data segments, packed into the connection send buffer without extra copy
+ * @param[in] seg_num segments number
+ *
+ * @return OPRT_OK on success. Others on error, please refer to tuya_error_code.h
+ */
+OPERATE_RET tuya_ai_basic_sendv(AI_PACKET_PT type, void *attr, AI_SEND_SEG_T *segs, uint32_t seg_num);
+
 /**
  * @brief text packet
  *
@@ -682,10 +731,33 @@ void tuya_ai_basic_pkt_free(char *data);
 /**
  * @brief set frag flag
  *
- * @param[in] flag fragment flag
+ * @param[in] flag fragment flag, true: deliver fragments without reassembly
  * @note
  * The function should be called after the AI basic protocol is initialized.
  * @return
  */
 void tuya_ai_basic_set_frag_flag(bool flag);
+
+/**
+ * @brief get ai protocol traffic stats
+ *
+ * @param[out] stats packets, bytes, allocations and latency histogram per
+ * stream class and direction since the last reset. Send latency runs from
+ * the send call to the last byte written, recv latency from the packet head
+ * read to the payload decrypted.
+ *
+ * @return OPRT_OK on success, OPRT_NOT_SUPPORTED without ENABLE_AI_PROTO_STATS
+ */
+OPERATE_RET tuya_ai_basic_get_stats(AI_PROTO_STATS_T *stats);
+
+/**
+ * @brief reset ai protocol traffic stats
+ */
+void tuya_ai_basic_reset_stats(void);
+
+/**
+ * @brief print pkt/s, KB/s, allocs per pkt and p50/p99 latency of every
+ * stream class to the log
+ */
+void tuya_ai_basic_dump_stats(void);
 #endif
\ No newline at end of file
@@ -9,7 +9,8 @@
  * AI sessions with thread-safe operations.
  *
  * Key features include:
- * - AI session management with configurable maximum session limit
+ * - AI session management with runtime configurable maximum session limit
+ * - Hashed recv dispatch table keyed on the stream id
  * - Asynchronous task scheduling with configurable delay
  * - Thread-safe operations using mutex and event mechanisms
  * - Integration with Tuya AI client and protocol layers
@@ -44,32 +45,147 @@
 typedef struct {
     char id[AI_UUID_V4_LEN];
     AI_SESSION_CFG_T cfg;
+    volatile uint8_t send_ready[AI_MAX_SESSION_ID_NUM];
 } AI_SESSION_T;
 
+typedef struct {
+    uint16_t id;
+    uint8_t used;
+    AI_BIZ_RECV_CB cb;
+    void *usr_data;
+} AI_BIZ_RECV_SLOT_T;
+
 typedef struct {
     THREAD_HANDLE thread;
     MUTEX_HANDLE mutex;
-    AI_SESSION_T session[AI_SESSION_MAX_NUM];
+    SEM_HANDLE send_sem;
+    uint32_t session_num;
+    AI_SESSION_T *session;
+    uint16_t *sent_ids;
+    // open addressing table of recv stream id, rebuilt on session change
+    uint32_t recv_mask;
+    AI_BIZ_RECV_SLOT_T *recv_tbl;
     AI_BIZ_RECV_CB cb;
+    void *cb_usr_data;
+    AI_STREAM_TYPE frag_stream_flag;
 } AI_BASIC_BIZ_T;
 AI_BASIC_BIZ_T *ai_basic_biz;
+static uint32_t ai_session_num = AI_SESSION_MAX_NUM;
+
+static uint32_t __ai_biz_recv_hash(uint16_t id)
+{
+    return (((uint32_t)id * 2654435761u) >> 16) & ai_basic_biz->recv_mask;
+}
+
+static AI_BIZ_RECV_SLOT_T *__ai_biz_recv_lookup(uint16_t id)
+{
+    uint32_t pos = __ai_biz_recv_hash(id);
+    // table is at most half full, probe always ends on an empty slot
+    while (ai_basic_biz->recv_tbl[pos].used) {
+        if (ai_basic_biz->recv_tbl[pos].id == id) {
+            return &ai_basic_biz->recv_tbl[pos];
+        }
+        pos = (pos + 1) & ai_basic_biz->recv_mask;
+    }
+    return NULL;
+}
+
+static void __ai_biz_recv_tbl_rebuild(void)
+{
+    uint32_t idx = 0, sidx = 0, pos = 0;
+    memset(ai_basic_biz->recv_tbl, 0, (ai_basic_biz->recv_mask + 1) * sizeof(AI_BIZ_RECV_SLOT_T));
+    for (idx = 0; idx < ai_basic_biz->session_num; idx++) {
+        AI_SESSION_T *session = &ai_basic_biz->session[idx];
+        if (session->id[0] == 0) {
+            continue;
+        }
+        for (sidx = 0; sidx < session->cfg.recv_num; sidx++) {
+            AI_BIZ_RECV_DATA_T *recv = &session->cfg.recv[sidx];
+            if (NULL == recv->cb) {
+                continue;
+            }
+            // the first session owning the id wins
+            pos = __ai_biz_recv_hash(recv->id);
+            while (ai_basic_biz->recv_tbl[pos].used && (ai_basic_biz->recv_tbl[pos].id != recv->id)) {
+                pos = (pos + 1) & ai_basic_biz->recv_mask;
+            }
+            if (!ai_basic_biz->recv_tbl[pos].used) {
+                ai_basic_biz->recv_tbl[pos].used = true;
+                ai_basic_biz->recv_tbl[pos].id = recv->id;
+                ai_basic_biz->recv_tbl[pos].cb = recv->cb;
+                ai_basic_biz->recv_tbl[pos].usr_data = recv->usr_data;
+            }
+        }
+    }
+}
+
+// only called at biz init, the session table is read by tuya_ai_biz_send_notify without the mutex
+static OPERATE_RET __ai_biz_session_alloc(uint32_t num)
+{
+    uint32_t tbl_size = 1;
+    AI_SESSION_T *session = NULL;
+    uint16_t *sent_ids = NULL;
+    AI_BIZ_RECV_SLOT_T *recv_tbl = NULL;
+
+    while (tbl_size < 2 * num * AI_MAX_SESSION_ID_NUM) {
+        tbl_size <<= 1;
+    }
+    session = (AI_SESSION_T *)Malloc(num * sizeof(AI_SESSION_T));
+    sent_ids = (uint16_t *)Malloc(num * AI_MAX_SESSION_ID_NUM * sizeof(uint16_t));
+    recv_tbl = (AI_BIZ_RECV_SLOT_T *)Malloc(tbl_size * sizeof(AI_BIZ_RECV_SLOT_T));
+    if ((NULL == session) || (NULL == sent_ids) || (NULL == recv_tbl)) {
+        PR_ERR("malloc session failed");
+        if (session) {
+            Free(session);
+        }
+        if (sent_ids) {
+            Free(sent_ids);
+        }
+        if (recv_tbl) {
+            Free(recv_tbl);
+        }
+        return OPRT_MALLOC_FAILED;
+    }
+    memset(session, 0, num * sizeof(AI_SESSION_T));
+
+    ai_basic_biz->session = session;
+    ai_basic_biz->session_num = num;
+    ai_basic_biz->sent_ids = sent_ids;
+    ai_basic_biz->recv_tbl = recv_tbl;
+    ai_basic_biz->recv_mask = tbl_size - 1;
+    __ai_biz_recv_tbl_rebuild();
+    AI_PROTO_D("session num:%d, recv tbl size:%d", num, tbl_size);
+    return OPRT_OK;
+}
 
 OPERATE_RET tuya_ai_send_biz_pkt(uint16_t id, AI_BIZ_ATTR_INFO_T *attr, AI_PACKET_PT type, AI_BIZ_HEAD_INFO_T *head,
                                  char *payload)
 {
     OPERATE_RET rt = OPRT_OK;
-    uint32_t payload_len = 0;
+    void *attr_value = NULL;
+    union {
+        AI_VIDEO_HEAD_T video;
+        AI_AUDIO_HEAD_T audio;
+        AI_IMAGE_HEAD_T image;
+        AI_FILE_HEAD_T file;
+        AI_TEXT_HEAD_T text;
+    } biz_head;
+    AI_SEND_SEG_T segs[2] = {0};
+
     if (ai_basic_biz == NULL) {
         PR_ERR("ai biz is null");
         return OPRT_COM_ERROR;
     }
     AI_PROTO_D("biz len:%d", head->len);
+    memset(&biz_head, 0, sizeof(biz_head));
+    segs[0].data = (char *)&biz_head;
+    if (payload && head->len) {
+        segs[1].data = payload;
+        segs[1].len = head->len;
+    }
+
     if (type == AI_PT_VIDEO) {
-        payload_len = sizeof(AI_VIDEO_HEAD_T) + head->len;
-        char *video = Malloc(payload_len);
-        TUYA_CHECK_NULL_RETURN(video, OPRT_MALLOC_FAILED);
-        memset(video, 0, payload_len);
-        AI_VIDEO_HEAD_T *video_head = (AI_VIDEO_HEAD_T *)video;
+        AI_VIDEO_HEAD_T *video_head = &biz_head.video;
         video_head->id = UNI_HTONS(id);
         video_head->stream_flag = head->stream_flag;
         video_head->timestamp = head->value.video.timestamp;
@@ -77,21 +193,12 @@ OPERATE_RET tuya_ai_send_biz_pkt(uint16_t id, AI_BIZ_ATTR_INFO_T *attr, AI_PACKE
         UNI_HTONLL(video_head->timestamp);
         UNI_HTONLL(video_head->pts);
         video_head->length = UNI_HTONL(head->len);
-        if (payload && head->len) {
-            memcpy(video + sizeof(AI_VIDEO_HEAD_T), payload, head->len);
-        }
+        segs[0].len = sizeof(AI_VIDEO_HEAD_T);
         if (attr && (attr->flag == AI_HAS_ATTR)) {
-            rt = tuya_ai_basic_video(&(attr->value.video), video, payload_len);
-        } else {
-            rt = tuya_ai_basic_video(NULL, video, payload_len);
+            attr_value = &(attr->value.video);
         }
-        Free(video);
     } else if (type == AI_PT_AUDIO) {
-        payload_len = sizeof(AI_AUDIO_HEAD_T) + head->len;
-        char *audio = Malloc(payload_len);
-        TUYA_CHECK_NULL_RETURN(audio, OPRT_MALLOC_FAILED);
-        memset(audio, 0, payload_len);
-        AI_AUDIO_HEAD_T *audio_head = (AI_AUDIO_HEAD_T *)audio;
+        AI_AUDIO_HEAD_T *audio_head = &biz_head.audio;
         audio_head->id = UNI_HTONS(id);
         audio_head->stream_flag = head->stream_flag;
         audio_head->timestamp = head->value.audio.timestamp;
@@ -99,87 +206,100 @@ OPERATE_RET tuya_ai_send_biz_pkt(uint16_t id, AI_BIZ_ATTR_INFO_T *attr, AI_PACKE
         UNI_HTONLL(audio_head->timestamp);
         UNI_HTONLL(audio_head->pts);
         audio_head->length = UNI_HTONL(head->len);
-        if (payload && head->len) {
-            memcpy(audio + sizeof(AI_AUDIO_HEAD_T), payload, head->len);
-        }
+        segs[0].len = sizeof(AI_AUDIO_HEAD_T);
         if (attr && (attr->flag == AI_HAS_ATTR)) {
-            rt = tuya_ai_basic_audio(&(attr->value.audio), audio, payload_len);
-        } else {
-            rt = tuya_ai_basic_audio(NULL, audio, payload_len);
+            attr_value = &(attr->value.audio);
         }
-        Free(audio);
     } else if (type == AI_PT_IMAGE) {
-        payload_len = sizeof(AI_IMAGE_HEAD_T) + head->len;
-        char *image = Malloc(payload_len);
-        TUYA_CHECK_NULL_RETURN(image, OPRT_MALLOC_FAILED);
-        memset(image, 0, payload_len);
-        AI_IMAGE_HEAD_T *image_head = (AI_IMAGE_HEAD_T *)image;
+        AI_IMAGE_HEAD_T *image_head = &biz_head.image;
         image_head->id = UNI_HTONS(id);
         image_head->stream_flag = head->stream_flag;
         image_head->timestamp = head->value.image.timestamp;
         UNI_HTONLL(image_head->timestamp);
         image_head->length = UNI_HTONL(head->len);
-        if (payload && head->len) {
-            memcpy(image + sizeof(AI_IMAGE_HEAD_T), payload, head->len);
-        }
-        rt = tuya_ai_basic_image(&(attr->value.image), image, payload_len);
-        Free(image);
+        segs[0].len = sizeof(AI_IMAGE_HEAD_T);
+        attr_value = &(attr->value.image);
     } else if (type == AI_PT_FILE) {
-        payload_len = sizeof(AI_FILE_HEAD_T) + head->len;
-        char *file = Malloc(payload_len);
-        TUYA_CHECK_NULL_RETURN(file, OPRT_MALLOC_FAILED);
-        memset(file, 0, payload_len);
-        AI_FILE_HEAD_T *file_head = (AI_FILE_HEAD_T *)file;
+        AI_FILE_HEAD_T *file_head = &biz_head.file;
         file_head->id = UNI_HTONS(id);
         file_head->stream_flag = head->stream_flag;
         file_head->length = UNI_HTONL(head->len);
-        if (payload && head->len) {
-            memcpy(file + sizeof(AI_FILE_HEAD_T), payload, head->len);
-        }
-        rt = tuya_ai_basic_file(&(attr->value.file), file, payload_len);
-        Free(file);
+        segs[0].len = sizeof(AI_FILE_HEAD_T);
+        attr_value = &(attr->value.file);
     } else if (type == AI_PT_TEXT) {
-        payload_len = sizeof(AI_TEXT_HEAD_T) + head->len;
-        char *text = Malloc(payload_len);
-        TUYA_CHECK_NULL_RETURN(text, OPRT_MALLOC_FAILED);
-        memset(text, 0, payload_len);
-        AI_TEXT_HEAD_T *text_head = (AI_TEXT_HEAD_T *)text;
+        AI_TEXT_HEAD_T *text_head = &biz_head.text;
         text_head->id = UNI_HTONS(id);
         text_head->stream_flag = head->stream_flag;
         text_head->length = UNI_HTONL(head->len);
-        if (payload && head->len) {
-            memcpy(text + sizeof(AI_TEXT_HEAD_T), payload, head->len);
-        }
+        segs[0].len = sizeof(AI_TEXT_HEAD_T);
         if (attr && (attr->flag == AI_HAS_ATTR)) {
-            rt = tuya_ai_basic_text(&(attr->value.text), text, payload_len);
-        } else {
-            rt = tuya_ai_basic_text(NULL, text, payload_len);
+            attr_value = &(attr->value.text);
         }
-        Free(text);
     } else {
         PR_ERR("unknow type:%d", type);
-        rt = OPRT_COM_ERROR;
+        return OPRT_COM_ERROR;
     }
 
+    rt = tuya_ai_basic_sendv(type, attr_value, segs, 2);
     if (rt != OPRT_OK) {
         PR_ERR("send biz data failed, rt:%d", rt);
     }
     return rt;
 }
 
-static void __ai_biz_thread_cb(void *args)
+static void __ai_biz_send_stream(AI_BIZ_SEND_DATA_T *send)
 {
     OPERATE_RET rt = OPRT_OK;
+    AI_BIZ_ATTR_INFO_T attr = {0};
+    AI_BIZ_HEAD_INFO_T head = {0};
+    char *payload = NULL;
+
+    do {
+        memset(&attr, 0, sizeof(attr));
+        memset(&head, 0, sizeof(head));
+        payload = NULL;
+        rt = send->get_cb(&attr, &head, &payload);
+        if (rt != OPRT_OK) {
+            break;
+        }
+        tuya_ai_send_biz_pkt(send->id, &attr, send->type, &head, payload);
+        if (send->free_cb) {
+            send->free_cb(payload);
+        }
+        // notify stream drain all ready data in one wakeup
+    } while (send->mode == AI_BIZ_SEND_NOTIFY);
+}
+
+static uint32_t __ai_biz_get_wait_time(void)
+{
+    uint32_t idx = 0, sidx = 0;
+    for (idx = 0; idx < ai_basic_biz->session_num; idx++) {
+        if (ai_basic_biz->session[idx].id[0] != 0) {
+            AI_SESSION_T *session = &ai_basic_biz->session[idx];
+            for (sidx = 0; sidx < session->cfg.send_num; sidx++) {
+                if (session->cfg.send[sidx].get_cb && (session->cfg.send[sidx].mode == AI_BIZ_SEND_POLL)) {
+                    return AI_BIZ_TASK_DELAY;
+                }
+            }
+        }
+    }
+    return SEM_WAIT_FOREVER;
+}
+
+static void __ai_biz_thread_cb(void *args)
+{
     uint32_t idx = 0, sidx = 0, kdx = 0;
+    uint32_t wait_time = AI_BIZ_TASK_DELAY;
     while (tal_thread_get_state(ai_basic_biz->thread) == THREAD_STATE_RUNNING) {
         if (!tuya_ai_client_is_ready()) {
             tal_system_sleep(200);
             continue;
         }
+        tal_semaphore_wait(ai_basic_biz->send_sem, wait_time);
         tal_mutex_lock(ai_basic_biz->mutex);
-        uint16_t sent_ids[AI_MAX_SESSION_ID_NUM * AI_SESSION_MAX_NUM] = {0};
+        uint16_t *sent_ids = ai_basic_biz->sent_ids;
         uint32_t sent_ids_count = 0;
-        for (idx = 0; idx < AI_SESSION_MAX_NUM; idx++) {
+        for (idx = 0; idx < ai_basic_biz->session_num; idx++) {
             if (ai_basic_biz->session[idx].id[0] != 0) {
                 AI_SESSION_T *session = &ai_basic_biz->session[idx];
                 for (sidx = 0; sidx < session->cfg.send_num; sidx++) {
@@ -191,38 +311,64 @@ static void __ai_biz_thread_cb(void *args)
                             break;
                         }
                     }
-                    if (!already_sent) {
-                        sent_ids[sent_ids_count++] = send_id;
-                        AI_BIZ_SEND_DATA_T *send = &session->cfg.send[sidx];
-                        if (send->get_cb) {
-                            AI_BIZ_ATTR_INFO_T attr = {0};
-                            AI_BIZ_HEAD_INFO_T head = {0};
-                            char *payload = NULL;
-                            rt = send->get_cb(&attr, &head, &payload);
-                            if (rt != OPRT_OK) {
-                                continue;
-                            }
-                            tuya_ai_send_biz_pkt(send->id, &attr, send->type, &head, payload);
-                            if (send->free_cb) {
-                                send->free_cb(payload);
-                            }
+                    if (already_sent) {
+                        continue;
+                    }
+                    sent_ids[sent_ids_count++] = send_id;
+                    AI_BIZ_SEND_DATA_T *send = &session->cfg.send[sidx];
+                    if (NULL == send->get_cb) {
+                        continue;
+                    }
+                    if (send->mode == AI_BIZ_SEND_NOTIFY) {
+                        if (!session->send_ready[sidx]) {
+                            continue;
                         }
+                        // clear before drain, a notify during drain wakes us again
+                        session->send_ready[sidx] = false;
                     }
+                    __ai_biz_send_stream(send);
                 }
             }
         }
+        wait_time = __ai_biz_get_wait_time();
         tal_mutex_unlock(ai_basic_biz->mutex);
-        tal_system_sleep(AI_BIZ_TASK_DELAY);
     }
 
     PR_NOTICE("ai biz thread exit");
     return;
 }
 
+OPERATE_RET tuya_ai_biz_send_notify(uint16_t id)
+{
+    uint32_t idx = 0, sidx = 0;
+    uint8_t found = false;
+    if ((ai_basic_biz == NULL) || (ai_basic_biz->send_sem == NULL)) {
+        return OPRT_COM_ERROR;
+    }
+
+    // lockless, the biz thread may hold the mutex while sending
+    for (idx = 0; idx < ai_basic_biz->session_num; idx++) {
+        AI_SESSION_T *session = &ai_basic_biz->session[idx];
+        if (session->id[0] == 0) {
+            continue;
+        }
+        for (sidx = 0; sidx < session->cfg.send_num; sidx++) {
+            if (session->cfg.send[sidx].id == id) {
+                session->send_ready[sidx] = true;
+                found = true;
+            }
+        }
+    }
+    if (!found) {
+        return OPRT_NOT_FOUND;
+    }
+    return tal_semaphore_post(ai_basic_biz->send_sem);
+}
+
 static uint8_t __ai_biz_need_send_task(void)
 {
     uint32_t idx = 0, sidx = 0;
-    for (idx = 0; idx < AI_SESSION_MAX_NUM; idx++) {
+    for (idx = 0; idx < ai_basic_biz->session_num; idx++) {
         if (ai_basic_biz->session[idx].id[0] != 0) {
             AI_SESSION_T *session = &ai_basic_biz->session[idx];
             for (sidx = 0; sidx < session->cfg.send_num; sidx++) {
@@ -263,11 +409,27 @@ static void __ai_biz_deinit(void)
         if (ai_basic_biz->thread) {
             tal_thread_delete(ai_basic_biz->thread);
             ai_basic_biz->thread = NULL;
+            if (ai_basic_biz->send_sem) {
+                tal_semaphore_post(ai_basic_biz->send_sem);
+            }
         }
         if (ai_basic_biz->mutex) {
             tal_mutex_release(ai_basic_biz->mutex);
             ai_basic_biz->mutex = NULL;
         }
+        if (ai_basic_biz->send_sem) {
+            tal_semaphore_release(ai_basic_biz->send_sem);
+            ai_basic_biz->send_sem = NULL;
+        }
+        if (ai_basic_biz->session) {
+            Free(ai_basic_biz->session);
+        }
+        if (ai_basic_biz->sent_ids) {
+            Free(ai_basic_biz->sent_ids);
+        }
+        if (ai_basic_biz->recv_tbl) {
+            Free(ai_basic_biz->recv_tbl);
+        }
         Free(ai_basic_biz);
         ai_basic_biz = NULL;
     }
@@ -620,7 +782,7 @@ static OPERATE_RET __ai_biz_recv_event(AI_EVENT_ATTR_T *event, char *payload)
     AI_EVENT_TYPE type = UNI_NTOHS(head->type);
 
     tal_mutex_lock(ai_basic_biz->mutex);
-    for (idx = 0; idx < AI_SESSION_MAX_NUM; idx++) {
+    for (idx = 0; idx < ai_basic_biz->session_num; idx++) {
         if ((ai_basic_biz->session[idx].id[0] != 0) && (!strcmp(ai_basic_biz->session[idx].id, event->session_id))) {
             AI_EVENT_CB cb = ai_basic_biz->session[idx].cfg.event_cb;
             if (cb) {
@@ -635,7 +797,7 @@ static OPERATE_RET __ai_biz_recv_event(AI_EVENT_ATTR_T *event, char *payload)
     }
     tal_mutex_unlock(ai_basic_biz->mutex);
 
-    if (idx == AI_SESSION_MAX_NUM) {
+    if (idx == ai_basic_biz->session_num) {
         PR_ERR("session not found");
         return OPRT_COM_ERROR;
     }
@@ -653,15 +815,16 @@ static OPERATE_RET __ai_biz_session_destory(AI_SESSION_ID id, AI_STATUS_CODE cod
 
     PR_NOTICE("del sessoion id:%s", id);
     tal_mutex_lock(ai_basic_biz->mutex);
-    for (idx = 0; idx < AI_SESSION_MAX_NUM; idx++) {
+    for (idx = 0; idx < ai_basic_biz->session_num; idx++) {
         if (ai_basic_biz->session[idx].id[0] != 0 && !strcmp(ai_basic_biz->session[idx].id, id)) {
             memset(&ai_basic_biz->session[idx], 0, sizeof(AI_SESSION_T));
             AI_PROTO_D("del session idx:%d", idx);
+            __ai_biz_recv_tbl_rebuild();
             break;
         }
     }
     tal_mutex_unlock(ai_basic_biz->mutex);
-    if (idx == AI_SESSION_MAX_NUM) {
+    if (idx == ai_basic_biz->session_num) {
         PR_ERR("session not found");
         return OPRT_COM_ERROR;
     }
@@ -692,7 +855,7 @@ OPERATE_RET __ai_biz_recv_handle(char *data, uint32_t len, AI_FRAG_FLAG frag)
         AI_PAYLOAD_HEAD_T *head = (AI_PAYLOAD_HEAD_T *)data;
         AI_PACKET_PT type = head->type;
         AI_ATTR_FLAG attr_flag = head->attribute_flag;
-        uint32_t idx = 0, attr_len = 0;
+        uint32_t attr_len = 0;
         uint32_t offset = sizeof(AI_PAYLOAD_HEAD_T);
         ai_basic_biz->cb = NULL;
 
@@ -740,42 +903,44 @@ OPERATE_RET __ai_biz_recv_handle(char *data, uint32_t len, AI_FRAG_FLAG frag)
         AI_PROTO_D("recv data id:%d", recv_id);
 
         tal_mutex_lock(ai_basic_biz->mutex);
-        for (idx = 0; idx < AI_SESSION_MAX_NUM; idx++) {
-            if (ai_basic_biz->session[idx].id[0] != 0) {
-                AI_SESSION_T *session = &ai_basic_biz->session[idx];
-                uint32_t sidx = 0;
-                for (sidx = 0; sidx < session->cfg.recv_num; sidx++) {
-                    if (session->cfg.recv[sidx].id == recv_id) {
-                        usr_data = session->cfg.recv[sidx].usr_data;
-                        if (session->cfg.recv[sidx].cb) {
-                            cb = session->cfg.recv[sidx].cb;
-                            break;
-                        }
-                    }
-                }
-                if (cb) {
-                    break;
-                }
-            }
+        AI_BIZ_RECV_SLOT_T *slot = __ai_biz_recv_lookup(recv_id);
+        if (slot) {
+            cb = slot->cb;
+            usr_data = slot->usr_data;
         }
         tal_mutex_unlock(ai_basic_biz->mutex);
         if (cb) {
+            if (frag == AI_PACKET_FRAG_START) {
+                // stream recv mode, only part of the data is in this fragment, defer the end flag to last fragment
+                uint32_t data_offset = (payload - data) + offset;
+                biz_head.len = (len > data_offset) ? (len - data_offset) : 0;
+                ai_basic_biz->frag_stream_flag = biz_head.stream_flag;
+                if (biz_head.stream_flag == AI_STREAM_ONE) {
+                    biz_head.stream_flag = AI_STREAM_START;
+                } else if (biz_head.stream_flag == AI_STREAM_END) {
+                    biz_head.stream_flag = AI_STREAM_ING;
+                }
+            }
             AI_PROTO_D("recv data id:%d, call cb: %p", recv_id, cb);
             rt = cb(&attr_info, &biz_head, payload + offset, usr_data);
             if (rt != OPRT_OK) {
                 PR_ERR("recv data handle failed, rt:%d", rt);
             }
             ai_basic_biz->cb = cb;
-        }
-        if (idx == AI_SESSION_MAX_NUM) {
+            ai_basic_biz->cb_usr_data = usr_data;
+        } else {
             PR_ERR("session not found");
             return OPRT_COM_ERROR;
         }
     } else {
         biz_head.len = len;
         biz_head.stream_flag = AI_STREAM_ING;
+        if ((frag == AI_PACKET_FRAG_END) && ((ai_basic_biz->frag_stream_flag == AI_STREAM_ONE) ||
+                                             (ai_basic_biz->frag_stream_flag == AI_STREAM_END))) {
+            biz_head.stream_flag = AI_STREAM_END;
+        }
         if (ai_basic_biz->cb) {
-            rt = ai_basic_biz->cb(NULL, &biz_head, data, usr_data);
+            rt = ai_basic_biz->cb(NULL, &biz_head, data, ai_basic_biz->cb_usr_data);
             if (rt != OPRT_OK) {
                 PR_ERR("recv data handle failed, rt:%d", rt);
             }
@@ -792,13 +957,14 @@ static OPERATE_RET __ai_clt_close_evt(void *data)
         return OPRT_OK;
     }
     tal_mutex_lock(ai_basic_biz->mutex);
-    for (idx = 0; idx < AI_SESSION_MAX_NUM; idx++) {
+    for (idx = 0; idx < ai_basic_biz->session_num; idx++) {
         if (ai_basic_biz->session[idx].id[0] != 0) {
             PR_NOTICE("close session id:%s", ai_basic_biz->session[idx].id);
             tal_event_publish(EVENT_AI_SESSION_CLOSE, ai_basic_biz->session[idx].id);
             memset(&ai_basic_biz->session[idx], 0, sizeof(AI_SESSION_T));
         }
     }
+    __ai_biz_recv_tbl_rebuild();
     tal_mutex_unlock(ai_basic_biz->mutex);
     AI_PROTO_D("close all session success");
     return OPRT_OK;
@@ -812,6 +978,8 @@ static OPERATE_RET __ai_clt_run_evt(void *data)
         TUYA_CHECK_NULL_RETURN(ai_basic_biz, OPRT_MALLOC_FAILED);
         memset(ai_basic_biz, 0, sizeof(AI_BASIC_BIZ_T));
         TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&ai_basic_biz->mutex), EXIT);
+        TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&ai_basic_biz->send_sem, 0, 1), EXIT);
+        TUYA_CALL_ERR_GOTO(__ai_biz_session_alloc(ai_session_num), EXIT);
         tuya_ai_client_reg_cb(__ai_biz_recv_handle);
         PR_NOTICE("ai biz init success");
     }
@@ -894,11 +1062,12 @@ OPERATE_RET tuya_ai_biz_crt_session(uint32_t bizCode, AI_SESSION_CFG_T *cfg, uin
 
     tal_mutex_lock(ai_basic_biz->mutex);
     uint32_t idx = 0;
-    for (idx = 0; idx < AI_SESSION_MAX_NUM; idx++) {
+    for (idx = 0; idx < ai_basic_biz->session_num; idx++) {
         if (ai_basic_biz->session[idx].id[0] == 0) {
             memcpy(&ai_basic_biz->session[idx].cfg, cfg, sizeof(AI_SESSION_CFG_T));
             memcpy(ai_basic_biz->session[idx].id, id, strlen(id));
             AI_PROTO_D("create session idx:%d", idx);
+            __ai_biz_recv_tbl_rebuild();
             break;
         }
     }
@@ -906,8 +1075,9 @@ OPERATE_RET tuya_ai_biz_crt_session(uint32_t bizCode, AI_SESSION_CFG_T *cfg, uin
         __ai_biz_create_task();
     }
     tal_mutex_unlock(ai_basic_biz->mutex);
+    tal_semaphore_post(ai_basic_biz->send_sem);
 
-    if (idx == AI_SESSION_MAX_NUM) {
+    if (idx == ai_basic_biz->session_num) {
         PR_ERR("session num is full");
         return rt;
     }
@@ -920,6 +1090,21 @@ OPERATE_RET tuya_ai_biz_del_session(AI_SESSION_ID id, AI_STATUS_CODE code)
     return __ai_biz_session_destory(id, code, true);
 }
 
+OPERATE_RET tuya_ai_biz_set_session_num(uint32_t num)
+{
+    if (0 == num) {
+        return OPRT_INVALID_PARM;
+    }
+
+    // the table can't be swapped under the lockless notify path
+    if (ai_basic_biz) {
+        PR_ERR("session num can only be set before biz init");
+        return OPRT_COM_ERROR;
+    }
+    ai_session_num = num;
+    return OPRT_OK;
+}
+
 int tuya_ai_biz_get_send_id(void)
 {
     static int odd_number = 1;
@@ -9,13 +9,13 @@
  *
  * Key features include:
  * - Secure communication using mbedTLS cryptographic primitives
+ * - Per-connection cipher contexts and precomputed HMAC pads
  * - Configurable timeout settings (AI_DEFAULT_TIMEOUT_MS)
  * - Cloud service configuration (AI_ATOP_THING_CONFIG_INFO)
  * - Protocol buffer management (AI_ADD_PKT_LEN)
  * - Default business tag handling (AI_DEFAULT_BIZ_TAG)
  * - Socket buffer size configuration (AI_READ_SOCKET_BUF_SIZE)
  * - Integration with Tuya transporter and IoT core services
- * - Cross-platform cipher operations through cipher_wrapper
  *
  * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
  *
@@ -26,8 +26,11 @@
 #include "tuya_cloud_types.h"
 #include "tal_api.h"
 #include "tuya_transporter.h"
+#include "buffered_transporter.h"
 #include "mbedtls/hkdf.h"
 #include "mbedtls/chacha20.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/sha256.h"
 #include "mix_method.h"
 #include "tuya_iot.h"
 #include "cJSON.h"
@@ -35,7 +38,6 @@
 #include "uni_random.h"
 #include "tal_system.h"
 #include "tal_hash.h"
-#include "cipher_wrapper.h"
 #include "tal_security.h"
 #include "tal_memory.h"
 #include "tuya_ai_protocol.h"
@@ -52,6 +54,17 @@
 #ifndef AI_WRITE_SOCKET_BUF_SIZE
 #define AI_WRITE_SOCKET_BUF_SIZE 0
 #endif
+#ifndef AI_READ_AHEAD_BUF_SIZE
+#define AI_READ_AHEAD_BUF_SIZE 0
+#endif
+#ifndef AI_SEND_QUEUE_MAX_SIZE
+#define AI_SEND_QUEUE_MAX_SIZE (256 * 1024)
+#endif
+#ifndef AI_SEND_BULK_SHARE
+#define AI_SEND_BULK_SHARE 25
+#endif
+#define AI_SEND_SHARE_WINDOW_MS 1000
+#define AI_SEND_HANDOFF_MS      100
 
 /**
  *
@@ -64,6 +77,7 @@
 typedef struct {
     AI_FRAG_FLAG frag_flag;
     uint32_t offset;
+    uint32_t size;
     char *data;
 } AI_RECV_FRAG_MNG_T;
 
@@ -71,12 +85,51 @@ typedef struct {
     uint32_t offset;
 } AI_SEND_FRAG_MNG_T;
 
+typedef struct ai_send_node {
+    struct ai_send_node *next;
+    AI_SEND_PACKET_T pkt;
+    uint32_t offset;
+    SYS_TIME_T ts;
+} AI_SEND_NODE_T;
+
+typedef struct {
+    MUTEX_HANDLE mutex;
+    SEM_HANDLE sem;
+    THREAD_HANDLE thread;
+    AI_SEND_NODE_T *head;
+    AI_SEND_NODE_T *tail;
+    uint32_t size;
+    uint32_t rt_waiting;
+    uint32_t rt_bytes;
+    uint32_t bulk_bytes;
+    SYS_TIME_T share_ts;
+    uint8_t is_exit; // the send thread left its loop and no longer touches the queue
+} AI_SEND_QUEUE_T;
+
+typedef struct {
+    uint8_t ready;
+#if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL2)
+    mbedtls_chacha20_context enc;
+    mbedtls_chacha20_context dec;
+#elif (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL3)
+    TKL_SYMMETRY_HANDLE enc;
+    TKL_SYMMETRY_HANDLE dec;
+#elif (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
+    mbedtls_gcm_context enc;
+    mbedtls_gcm_context dec;
+#endif
+    // sha256 state after the ipad/opad block of the sign key
+    mbedtls_sha256_context hmac_inner;
+    mbedtls_sha256_context hmac_outer;
+} AI_CRYPT_CTX_T;
+
 typedef struct {
     AI_ATOP_CFG_INFO_T config;
     MUTEX_HANDLE mutex;
     tuya_transporter_t transporter;
     char crypt_key[AI_KEY_LEN + 1];
     char sign_key[AI_KEY_LEN + 1];
+    AI_CRYPT_CTX_T crypt_ctx; // rebuilt whenever the keys are generated
     uint16_t sequence_in;
     uint16_t sequence_out;
     char crypt_random[AI_RANDOM_LEN + 1];
@@ -90,10 +143,77 @@ typedef struct {
     AI_SEND_FRAG_MNG_T send_frag_mng[2]; // 0:image,1:file
     bool frag_flag;
     char recv_buf[AI_MAX_FRAGMENT_LENGTH + AI_ADD_PKT_LEN];
+    char send_buf[AI_MAX_FRAGMENT_LENGTH + AI_ADD_PKT_LEN];
+#if defined(ENABLE_AI_SEND_QUEUE) && (ENABLE_AI_SEND_QUEUE == 1)
+    AI_SEND_QUEUE_T send_q;
+#endif
 } AI_BASIC_PROTO_T;
 
 static AI_BASIC_PROTO_T *ai_basic_proto = NULL;
 
+#if defined(ENABLE_AI_PROTO_STATS) && (ENABLE_AI_PROTO_STATS == 1)
+static AI_PROTO_STATS_T ai_proto_stats;
+// updated by the caller, send and recv threads. Created at the first proto init, kept across reconnects
+static MUTEX_HANDLE ai_stats_mutex;
+static uint8_t ai_recv_stats_class; // only used by the recv thread
+
+static uint8_t __ai_stats_class(AI_PACKET_PT type)
+{
+    if ((type >= AI_PT_VIDEO) && (type <= AI_PT_EVENT)) {
+        return type - AI_PT_VIDEO + 1;
+    }
+    return 0;
+}
+
+static void __ai_stats_record(AI_STATS_ITEM_T *item, uint32_t len, SYS_TIME_T start)
+{
+    uint32_t cost = (uint32_t)(tal_system_get_millisecond() - start);
+    uint32_t bucket = 0;
+    while (cost && (bucket < AI_STATS_LAT_BUCKETS - 1)) {
+        cost >>= 1;
+        bucket++;
+    }
+    tal_mutex_lock(ai_stats_mutex);
+    item->pkts++;
+    item->bytes += len;
+    item->lat_hist[bucket]++;
+    tal_mutex_unlock(ai_stats_mutex);
+}
+
+static void __ai_stats_alloc(AI_STATS_ITEM_T *item, uint32_t count)
+{
+    tal_mutex_lock(ai_stats_mutex);
+    item->allocs += count;
+    tal_mutex_unlock(ai_stats_mutex);
+}
+
+#define AI_STATS_TS(ts)                    SYS_TIME_T ts = tal_system_get_millisecond()
+#define AI_STATS_SEND(type, len, ts)       __ai_stats_record(&ai_proto_stats.send[__ai_stats_class(type)], len, ts)
+#define AI_STATS_SEND_ALLOC(type)          __ai_stats_alloc(&ai_proto_stats.send[__ai_stats_class(type)], 1)
+#define AI_STATS_RECV_CLASS(type)          ai_recv_stats_class = __ai_stats_class(type)
+#define AI_STATS_RECV(len, ts)             __ai_stats_record(&ai_proto_stats.recv[ai_recv_stats_class], len, ts)
+#define AI_STATS_RECV_ALLOC()              __ai_stats_alloc(&ai_proto_stats.recv[ai_recv_stats_class], 1)
+#else
+#define AI_STATS_TS(ts)
+#define AI_STATS_SEND(type, len, ts)
+#define AI_STATS_SEND_ALLOC(type)
+#define AI_STATS_RECV_CLASS(type)
+#define AI_STATS_RECV(len, ts)
+#define AI_STATS_RECV_ALLOC()
+#endif
+#if defined(ENABLE_AI_SEND_QUEUE) && (ENABLE_AI_SEND_QUEUE == 1)
+static void __ai_send_queue_clear(void);
+static void __ai_send_queue_deinit(void);
+#endif
+
+static void __ai_basic_reset_recv_frag(void)
+{
+    if (ai_basic_proto->recv_frag_mng.data) {
+        Free(ai_basic_proto->recv_frag_mng.data);
+    }
+    memset(&ai_basic_proto->recv_frag_mng, 0, sizeof(AI_RECV_FRAG_MNG_T));
+}
+
 static void __ai_atop_cfg_free(void)
 {
     uint32_t idx = 0;
@@ -173,9 +293,83 @@ static OPERATE_RET __ai_generate_sign_key()
     return rt;
 }
 
-static char *__ai_get_sign_key(void)
+static void __ai_crypt_ctx_free(void)
+{
+    AI_CRYPT_CTX_T *ctx = &ai_basic_proto->crypt_ctx;
+    if (!ctx->ready) {
+        return;
+    }
+#if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL2)
+    mbedtls_chacha20_free(&ctx->enc);
+    mbedtls_chacha20_free(&ctx->dec);
+#elif (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL3)
+    if (ctx->enc) {
+        tal_aes_free(ctx->enc);
+    }
+    if (ctx->dec) {
+        tal_aes_free(ctx->dec);
+    }
+#elif (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
+    mbedtls_gcm_free(&ctx->enc);
+    mbedtls_gcm_free(&ctx->dec);
+#endif
+    mbedtls_sha256_free(&ctx->hmac_inner);
+    mbedtls_sha256_free(&ctx->hmac_outer);
+    memset(ctx, 0, sizeof(AI_CRYPT_CTX_T));
+}
+
+static OPERATE_RET __ai_hmac_pad_init(mbedtls_sha256_context *sha, uint8_t pad_byte)
 {
-    return ai_basic_proto->sign_key;
+    OPERATE_RET rt = OPRT_OK;
+    uint8_t pad[64];
+    uint32_t idx = 0;
+
+    memset(pad, pad_byte, sizeof(pad));
+    for (idx = 0; idx < AI_KEY_LEN; idx++) {
+        pad[idx] ^= (uint8_t)ai_basic_proto->sign_key[idx];
+    }
+    mbedtls_sha256_init(sha);
+    rt = mbedtls_sha256_starts(sha, 0);
+    if (OPRT_OK == rt) {
+        rt = mbedtls_sha256_update(sha, pad, sizeof(pad));
+    }
+    memset(pad, 0, sizeof(pad));
+    return rt;
+}
+
+// expand the key schedules once per connection instead of per packet
+static OPERATE_RET __ai_crypt_ctx_init(void)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_CRYPT_CTX_T *ctx = &ai_basic_proto->crypt_ctx;
+    uint8_t *key = (uint8_t *)__ai_get_crypt_key();
+
+    __ai_crypt_ctx_free();
+    ctx->ready = true;
+#if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL2)
+    mbedtls_chacha20_init(&ctx->enc);
+    mbedtls_chacha20_init(&ctx->dec);
+    TUYA_CALL_ERR_GOTO(mbedtls_chacha20_setkey(&ctx->enc, key), EXIT);
+    TUYA_CALL_ERR_GOTO(mbedtls_chacha20_setkey(&ctx->dec, key), EXIT);
+#elif (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL3)
+    TUYA_CALL_ERR_GOTO(tal_aes_create_init(&ctx->enc), EXIT);
+    TUYA_CALL_ERR_GOTO(tal_aes_create_init(&ctx->dec), EXIT);
+    TUYA_CALL_ERR_GOTO(tal_aes_setkey_enc(ctx->enc, key, AI_KEY_LEN * 8), EXIT);
+    TUYA_CALL_ERR_GOTO(tal_aes_setkey_dec(ctx->dec, key, AI_KEY_LEN * 8), EXIT);
+#elif (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
+    mbedtls_gcm_init(&ctx->enc);
+    mbedtls_gcm_init(&ctx->dec);
+    TUYA_CALL_ERR_GOTO(mbedtls_gcm_setkey(&ctx->enc, MBEDTLS_CIPHER_ID_AES, key, AI_KEY_LEN * 8), EXIT);
+    TUYA_CALL_ERR_GOTO(mbedtls_gcm_setkey(&ctx->dec, MBEDTLS_CIPHER_ID_AES, key, AI_KEY_LEN * 8), EXIT);
+#endif
+    TUYA_CALL_ERR_GOTO(__ai_hmac_pad_init(&ctx->hmac_inner, 0x36), EXIT);
+    TUYA_CALL_ERR_GOTO(__ai_hmac_pad_init(&ctx->hmac_outer, 0x5C), EXIT);
+    return rt;
+
+EXIT:
+    PR_ERR("ai crypt ctx init failed, rt:%d", rt);
+    __ai_crypt_ctx_free();
+    return rt;
 }
 
 static AI_PACKET_SL __ai_get_sl(AI_PACKET_PT type, uint8_t is_decrypt)
@@ -193,6 +387,10 @@ static AI_PACKET_SL __ai_get_sl(AI_PACKET_PT type, uint8_t is_decrypt)
 static void __ai_basic_proto_deinit(void)
 {
     if (ai_basic_proto) {
+#if defined(ENABLE_AI_SEND_QUEUE) && (ENABLE_AI_SEND_QUEUE == 1)
+        // the send thread writes through the transporter, stop it first
+        __ai_send_queue_deinit();
+#endif
         if (ai_basic_proto->transporter) {
             tuya_transporter_close(ai_basic_proto->transporter);
             tuya_transporter_destroy(ai_basic_proto->transporter);
@@ -201,7 +399,9 @@ static void __ai_basic_proto_deinit(void)
         if (ai_basic_proto->mutex) {
             tal_mutex_release(ai_basic_proto->mutex);
         }
+        __ai_crypt_ctx_free();
         __ai_atop_cfg_free();
+        __ai_basic_reset_recv_frag();
         if (ai_basic_proto->connection_id) {
             Free(ai_basic_proto->connection_id);
             ai_basic_proto->connection_id = NULL;
@@ -212,8 +412,10 @@ static void __ai_basic_proto_deinit(void)
     return;
 }
 
-static void __ai_basic_proto_reinit(void)
+static OPERATE_RET __ai_basic_proto_reinit(void)
 {
+    OPERATE_RET rt = OPRT_OK;
+
     tal_mutex_lock(ai_basic_proto->mutex);
     if (ai_basic_proto->transporter) {
         tuya_transporter_close(ai_basic_proto->transporter);
@@ -225,37 +427,60 @@ static void __ai_basic_proto_reinit(void)
         OS_FREE(ai_basic_proto->connection_id);
         ai_basic_proto->connection_id = NULL;
     }
-    __ai_generate_crypt_key();
-    __ai_generate_sign_key();
     ai_basic_proto->connected = FALSE;
     ai_basic_proto->sequence_in = 0;
     ai_basic_proto->sequence_out = 1;
-    memset(ai_basic_proto->recv_buf, 0, sizeof(ai_basic_proto->recv_buf));
     memset(ai_basic_proto->encrypt_iv, 0, AI_IV_LEN);
     uni_random_string(ai_basic_proto->encrypt_iv, AI_IV_LEN);
     ai_basic_proto->sl = AI_PACKET_SECURITY_LEVEL;
     memset(ai_basic_proto->decrypt_iv, 0, AI_IV_LEN);
-    memset(&ai_basic_proto->recv_frag_mng, 0, sizeof(ai_basic_proto->recv_frag_mng));
+    __ai_basic_reset_recv_frag();
+#if defined(ENABLE_AI_SEND_QUEUE) && (ENABLE_AI_SEND_QUEUE == 1)
+    __ai_send_queue_clear();
+#endif
+    // without the keys every packet above SL0 is refused, the caller must not connect
+    TUYA_CALL_ERR_GOTO(__ai_generate_crypt_key(), EXIT);
+    TUYA_CALL_ERR_GOTO(__ai_generate_sign_key(), EXIT);
+    TUYA_CALL_ERR_GOTO(__ai_crypt_ctx_init(), EXIT);
     tal_mutex_unlock(ai_basic_proto->mutex);
     PR_NOTICE("ai proto reinit success");
-    return;
+    return OPRT_OK;
+
+EXIT:
+    tal_mutex_unlock(ai_basic_proto->mutex);
+    PR_ERR("ai proto reinit failed, rt:%d", rt);
+    return rt;
 }
 
 static OPERATE_RET __ai_basic_proto_init(void)
 {
     OPERATE_RET rt = OPRT_OK;
     if (ai_basic_proto) {
-        __ai_basic_proto_reinit();
+        TUYA_CALL_ERR_RETURN(__ai_basic_proto_reinit());
     } else {
         ai_basic_proto = Malloc(sizeof(AI_BASIC_PROTO_T));
         TUYA_CHECK_NULL_RETURN(ai_basic_proto, OPRT_MALLOC_FAILED);
         memset(ai_basic_proto, 0, sizeof(AI_BASIC_PROTO_T));
         TUYA_CALL_ERR_GOTO(__ai_generate_crypt_key(), EXIT);
         TUYA_CALL_ERR_GOTO(__ai_generate_sign_key(), EXIT);
+        TUYA_CALL_ERR_GOTO(__ai_crypt_ctx_init(), EXIT);
         TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&ai_basic_proto->mutex), EXIT);
+#if defined(ENABLE_AI_SEND_QUEUE) && (ENABLE_AI_SEND_QUEUE == 1)
+        TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&ai_basic_proto->send_q.mutex), EXIT);
+        TUYA_CALL_ERR_GOTO(tal_semaphore_create_init(&ai_basic_proto->send_q.sem, 0, 1), EXIT);
+#endif
         ai_basic_proto->sequence_out = 1;
         uni_random_string(ai_basic_proto->encrypt_iv, AI_IV_LEN);
         ai_basic_proto->sl = AI_PACKET_SECURITY_LEVEL;
+#if defined(ENABLE_AI_RECV_STREAM_MODE) && (ENABLE_AI_RECV_STREAM_MODE == 1)
+        ai_basic_proto->frag_flag = true;
+#endif
+#if defined(ENABLE_AI_PROTO_STATS) && (ENABLE_AI_PROTO_STATS == 1)
+        if (NULL == ai_stats_mutex) {
+            TUYA_CALL_ERR_GOTO(tal_mutex_create_init(&ai_stats_mutex), EXIT);
+            ai_proto_stats.start_ms = tal_system_get_millisecond();
+        }
+#endif
         PR_NOTICE("ai proto init success, sl:%d", ai_basic_proto->sl);
     }
     return rt;
@@ -416,8 +641,13 @@ static uint32_t __ai_get_payload_len(char *buf)
 static OPERATE_RET __ai_packet_sign(char *buf, uint8_t *signature)
 {
     OPERATE_RET rt = OPRT_OK;
-    char *sign_key = __ai_get_sign_key();
-    TUYA_CHECK_NULL_RETURN(sign_key, OPRT_COM_ERROR);
+    AI_CRYPT_CTX_T *ctx = &ai_basic_proto->crypt_ctx;
+    mbedtls_sha256_context sha;
+    uint8_t inner[32];
+    if (!ctx->ready) {
+        PR_ERR("crypt ctx not ready");
+        return OPRT_COM_ERROR;
+    }
 
     uint32_t head_len = __ai_get_head_len(buf);
     uint32_t payload_len = __ai_get_payload_len(buf);
@@ -439,7 +669,21 @@ static OPERATE_RET __ai_packet_sign(char *buf, uint8_t *signature)
         sign_len = sizeof(sign_data);
     }
 
-    rt = tal_sha256_mac((uint8_t *)sign_key, AI_KEY_LEN, (uint8_t *)sign_data, sign_len, signature);
+    // hmac-sha256 resumed from the precomputed pad states, shared read-only by send and recv
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_clone(&sha, &ctx->hmac_inner);
+    rt = mbedtls_sha256_update(&sha, sign_data, sign_len);
+    if (OPRT_OK == rt) {
+        rt = mbedtls_sha256_finish(&sha, inner);
+    }
+    if (OPRT_OK == rt) {
+        mbedtls_sha256_clone(&sha, &ctx->hmac_outer);
+        rt = mbedtls_sha256_update(&sha, inner, sizeof(inner));
+    }
+    if (OPRT_OK == rt) {
+        rt = mbedtls_sha256_finish(&sha, signature);
+    }
+    mbedtls_sha256_free(&sha);
     if (OPRT_OK != rt) {
         PR_ERR("sign packet failed, rt:%d", rt);
     }
@@ -526,21 +770,40 @@ static int __ai_encrypt_add_pkcs(char *p, uint32_t len)
     return (len + cz);
 }
 
-static OPERATE_RET __ai_encrypt_packet(AI_PACKET_PT type, char *data, uint32_t len, char *output, uint32_t *en_len)
+// length of the plain data before the pkcs padding, a pad over one block or the data is a corrupt packet
+static OPERATE_RET __ai_decrypt_del_pkcs(char *p, uint32_t len, uint32_t *de_len)
+{
+    uint8_t cz = len ? (uint8_t)p[len - 1] : 0;
+
+    if ((0 == cz) || (cz > 16) || (cz > len)) {
+        PR_ERR("pkcs padding err:%d, len:%d", cz, len);
+        return OPRT_COM_ERROR;
+    }
+    *de_len = len - cz;
+    return OPRT_OK;
+}
+
+// encrypt in place, data must have AI_ADD_PKT_LEN bytes tailroom for padding and tag
+static OPERATE_RET __ai_encrypt_packet(AI_PACKET_PT type, char *data, uint32_t len, uint32_t *en_len)
 {
     OPERATE_RET rt = OPRT_OK;
     int data_out_len = 0;
-    char *key = __ai_get_crypt_key();
-    TUYA_CHECK_NULL_RETURN(key, OPRT_COM_ERROR);
+    AI_CRYPT_CTX_T *ctx = &ai_basic_proto->crypt_ctx;
 
     AI_PACKET_SL sl = __ai_get_sl(type, false);
+    if ((sl != AI_PACKET_SL0) && (!ctx->ready)) {
+        PR_ERR("crypt ctx not ready");
+        return OPRT_COM_ERROR;
+    }
     if (sl == AI_PACKET_SL2) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL2)
-        memcpy(output, data, len);
-        data_out_len = __ai_encrypt_add_pkcs(output, len);
+        data_out_len = __ai_encrypt_add_pkcs(data, len);
         char nonce[12] = {0};
         memcpy(nonce, ai_basic_proto->encrypt_iv, sizeof(nonce));
-        rt = mbedtls_chacha20_crypt((uint8_t *)key, (uint8_t *)nonce, 0, len, (uint8_t *)data, (uint8_t *)output);
+        rt = mbedtls_chacha20_starts(&ctx->enc, (uint8_t *)nonce, 0);
+        if (OPRT_OK == rt) {
+            rt = mbedtls_chacha20_update(&ctx->enc, len, (uint8_t *)data, (uint8_t *)data);
+        }
         if (OPRT_OK != rt) {
             PR_ERR("chacha20_crypt error:%d", rt);
             return rt;
@@ -549,10 +812,9 @@ static OPERATE_RET __ai_encrypt_packet(AI_PACKET_PT type, char *data, uint32_t l
 #endif
     } else if (sl == AI_PACKET_SL3) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL3)
-        memcpy(output, data, len);
-        data_out_len = tal_pkcs7padding_buffer((uint8_t *)output, len);
-        rt = tal_aes256_cbc_encode_raw((uint8_t *)output, data_out_len, (uint8_t *)key,
-                                       (uint8_t *)ai_basic_proto->encrypt_iv, (uint8_t *)output);
+        data_out_len = tal_pkcs7padding_buffer((uint8_t *)data, len);
+        rt = tal_aes_crypt_cbc(ctx->enc, SYMMETRY_ENCRYPT, data_out_len, (uint8_t *)ai_basic_proto->encrypt_iv,
+                               (uint8_t *)data, (uint8_t *)data);
         if (OPRT_OK != rt) {
             PR_ERR("aes128_cbc_encode error:%d", rt);
             return rt;
@@ -561,32 +823,19 @@ static OPERATE_RET __ai_encrypt_packet(AI_PACKET_PT type, char *data, uint32_t l
 #endif
     } else if (sl == AI_PACKET_SL4) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
-        uint8_t tag[AI_GCM_TAG_LEN] = {0};
-        memcpy(output, data, len);
-        data_out_len = __ai_encrypt_add_pkcs(output, len);
-
-        const cipher_params_t en_input = {
-            .cipher_type = MBEDTLS_CIPHER_AES_256_GCM,
-            .key = (unsigned char *)key,
-            .key_len = AI_KEY_LEN,
-            .nonce = (uint8_t *)ai_basic_proto->encrypt_iv,
-            .nonce_len = AI_IV_LEN,
-            .ad = NULL,
-            .ad_len = 0,
-            .data = (uint8_t *)output,
-            .data_len = data_out_len,
-        };
-        rt = mbedtls_cipher_auth_encrypt_wrapper(&en_input, (uint8_t *)output, (size_t *)en_len, tag, sizeof(tag));
+        data_out_len = __ai_encrypt_add_pkcs(data, len);
+        // tag is written right after the cipher text
+        rt = mbedtls_gcm_crypt_and_tag(&ctx->enc, MBEDTLS_GCM_ENCRYPT, data_out_len,
+                                       (uint8_t *)ai_basic_proto->encrypt_iv, AI_IV_LEN, NULL, 0, (uint8_t *)data,
+                                       (uint8_t *)data, AI_GCM_TAG_LEN, (uint8_t *)data + data_out_len);
         if (rt != OPRT_OK) {
             PR_ERR("aes128_gcm_encode error:%x", rt);
         }
-        memcpy(output + *en_len, tag, sizeof(tag));
-        *en_len += sizeof(tag);
-        // tuya_debug_hex_dump("encrypt_data", 64, (uint8_t *)output, *en_len);
+        *en_len = data_out_len + AI_GCM_TAG_LEN;
+        // tuya_debug_hex_dump("encrypt_data", 64, (uint8_t *)data, *en_len);
 #endif
     } else if (sl == AI_PACKET_SL0) {
         AI_PROTO_D("sl:%d do not need crypt", sl);
-        memcpy(output, data, len);
         *en_len = len;
     } else {
         PR_ERR("sl:%d err", sl);
@@ -596,63 +845,58 @@ static OPERATE_RET __ai_encrypt_packet(AI_PACKET_PT type, char *data, uint32_t l
     return rt;
 }
 
-static OPERATE_RET __ai_decrypt_packet(char *data, uint32_t len, char *output, uint32_t *de_len)
+// decrypt in place
+static OPERATE_RET __ai_decrypt_packet(char *data, uint32_t len, uint32_t *de_len)
 {
     OPERATE_RET rt = OPRT_OK;
-    char *key = __ai_get_crypt_key();
-    TUYA_CHECK_NULL_RETURN(key, OPRT_COM_ERROR);
+    AI_CRYPT_CTX_T *ctx = &ai_basic_proto->crypt_ctx;
 
     AI_PACKET_SL sl = __ai_get_sl(0, true);
+    if ((sl != AI_PACKET_SL0) && (!ctx->ready)) {
+        PR_ERR("crypt ctx not ready");
+        return OPRT_COM_ERROR;
+    }
     if (sl == AI_PACKET_SL2) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL2)
         char nonce[12] = {0};
         memcpy(nonce, ai_basic_proto->decrypt_iv, sizeof(nonce));
-        rt = mbedtls_chacha20_crypt((uint8_t *)key, (uint8_t *)nonce, 0, len, (uint8_t *)data, (uint8_t *)output);
+        rt = mbedtls_chacha20_starts(&ctx->dec, (uint8_t *)nonce, 0);
+        if (OPRT_OK == rt) {
+            rt = mbedtls_chacha20_update(&ctx->dec, len, (uint8_t *)data, (uint8_t *)data);
+        }
         if (OPRT_OK != rt) {
             PR_ERR("chacha20_crypt error:%d", rt);
             return rt;
         }
-        *de_len = len - output[len - 1];
+        rt = __ai_decrypt_del_pkcs(data, len, de_len);
 #endif
     } else if (sl == AI_PACKET_SL3) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL3)
-        rt = tal_aes256_cbc_decode_raw((uint8_t *)data, len, (uint8_t *)key, (uint8_t *)ai_basic_proto->decrypt_iv,
-                                       (uint8_t *)output);
+        rt = tal_aes_crypt_cbc(ctx->dec, SYMMETRY_DECRYPT, len, (uint8_t *)ai_basic_proto->decrypt_iv, (uint8_t *)data,
+                               (uint8_t *)data);
         if (OPRT_OK != rt) {
             PR_ERR("aes128_cbc_decode error:%d", rt);
             return rt;
         }
-        *de_len = len - output[len - 1];
+        rt = __ai_decrypt_del_pkcs(data, len, de_len);
 #endif
     } else if (sl == AI_PACKET_SL4) {
 #if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL4)
-        // tuya_debug_hex_dump("decrypt_data", 64, (uint8_t *)data, len - AI_GCM_TAG_LEN);
-        // tuya_debug_hex_dump("decrypt_key", 64, (uint8_t *)key, AI_KEY_LEN);
-        // tuya_debug_hex_dump("decrypt_iv", 64, (uint8_t *)ai_basic_proto->decrypt_iv, AI_IV_LEN);
-        // tuya_debug_hex_dump("decrypt_tag", 64, (uint8_t *)(data + len - AI_GCM_TAG_LEN), AI_GCM_TAG_LEN);
-        const cipher_params_t de_input = {
-            .cipher_type = MBEDTLS_CIPHER_AES_256_GCM,
-            .key = (unsigned char *)key,
-            .key_len = AI_KEY_LEN,
-            .nonce = (uint8_t *)ai_basic_proto->decrypt_iv,
-            .nonce_len = AI_IV_LEN,
-            .ad = NULL,
-            .ad_len = 0,
-            .data = (uint8_t *)data,
-            .data_len = len - AI_GCM_TAG_LEN,
-        };
-
-        rt = mbedtls_cipher_auth_decrypt_wrapper(&de_input, (uint8_t *)output, (size_t *)de_len,
-                                                 (uint8_t *)(data + len - AI_GCM_TAG_LEN), AI_GCM_TAG_LEN);
+        if (len <= AI_GCM_TAG_LEN) {
+            PR_ERR("gcm data too short:%d", len);
+            return OPRT_COM_ERROR;
+        }
+        size_t out_len = len - AI_GCM_TAG_LEN;
+        rt = mbedtls_gcm_auth_decrypt(&ctx->dec, out_len, (uint8_t *)ai_basic_proto->decrypt_iv, AI_IV_LEN, NULL, 0,
+                                      (uint8_t *)(data + out_len), AI_GCM_TAG_LEN, (uint8_t *)data, (uint8_t *)data);
         if (rt != OPRT_OK) {
             PR_ERR("aes128_gcm_decode error:%x", rt);
             return rt;
         }
-        *de_len = *de_len - output[*de_len - 1];
+        rt = __ai_decrypt_del_pkcs(data, out_len, de_len);
 #endif
     } else if (sl == AI_PACKET_SL0) {
         AI_PROTO_D("sl:%d do not need crypt ", sl);
-        memcpy(output, data, len);
         *de_len = len;
     } else {
         AI_PROTO_D("sl:%d err", sl);
@@ -662,8 +906,35 @@ static OPERATE_RET __ai_decrypt_packet(char *data, uint32_t len, char *output, u
     return rt;
 }
 
-static OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, char *payload_buf, uint32_t *payload_len,
-                                     AI_FRAG_FLAG frag, uint32_t origin_len)
+static void __ai_copy_send_data(AI_SEND_PACKET_T *info, uint32_t data_offset, char *dst, uint32_t len)
+{
+    uint32_t idx = 0, copy_len = 0;
+    AI_SEND_SEG_T *seg = NULL;
+
+    if (0 == len) {
+        return;
+    }
+    if (0 == info->seg_num) {
+        memcpy(dst, info->data + data_offset, len);
+        return;
+    }
+    for (idx = 0; (idx < info->seg_num) && (len > 0); idx++) {
+        seg = &info->segs[idx];
+        if (data_offset >= seg->len) {
+            data_offset -= seg->len;
+            continue;
+        }
+        copy_len = seg->len - data_offset;
+        copy_len = (copy_len > len) ? len : copy_len;
+        memcpy(dst, seg->data + data_offset, copy_len);
+        dst += copy_len;
+        len -= copy_len;
+        data_offset = 0;
+    }
+}
+
+static OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, char *buf, uint32_t *payload_len, AI_FRAG_FLAG frag,
+                                     uint32_t origin_len, uint32_t data_offset)
 {
     OPERATE_RET rt = OPRT_OK;
     uint32_t idx = 0, attr_len = 0, packet_len = 0;
@@ -671,10 +942,6 @@ static OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, char *payload_buf,
     TUYA_CHECK_NULL_RETURN(info, OPRT_INVALID_PARM);
     packet_len = __ai_get_send_payload_len(info, frag);
 
-    char *buf = Malloc(packet_len);
-    TUYA_CHECK_NULL_RETURN(buf, OPRT_MALLOC_FAILED);
-    memset(buf, 0, packet_len);
-
     if (tuya_ai_is_need_attr(frag)) {
         AI_PAYLOAD_HEAD_T payload_head = {0};
         payload_head.type = info->type;
@@ -714,7 +981,6 @@ static OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, char *payload_buf,
                     memcpy(buf + offset, info->attrs[idx]->value.str, attr_idx_len);
                 } else {
                     PR_ERR("unknow payload type:%d", payload_type);
-                    Free(buf);
                     return OPRT_COM_ERROR;
                 }
                 offset += attr_idx_len;
@@ -728,17 +994,15 @@ static OPERATE_RET __ai_pack_payload(AI_SEND_PACKET_T *info, char *payload_buf,
         offset += sizeof(info->len);
     }
 
-    memcpy(buf + offset, info->data, info->len);
+    __ai_copy_send_data(info, data_offset, buf + offset, info->len);
     offset += info->len;
     AI_PROTO_D("payload len:%d, offset:%d", packet_len, offset);
 
     // tuya_debug_hex_dump("payload_uncrypt", 64, (uint8_t *)buf, packet_len);
-    rt = __ai_encrypt_packet(info->type, buf, packet_len, payload_buf, payload_len);
+    rt = __ai_encrypt_packet(info->type, buf, packet_len, payload_len);
     if (OPRT_OK != rt) {
         PR_ERR("encrypt packet failed, rt:%d", rt);
     }
-
-    Free(buf);
     return rt;
 }
 
@@ -847,7 +1111,8 @@ OPERATE_RET tuya_ai_get_attr_value(char *de_buf, uint32_t *offset, AI_ATTRIBUTE_
     return rt;
 }
 
-static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag, uint32_t origin_len)
+static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag, uint32_t origin_len,
+                                     uint32_t data_offset)
 {
     OPERATE_RET rt = OPRT_OK;
     uint32_t payload_len = 0, offset = 0;
@@ -864,9 +1129,8 @@ static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
         PR_ERR("send packet too long, len: %d", uncrypt_len);
         return OPRT_COM_ERROR;
     }
-    char *send_pkt_buf = Malloc(uncrypt_len);
-    TUYA_CHECK_NULL_RETURN(send_pkt_buf, OPRT_MALLOC_FAILED);
-    memset(send_pkt_buf, 0, uncrypt_len);
+    // packet is built and encrypted in place in the connection send buffer
+    char *send_pkt_buf = ai_basic_proto->send_buf;
 
     uint32_t head_len = sizeof(AI_PACKET_HEAD_T);
     // AI_PROTO_D("head len:%d", head_len);
@@ -889,9 +1153,9 @@ static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
     uint32_t length = 0;
     offset += sizeof(length);
 
-    rt = __ai_pack_payload(info, send_pkt_buf + offset, &payload_len, frag, origin_len);
+    rt = __ai_pack_payload(info, send_pkt_buf + offset, &payload_len, frag, origin_len, data_offset);
     if (OPRT_OK != rt) {
-        goto EXIT;
+        return rt;
     }
     length = UNI_HTONL(payload_len + AI_SIGN_LEN);
 
@@ -903,7 +1167,7 @@ static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
 
     rt = __ai_packet_sign(send_pkt_buf, signature);
     if (OPRT_OK != rt) {
-        goto EXIT;
+        return rt;
     }
     offset += payload_len;
     memcpy(send_pkt_buf + offset, signature, AI_SIGN_LEN);
@@ -922,9 +1186,6 @@ static OPERATE_RET __ai_packet_write(AI_SEND_PACKET_T *info, AI_FRAG_FLAG frag,
     } else {
         rt = OPRT_OK;
     }
-
-EXIT:
-    Free(send_pkt_buf);
     return rt;
 }
 
@@ -1010,6 +1271,7 @@ OPERATE_RET tuya_ai_basic_pkt_frag_send(AI_SEND_PACKET_T *info)
 {
     OPERATE_RET rt = OPRT_OK;
     AI_FRAG_FLAG frag_flag = AI_PACKET_NO_FRAG;
+    AI_STATS_TS(ts);
     if (!ai_basic_proto) {
         tuya_ai_free_attrs(info);
         __ai_basic_reset_send_frag(info->type);
@@ -1027,21 +1289,283 @@ OPERATE_RET tuya_ai_basic_pkt_frag_send(AI_SEND_PACKET_T *info)
     }
 
     __ai_basic_get_send_frag(info->type, info->len, info->total_len, &frag_flag);
-    rt = __ai_packet_write(info, frag_flag, info->total_len);
+    rt = __ai_packet_write(info, frag_flag, info->total_len, 0);
+    if (OPRT_OK == rt) {
+        AI_STATS_SEND(info->type, info->len, ts);
+    }
 
     tuya_ai_free_attrs(info);
     tal_mutex_unlock(ai_basic_proto->mutex);
     return rt;
 }
 
-OPERATE_RET tuya_ai_basic_pkt_send(AI_SEND_PACKET_T *info)
+static OPERATE_RET __ai_packet_write_frag(AI_SEND_PACKET_T *info, uint32_t origin_len, uint32_t *offset)
 {
     OPERATE_RET rt = OPRT_OK;
-    uint32_t offset = 0, frag_len = 0, attr_len = 0;
-    uint32_t one_packet_len = 0;
+    uint32_t frag_len = 0, one_packet_len = 0;
     uint32_t min_pkt_len = sizeof(AI_PACKET_HEAD_T) + (2 * AI_ADD_PKT_LEN); // AI_SIGN_LEN + AI_IV_LEN + AI_ADD_PKT_LEN
+
+    if (*offset == 0) {
+        one_packet_len = AI_MAX_FRAGMENT_LENGTH - min_pkt_len - __ai_get_send_attr_len(info);
+    } else {
+        one_packet_len = AI_MAX_FRAGMENT_LENGTH - min_pkt_len;
+    }
+    frag_len = (origin_len - *offset) > one_packet_len ? one_packet_len : (origin_len - *offset);
+    info->len = frag_len;
+    AI_PROTO_D("offset:%d, frag_len:%d, %d", *offset, frag_len, origin_len);
+    if (*offset == 0) {
+        rt = __ai_packet_write(info, AI_PACKET_FRAG_START, origin_len, *offset);
+    } else if ((*offset + frag_len) == origin_len) {
+        rt = __ai_packet_write(info, AI_PACKET_FRAG_END, origin_len, *offset);
+    } else {
+        rt = __ai_packet_write(info, AI_PACKET_FRAG_ING, origin_len, *offset);
+    }
+    info->len = origin_len;
+    if (OPRT_OK == rt) {
+        *offset += frag_len;
+    }
+    return rt;
+}
+
+#if defined(ENABLE_AI_SEND_QUEUE) && (ENABLE_AI_SEND_QUEUE == 1)
+static uint8_t __ai_is_bulk_pkt(AI_PACKET_PT type)
+{
+    return ((AI_PT_IMAGE == type) || (AI_PT_FILE == type));
+}
+
+static void __ai_send_queue_clear(void)
+{
+    AI_SEND_QUEUE_T *q = &ai_basic_proto->send_q;
+    AI_SEND_NODE_T *node = NULL;
+
+    tal_mutex_lock(q->mutex);
+    while (q->head) {
+        node = q->head;
+        q->head = node->next;
+        PR_NOTICE("drop queued pkt type:%d, sent:%d/%d", node->pkt.type, node->offset, node->pkt.len);
+        tuya_ai_free_attrs(&node->pkt);
+        Free(node);
+    }
+    q->tail = NULL;
+    q->size = 0;
+    tal_mutex_unlock(q->mutex);
+}
+
+static void __ai_send_queue_deinit(void)
+{
+    AI_SEND_QUEUE_T *q = &ai_basic_proto->send_q;
+    uint8_t is_exit = false;
+
+    if (q->thread) {
+        tal_thread_delete(q->thread);
+        tal_semaphore_post(q->sem);
+        // the thread may be in the middle of a fragment, wait until it is out of its loop
+        while (!is_exit) {
+            tal_mutex_lock(q->mutex);
+            is_exit = q->is_exit;
+            tal_mutex_unlock(q->mutex);
+            if (!is_exit) {
+                tal_system_sleep(10);
+            }
+        }
+        q->thread = NULL;
+    }
+    if (q->mutex) {
+        __ai_send_queue_clear();
+        tal_mutex_release(q->mutex);
+        q->mutex = NULL;
+    }
+    if (q->sem) {
+        tal_semaphore_release(q->sem);
+        q->sem = NULL;
+    }
+}
+
+static void __ai_send_rt_enter(void)
+{
+    tal_mutex_lock(ai_basic_proto->send_q.mutex);
+    ai_basic_proto->send_q.rt_waiting++;
+    tal_mutex_unlock(ai_basic_proto->send_q.mutex);
+}
+
+// called with the proto mutex held
+static void __ai_send_rt_exit(uint32_t len)
+{
+    tal_mutex_lock(ai_basic_proto->send_q.mutex);
+    ai_basic_proto->send_q.rt_waiting--;
+    ai_basic_proto->send_q.rt_bytes += len;
+    tal_mutex_unlock(ai_basic_proto->send_q.mutex);
+    // a throttled bulk upload may go on once no real-time sender is waiting
+    tal_semaphore_post(ai_basic_proto->send_q.sem);
+}
+
+// returns how long bulk data has to wait for its share, 0 if it may be sent now
+static uint32_t __ai_send_bulk_wait(void)
+{
+    AI_SEND_QUEUE_T *q = &ai_basic_proto->send_q;
+    uint32_t wait_ms = 0;
+    SYS_TIME_T now = tal_system_get_millisecond();
+
+    tal_mutex_lock(q->mutex);
+    if ((now - q->share_ts) >= AI_SEND_SHARE_WINDOW_MS) {
+        q->share_ts = now;
+        q->rt_bytes = 0;
+        q->bulk_bytes = 0;
+    }
+    // real-time senders go first, bulk keeps its share of the window so it never starves
+    if (q->rt_waiting &&
+        ((uint64_t)q->bulk_bytes * 100) >= ((uint64_t)AI_SEND_BULK_SHARE * (q->rt_bytes + q->bulk_bytes))) {
+        wait_ms = AI_SEND_SHARE_WINDOW_MS - (uint32_t)(now - q->share_ts);
+    }
+    tal_mutex_unlock(q->mutex);
+    return wait_ms;
+}
+
+static void __ai_send_thread_cb(void *args)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_SEND_QUEUE_T *q = &ai_basic_proto->send_q;
+    AI_SEND_NODE_T *node = NULL;
+    uint32_t offset = 0, wait_ms = 0, rt_waiting = 0;
+
+    while (tal_thread_get_state(q->thread) == THREAD_STATE_RUNNING) {
+        tal_mutex_lock(q->mutex);
+        node = q->head;
+        tal_mutex_unlock(q->mutex);
+        if (NULL == node) {
+            tal_semaphore_wait(q->sem, SEM_WAIT_FOREVER);
+            continue;
+        }
+        wait_ms = __ai_send_bulk_wait();
+        if (wait_ms) {
+            // woken early when the real-time senders are done
+            tal_semaphore_wait(q->sem, wait_ms);
+            continue;
+        }
+        // one fragment per lock, so audio/control packets can be written in between. The
+        // queue is only cleared under the proto mutex, so the head stays valid while it is held
+        tal_mutex_lock(ai_basic_proto->mutex);
+        tal_mutex_lock(q->mutex);
+        node = q->head;
+        tal_mutex_unlock(q->mutex);
+        if (NULL == node) {
+            tal_mutex_unlock(ai_basic_proto->mutex);
+            continue;
+        }
+        offset = node->offset;
+        if (ai_basic_proto->connected) {
+            rt = __ai_packet_write_frag(&node->pkt, node->pkt.len, &node->offset);
+        } else {
+            rt = OPRT_COM_ERROR;
+        }
+        tal_mutex_lock(q->mutex);
+        q->bulk_bytes += node->offset - offset;
+        rt_waiting = q->rt_waiting;
+        if ((OPRT_OK != rt) || (node->offset >= node->pkt.len)) {
+            if (OPRT_OK != rt) {
+                PR_ERR("send queued pkt failed, rt:%d, type:%d", rt, node->pkt.type);
+            } else {
+                AI_STATS_SEND(node->pkt.type, node->pkt.len, node->ts);
+            }
+            q->head = node->next;
+            if (NULL == q->head) {
+                q->tail = NULL;
+            }
+            q->size -= node->pkt.len;
+            tuya_ai_free_attrs(&node->pkt);
+            Free(node);
+        }
+        tal_mutex_unlock(q->mutex);
+        tal_mutex_unlock(ai_basic_proto->mutex);
+        if (rt_waiting) {
+            // the mutex is not handed over on unlock, wait until the real-time sender has taken it
+            tal_semaphore_wait(q->sem, AI_SEND_HANDOFF_MS);
+        }
+    }
+    PR_NOTICE("ai send thread exit");
+    tal_mutex_lock(q->mutex);
+    q->is_exit = true;
+    tal_mutex_unlock(q->mutex);
+}
+
+// called with the proto mutex held, attrs of info are owned by the queue on success
+static OPERATE_RET __ai_send_queue_push(AI_SEND_PACKET_T *info)
+{
+    OPERATE_RET rt = OPRT_OK;
+    AI_SEND_QUEUE_T *q = &ai_basic_proto->send_q;
+    AI_SEND_NODE_T *node = NULL;
+
+    if (NULL == q->thread) {
+        THREAD_CFG_T thrd_param = {0};
+        thrd_param.priority = THREAD_PRIO_2;
+        thrd_param.thrdname = "ai_send_thread";
+        thrd_param.stackDepth = 4096;
+#if defined(AI_STACK_IN_PSRAM) && (AI_STACK_IN_PSRAM == 1)
+        thrd_param.psram_mode = 1;
+#endif
+        rt = tal_thread_create_and_start(&q->thread, NULL, NULL, __ai_send_thread_cb, NULL, &thrd_param);
+        if (OPRT_OK != rt) {
+            PR_ERR("ai send thread create err, rt:%d", rt);
+            return rt;
+        }
+    }
+
+    tal_mutex_lock(q->mutex);
+    if ((q->size + info->len) > AI_SEND_QUEUE_MAX_SIZE) {
+        tal_mutex_unlock(q->mutex);
+        PR_WARN("ai send queue full, size:%d, len:%d", q->size, info->len);
+        return OPRT_EXCEED_UPPER_LIMIT;
+    }
+    tal_mutex_unlock(q->mutex);
+
+    node = (AI_SEND_NODE_T *)OS_MALLOC(sizeof(AI_SEND_NODE_T) + info->len);
+    TUYA_CHECK_NULL_RETURN(node, OPRT_MALLOC_FAILED);
+    memset(node, 0, sizeof(AI_SEND_NODE_T));
+    memcpy(&node->pkt, info, sizeof(AI_SEND_PACKET_T));
+    node->ts = tal_system_get_millisecond();
+    AI_STATS_SEND_ALLOC(info->type);
+    node->pkt.data = (char *)(node + 1);
+    node->pkt.seg_num = 0;
+    node->pkt.segs = NULL;
+    __ai_copy_send_data(info, 0, node->pkt.data, info->len);
+
+    tal_mutex_lock(q->mutex);
+    if (q->tail) {
+        q->tail->next = node;
+    } else {
+        q->head = node;
+    }
+    q->tail = node;
+    q->size += info->len;
+    tal_mutex_unlock(q->mutex);
+    tal_semaphore_post(q->sem);
+    AI_PROTO_D("queue pkt type:%d, len:%d", info->type, info->len);
+    return OPRT_OK;
+}
+
+uint32_t tuya_ai_basic_get_send_queue_size(void)
+{
+    uint32_t size = 0;
+    if (ai_basic_proto) {
+        tal_mutex_lock(ai_basic_proto->send_q.mutex);
+        size = ai_basic_proto->send_q.size;
+        tal_mutex_unlock(ai_basic_proto->send_q.mutex);
+    }
+    return size;
+}
+#else
+uint32_t tuya_ai_basic_get_send_queue_size(void)
+{
+    return 0;
+}
+#endif
+
+OPERATE_RET tuya_ai_basic_pkt_send(AI_SEND_PACKET_T *info)
+{
+    OPERATE_RET rt = OPRT_OK;
+    uint32_t offset = 0;
     uint32_t origin_len = info->len;
-    char *origin_data = info->data;
+    AI_STATS_TS(ts);
     // AI_PROTO_D("send payload len:%d", payload_len);
 
     if (!ai_basic_proto) {
@@ -1050,7 +1574,23 @@ OPERATE_RET tuya_ai_basic_pkt_send(AI_SEND_PACKET_T *info)
         return OPRT_COM_ERROR;
     }
 
+    uint32_t send_pkt_len = __ai_get_send_pkt_len(info, AI_PACKET_NO_FRAG);
+#if defined(ENABLE_AI_PROTO_STATS) && (ENABLE_AI_PROTO_STATS == 1)
+    // every attribute of the packet was malloced by tuya_ai_create_attribute
+    __ai_stats_alloc(&ai_proto_stats.send[__ai_stats_class(info->type)], info->count);
+#endif
+#if defined(ENABLE_AI_SEND_QUEUE) && (ENABLE_AI_SEND_QUEUE == 1)
+    uint8_t queued = (send_pkt_len > AI_MAX_FRAGMENT_LENGTH) && __ai_is_bulk_pkt(info->type);
+    if (!queued) {
+        __ai_send_rt_enter();
+    }
+#endif
     tal_mutex_lock(ai_basic_proto->mutex);
+#if defined(ENABLE_AI_SEND_QUEUE) && (ENABLE_AI_SEND_QUEUE == 1)
+    if (!queued) {
+        __ai_send_rt_exit(send_pkt_len);
+    }
+#endif
     if (!ai_basic_proto->connected) {
         tuya_ai_free_attrs(info);
         tal_mutex_unlock(ai_basic_proto->mutex);
@@ -1058,36 +1598,31 @@ OPERATE_RET tuya_ai_basic_pkt_send(AI_SEND_PACKET_T *info)
         return OPRT_COM_ERROR;
     }
 
-    uint32_t send_pkt_len = __ai_get_send_pkt_len(info, AI_PACKET_NO_FRAG);
+#if defined(ENABLE_AI_SEND_QUEUE) && (ENABLE_AI_SEND_QUEUE == 1)
+    if (queued) {
+        // multi-fragment image/file is sent by the send thread
+        rt = __ai_send_queue_push(info);
+        if (OPRT_OK != rt) {
+            tuya_ai_free_attrs(info);
+        }
+        tal_mutex_unlock(ai_basic_proto->mutex);
+        return rt;
+    }
+#endif
+
     if (send_pkt_len <= AI_MAX_FRAGMENT_LENGTH) {
-        rt = __ai_packet_write(info, AI_PACKET_NO_FRAG, origin_len);
+        rt = __ai_packet_write(info, AI_PACKET_NO_FRAG, origin_len, 0);
     } else {
         while (offset < origin_len) {
-            if (offset == 0) {
-                attr_len = __ai_get_send_attr_len(info);
-                one_packet_len = AI_MAX_FRAGMENT_LENGTH - min_pkt_len - attr_len;
-            } else {
-                one_packet_len = AI_MAX_FRAGMENT_LENGTH - min_pkt_len;
-            }
-            frag_len = (origin_len - offset) > one_packet_len ? one_packet_len : (origin_len - offset);
-            info->data = origin_data + offset;
-            info->len = frag_len;
-            AI_PROTO_D("offset:%d, frag_len:%d, %d", offset, frag_len, origin_len);
-            if (offset == 0) {
-                rt = __ai_packet_write(info, AI_PACKET_FRAG_START, origin_len);
-            } else if ((offset + frag_len) == origin_len) {
-                rt = __ai_packet_write(info, AI_PACKET_FRAG_END, origin_len);
-            } else {
-                rt = __ai_packet_write(info, AI_PACKET_FRAG_ING, origin_len);
-            }
+            rt = __ai_packet_write_frag(info, origin_len, &offset);
             if (OPRT_OK != rt) {
                 AI_PROTO_D("send fragment failed, rt:%d", rt);
                 break;
             }
-            offset += frag_len;
         }
-        info->data = origin_data;
-        info->len = origin_len;
+    }
+    if (OPRT_OK == rt) {
+        AI_STATS_SEND(info->type, origin_len, ts);
     }
     tuya_ai_free_attrs(info);
 
@@ -1426,8 +1961,18 @@ static int __ai_baisc_read_pkt_head(char *recv_buf)
     return offset;
 }
 
+static bool __ai_is_recv_buf(char *data)
+{
+    return ((data >= ai_basic_proto->recv_buf) &&
+            (data < ai_basic_proto->recv_buf + sizeof(ai_basic_proto->recv_buf)));
+}
+
 void tuya_ai_basic_pkt_free(char *data)
 {
+    if ((NULL == data) || __ai_is_recv_buf(data)) {
+        // packet was decrypted in place, nothing to free
+        return;
+    }
     if (data == ai_basic_proto->recv_frag_mng.data) {
         Free(data);
         ai_basic_proto->recv_frag_mng.data = NULL;
@@ -1450,21 +1995,22 @@ static bool __ai_basic_get_frag_flag(void)
 {
     return ai_basic_proto->frag_flag;
 }
-OPERATE_RET tuya_ai_basic_pkt_read(char **out, uint32_t *out_len, AI_FRAG_FLAG *out_frag)
+
+/**
+ * read one packet from transporter, verify and decrypt it in place in recv_buf
+ */
+static OPERATE_RET __ai_basic_pkt_read_one(char **out, uint32_t *out_len, AI_FRAG_FLAG *out_frag)
 {
     OPERATE_RET rt = OPRT_OK;
     uint8_t calc_sign[AI_SIGN_LEN] = {0};
-    uint8_t packet_sign[AI_SIGN_LEN] = {0};
-    char *decrypt_buf = NULL;
     char *recv_buf = ai_basic_proto->recv_buf;
-    TUYA_CHECK_NULL_RETURN(recv_buf, OPRT_COM_ERROR);
 
-    memset(recv_buf, 0, sizeof(ai_basic_proto->recv_buf));
     AI_PROTO_D("recv packet ing");
     int recv_len = __ai_baisc_read_pkt_head(recv_buf);
     if (recv_len <= 0) {
-        goto EXIT;
+        return recv_len;
     }
+    AI_STATS_TS(ts);
 
     AI_PACKET_HEAD_T *head = (AI_PACKET_HEAD_T *)recv_buf;
     AI_PROTO_D("recv packet ver:%d", head->version);
@@ -1481,14 +2027,13 @@ OPERATE_RET tuya_ai_basic_pkt_read(char **out, uint32_t *out_len, AI_FRAG_FLAG *
 
     if (packet_len + head_len > sizeof(ai_basic_proto->recv_buf)) {
         PR_ERR("recv packet too long, pkt len:%u, head len:%u", packet_len, head_len);
-        recv_len = OPRT_RESOURCE_NOT_READY;
-        goto EXIT;
+        return OPRT_RESOURCE_NOT_READY;
     }
 
     uint16_t sequence = UNI_NTOHS(head->sequence);
     if (sequence <= ai_basic_proto->sequence_in) {
         PR_ERR("sequence error, in:%d, pre:%d", sequence, ai_basic_proto->sequence_in);
-        goto EXIT;
+        return OPRT_COM_ERROR;
     }
 
     ai_basic_proto->sequence_in = sequence;
@@ -1507,7 +2052,7 @@ OPERATE_RET tuya_ai_basic_pkt_read(char **out, uint32_t *out_len, AI_FRAG_FLAG *
                 continue;
             }
             PR_ERR("continue read failed, rt:%d, %d", recv_len, continue_recv_len);
-            goto EXIT;
+            return OPRT_COM_ERROR;
         }
         offset += recv_len;
     }
@@ -1515,130 +2060,145 @@ OPERATE_RET tuya_ai_basic_pkt_read(char **out, uint32_t *out_len, AI_FRAG_FLAG *
     rt = __ai_packet_sign(recv_buf, calc_sign);
     if (OPRT_OK != rt) {
         PR_ERR("packet sign failed, rt:%d", rt);
-        goto EXIT;
+        return rt;
     }
 
     AI_PROTO_D("sign ok");
     uint32_t payload_len = __ai_get_payload_len(recv_buf);
     char *payload = recv_buf + head_len;
-    memcpy(packet_sign, payload + payload_len, AI_SIGN_LEN);
-    if (memcmp(calc_sign, packet_sign, sizeof(calc_sign))) {
+    if (memcmp(calc_sign, payload + payload_len, sizeof(calc_sign))) {
         PR_ERR("packet sign error");
-        // tuya_debug_hex_dump("calc_sign", AI_SIGN_LEN, calc_sign, AI_SIGN_LEN);
-        // tuya_debug_hex_dump("packet_sign", AI_SIGN_LEN, packet_sign, AI_SIGN_LEN);
-        recv_len = OPRT_RESOURCE_NOT_READY;
-        goto EXIT;
+        return OPRT_RESOURCE_NOT_READY;
     }
 
     uint32_t decrypt_len = 0;
-    decrypt_buf = Malloc(packet_len + head_len + AI_ADD_PKT_LEN);
-    TUYA_CHECK_NULL_RETURN(decrypt_buf, OPRT_MALLOC_FAILED);
-    memset(decrypt_buf, 0, packet_len + head_len + AI_ADD_PKT_LEN);
-    rt = __ai_decrypt_packet(payload, payload_len, decrypt_buf, &decrypt_len);
+    rt = __ai_decrypt_packet(payload, payload_len, &decrypt_len);
     if (OPRT_OK != rt) {
         PR_ERR("decrypt packet failed, rt:%d", rt);
-        goto EXIT;
+        return rt;
     }
     AI_PROTO_D("decrypt len:%d", decrypt_len);
-    AI_PROTO_D("frag flag:%d, sdk frag flag:%d", head->frag_flag, __ai_basic_get_frag_flag());
+    // padding and signature follow the plain data, terminate it for string payloads
+    payload[decrypt_len] = 0;
+    if ((head->frag_flag == AI_PACKET_NO_FRAG) || (head->frag_flag == AI_PACKET_FRAG_START)) {
+        AI_STATS_RECV_CLASS(((AI_PAYLOAD_HEAD_T *)payload)->type);
+    }
+    AI_STATS_RECV(decrypt_len, ts);
+
+    *out = payload;
+    *out_len = decrypt_len;
+    *out_frag = head->frag_flag;
+    return OPRT_OK;
+}
+
+static uint32_t __ai_get_frag_origin_len(char *data, uint32_t *frag_offset)
+{
+    uint32_t origin_len = 0, attr_len = 0;
+    AI_PAYLOAD_HEAD_T *pkt_head = (AI_PAYLOAD_HEAD_T *)data;
 
-    if (!__ai_basic_get_frag_flag()) {
-        AI_FRAG_FLAG current_frag_flag = head->frag_flag;
-        AI_FRAG_FLAG last_frag_flag = ai_basic_proto->recv_frag_mng.frag_flag;
+    *frag_offset = sizeof(AI_PAYLOAD_HEAD_T);
+    if (pkt_head->attribute_flag == AI_HAS_ATTR) {
+        memcpy(&attr_len, data + *frag_offset, sizeof(attr_len));
+        *frag_offset += sizeof(attr_len);
+        attr_len = UNI_NTOHL(attr_len);
+        *frag_offset += attr_len;
+    }
+    memcpy(&origin_len, data + *frag_offset, sizeof(origin_len));
+    origin_len = UNI_NTOHL(origin_len);
+    AI_PROTO_D("recv start frag packet, attr flag:%d, origin len:%d", pkt_head->attribute_flag, origin_len);
+    return origin_len;
+}
+
+OPERATE_RET tuya_ai_basic_pkt_read(char **out, uint32_t *out_len, AI_FRAG_FLAG *out_frag)
+{
+    OPERATE_RET rt = OPRT_OK;
+    char *de_buf = NULL;
+    uint32_t de_len = 0;
+    AI_FRAG_FLAG current_frag_flag = AI_PACKET_NO_FRAG;
+    AI_RECV_FRAG_MNG_T *frag_mng = &ai_basic_proto->recv_frag_mng;
+
+    *out = NULL;
+    while (1) {
+        de_buf = NULL;
+        rt = __ai_basic_pkt_read_one(&de_buf, &de_len, &current_frag_flag);
+        if ((OPRT_OK != rt) || (NULL == de_buf)) {
+            break;
+        }
+        AI_PROTO_D("frag flag:%d, sdk frag flag:%d", current_frag_flag, __ai_basic_get_frag_flag());
+
+        if (__ai_basic_get_frag_flag()) {
+            // stream mode, fragments are delivered as they arrive from recv_buf
+            *out = de_buf;
+            *out_len = de_len;
+            *out_frag = current_frag_flag;
+            AI_PROTO_D("recv packet len:%d", *out_len);
+            return OPRT_OK;
+        }
+
+        AI_FRAG_FLAG last_frag_flag = frag_mng->frag_flag;
         if ((last_frag_flag == AI_PACKET_FRAG_START) || (last_frag_flag == AI_PACKET_FRAG_ING)) {
             if ((current_frag_flag != AI_PACKET_FRAG_ING) && (current_frag_flag != AI_PACKET_FRAG_END)) {
                 PR_ERR("recv start frag packet, but not continue %d, %d", current_frag_flag, last_frag_flag);
-                goto EXIT;
+                rt = OPRT_COM_ERROR;
+                break;
             }
+        } else if ((current_frag_flag == AI_PACKET_FRAG_ING) || (current_frag_flag == AI_PACKET_FRAG_END)) {
+            PR_ERR("recv continue frag packet without start %d", current_frag_flag);
+            rt = OPRT_COM_ERROR;
+            break;
+        }
+
+        AI_PROTO_D("frag mng info, flag:%d, offset:%d", frag_mng->frag_flag, frag_mng->offset);
+        if (current_frag_flag == AI_PACKET_NO_FRAG) {
+            *out = de_buf;
+            *out_len = de_len;
+            *out_frag = AI_PACKET_NO_FRAG;
+            AI_PROTO_D("recv packet len:%d", *out_len);
+            return OPRT_OK;
         }
 
-        AI_PROTO_D("frag flag:%d", head->frag_flag);
-        AI_PROTO_D("frag mng info, flag:%d, offset:%d", ai_basic_proto->recv_frag_mng.frag_flag,
-                   ai_basic_proto->recv_frag_mng.offset);
         if (current_frag_flag == AI_PACKET_FRAG_START) {
-            uint32_t origin_len = 0, frag_offset = 0, attr_len = 0, frag_total_len = 0;
-            AI_PAYLOAD_HEAD_T *pkt_head = (AI_PAYLOAD_HEAD_T *)decrypt_buf;
-            if (pkt_head->attribute_flag == AI_HAS_ATTR) {
-                frag_offset = sizeof(AI_PAYLOAD_HEAD_T);
-                memcpy(&attr_len, decrypt_buf + frag_offset, sizeof(attr_len));
-                frag_offset += sizeof(attr_len);
-                attr_len = UNI_NTOHL(attr_len);
-                frag_offset += attr_len;
-                memcpy(&origin_len, decrypt_buf + frag_offset, sizeof(origin_len));
-                origin_len = UNI_NTOHL(origin_len);
-                AI_PROTO_D("recv start frag packet with attr, origin len:%d", origin_len);
-            } else {
-                memcpy(&origin_len, decrypt_buf + sizeof(AI_PAYLOAD_HEAD_T), sizeof(origin_len));
-                origin_len = UNI_NTOHL(origin_len);
-                AI_PROTO_D("recv start frag packet, origin len:%d", origin_len);
-            }
-            if (origin_len <= decrypt_len) {
-                PR_ERR("origin len error, origin len:%d, decrypt len:%d", origin_len, decrypt_len);
-                goto EXIT;
+            uint32_t frag_offset = 0, frag_total_len = 0;
+            uint32_t origin_len = __ai_get_frag_origin_len(de_buf, &frag_offset);
+            if (origin_len <= de_len) {
+                PR_ERR("origin len error, origin len:%d, decrypt len:%d", origin_len, de_len);
+                rt = OPRT_COM_ERROR;
+                break;
             }
-            memset(&ai_basic_proto->recv_frag_mng, 0, sizeof(AI_RECV_FRAG_MNG_T));
-            ai_basic_proto->recv_frag_mng.frag_flag = current_frag_flag;
+            __ai_basic_reset_recv_frag();
             frag_total_len = origin_len + frag_offset + AI_ADD_PKT_LEN;
             AI_PROTO_D("frag_total_len %d", frag_total_len);
-            ai_basic_proto->recv_frag_mng.data = Malloc(frag_total_len);
-            if (!ai_basic_proto->recv_frag_mng.data) {
-                PR_ERR("malloc origin data failed len:%d", decrypt_len);
-                goto EXIT;
-            }
-            AI_PROTO_D("malloc recv_frag_mng data addr %p", ai_basic_proto->recv_frag_mng.data);
-            memset(ai_basic_proto->recv_frag_mng.data, 0, frag_total_len);
-            memcpy(ai_basic_proto->recv_frag_mng.data, decrypt_buf, decrypt_len);
-            ai_basic_proto->recv_frag_mng.offset = decrypt_len;
-            Free(decrypt_buf);
-            decrypt_buf = NULL;
-            rt = tuya_ai_basic_pkt_read(out, out_len, out_frag);
-            if (rt != OPRT_OK) {
-                PR_ERR("read continue frag packet failed, rt:%d", rt);
-                goto EXIT;
-            }
-        } else if (current_frag_flag == AI_PACKET_FRAG_ING) {
-            memcpy(ai_basic_proto->recv_frag_mng.data + ai_basic_proto->recv_frag_mng.offset, decrypt_buf, decrypt_len);
-            ai_basic_proto->recv_frag_mng.frag_flag = current_frag_flag;
-            ai_basic_proto->recv_frag_mng.offset += decrypt_len;
-            Free(decrypt_buf);
-            decrypt_buf = NULL;
-            rt = tuya_ai_basic_pkt_read(out, out_len, out_frag);
-            if (rt != OPRT_OK) {
-                PR_ERR("read continue ing frag packet failed, rt:%d", rt);
-                goto EXIT;
+            frag_mng->data = Malloc(frag_total_len);
+            AI_STATS_RECV_ALLOC();
+            if (!frag_mng->data) {
+                PR_ERR("malloc origin data failed len:%d", frag_total_len);
+                rt = OPRT_MALLOC_FAILED;
+                break;
             }
-        } else if (current_frag_flag == AI_PACKET_FRAG_END) {
-            memcpy(ai_basic_proto->recv_frag_mng.data + ai_basic_proto->recv_frag_mng.offset, decrypt_buf, decrypt_len);
-            ai_basic_proto->recv_frag_mng.frag_flag = current_frag_flag;
-            ai_basic_proto->recv_frag_mng.offset += decrypt_len;
-            Free(decrypt_buf);
-            decrypt_buf = NULL;
-            *out = ai_basic_proto->recv_frag_mng.data;
-            *out_len = ai_basic_proto->recv_frag_mng.offset;
-            *out_frag = AI_PACKET_NO_FRAG;
-        } else {
-            *out = decrypt_buf;
-            *out_len = decrypt_len;
+            frag_mng->size = frag_total_len;
+        }
+
+        if (frag_mng->offset + de_len >= frag_mng->size) {
+            PR_ERR("recv frag overflow, offset:%d, len:%d, size:%d", frag_mng->offset, de_len, frag_mng->size);
+            rt = OPRT_COM_ERROR;
+            break;
+        }
+        memcpy(frag_mng->data + frag_mng->offset, de_buf, de_len);
+        frag_mng->offset += de_len;
+        frag_mng->data[frag_mng->offset] = 0;
+        frag_mng->frag_flag = current_frag_flag;
+
+        if (current_frag_flag == AI_PACKET_FRAG_END) {
+            *out = frag_mng->data;
+            *out_len = frag_mng->offset;
             *out_frag = AI_PACKET_NO_FRAG;
+            AI_PROTO_D("recv packet len:%d", *out_len);
+            return OPRT_OK;
         }
-    } else {
-        *out = decrypt_buf;
-        *out_len = decrypt_len;
-        *out_frag = head->frag_flag;
     }
-    AI_PROTO_D("recv packet len:%d", *out_len);
-    return rt;
 
-EXIT:
-    if (decrypt_buf) {
-        Free(decrypt_buf);
-        decrypt_buf = NULL;
-    }
-    if (ai_basic_proto->recv_frag_mng.data) {
-        Free(ai_basic_proto->recv_frag_mng.data);
-    }
-    memset(&ai_basic_proto->recv_frag_mng, 0, SIZEOF(AI_RECV_FRAG_MNG_T));
-    return recv_len;
+    __ai_basic_reset_recv_frag();
+    return rt;
 }
 
 OPERATE_RET tuya_parse_user_attrs(char *in, uint32_t attr_len, AI_ATTRIBUTE_T **attr_out, uint32_t *attr_num)
@@ -1760,7 +2320,7 @@ OPERATE_RET tuya_ai_auth_resp(void)
     AI_PAYLOAD_HEAD_T *packet = (AI_PAYLOAD_HEAD_T *)de_buf;
     if (packet->attribute_flag != AI_HAS_ATTR) {
         PR_ERR("auth resp packet has no attribute");
-        Free(de_buf);
+        tuya_ai_basic_pkt_free(de_buf);
         return OPRT_COM_ERROR;
     }
 
@@ -1776,7 +2336,7 @@ OPERATE_RET tuya_ai_auth_resp(void)
         PR_ERR("auth resp packet type error %d", packet->type);
         rt = OPRT_COM_ERROR;
     }
-    Free(de_buf);
+    tuya_ai_basic_pkt_free(de_buf);
     return rt;
 }
 
@@ -1814,6 +2374,17 @@ OPERATE_RET tuya_ai_basic_connect(void)
         PR_ERR("create transporter err");
         return OPRT_COM_ERROR;
     }
+#if (AI_READ_AHEAD_BUF_SIZE > 0)
+    // head, iv, length and payload of a packet are served by one socket read
+    tuya_transporter_t buffered = tuya_buffered_transporter_create(ai_basic_proto->transporter, AI_READ_AHEAD_BUF_SIZE);
+    if (!buffered) {
+        tuya_transporter_destroy(ai_basic_proto->transporter);
+        ai_basic_proto->transporter = NULL;
+        PR_ERR("create buffered transporter err");
+        return OPRT_COM_ERROR;
+    }
+    ai_basic_proto->transporter = buffered;
+#endif
     uint32_t idx = 0;
     for (idx = 0; idx < ai_basic_proto->config.host_num; idx++) {
         PR_NOTICE("connect to host :%s, port: %d", ai_basic_proto->config.hosts[idx], ai_basic_proto->config.tcp_port);
@@ -2092,99 +2663,84 @@ OPERATE_RET tuya_ai_basic_session_close(char *session_id, AI_STATUS_CODE code)
     return tuya_ai_basic_pkt_send(&pkt);
 }
 
-OPERATE_RET tuya_ai_basic_video(AI_VIDEO_ATTR_T *video, char *data, uint32_t len)
+OPERATE_RET tuya_ai_basic_sendv(AI_PACKET_PT type, void *attr, AI_SEND_SEG_T *segs, uint32_t seg_num)
 {
     OPERATE_RET rt = OPRT_OK;
+    uint32_t idx = 0;
     AI_SEND_PACKET_T pkt = {0};
-    pkt.type = AI_PT_VIDEO;
-    if (video) {
-        rt = __create_video_attrs(&pkt, video);
-        if (OPRT_OK != rt) {
-            return rt;
+    pkt.type = type;
+    pkt.segs = segs;
+    pkt.seg_num = seg_num;
+    for (idx = 0; idx < seg_num; idx++) {
+        pkt.len += segs[idx].len;
+    }
+
+    if (type == AI_PT_VIDEO) {
+        if (attr) {
+            rt = __create_video_attrs(&pkt, (AI_VIDEO_ATTR_T *)attr);
+        }
+        AI_PROTO_D("send video");
+    } else if (type == AI_PT_AUDIO) {
+        if (attr) {
+            rt = __create_audio_attrs(&pkt, (AI_AUDIO_ATTR_T *)attr);
         }
+    } else if (type == AI_PT_IMAGE) {
+        TUYA_CHECK_NULL_RETURN(attr, OPRT_INVALID_PARM);
+        rt = __create_image_attrs(&pkt, (AI_IMAGE_ATTR_T *)attr);
+        pkt.total_len = ((AI_IMAGE_ATTR_T *)attr)->base.len;
+        AI_PROTO_D("send image");
+    } else if (type == AI_PT_FILE) {
+        TUYA_CHECK_NULL_RETURN(attr, OPRT_INVALID_PARM);
+        rt = __create_file_attrs(&pkt, (AI_FILE_ATTR_T *)attr);
+        pkt.total_len = ((AI_FILE_ATTR_T *)attr)->base.len;
+        AI_PROTO_D("send file");
+    } else if (type == AI_PT_TEXT) {
+        if (attr) {
+            rt = __create_text_attrs(&pkt, (AI_TEXT_ATTR_T *)attr);
+        }
+        AI_PROTO_D("send text");
+    } else {
+        PR_ERR("sendv unsupport type:%d", type);
+        return OPRT_INVALID_PARM;
+    }
+    if (OPRT_OK != rt) {
+        return rt;
+    }
+
+    if (((type == AI_PT_IMAGE) || (type == AI_PT_FILE)) && (pkt.len != pkt.total_len)) {
+        return tuya_ai_basic_pkt_frag_send(&pkt);
     }
-    pkt.len = len;
-    pkt.data = data;
-    AI_PROTO_D("send video");
     return tuya_ai_basic_pkt_send(&pkt);
 }
 
+OPERATE_RET tuya_ai_basic_video(AI_VIDEO_ATTR_T *video, char *data, uint32_t len)
+{
+    AI_SEND_SEG_T seg = {.data = data, .len = len};
+    return tuya_ai_basic_sendv(AI_PT_VIDEO, video, &seg, 1);
+}
+
 OPERATE_RET tuya_ai_basic_audio(AI_AUDIO_ATTR_T *audio, char *data, uint32_t len)
 {
-    OPERATE_RET rt = OPRT_OK;
-    AI_SEND_PACKET_T pkt = {0};
-    pkt.type = AI_PT_AUDIO;
-    if (audio) {
-        rt = __create_audio_attrs(&pkt, audio);
-        if (OPRT_OK != rt) {
-            return rt;
-        }
-    }
-    pkt.len = len;
-    pkt.data = data;
-    rt = tuya_ai_basic_pkt_send(&pkt);
-    return rt;
+    AI_SEND_SEG_T seg = {.data = data, .len = len};
+    return tuya_ai_basic_sendv(AI_PT_AUDIO, audio, &seg, 1);
 }
 
 OPERATE_RET tuya_ai_basic_image(AI_IMAGE_ATTR_T *image, char *data, uint32_t len)
 {
-    OPERATE_RET rt = OPRT_OK;
-    AI_SEND_PACKET_T pkt = {0};
-    pkt.type = AI_PT_IMAGE;
-    if (image) {
-        rt = __create_image_attrs(&pkt, image);
-        if (OPRT_OK != rt) {
-            return rt;
-        }
-    }
-    pkt.total_len = image->base.len;
-    pkt.len = len;
-    pkt.data = data;
-    AI_PROTO_D("send image");
-    if (pkt.len == pkt.total_len) {
-        return tuya_ai_basic_pkt_send(&pkt);
-    } else {
-        return tuya_ai_basic_pkt_frag_send(&pkt);
-    }
+    AI_SEND_SEG_T seg = {.data = data, .len = len};
+    return tuya_ai_basic_sendv(AI_PT_IMAGE, image, &seg, 1);
 }
 
 OPERATE_RET tuya_ai_basic_file(AI_FILE_ATTR_T *file, char *data, uint32_t len)
 {
-    OPERATE_RET rt = OPRT_OK;
-    AI_SEND_PACKET_T pkt = {0};
-    pkt.type = AI_PT_FILE;
-    if (file) {
-        rt = __create_file_attrs(&pkt, file);
-        if (OPRT_OK != rt) {
-            return rt;
-        }
-    }
-    pkt.total_len = file->base.len;
-    pkt.len = len;
-    pkt.data = data;
-    AI_PROTO_D("send file");
-    if (pkt.len == pkt.total_len) {
-        return tuya_ai_basic_pkt_send(&pkt);
-    } else {
-        return tuya_ai_basic_pkt_frag_send(&pkt);
-    }
+    AI_SEND_SEG_T seg = {.data = data, .len = len};
+    return tuya_ai_basic_sendv(AI_PT_FILE, file, &seg, 1);
 }
 
 OPERATE_RET tuya_ai_basic_text(AI_TEXT_ATTR_T *text, char *data, uint32_t len)
 {
-    OPERATE_RET rt = OPRT_OK;
-    AI_SEND_PACKET_T pkt = {0};
-    pkt.type = AI_PT_TEXT;
-    if (text) {
-        rt = __create_text_attrs(&pkt, text);
-        if (OPRT_OK != rt) {
-            return rt;
-        }
-    }
-    pkt.len = len;
-    pkt.data = data;
-    AI_PROTO_D("send text");
-    return tuya_ai_basic_pkt_send(&pkt);
+    AI_SEND_SEG_T seg = {.data = data, .len = len};
+    return tuya_ai_basic_sendv(AI_PT_TEXT, text, &seg, 1);
 }
 
 OPERATE_RET tuya_ai_basic_event(AI_EVENT_ATTR_T *event, char *data, uint32_t len)
@@ -2226,4 +2782,88 @@ OPERATE_RET tuya_ai_basic_uuid_v4(char *uuid_str)
              uuid[1], uuid[2], uuid[3], uuid[4], uuid[5], uuid[6], uuid[7], uuid[8], uuid[9], uuid[10], uuid[11],
              uuid[12], uuid[13], uuid[14], uuid[15]);
     return OPRT_OK;
-}
\ No newline at end of file
+}
+
+#if defined(ENABLE_AI_PROTO_STATS) && (ENABLE_AI_PROTO_STATS == 1)
+OPERATE_RET tuya_ai_basic_get_stats(AI_PROTO_STATS_T *stats)
+{
+    TUYA_CHECK_NULL_RETURN(stats, OPRT_INVALID_PARM);
+    tal_mutex_lock(ai_stats_mutex);
+    memcpy(stats, &ai_proto_stats, sizeof(AI_PROTO_STATS_T));
+    tal_mutex_unlock(ai_stats_mutex);
+    return OPRT_OK;
+}
+
+void tuya_ai_basic_reset_stats(void)
+{
+    tal_mutex_lock(ai_stats_mutex);
+    memset(&ai_proto_stats, 0, sizeof(AI_PROTO_STATS_T));
+    ai_proto_stats.start_ms = tal_system_get_millisecond();
+    tal_mutex_unlock(ai_stats_mutex);
+}
+
+static uint32_t __ai_stats_percentile(AI_STATS_ITEM_T *item, uint32_t percent)
+{
+    uint32_t idx = 0, sum = 0;
+    uint32_t target = (item->pkts * percent + 99) / 100;
+    for (idx = 0; idx < AI_STATS_LAT_BUCKETS; idx++) {
+        sum += item->lat_hist[idx];
+        if (sum >= target) {
+            break;
+        }
+    }
+    // upper bound of the bucket in ms
+    return (idx == 0) ? 1 : (1 << idx);
+}
+
+static void __ai_stats_dump_item(const char *dir, uint32_t cls, AI_STATS_ITEM_T *item, uint32_t elapsed_ms)
+{
+    static const char *cls_name[AI_STATS_CLASS_NUM] = {"ctrl", "video", "audio", "image", "file", "text", "event"};
+    if (0 == item->pkts) {
+        return;
+    }
+    PR_NOTICE("%s %-5s pkts:%u, %u pkt/s, %u KB/s, allocs/pkt:%u.%02u, p50<%ums, p99<%ums", dir, cls_name[cls],
+              item->pkts, (uint32_t)((uint64_t)item->pkts * 1000 / elapsed_ms),
+              (uint32_t)(item->bytes * 1000 / 1024 / elapsed_ms), item->allocs / item->pkts,
+              (item->allocs % item->pkts) * 100 / item->pkts, __ai_stats_percentile(item, 50),
+              __ai_stats_percentile(item, 99));
+}
+
+void tuya_ai_basic_dump_stats(void)
+{
+    uint32_t idx = 0;
+    AI_STATS_ITEM_T send, recv;
+
+    tal_mutex_lock(ai_stats_mutex);
+    uint32_t elapsed_ms = (uint32_t)(tal_system_get_millisecond() - ai_proto_stats.start_ms);
+    tal_mutex_unlock(ai_stats_mutex);
+    if (0 == elapsed_ms) {
+        elapsed_ms = 1;
+    }
+    PR_NOTICE("ai proto stats in %u ms", elapsed_ms);
+    for (idx = 0; idx < AI_STATS_CLASS_NUM; idx++) {
+        // one class at a time, the log is not written under the lock
+        tal_mutex_lock(ai_stats_mutex);
+        send = ai_proto_stats.send[idx];
+        recv = ai_proto_stats.recv[idx];
+        tal_mutex_unlock(ai_stats_mutex);
+        __ai_stats_dump_item("send", idx, &send, elapsed_ms);
+        __ai_stats_dump_item("recv", idx, &recv, elapsed_ms);
+    }
+}
+#else
+OPERATE_RET tuya_ai_basic_get_stats(AI_PROTO_STATS_T *stats)
+{
+    return OPRT_NOT_SUPPORTED;
+}
+
+void tuya_ai_basic_reset_stats(void)
+{
+    return;
+}
+
+void tuya_ai_basic_dump_stats(void)
+{
+    return;
+}
+#endif
@@ -0,0 +1,309 @@
+/**
+ * @file ut_ai_proto_stub.c
+ * @brief Stub of the transporter, the iot client and the atop request used by
+ * the tuya_ai_basic protocol unit tests.
+ *
+ * The tcp transporter is one end of a unix socketpair: what the protocol
+ * writes is read back by the same connection, so every packet goes through the
+ * real encrypt, sign, verify and decrypt paths. The socket reads are counted so
+ * the test can report the read calls per packet, and the test can drop what was
+ * written when it only measures the send path. A link rate makes every write
+ * take as long as it would on a slow uplink.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tal_api.h"
+#include "tuya_transporter.h"
+#include "atop_base.h"
+#include "tuya_iot.h"
+#include "cJSON.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define UT_PROTO_LOCALKEY "0123456789abcdef"
+
+// the answer of the thing config api, one host so the connect loop runs once
+#define UT_PROTO_ATOP_CFG                                                                                              \
+    "{\"tcpport\":443,\"udpport\":0,\"username\":\"ut_user\",\"credential\":\"ut_pwd\","                                \
+    "\"hosts\":[\"127.0.0.1\"],\"expire\":86400,\"bizCode\":1,\"clientId\":\"ut_client\","                              \
+    "\"derivedAlgorithm\":\"hkdf\",\"derivedIv\":\"0000000000000000\"}"
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    struct tuya_transporter_inter_t base;
+    int fd[2]; // fd[0] is written by the protocol, fd[1] is read by it
+} UT_LOOP_TRANSPORTER_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static tuya_iot_client_t s_ut_iot_client;
+static UT_LOOP_TRANSPORTER_T *s_ut_loop; // the last one created
+static uint32_t s_ut_sock_read_cnt;
+static uint32_t s_ut_sock_write_cnt;
+static uint32_t s_ut_link_kbps; // 0: as fast as the socket
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+static OPERATE_RET __ut_loop_connect(tuya_transporter_t t, const char *host, int port, int timeout_ms)
+{
+    UT_LOOP_TRANSPORTER_T *loop = (UT_LOOP_TRANSPORTER_T *)t;
+    int size = 1024 * 1024;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, loop->fd)) {
+        return OPRT_SOCK_CONN_ERR;
+    }
+    // a fragmented message is written in full before the test reads it back
+    setsockopt(loop->fd[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(loop->fd[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __ut_loop_close(tuya_transporter_t t)
+{
+    UT_LOOP_TRANSPORTER_T *loop = (UT_LOOP_TRANSPORTER_T *)t;
+
+    if (loop->fd[0] >= 0) {
+        close(loop->fd[0]);
+        close(loop->fd[1]);
+        loop->fd[0] = loop->fd[1] = -1;
+    }
+
+    return OPRT_OK;
+}
+
+static OPERATE_RET __ut_loop_read(tuya_transporter_t t, uint8_t *buf, int len, int timeout_ms)
+{
+    UT_LOOP_TRANSPORTER_T *loop = (UT_LOOP_TRANSPORTER_T *)t;
+    struct pollfd pfd = {.fd = loop->fd[1], .events = POLLIN};
+    ssize_t ret = 0;
+
+    if (poll(&pfd, 1, timeout_ms) <= 0) {
+        return OPRT_RESOURCE_NOT_READY;
+    }
+    s_ut_sock_read_cnt++;
+    ret = recv(loop->fd[1], buf, len, 0);
+
+    return (ret > 0) ? (OPERATE_RET)ret : OPRT_SOCK_ERR;
+}
+
+static OPERATE_RET __ut_loop_write(tuya_transporter_t t, uint8_t *buf, int len, int timeout_ms)
+{
+    UT_LOOP_TRANSPORTER_T *loop = (UT_LOOP_TRANSPORTER_T *)t;
+    ssize_t ret = 0;
+    int offset = 0;
+
+    s_ut_sock_write_cnt++;
+    if (s_ut_link_kbps) {
+        // the writer holds the connection for the time the bytes take on the link
+        uint64_t ns = (uint64_t)len * 8 * 1000000 / s_ut_link_kbps;
+        struct timespec ts = {.tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000};
+        nanosleep(&ts, NULL);
+    }
+    while (offset < len) {
+        ret = send(loop->fd[0], buf + offset, len - offset, 0);
+        if (ret <= 0) {
+            return OPRT_SOCK_ERR;
+        }
+        offset += ret;
+    }
+
+    return offset;
+}
+
+static OPERATE_RET __ut_loop_destroy(tuya_transporter_t t)
+{
+    if (s_ut_loop == (UT_LOOP_TRANSPORTER_T *)t) {
+        s_ut_loop = NULL;
+    }
+    __ut_loop_close(t);
+    tal_free(t);
+
+    return OPRT_OK;
+}
+
+tuya_transporter_t tuya_transporter_create(TUYA_TRANSPORT_TYPE_E transport_type, tuya_transporter_t dependency)
+{
+    UT_LOOP_TRANSPORTER_T *loop = NULL;
+
+    if (TRANSPORT_TYPE_TCP != transport_type) {
+        return NULL;
+    }
+    loop = (UT_LOOP_TRANSPORTER_T *)tal_malloc(sizeof(UT_LOOP_TRANSPORTER_T));
+    if (NULL == loop) {
+        return NULL;
+    }
+    memset(loop, 0, sizeof(UT_LOOP_TRANSPORTER_T));
+    loop->fd[0] = loop->fd[1] = -1;
+    tuya_transporter_set_func((tuya_transporter_t)loop, __ut_loop_connect, __ut_loop_close, __ut_loop_read,
+                              __ut_loop_write, NULL, NULL, __ut_loop_destroy, NULL);
+    s_ut_loop = loop;
+
+    return (tuya_transporter_t)loop;
+}
+
+OPERATE_RET tuya_transporter_set_func(tuya_transporter_t transporter, transporter_connect_fn connect,
+                                      transporter_close_fn close, transporter_read_fn read, transporter_write_fn write,
+                                      transporter_poll_read_fn poll_read, transporter_poll_read_fn poll_write,
+                                      transporter_destroy_fn destroy, transporter_ctrl ctrl)
+{
+    transporter->f_connect = connect;
+    transporter->f_close = close;
+    transporter->f_read = read;
+    transporter->f_write = write;
+    transporter->f_poll_read = poll_read;
+    transporter->f_poll_write = poll_write;
+    transporter->f_destroy = destroy;
+    transporter->f_ctrl = ctrl;
+
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_transporter_destroy(tuya_transporter_t transporter)
+{
+    return transporter->f_destroy(transporter);
+}
+
+OPERATE_RET tuya_transporter_connect(tuya_transporter_t transporter, const char *host, int port, int timeout_ms)
+{
+    return transporter->f_connect(transporter, host, port, timeout_ms);
+}
+
+OPERATE_RET tuya_transporter_close(tuya_transporter_t transporter)
+{
+    return transporter->f_close(transporter);
+}
+
+OPERATE_RET tuya_transporter_read(tuya_transporter_t transporter, uint8_t *buf, int len, int timeout_ms)
+{
+    return transporter->f_read(transporter, buf, len, timeout_ms);
+}
+
+OPERATE_RET tuya_transporter_write(tuya_transporter_t transporter, uint8_t *buf, int len, int timeout_ms)
+{
+    return transporter->f_write(transporter, buf, len, timeout_ms);
+}
+
+OPERATE_RET tuya_transporter_poll_read(tuya_transporter_t transporter, int timeout_ms)
+{
+    return transporter->f_poll_read ? transporter->f_poll_read(transporter, timeout_ms) : OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tuya_transporter_poll_write(tuya_transporter_t transporter, int timeout_ms)
+{
+    return transporter->f_poll_write ? transporter->f_poll_write(transporter, timeout_ms) : OPRT_NOT_SUPPORTED;
+}
+
+OPERATE_RET tuya_transporter_ctrl(tuya_transporter_t transporter, uint32_t cmd, void *args)
+{
+    return transporter->f_ctrl ? transporter->f_ctrl(transporter, cmd, args) : OPRT_NOT_SUPPORTED;
+}
+
+tuya_iot_client_t *tuya_iot_client_get(void)
+{
+    strcpy(s_ut_iot_client.activate.devid, "ut_devid");
+    strcpy(s_ut_iot_client.activate.seckey, "ut_seckey");
+    strcpy(s_ut_iot_client.activate.localkey, UT_PROTO_LOCALKEY);
+
+    return &s_ut_iot_client;
+}
+
+int atop_base_request(const atop_base_request_t *request, atop_base_response_t *response)
+{
+    response->success = true;
+    response->result = cJSON_Parse(UT_PROTO_ATOP_CFG);
+
+    return response->result ? OPRT_OK : OPRT_CJSON_PARSE_ERR;
+}
+
+void atop_base_response_free(atop_base_response_t *response)
+{
+    cJSON_Delete(response->result);
+}
+
+int uni_random_string(char *dst, int size)
+{
+    static const char chars[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    int idx = 0;
+
+    for (idx = 0; idx < size; idx++) {
+        dst[idx] = chars[rand() % (sizeof(chars) - 1)];
+    }
+
+    return 0;
+}
+
+int uni_random_bytes(uint8_t *output, size_t output_len)
+{
+    size_t idx = 0;
+
+    for (idx = 0; idx < output_len; idx++) {
+        output[idx] = (uint8_t)rand();
+    }
+
+    return 0;
+}
+
+char *mm_strdup(const char *str)
+{
+    char *dst = (char *)tal_malloc(strlen(str) + 1);
+
+    if (dst) {
+        strcpy(dst, str);
+    }
+
+    return dst;
+}
+
+TIME_T tal_time_get_posix(void)
+{
+    return (TIME_T)time(NULL);
+}
+
+SYS_TICK_T tal_time_get_posix_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (SYS_TICK_T)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void ut_ai_proto_sock_cnt(uint32_t *read_cnt, uint32_t *write_cnt)
+{
+    *read_cnt = s_ut_sock_read_cnt;
+    *write_cnt = s_ut_sock_write_cnt;
+}
+
+uint32_t ut_ai_proto_sock_drain(void)
+{
+    char buf[4096];
+    ssize_t ret = 0;
+    uint32_t total = 0;
+
+    if ((NULL == s_ut_loop) || (s_ut_loop->fd[1] < 0)) {
+        return 0;
+    }
+    while ((ret = recv(s_ut_loop->fd[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        total += ret;
+    }
+
+    return total;
+}
+
+void ut_ai_proto_set_link_rate(uint32_t kbps)
+{
+    s_ut_link_kbps = kbps;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file ut_ai_stub.c
+ * @brief Stub of the event bus, the AI client and the AI protocol layer used by
+ * the tuya_ai_basic unit tests.
+ *
+ * Subscriptions are kept so the test can raise the client events itself, the
+ * recv handler registered by the biz layer is kept so the test can feed it
+ * packets, and every request to the cloud succeeds without sending anything.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "tal_event.h"
+#include "tuya_ai_client.h"
+#include "tuya_ai_protocol.h"
+
+/***********************************************************
+************************macro define************************
+***********************************************************/
+#define UT_EVENT_SUB_MAX 8
+
+/***********************************************************
+***********************typedef define***********************
+***********************************************************/
+typedef struct {
+    const char *name;
+    EVENT_SUBSCRIBE_CB cb;
+} UT_EVENT_SUB_T;
+
+/***********************************************************
+***********************variable define**********************
+***********************************************************/
+static UT_EVENT_SUB_T s_ut_event_sub[UT_EVENT_SUB_MAX];
+static AI_BASIC_DATA_HANDLE s_ut_recv_handle;
+static uint32_t s_ut_uuid_seq;
+static uint32_t s_ut_session_close_cnt;
+
+/***********************************************************
+***********************function define**********************
+***********************************************************/
+OPERATE_RET tal_event_subscribe(const char *name, const char *desc, const EVENT_SUBSCRIBE_CB cb, SUBSCRIBE_TYPE_E type)
+{
+    uint32_t idx = 0;
+
+    for (idx = 0; idx < UT_EVENT_SUB_MAX; idx++) {
+        if (NULL == s_ut_event_sub[idx].cb) {
+            s_ut_event_sub[idx].name = name;
+            s_ut_event_sub[idx].cb = cb;
+            return OPRT_OK;
+        }
+    }
+
+    return OPRT_EXCEED_UPPER_LIMIT;
+}
+
+OPERATE_RET tal_event_publish(const char *name, void *data)
+{
+    return OPRT_OK;
+}
+
+void tuya_ai_client_reg_cb(AI_BASIC_DATA_HANDLE cb)
+{
+    s_ut_recv_handle = cb;
+}
+
+uint8_t tuya_ai_client_is_ready(void)
+{
+    return true;
+}
+
+OPERATE_RET tuya_ai_basic_uuid_v4(char *uuid_str)
+{
+    snprintf(uuid_str, AI_UUID_V4_LEN, "ut-session-%08u", (unsigned int)++s_ut_uuid_seq);
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_basic_session_new(AI_SESSION_NEW_ATTR_T *session, char *data, uint32_t len)
+{
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_basic_session_close(char *session_id, AI_STATUS_CODE code)
+{
+    s_ut_session_close_cnt++;
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_basic_sendv(AI_PACKET_PT type, void *attr, AI_SEND_SEG_T *segs, uint32_t seg_num)
+{
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_ai_get_attr_value(char *de_buf, uint32_t *offset, AI_ATTRIBUTE_T *attr)
+{
+    // the test packets carry no attribute
+    return OPRT_NOT_SUPPORTED;
+}
+
+/**
+ * @brief run the subscribers of an event, like tal_event_publish
+ *
+ * @param[in] name: event name
+ * @param[in] data: event data
+ */
+void ut_ai_event_raise(const char *name, void *data)
+{
+    uint32_t idx = 0;
+
+    for (idx = 0; idx < UT_EVENT_SUB_MAX; idx++) {
+        if (s_ut_event_sub[idx].cb && !strcmp(s_ut_event_sub[idx].name, name)) {
+            s_ut_event_sub[idx].cb(data);
+        }
+    }
+}
+
+/**
+ * @brief pass a packet from the client to the recv handler of the biz layer
+ *
+ * @param[in] data: decrypted payload
+ * @param[in] len: payload length
+ * @param[in] frag: fragment flag
+ *
+ * @return the result of the handler, OPRT_COM_ERROR if none is registered
+ */
+OPERATE_RET ut_ai_client_recv(char *data, uint32_t len, AI_FRAG_FLAG frag)
+{
+    if (NULL == s_ut_recv_handle) {
+        return OPRT_COM_ERROR;
+    }
+    return s_ut_recv_handle(data, len, frag);
+}
+
+/**
+ * @brief get how many sessions were closed to the cloud
+ *
+ * @return the close count
+ */
+uint32_t ut_ai_session_close_cnt(void)
+{
+    return s_ut_session_close_cnt;
+}
@@ -0,0 +1,433 @@
+/**
+ * @file ut_tuya_ai_biz.cpp
+ * @brief Unit tests of the AI biz recv dispatch: stream id lookup over hundreds
+ * of streams, session churn against a linear scan, duplicate ids and fragments,
+ * and of the send thread: the latency and idle wakeups of a notified channel
+ * against a polled one.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+// the headers of the module have no C++ guard
+#include "tal_log.h"
+#include "tuya_ai_biz.h"
+#include "tuya_ai_client.h"
+#include "tuya_ai_protocol.h"
+
+void ut_ai_event_raise(const char *name, void *data);
+OPERATE_RET ut_ai_client_recv(char *data, uint32_t len, AI_FRAG_FLAG frag);
+uint32_t ut_ai_session_close_cnt(void);
+
+extern int ut_tal_log_level;
+}
+
+#define UT_SESSION_NUM 128
+
+#ifndef AI_BIZ_TASK_DELAY
+#define AI_BIZ_TASK_DELAY 10
+#endif
+
+typedef struct {
+    uint16_t id;
+    uint32_t cnt;
+    uint32_t len;
+    AI_STREAM_TYPE stream_flag;
+    uint32_t err_cnt; // the data is not the one sent to this id
+} UT_STREAM_T;
+
+// a session as the biz layer keeps it, at the same index
+typedef struct {
+    std::string id;
+    uint16_t recv_num;
+    UT_STREAM_T stream[AI_MAX_SESSION_ID_NUM];
+} UT_SESSION_T;
+
+static uint32_t s_recv_cnt;
+
+static OPERATE_RET recv_cb(AI_BIZ_ATTR_INFO_T *attr, AI_BIZ_HEAD_INFO_T *head, char *data, void *usr_data)
+{
+    UT_STREAM_T *stream = (UT_STREAM_T *)usr_data;
+
+    // the first data byte of a packet is the low byte of its id
+    if (attr && (head->len > 0) && ((uint8_t)data[0] != (uint8_t)stream->id)) {
+        stream->err_cnt++;
+    }
+    stream->cnt++;
+    stream->len += head->len;
+    stream->stream_flag = head->stream_flag;
+    s_recv_cnt++;
+
+    return OPRT_OK;
+}
+
+// a send channel fed by the test, the biz thread takes the frames in the order they were queued
+typedef struct {
+    std::mutex lock;
+    std::deque<std::chrono::steady_clock::time_point> frames;
+    std::vector<double> lat_us; // from the queueing of a frame to the biz thread taking it
+    std::atomic<uint32_t> get_cnt;
+} UT_SEND_CHANNEL_T;
+
+static UT_SEND_CHANNEL_T s_send;
+
+static OPERATE_RET send_get_cb(AI_BIZ_ATTR_INFO_T *attr, AI_BIZ_HEAD_INFO_T *head, char **data)
+{
+    static char frame[16];
+    std::lock_guard<std::mutex> guard(s_send.lock);
+
+    s_send.get_cnt++;
+    if (s_send.frames.empty()) {
+        return OPRT_NOT_FOUND;
+    }
+    s_send.lat_us.push_back(
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - s_send.frames.front()).count());
+    s_send.frames.pop_front();
+    attr->flag = AI_NO_ATTR;
+    head->stream_flag = AI_STREAM_ING;
+    head->len = sizeof(frame);
+    *data = frame;
+
+    return OPRT_OK;
+}
+
+class AiBizTest : public ::testing::Test {
+protected:
+    std::vector<UT_SESSION_T> sessions = std::vector<UT_SESSION_T>(UT_SESSION_NUM);
+
+    static void SetUpTestSuite()
+    {
+        // every packet sent to an unknown id logs an error, the tests send thousands
+        ut_tal_log_level = -1;
+        ASSERT_EQ(OPRT_OK, tuya_ai_biz_set_session_num(UT_SESSION_NUM));
+        ASSERT_EQ(OPRT_OK, tuya_ai_biz_init());
+        ut_ai_event_raise(EVENT_AI_CLIENT_RUN, NULL);
+    }
+
+    static void TearDownTestSuite()
+    {
+        ut_tal_log_level = TAL_LOG_LEVEL_WARN;
+    }
+
+    void SetUp() override
+    {
+        s_recv_cnt = 0;
+    }
+
+    void TearDown() override
+    {
+        ut_ai_event_raise(EVENT_AI_CLIENT_CLOSE, NULL);
+    }
+
+    // create a session with the given recv ids, it takes the first free index like the biz layer
+    int create(const std::vector<uint16_t> &ids)
+    {
+        AI_SESSION_CFG_T cfg;
+        char id[AI_UUID_V4_LEN] = {0};
+        int idx = 0;
+
+        memset(&cfg, 0, sizeof(cfg));
+        while ((idx < UT_SESSION_NUM) && !sessions[idx].id.empty()) {
+            idx++;
+        }
+        UT_SESSION_T tmp;
+        UT_SESSION_T &session = (idx < UT_SESSION_NUM) ? sessions[idx] : tmp;
+
+        session.recv_num = ids.size();
+        for (size_t i = 0; i < ids.size(); i++) {
+            memset(&session.stream[i], 0, sizeof(UT_STREAM_T));
+            session.stream[i].id = ids[i];
+            cfg.recv[i].id = ids[i];
+            cfg.recv[i].cb = recv_cb;
+            cfg.recv[i].usr_data = &session.stream[i];
+        }
+        cfg.recv_num = ids.size();
+
+        EXPECT_EQ(OPRT_OK, tuya_ai_biz_crt_session(1, &cfg, NULL, 0, id));
+        if (idx < UT_SESSION_NUM) {
+            session.id = id;
+        }
+        return idx;
+    }
+
+    void destroy(int idx)
+    {
+        EXPECT_EQ(OPRT_OK, tuya_ai_biz_del_session((AI_SESSION_ID)sessions[idx].id.c_str(), 0));
+        sessions[idx].id.clear();
+    }
+
+    // the stream that gets the id: the first one in index order, like the scan the table replaced
+    UT_STREAM_T *owner(uint16_t id)
+    {
+        for (auto &session : sessions) {
+            if (session.id.empty()) {
+                continue;
+            }
+            for (uint16_t i = 0; i < session.recv_num; i++) {
+                if (session.stream[i].id == id) {
+                    return &session.stream[i];
+                }
+            }
+        }
+        return NULL;
+    }
+
+    // audio packet without attributes: payload head, attribute length, audio head, data
+    std::vector<char> packet(uint16_t id, uint32_t len, AI_STREAM_TYPE stream_flag = AI_STREAM_ONE)
+    {
+        std::vector<char> pkt(sizeof(AI_PAYLOAD_HEAD_T) + sizeof(uint32_t) + sizeof(AI_AUDIO_HEAD_T) + len,
+                              (char)id);
+        AI_PAYLOAD_HEAD_T *head = (AI_PAYLOAD_HEAD_T *)pkt.data();
+        AI_AUDIO_HEAD_T *audio = (AI_AUDIO_HEAD_T *)(pkt.data() + sizeof(AI_PAYLOAD_HEAD_T) + sizeof(uint32_t));
+
+        memset(pkt.data(), 0, pkt.size() - len);
+        head->attribute_flag = AI_NO_ATTR;
+        head->type = AI_PT_AUDIO;
+        audio->id = UNI_HTONS(id);
+        audio->stream_flag = stream_flag;
+        audio->length = UNI_HTONL(len);
+        return pkt;
+    }
+
+    OPERATE_RET send(uint16_t id, uint32_t len = 16)
+    {
+        std::vector<char> pkt = packet(id, len);
+        return ut_ai_client_recv(pkt.data(), pkt.size(), AI_PACKET_NO_FRAG);
+    }
+
+    // send to the id and check that exactly its owner got it
+    void check_dispatch(uint16_t id)
+    {
+        UT_STREAM_T *stream = owner(id);
+        uint32_t cnt = stream ? stream->cnt : 0;
+        uint32_t recv_cnt = s_recv_cnt;
+
+        if (stream) {
+            ASSERT_EQ(OPRT_OK, send(id)) << "id " << id;
+            EXPECT_EQ(cnt + 1, stream->cnt) << "id " << id;
+            EXPECT_EQ(0u, stream->err_cnt) << "id " << id;
+        } else {
+            EXPECT_EQ(OPRT_COM_ERROR, send(id)) << "id " << id;
+        }
+        EXPECT_EQ(recv_cnt + (stream ? 1 : 0), s_recv_cnt) << "id " << id;
+    }
+};
+
+// every session full of streams, ids from the biz allocator and random ones from the cloud
+TEST_F(AiBizTest, DispatchesHundredsOfStreams)
+{
+    std::set<uint16_t> used;
+
+    srand(1);
+    for (int idx = 0; idx < UT_SESSION_NUM; idx++) {
+        std::vector<uint16_t> ids;
+        while (ids.size() < AI_MAX_SESSION_ID_NUM) {
+            uint16_t id = (idx % 2) ? (uint16_t)(rand() % 0xFFFF + 1) : (uint16_t)tuya_ai_biz_get_recv_id();
+            if (used.insert(id).second) {
+                ids.push_back(id);
+            }
+        }
+        ASSERT_EQ(idx, create(ids));
+    }
+
+    for (uint16_t id : used) {
+        check_dispatch(id);
+    }
+    EXPECT_EQ(UT_SESSION_NUM * AI_MAX_SESSION_ID_NUM, s_recv_cnt);
+
+    // unknown ids probe to an empty slot and are not dispatched
+    for (int i = 0; i < 1000; i++) {
+        uint16_t id = rand() % 0xFFFF + 1;
+        if (!used.count(id)) {
+            check_dispatch(id);
+        }
+    }
+}
+
+// random create and delete with shared ids, every packet goes where the linear scan would send it
+TEST_F(AiBizTest, SessionChurnMatchesLinearScan)
+{
+    std::vector<int> active;
+
+    srand(2);
+    for (int i = 0; i < 20000; i++) {
+        int op = rand() % 100;
+
+        if ((op < 10) && (active.size() < UT_SESSION_NUM)) {
+            std::vector<uint16_t> ids(rand() % AI_MAX_SESSION_ID_NUM + 1);
+            // a small id space, so ids are shared and probe runs are long
+            for (auto &id : ids) {
+                id = rand() % 400 + 1;
+            }
+            active.push_back(create(ids));
+        } else if ((op < 18) && !active.empty()) {
+            size_t pos = rand() % active.size();
+            destroy(active[pos]);
+            active.erase(active.begin() + pos);
+        } else {
+            check_dispatch(rand() % 420 + 1);
+        }
+    }
+}
+
+TEST_F(AiBizTest, FirstSessionKeepsDuplicateId)
+{
+    int first = create({100, 101});
+    int second = create({100, 102});
+
+    ASSERT_EQ(OPRT_OK, send(100));
+    EXPECT_EQ(1u, sessions[first].stream[0].cnt);
+    EXPECT_EQ(0u, sessions[second].stream[0].cnt);
+
+    // the id moves to the other session once the first is gone
+    destroy(first);
+    ASSERT_EQ(OPRT_OK, send(100));
+    EXPECT_EQ(1u, sessions[second].stream[0].cnt);
+    EXPECT_EQ(OPRT_COM_ERROR, send(101));
+
+    // a new session takes the free index in front, and the id with it
+    int third = create({100});
+    EXPECT_EQ(first, third);
+    ASSERT_EQ(OPRT_OK, send(100));
+    EXPECT_EQ(1u, sessions[third].stream[0].cnt);
+    EXPECT_EQ(1u, sessions[second].stream[0].cnt);
+}
+
+TEST_F(AiBizTest, DeleteClosesToCloudAndDropsStreams)
+{
+    uint32_t close_cnt = ut_ai_session_close_cnt();
+    int idx = create({200, 201, 202});
+
+    destroy(idx);
+    EXPECT_EQ(close_cnt + 1, ut_ai_session_close_cnt());
+    EXPECT_EQ(OPRT_COM_ERROR, send(200));
+    EXPECT_EQ(OPRT_COM_ERROR, send(202));
+    EXPECT_EQ(OPRT_COM_ERROR, tuya_ai_biz_del_session((AI_SESSION_ID) "ut-session-unknown", 0));
+}
+
+TEST_F(AiBizTest, ClientCloseDropsEveryStream)
+{
+    for (int idx = 0; idx < 10; idx++) {
+        create({(uint16_t)(300 + idx)});
+    }
+    ASSERT_EQ(OPRT_OK, send(305));
+
+    ut_ai_event_raise(EVENT_AI_CLIENT_CLOSE, NULL);
+    for (auto &session : sessions) {
+        session.id.clear();
+    }
+
+    for (int idx = 0; idx < 10; idx++) {
+        EXPECT_EQ(OPRT_COM_ERROR, send(300 + idx));
+    }
+    EXPECT_EQ(1u, s_recv_cnt);
+}
+
+// the fragments after the first packet carry no head, they go to the stream of the first one
+TEST_F(AiBizTest, FragmentsFollowTheFirstPacket)
+{
+    int idx = create({400, 401});
+    UT_STREAM_T *stream = &sessions[idx].stream[1];
+    std::vector<char> pkt = packet(401, 100);
+    std::vector<char> frag(64, (char)401);
+
+    // the start fragment holds 32 of the 100 data bytes
+    ASSERT_EQ(OPRT_OK, ut_ai_client_recv(pkt.data(), pkt.size() - 68, AI_PACKET_FRAG_START));
+    EXPECT_EQ(32u, stream->len);
+    EXPECT_EQ(AI_STREAM_START, stream->stream_flag);
+
+    ASSERT_EQ(OPRT_OK, ut_ai_client_recv(frag.data(), 64, AI_PACKET_FRAG_ING));
+    EXPECT_EQ(AI_STREAM_ING, stream->stream_flag);
+
+    ASSERT_EQ(OPRT_OK, ut_ai_client_recv(frag.data(), 4, AI_PACKET_FRAG_END));
+    EXPECT_EQ(AI_STREAM_END, stream->stream_flag);
+    EXPECT_EQ(3u, stream->cnt);
+    EXPECT_EQ(100u, stream->len);
+    EXPECT_EQ(0u, sessions[idx].stream[0].cnt);
+}
+
+TEST_F(AiBizTest, SessionNumIsFixedOnceRunning)
+{
+    EXPECT_EQ(OPRT_INVALID_PARM, tuya_ai_biz_set_session_num(0));
+    EXPECT_EQ(OPRT_COM_ERROR, tuya_ai_biz_set_session_num(UT_SESSION_NUM * 2));
+
+    for (int idx = 0; idx < UT_SESSION_NUM; idx++) {
+        ASSERT_EQ(idx, create({(uint16_t)(1000 + idx)}));
+    }
+
+    // no index is left, the session is not kept and its ids are not dispatched
+    EXPECT_EQ(UT_SESSION_NUM, create({999}));
+    EXPECT_EQ(OPRT_COM_ERROR, send(999));
+    check_dispatch(1000 + UT_SESSION_NUM - 1);
+}
+
+// a notified channel is sent as soon as it has data and costs no wakeup while idle, a polled one waits for the tick
+TEST_F(AiBizTest, NotifySendsAtOnceWithoutIdleWakeups)
+{
+    const AI_BIZ_SEND_MODE modes[] = {AI_BIZ_SEND_POLL, AI_BIZ_SEND_NOTIFY};
+    const char *name[] = {"poll", "notify"};
+    uint32_t idle[2] = {0};
+    double p50[2] = {0}, p99[2] = {0};
+
+    for (int m = 0; m < 2; m++) {
+        AI_SESSION_CFG_T cfg;
+        char id[AI_UUID_V4_LEN] = {0};
+
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.send_num = 1;
+        cfg.send[0].type = AI_PT_AUDIO;
+        cfg.send[0].id = 500;
+        cfg.send[0].get_cb = send_get_cb;
+        cfg.send[0].mode = modes[m];
+        s_send.lat_us.clear();
+        ASSERT_EQ(OPRT_OK, tuya_ai_biz_crt_session(1, &cfg, NULL, 0, id));
+
+        // the session is created with a wakeup, count the ones after it while nothing is queued
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        s_send.get_cnt = 0;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        idle[m] = s_send.get_cnt;
+
+        // slower than the poll, which takes one frame per tick, at an offset that drifts against the tick
+        for (int idx = 0; idx < 50; idx++) {
+            {
+                std::lock_guard<std::mutex> guard(s_send.lock);
+                s_send.frames.push_back(std::chrono::steady_clock::now());
+            }
+            if (AI_BIZ_SEND_NOTIFY == modes[m]) {
+                EXPECT_EQ(OPRT_OK, tuya_ai_biz_send_notify(500));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(13));
+        }
+        for (int wait = 0; (wait < 100) && (s_send.lat_us.size() < 50); wait++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_EQ(OPRT_OK, tuya_ai_biz_del_session((AI_SESSION_ID)id, 0));
+
+        std::lock_guard<std::mutex> guard(s_send.lock);
+        ASSERT_EQ(50u, s_send.lat_us.size()) << name[m];
+        std::sort(s_send.lat_us.begin(), s_send.lat_us.end());
+        p50[m] = s_send.lat_us[24];
+        p99[m] = s_send.lat_us[48];
+        printf("[ ai biz ] %-6s send: %u get calls in 200 ms idle, latency p50 %.0f us p99 %.0f us\n", name[m],
+               idle[m], p50[m], p99[m]);
+    }
+
+    EXPECT_GE(idle[0], 200u / AI_BIZ_TASK_DELAY / 2);
+    EXPECT_EQ(0u, idle[1]);
+    EXPECT_LT(p99[1], AI_BIZ_TASK_DELAY * 1000.0 / 2);
+    EXPECT_LT(p50[1], p50[0]);
+    RecordProperty("notify_p99_us", (int)p99[1]);
+}
@@ -0,0 +1,659 @@
+/**
+ * @file ut_tuya_ai_protocol.cpp
+ * @brief Unit tests of the AI packet layer over a socketpair loopback: the
+ * scatter-gather send path, the in place receive path and the fragments of a
+ * large reply, with their allocations per packet, the packet throughput of
+ * the security level the test is built with, the rate, latency, allocations
+ * and cpu per MB of the audio, text, image and file streams, the socket
+ * reads per packet with and without the read-ahead transporter and, on a slow
+ * link, the priority of real-time sends over a queued upload.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+// the headers of the module have no C++ guard
+#include "tal_log.h"
+#include "tuya_ai_protocol.h"
+#include "buffered_transporter.h"
+
+void ut_ai_proto_sock_cnt(uint32_t *read_cnt, uint32_t *write_cnt);
+uint32_t ut_ai_proto_sock_drain(void);
+void ut_ai_proto_set_link_rate(uint32_t kbps);
+
+extern int ut_tal_log_level;
+extern uint32_t ut_tal_malloc_cnt;
+}
+
+#define UT_AUDIO_FRAME_LEN 640 // 20 ms of 16 kHz mono pcm
+#define UT_PKT_NUM         2000
+#define UT_BURST_NUM       16
+
+#ifndef AI_READ_AHEAD_BUF_SIZE
+#define AI_READ_AHEAD_BUF_SIZE 0
+#endif
+
+// the SL2 sender leaves the pkcs padding in clear and the receiver decrypts it with the data, so the loopback cannot
+// read back its own SL2 packets. At SL2 the send path is measured and the receive tests are skipped
+#if (AI_PACKET_SECURITY_LEVEL == AI_PACKET_SL2)
+#define UT_LOOPBACK_RECV 0
+#else
+#define UT_LOOPBACK_RECV 1
+#endif
+
+#define UT_REQUIRE_LOOPBACK_RECV()                                                                                     \
+    if (!UT_LOOPBACK_RECV) {                                                                                           \
+        GTEST_SKIP() << "SL2 packets do not round trip on the loopback";                                               \
+    }
+
+class AiProtoTest : public ::testing::Test {
+protected:
+    static bool connected;
+
+    AI_AUDIO_ATTR_T audio = {};
+
+    void SetUp() override
+    {
+        audio.base.codec_type = AUDIO_CODEC_PCM;
+        audio.base.sample_rate = 16000;
+        audio.base.channels = AUDIO_CHANNELS_MONO;
+        audio.base.bit_depth = 16;
+        if (!connected) {
+            ut_tal_log_level = TAL_LOG_LEVEL_ERR;
+            ASSERT_EQ(OPRT_OK, tuya_ai_basic_atop_req());
+            ASSERT_EQ(OPRT_OK, tuya_ai_basic_connect());
+            connected = true;
+        }
+    }
+
+    static uint32_t malloc_cnt(void)
+    {
+        return __atomic_load_n(&ut_tal_malloc_cnt, __ATOMIC_RELAXED);
+    }
+
+    // offset of the data in a message or a start fragment, after the payload head, the attributes and the length
+    static uint32_t data_offset(const char *buf, uint32_t *data_len)
+    {
+        uint32_t attr_len = 0, offset = sizeof(AI_PAYLOAD_HEAD_T);
+
+        if (((AI_PAYLOAD_HEAD_T *)buf)->attribute_flag == AI_HAS_ATTR) {
+            memcpy(&attr_len, buf + offset, sizeof(attr_len));
+            offset += sizeof(attr_len) + UNI_NTOHL(attr_len);
+        }
+        memcpy(data_len, buf + offset, sizeof(*data_len));
+        *data_len = UNI_NTOHL(*data_len);
+        return offset + sizeof(*data_len);
+    }
+
+    // reads one message back and checks its data, only drops it when the loopback cannot read it
+    static bool read_back(const std::string &data, AI_PACKET_PT *type)
+    {
+        if (!UT_LOOPBACK_RECV) {
+            return ut_ai_proto_sock_drain() > data.size();
+        }
+        return data == read_data(type);
+    }
+
+    // reads one message back and returns its data
+    static std::string read_data(AI_PACKET_PT *type)
+    {
+        char *buf = NULL;
+        uint32_t len = 0, data_len = 0, offset = 0;
+        AI_FRAG_FLAG frag = AI_PACKET_NO_FRAG;
+        std::string data;
+
+        if ((OPRT_OK != tuya_ai_basic_pkt_read(&buf, &len, &frag)) || (NULL == buf)) {
+            return data;
+        }
+        *type = ((AI_PAYLOAD_HEAD_T *)buf)->type;
+        offset = data_offset(buf, &data_len);
+        if (offset + data_len == len) {
+            data.assign(buf + offset, data_len);
+        }
+        tuya_ai_basic_pkt_free(buf);
+        return data;
+    }
+};
+
+bool AiProtoTest::connected = false;
+
+static std::string pattern(uint32_t len, uint32_t seed)
+{
+    std::string data(len, 0);
+
+    for (uint32_t idx = 0; idx < len; idx++) {
+        data[idx] = (char)((idx * 31 + seed) % 251);
+    }
+    return data;
+}
+
+// the packet is packed and encrypted in the connection buffer, only the attributes of the call are allocated
+TEST_F(AiProtoTest, AudioSendAllocatesOnlyAttributes)
+{
+    std::string frame = pattern(UT_AUDIO_FRAME_LEN, 1);
+    AI_PACKET_PT type = 0;
+    uint32_t send_allocs = 0, plain_allocs = 0, before = 0;
+    double send_us = 0;
+
+    for (uint32_t idx = 0; idx < UT_PKT_NUM; idx++) {
+        // the first frame of a stream carries the attributes, the rest is data only
+        AI_AUDIO_ATTR_T *attr = (idx % 50) ? NULL : &audio;
+        before = malloc_cnt();
+        auto start = std::chrono::steady_clock::now();
+
+        ASSERT_EQ(OPRT_OK, tuya_ai_basic_audio(attr, (char *)frame.data(), frame.size()));
+
+        send_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        if (attr) {
+            send_allocs += malloc_cnt() - before;
+        } else {
+            plain_allocs += malloc_cnt() - before;
+        }
+        ASSERT_TRUE(read_back(frame, &type));
+        EXPECT_EQ(UT_LOOPBACK_RECV ? AI_PT_AUDIO : 0, type);
+    }
+
+    // codec, sample rate, channels and bit depth
+    EXPECT_EQ(4u * (UT_PKT_NUM / 50), send_allocs);
+    EXPECT_EQ(0u, plain_allocs);
+    printf("[ ai proto ] audio %u B: %.1f allocs/pkt with attributes, %.1f without, %.1f us/pkt send\n",
+           UT_AUDIO_FRAME_LEN, (double)send_allocs / (UT_PKT_NUM / 50),
+           (double)plain_allocs / (UT_PKT_NUM - UT_PKT_NUM / 50), send_us / UT_PKT_NUM);
+    RecordProperty("send_ns_per_pkt", (int)(send_us * 1000 / UT_PKT_NUM));
+}
+
+// header, body and tail segments go out as one payload without being joined by the caller
+TEST_F(AiProtoTest, SendvGathersSegments)
+{
+    std::string head = pattern(7, 2), body = pattern(1021, 3), tail = pattern(13, 4);
+    AI_SEND_SEG_T segs[3] = {{(char *)head.data(), (uint32_t)head.size()},
+                             {(char *)body.data(), (uint32_t)body.size()},
+                             {(char *)tail.data(), (uint32_t)tail.size()}};
+    AI_PACKET_PT type = 0;
+    uint32_t before = malloc_cnt();
+
+    UT_REQUIRE_LOOPBACK_RECV();
+
+    ASSERT_EQ(OPRT_OK, tuya_ai_basic_sendv(AI_PT_AUDIO, NULL, segs, 3));
+    EXPECT_EQ(before, malloc_cnt());
+    EXPECT_EQ(head + body + tail, read_data(&type));
+
+    // an empty segment in the middle and a text packet
+    segs[1].len = 0;
+    ASSERT_EQ(OPRT_OK, tuya_ai_basic_sendv(AI_PT_TEXT, NULL, segs, 3));
+    EXPECT_EQ(head + tail, read_data(&type));
+    EXPECT_EQ(AI_PT_TEXT, type);
+}
+
+// a message over the fragment length is split in the same buffer, still without a per fragment allocation
+TEST_F(AiProtoTest, FragmentedSendAllocatesOnlyAttributes)
+{
+    std::string data = pattern(3 * AI_MAX_FRAGMENT_LENGTH + 100, 5);
+    AI_PACKET_PT type = 0;
+    uint32_t read_cnt = 0, write_cnt = 0, write_before = 0;
+    uint32_t before = 0;
+
+    UT_REQUIRE_LOOPBACK_RECV();
+
+    ut_ai_proto_sock_cnt(&read_cnt, &write_before);
+    before = malloc_cnt();
+    ASSERT_EQ(OPRT_OK, tuya_ai_basic_audio(&audio, (char *)data.data(), data.size()));
+    EXPECT_EQ(before + 4, malloc_cnt());
+
+    ut_ai_proto_sock_cnt(&read_cnt, &write_cnt);
+    EXPECT_EQ(4u, write_cnt - write_before);
+    EXPECT_EQ(data, read_data(&type));
+}
+
+// a whole packet is verified and decrypted in the connection buffer
+TEST_F(AiProtoTest, RecvDecryptsInPlace)
+{
+    std::string frame = pattern(UT_AUDIO_FRAME_LEN, 6);
+    AI_PACKET_PT type = 0;
+    uint32_t recv_allocs = 0, before = 0;
+    double recv_us = 0;
+
+    UT_REQUIRE_LOOPBACK_RECV();
+
+    for (uint32_t idx = 0; idx < UT_PKT_NUM; idx++) {
+        ASSERT_EQ(OPRT_OK, tuya_ai_basic_audio(NULL, (char *)frame.data(), frame.size()));
+        before = malloc_cnt();
+        auto start = std::chrono::steady_clock::now();
+
+        ASSERT_EQ(frame, read_data(&type));
+
+        recv_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        recv_allocs += malloc_cnt() - before;
+    }
+
+    EXPECT_EQ(0u, recv_allocs);
+    printf("[ ai proto ] recv %u B: %.1f allocs/pkt, %.1f us/pkt\n", UT_AUDIO_FRAME_LEN,
+           (double)recv_allocs / UT_PKT_NUM, recv_us / UT_PKT_NUM);
+    RecordProperty("recv_ns_per_pkt", (int)(recv_us * 1000 / UT_PKT_NUM));
+}
+
+// a large reply is handed out fragment by fragment in stream mode, or once reassembled in one buffer
+TEST_F(AiProtoTest, RecvFragmentsStreamAndReassemble)
+{
+    std::string data = pattern(8 * AI_MAX_FRAGMENT_LENGTH, 7);
+    const char *name[] = {"reassembled", "stream"};
+
+    UT_REQUIRE_LOOPBACK_RECV();
+
+    for (int stream = 0; stream < 2; stream++) {
+        std::string got;
+        char *buf = NULL;
+        uint32_t len = 0, data_len = 0, offset = 0, pieces = 0, before = 0;
+        AI_FRAG_FLAG frag = AI_PACKET_NO_FRAG;
+        double first_us = 0;
+
+        tuya_ai_basic_set_frag_flag(stream);
+        ASSERT_EQ(OPRT_OK, tuya_ai_basic_audio(&audio, (char *)data.data(), data.size()));
+        before = malloc_cnt();
+        auto start = std::chrono::steady_clock::now();
+        do {
+            ASSERT_EQ(OPRT_OK, tuya_ai_basic_pkt_read(&buf, &len, &frag));
+            ASSERT_TRUE(NULL != buf);
+            if (0 == pieces++) {
+                first_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                offset = data_offset(buf, &data_len);
+                EXPECT_EQ(data.size(), data_len);
+            } else {
+                offset = 0;
+            }
+            got.append(buf + offset, len - offset);
+            tuya_ai_basic_pkt_free(buf);
+        } while ((AI_PACKET_FRAG_START == frag) || (AI_PACKET_FRAG_ING == frag));
+        double total_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        EXPECT_EQ(data, got);
+        // reassembly keeps one buffer for the whole reply, stream mode none
+        EXPECT_EQ(stream ? 0u : 1u, malloc_cnt() - before);
+        EXPECT_EQ(stream ? 9u : 1u, pieces);
+        printf("[ ai proto ] recv %zu B %s: %u pieces, %u allocs, first data %.0f us, all %.0f us\n", data.size(),
+               name[stream], pieces, malloc_cnt() - before, first_us, total_us);
+    }
+    tuya_ai_basic_set_frag_flag(false);
+}
+
+// the cipher and hmac contexts of the connection are set up once, every packet only runs the cipher and the hash
+TEST_F(AiProtoTest, SecurityLevelThroughput)
+{
+    const uint32_t len[] = {UT_AUDIO_FRAME_LEN, 16 * 1024};
+
+    for (uint32_t size : len) {
+        std::string data = pattern(size, 8);
+        AI_PACKET_PT type = 0;
+        double send_us = 0, recv_us = 0;
+
+        for (uint32_t idx = 0; idx < UT_PKT_NUM; idx++) {
+            auto start = std::chrono::steady_clock::now();
+            ASSERT_EQ(OPRT_OK, tuya_ai_basic_audio(NULL, (char *)data.data(), data.size()));
+            auto sent = std::chrono::steady_clock::now();
+            ASSERT_TRUE(read_back(data, &type));
+
+            send_us += std::chrono::duration<double, std::micro>(sent - start).count();
+            recv_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent).count();
+        }
+
+        printf("[ ai proto ] SL%d %u B: send %.1f us/pkt %.1f MB/s", AI_PACKET_SECURITY_LEVEL, size,
+               send_us / UT_PKT_NUM, (double)size * UT_PKT_NUM / send_us);
+        RecordProperty(("send_ns_per_" + std::to_string(size)).c_str(), (int)(send_us * 1000 / UT_PKT_NUM));
+        if (UT_LOOPBACK_RECV) {
+            printf(", recv %.1f us/pkt %.1f MB/s", recv_us / UT_PKT_NUM, (double)size * UT_PKT_NUM / recv_us);
+            RecordProperty(("recv_ns_per_" + std::to_string(size)).c_str(), (int)(recv_us * 1000 / UT_PKT_NUM));
+        }
+        printf("\n");
+    }
+}
+
+typedef struct {
+    const char *name;
+    AI_PACKET_PT type;
+    uint32_t len;
+    uint32_t num;
+} UT_STREAM_T;
+
+static double cpu_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static double percentile(std::vector<double> &lat, uint32_t percent)
+{
+    if (lat.empty()) {
+        return 0;
+    }
+    std::sort(lat.begin(), lat.end());
+    return lat[(lat.size() - 1) * percent / 100];
+}
+
+// every stream class of the device end to end on the loopback: rate, latency, allocations and cpu per MB
+TEST_F(AiProtoTest, StreamThroughputAndCpuPerMb)
+{
+    const UT_STREAM_T streams[] = {
+        {"audio", AI_PT_AUDIO, UT_AUDIO_FRAME_LEN, UT_PKT_NUM},
+        {"text", AI_PT_TEXT, 256, UT_PKT_NUM},
+        {"image", AI_PT_IMAGE, 48 * 1024, 200},
+        {"file", AI_PT_FILE, 96 * 1024, 100},
+    };
+    AI_IMAGE_ATTR_T image = {};
+    AI_FILE_ATTR_T file = {};
+
+    image.base.format = IMAGE_FORMAT_JPEG;
+    image.base.width = 320;
+    image.base.height = 240;
+    file.base.format = FILE_FORMAT_JSON;
+    snprintf(file.base.file_name, sizeof(file.base.file_name), "ut.json");
+
+    for (const UT_STREAM_T &stream : streams) {
+        std::string data = pattern(stream.len, stream.type);
+        std::vector<double> send_lat, recv_lat;
+        AI_PACKET_PT type = 0;
+        uint32_t allocs = 0, before = 0;
+        OPERATE_RET rt = OPRT_OK;
+
+        image.base.len = file.base.len = stream.len;
+        double cpu_start = cpu_us();
+        auto wall_start = std::chrono::steady_clock::now();
+        for (uint32_t idx = 0; idx < stream.num; idx++) {
+            before = malloc_cnt();
+            auto start = std::chrono::steady_clock::now();
+            // audio and text are streams of plain frames, an image or a file is one message with its attributes
+            if (AI_PT_AUDIO == stream.type) {
+                rt = tuya_ai_basic_audio(NULL, (char *)data.data(), data.size());
+            } else if (AI_PT_TEXT == stream.type) {
+                rt = tuya_ai_basic_text(NULL, (char *)data.data(), data.size());
+            } else if (AI_PT_IMAGE == stream.type) {
+                rt = tuya_ai_basic_image(&image, (char *)data.data(), data.size());
+            } else {
+                rt = tuya_ai_basic_file(&file, (char *)data.data(), data.size());
+            }
+            auto sent = std::chrono::steady_clock::now();
+            ASSERT_EQ(OPRT_OK, rt);
+            ASSERT_TRUE(read_back(data, &type));
+            auto done = std::chrono::steady_clock::now();
+            allocs += malloc_cnt() - before;
+
+            EXPECT_EQ(UT_LOOPBACK_RECV ? stream.type : 0, type);
+            send_lat.push_back(std::chrono::duration<double, std::micro>(sent - start).count());
+            recv_lat.push_back(std::chrono::duration<double, std::micro>(done - sent).count());
+        }
+        double wall = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - wall_start).count();
+        double cpu = cpu_us() - cpu_start;
+        double mb = (double)stream.len * stream.num / (1024 * 1024);
+
+        printf("[ ai proto ] SL%d %-5s %6u B: %.0f pkt/s %.1f MB/s, send p50 %.1f p99 %.1f us", AI_PACKET_SECURITY_LEVEL,
+               stream.name, stream.len, stream.num * 1e6 / wall, mb * 1e6 / wall, percentile(send_lat, 50),
+               percentile(send_lat, 99));
+        if (UT_LOOPBACK_RECV) {
+            printf(", recv p50 %.1f p99 %.1f us", percentile(recv_lat, 50), percentile(recv_lat, 99));
+        }
+        printf(", %.2f allocs/pkt, cpu %.1f ms/MB\n", (double)allocs / stream.num, cpu / 1000 / mb);
+        RecordProperty((std::string(stream.name) + "_cpu_us_per_mb").c_str(), (int)(cpu / mb));
+    }
+}
+
+// head, iv, length and payload are separate socket reads, the read-ahead layer serves them from one refill
+TEST_F(AiProtoTest, RecvSocketReadsPerPacket)
+{
+    std::string frame = pattern(UT_AUDIO_FRAME_LEN, 9);
+    AI_PACKET_PT type = 0;
+    uint32_t read_before = 0, read_cnt = 0, write_cnt = 0, single_reads = 0, burst_reads = 0;
+    double recv_us = 0;
+
+    UT_REQUIRE_LOOPBACK_RECV();
+
+    // one packet in flight at a time, as for a stream of small packets
+    ut_ai_proto_sock_cnt(&read_before, &write_cnt);
+    for (uint32_t idx = 0; idx < UT_PKT_NUM; idx++) {
+        ASSERT_EQ(OPRT_OK, tuya_ai_basic_audio(NULL, (char *)frame.data(), frame.size()));
+        auto start = std::chrono::steady_clock::now();
+        ASSERT_EQ(frame, read_data(&type));
+        recv_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+    ut_ai_proto_sock_cnt(&read_cnt, &write_cnt);
+    single_reads = read_cnt - read_before;
+
+    // several packets queued on the socket, as after a stall of the reader
+    read_before = read_cnt;
+    for (uint32_t idx = 0; idx < UT_BURST_NUM; idx++) {
+        ASSERT_EQ(OPRT_OK, tuya_ai_basic_audio(NULL, (char *)frame.data(), frame.size()));
+    }
+    for (uint32_t idx = 0; idx < UT_BURST_NUM; idx++) {
+        ASSERT_EQ(frame, read_data(&type));
+    }
+    ut_ai_proto_sock_cnt(&read_cnt, &write_cnt);
+    burst_reads = read_cnt - read_before;
+
+#if (AI_READ_AHEAD_BUF_SIZE > 0)
+    EXPECT_EQ(UT_PKT_NUM, single_reads);
+    EXPECT_LT(burst_reads, UT_BURST_NUM);
+#else
+    EXPECT_GT(single_reads, 2u * UT_PKT_NUM);
+#endif
+    printf("[ ai proto ] read-ahead %d B, %u B pkts: %.2f socket reads/pkt one at a time, %.2f in a burst of %u, "
+           "%.1f us/pkt recv\n",
+           AI_READ_AHEAD_BUF_SIZE, UT_AUDIO_FRAME_LEN, (double)single_reads / UT_PKT_NUM,
+           (double)burst_reads / UT_BURST_NUM, UT_BURST_NUM, recv_us / UT_PKT_NUM);
+    RecordProperty("reads_per_pkt_x100", (int)(single_reads * 100 / UT_PKT_NUM));
+}
+
+#if defined(ENABLE_AI_SEND_QUEUE) && (ENABLE_AI_SEND_QUEUE == 1)
+#define UT_SEND_QUEUE 1
+#else
+#define UT_SEND_QUEUE 0
+#endif
+
+#ifndef AI_SEND_BULK_SHARE
+#define AI_SEND_BULK_SHARE 25
+#endif
+
+#define UT_LINK_KBPS 8000 // a 1 MB/s uplink, a full fragment takes 20 ms on it
+
+#define UT_REQUIRE_SEND_QUEUE()                                                                                        \
+    if (!UT_SEND_QUEUE) {                                                                                              \
+        GTEST_SKIP() << "built without ENABLE_AI_SEND_QUEUE";                                                          \
+    }
+
+// the peer of a slow uplink: audio frames and the fragments of one file upload, read in stream mode
+class AiSendQueueTest : public AiProtoTest {
+protected:
+    std::atomic<uint32_t> audio_sent{0};
+    std::atomic<uint32_t> audio_recv{0};
+    std::atomic<uint32_t> audio_in_upload{0}; // audio frames which arrived between two fragments of the file
+    std::atomic<uint64_t> audio_bytes{0};
+    std::atomic<uint64_t> file_bytes{0};
+    std::atomic<bool> file_done{false};
+    std::atomic<bool> stop{false};
+    std::thread reader;
+
+    void SetUp() override
+    {
+        AiProtoTest::SetUp();
+        UT_REQUIRE_SEND_QUEUE();
+        tuya_ai_basic_set_frag_flag(true);
+        ut_ai_proto_set_link_rate(UT_LINK_KBPS);
+        reader = std::thread([this] { read_link(); });
+    }
+
+    void TearDown() override
+    {
+        if (reader.joinable()) {
+            // a last frame wakes the reader out of its socket wait
+            stop = true;
+            audio_sent++;
+            tuya_ai_basic_audio(NULL, (char *)"end", 3);
+            reader.join();
+        }
+        ut_ai_proto_set_link_rate(0);
+        tuya_ai_basic_set_frag_flag(false);
+    }
+
+    // reads until every audio frame sent and the whole file are in
+    void read_link(void)
+    {
+        bool in_file = false;
+
+        while (!(stop && file_done && (audio_recv == audio_sent))) {
+            char *buf = NULL;
+            uint32_t len = 0, data_len = 0, offset = 0;
+            AI_FRAG_FLAG frag = AI_PACKET_NO_FRAG;
+            AI_PACKET_PT type = AI_PT_FILE;
+
+            if ((OPRT_OK != tuya_ai_basic_pkt_read(&buf, &len, &frag)) || (NULL == buf)) {
+                continue;
+            }
+            // only a whole message and the start fragment carry the payload head
+            if ((AI_PACKET_NO_FRAG == frag) || (AI_PACKET_FRAG_START == frag)) {
+                type = ((AI_PAYLOAD_HEAD_T *)buf)->type;
+                offset = data_offset(buf, &data_len);
+            }
+            if (AI_PT_AUDIO == type) {
+                audio_bytes += len - offset;
+                audio_in_upload += in_file;
+                audio_recv++;
+            } else if (AI_PT_FILE == type) {
+                file_bytes += len - offset;
+                in_file = (AI_PACKET_FRAG_START == frag) || (AI_PACKET_FRAG_ING == frag);
+                file_done = !in_file;
+            }
+            tuya_ai_basic_pkt_free(buf);
+        }
+    }
+
+    bool wait_file(uint32_t timeout_ms)
+    {
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (!file_done && (std::chrono::steady_clock::now() < end)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return file_done;
+    }
+
+    void queue_file(const std::string &data)
+    {
+        AI_FILE_ATTR_T file = {};
+
+        file.base.len = data.size();
+        file.base.format = FILE_FORMAT_JSON;
+        ASSERT_EQ(OPRT_OK, tuya_ai_basic_file(&file, (char *)data.data(), data.size()));
+    }
+};
+
+// the upload is written one fragment at a time by the send thread, a frame waits for one fragment at most
+TEST_F(AiSendQueueTest, RealTimeSendsGoAheadOfUpload)
+{
+    const uint32_t frag_us = AI_MAX_FRAGMENT_LENGTH * 8 * 1000 / UT_LINK_KBPS;
+    std::string data = pattern(10 * AI_MAX_FRAGMENT_LENGTH, 11), frame = pattern(UT_AUDIO_FRAME_LEN, 12);
+    std::vector<double> lat;
+
+    auto start = std::chrono::steady_clock::now();
+    queue_file(data);
+    double queue_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    // a 20 ms frame cadence while the upload is on the link
+    for (uint32_t idx = 0; idx < 8; idx++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        auto sent = std::chrono::steady_clock::now();
+        ASSERT_EQ(OPRT_OK, tuya_ai_basic_audio(NULL, (char *)frame.data(), frame.size()));
+        lat.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent).count());
+        audio_sent++;
+    }
+    ASSERT_TRUE(wait_file(5000));
+    double upload_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    // the frames went out between the fragments of the file, none waited for the whole upload
+    EXPECT_LT(queue_us, frag_us);
+    EXPECT_EQ(8u, audio_in_upload.load());
+    EXPECT_LT(percentile(lat, 100), 2.0 * frag_us);
+    EXPECT_EQ(data.size(), file_bytes.load());
+    printf("[ ai proto ] %zu B upload at %u kbps: queued in %.0f us, on the link %.0f ms, audio send p50 %.0f us "
+           "max %.0f us, %u/8 frames inside the upload\n",
+           data.size(), UT_LINK_KBPS, queue_us, upload_us / 1000, percentile(lat, 50), percentile(lat, 100),
+           audio_in_upload.load());
+}
+
+// with real-time senders always waiting, the upload gets AI_SEND_BULK_SHARE of the window and still finishes
+TEST_F(AiSendQueueTest, UploadKeepsBulkShareUnderLoad)
+{
+    std::string data = pattern(12 * AI_MAX_FRAGMENT_LENGTH, 13), frame = pattern(UT_AUDIO_FRAME_LEN, 14);
+    std::atomic<bool> loaded{true};
+    std::vector<std::thread> senders;
+
+    for (uint32_t idx = 0; idx < 3; idx++) {
+        senders.emplace_back([&] {
+            while (loaded) {
+                if (OPRT_OK == tuya_ai_basic_audio(NULL, (char *)frame.data(), frame.size())) {
+                    audio_sent++;
+                }
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    uint64_t audio_start = audio_bytes;
+    auto start = std::chrono::steady_clock::now();
+    queue_file(data);
+    // at its share the upload needs one to two of the 1 s share windows
+    bool done = wait_file(6000);
+    double upload_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    uint64_t audio_upload = audio_bytes - audio_start;
+    loaded = false;
+    for (auto &sender : senders) {
+        sender.join();
+    }
+
+    double share = 100.0 * file_bytes / (file_bytes + audio_upload);
+    EXPECT_TRUE(done);
+    EXPECT_GT(share, AI_SEND_BULK_SHARE / 2.0);
+    EXPECT_LT(share, AI_SEND_BULK_SHARE * 2.0);
+    printf("[ ai proto ] %zu B upload under 3 audio senders at %u kbps: %.0f ms, bulk share %.1f%% (configured %d%%), "
+           "%.0f KB audio alongside\n",
+           data.size(), UT_LINK_KBPS, upload_ms, share, AI_SEND_BULK_SHARE, audio_upload / 1024.0);
+}
+
+// peek leaves the bytes in the buffer, consume and read take them, one inner read fills the buffer
+TEST(AiProtoBufferedTest, PeekConsume)
+{
+    std::string data = pattern(100, 10), got(20, 0);
+    tuya_transporter_t tcp = tuya_transporter_create(TRANSPORT_TYPE_TCP, NULL);
+    tuya_transporter_t buffered = tuya_buffered_transporter_create(tcp, 64);
+    uint8_t *peek = NULL;
+    uint32_t read_cnt = 0, inner_cnt = 0;
+
+    ASSERT_TRUE(NULL != buffered);
+    ASSERT_EQ(OPRT_OK, tuya_transporter_connect(buffered, "127.0.0.1", 443, 1000));
+    ASSERT_EQ((int)data.size(), tuya_transporter_write(buffered, (uint8_t *)data.data(), data.size(), 1000));
+
+    ASSERT_GE(tuya_buffered_transporter_peek(buffered, &peek, 10, 1000), 10);
+    EXPECT_EQ(0, memcmp(peek, data.data(), 10));
+    ASSERT_GE(tuya_buffered_transporter_peek(buffered, &peek, 10, 1000), 10);
+    EXPECT_EQ(0, memcmp(peek, data.data(), 10));
+    EXPECT_EQ(OPRT_OK, tuya_buffered_transporter_consume(buffered, 4));
+    EXPECT_EQ(20, tuya_transporter_read(buffered, (uint8_t *)&got[0], 20, 1000));
+    EXPECT_EQ(data.substr(4, 20), got);
+
+    EXPECT_EQ(OPRT_OK, tuya_buffered_transporter_get_stats(buffered, &read_cnt, &inner_cnt));
+    EXPECT_EQ(3u, read_cnt);
+    EXPECT_EQ(1u, inner_cnt);
+
+    // a read at least as large as the buffer skips it once the buffered bytes are handed out
+    got.assign(76, 0);
+    EXPECT_EQ(40, tuya_transporter_read(buffered, (uint8_t *)&got[0], 76, 1000));
+    EXPECT_EQ(36, tuya_transporter_read(buffered, (uint8_t *)&got[40], 36, 1000));
+    EXPECT_EQ(data.substr(24), got);
+    tuya_transporter_destroy(buffered);
+}
@@ -0,0 +1,239 @@
+/**
+ * @file buffered_transporter.c
+ * @brief Implementation of the buffered read-ahead transporter.
+ *
+ * This file implements a transporter decorator which keeps a read-ahead buffer
+ * in front of another transporter. A framed protocol usually reads a packet as
+ * several small pieces (head, length, payload); with the buffered transporter
+ * a single read of the inner transporter fills the buffer and the following
+ * pieces are copied from memory, cutting the number of socket syscalls or
+ * mbedtls record reads per packet.
+ *
+ * Writes, polls, connect, close and ctrl commands are forwarded to the inner
+ * transporter. The buffer is meant for a single reader and is not locked.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#include "tuya_error_code.h"
+#include "tal_api.h"
+#include "tuya_transporter.h"
+#include "buffered_transporter.h"
+
+typedef struct buffered_transporter_inter_t {
+    struct tuya_transporter_inter_t base;
+    tuya_transporter_t inner;
+    uint8_t *buf;
+    int size;
+    int head; // first unread byte
+    int tail; // end of buffered data
+    uint32_t read_cnt;
+    uint32_t inner_read_cnt;
+} * tuya_buffered_transporter_t;
+
+static void buffered_transporter_reset(tuya_buffered_transporter_t bt)
+{
+    bt->head = 0;
+    bt->tail = 0;
+}
+
+static OPERATE_RET buffered_transporter_connect(tuya_transporter_t t, const char *host, int port, int timeout_ms)
+{
+    tuya_buffered_transporter_t bt = (tuya_buffered_transporter_t)t;
+
+    buffered_transporter_reset(bt);
+    return tuya_transporter_connect(bt->inner, host, port, timeout_ms);
+}
+
+static OPERATE_RET buffered_transporter_close(tuya_transporter_t t)
+{
+    tuya_buffered_transporter_t bt = (tuya_buffered_transporter_t)t;
+
+    buffered_transporter_reset(bt);
+    return tuya_transporter_close(bt->inner);
+}
+
+/**
+ * @brief Reads data from the buffered transporter.
+ *
+ * Buffered bytes are returned first without touching the inner transporter.
+ * When the buffer is empty it is refilled by one inner read of up to the
+ * buffer size; reads not smaller than the buffer go to the inner transporter
+ * directly to avoid an extra copy.
+ *
+ * @param t The buffered transporter.
+ * @param buf The buffer to store the read data.
+ * @param len The maximum number of bytes to read.
+ * @param timeout_ms The timeout value in milliseconds for a refill.
+ * @return The number of bytes read on success, or a negative error code on
+ * failure.
+ */
+static OPERATE_RET buffered_transporter_read(tuya_transporter_t t, uint8_t *buf, int len, int timeout_ms)
+{
+    int ret = 0, avail = 0;
+    tuya_buffered_transporter_t bt = (tuya_buffered_transporter_t)t;
+
+    if ((NULL == buf) || (len <= 0)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    bt->read_cnt++;
+    avail = bt->tail - bt->head;
+    if (avail == 0) {
+        buffered_transporter_reset(bt);
+        bt->inner_read_cnt++;
+        if (len >= bt->size) {
+            return tuya_transporter_read(bt->inner, buf, len, timeout_ms);
+        }
+        ret = tuya_transporter_read(bt->inner, bt->buf, bt->size, timeout_ms);
+        if (ret <= 0) {
+            return ret;
+        }
+        bt->tail = ret;
+        avail = ret;
+    }
+
+    if (len > avail) {
+        len = avail;
+    }
+    memcpy(buf, bt->buf + bt->head, len);
+    bt->head += len;
+    return len;
+}
+
+static OPERATE_RET buffered_transporter_write(tuya_transporter_t t, uint8_t *buf, int len, int timeout_ms)
+{
+    tuya_buffered_transporter_t bt = (tuya_buffered_transporter_t)t;
+
+    return tuya_transporter_write(bt->inner, buf, len, timeout_ms);
+}
+
+static OPERATE_RET buffered_transporter_poll_read(tuya_transporter_t t, int timeout_ms)
+{
+    tuya_buffered_transporter_t bt = (tuya_buffered_transporter_t)t;
+
+    // data already buffered is readable without waiting on the socket
+    if (bt->tail > bt->head) {
+        return 1;
+    }
+    return tuya_transporter_poll_read(bt->inner, timeout_ms);
+}
+
+static OPERATE_RET buffered_transporter_poll_write(tuya_transporter_t t, int timeout_ms)
+{
+    tuya_buffered_transporter_t bt = (tuya_buffered_transporter_t)t;
+
+    return tuya_transporter_poll_write(bt->inner, timeout_ms);
+}
+
+static OPERATE_RET buffered_transporter_ctrl(tuya_transporter_t t, uint32_t cmd, void *args)
+{
+    tuya_buffered_transporter_t bt = (tuya_buffered_transporter_t)t;
+
+    return tuya_transporter_ctrl(bt->inner, cmd, args);
+}
+
+int tuya_buffered_transporter_peek(tuya_transporter_t t, uint8_t **data, int len, int timeout_ms)
+{
+    int ret = 0;
+    tuya_buffered_transporter_t bt = (tuya_buffered_transporter_t)t;
+
+    if ((NULL == bt) || (NULL == data) || (len <= 0) || (len > bt->size)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    bt->read_cnt++;
+    while ((bt->tail - bt->head) < len) {
+        // move the unread bytes to the front so the refill fits behind them
+        if (bt->head > 0) {
+            memmove(bt->buf, bt->buf + bt->head, bt->tail - bt->head);
+            bt->tail -= bt->head;
+            bt->head = 0;
+        }
+        bt->inner_read_cnt++;
+        ret = tuya_transporter_read(bt->inner, bt->buf + bt->tail, bt->size - bt->tail, timeout_ms);
+        if (ret <= 0) {
+            if ((ret == OPRT_RESOURCE_NOT_READY) && (bt->tail > bt->head)) {
+                break;
+            }
+            return ret;
+        }
+        bt->tail += ret;
+    }
+
+    *data = bt->buf + bt->head;
+    return bt->tail - bt->head;
+}
+
+OPERATE_RET tuya_buffered_transporter_consume(tuya_transporter_t t, int len)
+{
+    tuya_buffered_transporter_t bt = (tuya_buffered_transporter_t)t;
+
+    if ((NULL == bt) || (len < 0)) {
+        return OPRT_INVALID_PARM;
+    }
+
+    if (len > (bt->tail - bt->head)) {
+        len = bt->tail - bt->head;
+    }
+    bt->head += len;
+    if (bt->head == bt->tail) {
+        buffered_transporter_reset(bt);
+    }
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_buffered_transporter_get_stats(tuya_transporter_t t, uint32_t *read_cnt, uint32_t *inner_read_cnt)
+{
+    tuya_buffered_transporter_t bt = (tuya_buffered_transporter_t)t;
+
+    if (NULL == bt) {
+        return OPRT_INVALID_PARM;
+    }
+    if (read_cnt) {
+        *read_cnt = bt->read_cnt;
+    }
+    if (inner_read_cnt) {
+        *inner_read_cnt = bt->inner_read_cnt;
+    }
+    return OPRT_OK;
+}
+
+OPERATE_RET tuya_buffered_transporter_destroy(tuya_transporter_t transporter)
+{
+    tuya_buffered_transporter_t bt = (tuya_buffered_transporter_t)transporter;
+
+    if (bt) {
+        tuya_transporter_destroy(bt->inner);
+        tal_free(bt);
+    }
+    return OPRT_OK;
+}
+
+tuya_transporter_t tuya_buffered_transporter_create(tuya_transporter_t inner, int buf_size)
+{
+    if ((NULL == inner) || (buf_size <= 0)) {
+        PR_ERR("buffered transporter invalid param");
+        return NULL;
+    }
+
+    // the buffer lives right behind the transporter struct
+    tuya_buffered_transporter_t t = tal_malloc(sizeof(struct buffered_transporter_inter_t) + buf_size);
+    if (t == NULL) {
+        PR_ERR("buffered transporter malloc fail");
+        return NULL;
+    }
+    memset(t, 0, sizeof(struct buffered_transporter_inter_t));
+
+    t->inner = inner;
+    t->buf = (uint8_t *)(t + 1);
+    t->size = buf_size;
+
+    tuya_transporter_set_func((tuya_transporter_t)&t->base, buffered_transporter_connect, buffered_transporter_close,
+                              buffered_transporter_read, buffered_transporter_write, buffered_transporter_poll_read,
+                              buffered_transporter_poll_write, tuya_buffered_transporter_destroy,
+                              buffered_transporter_ctrl);
+
+    return &t->base;
+}
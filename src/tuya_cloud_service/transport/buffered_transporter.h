@@ -0,0 +1,89 @@
+/**
+ * @file buffered_transporter.h
+ * @brief Header file for the buffered read-ahead transporter.
+ *
+ * The buffered transporter decorates another transporter (tcp, tls or
+ * websocket) with a read-ahead buffer. Each refill reads as much as the buffer
+ * holds in one call of the underlying transporter, and the following small
+ * reads of a framed protocol (fixed head, length, payload) are served from
+ * memory instead of separate socket or TLS record reads.
+ *
+ * Besides the normal read interface, peek/consume allow a parser to look at
+ * buffered bytes in place before deciding how much to take.
+ *
+ * @copyright Copyright (c) 2021-2025 Tuya Inc. All Rights Reserved.
+ *
+ */
+
+#ifndef __BUFFERED_TRANSPORTER_H__
+#define __BUFFERED_TRANSPORTER_H__
+
+#include "tuya_transporter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef BUFFERED_TRANSPORTER_DEFAULT_SIZE
+#define BUFFERED_TRANSPORTER_DEFAULT_SIZE (1024)
+#endif
+
+/**
+ * @brief Creates a buffered transporter over another transporter.
+ *
+ * The buffered transporter takes ownership of the inner transporter, it is
+ * destroyed together with the buffered one.
+ *
+ * @param inner The transporter to read from and write to.
+ * @param buf_size The size of the read-ahead buffer in bytes.
+ * @return The created buffered transporter, or NULL on failure.
+ */
+tuya_transporter_t tuya_buffered_transporter_create(tuya_transporter_t inner, int buf_size);
+
+/**
+ * @brief Destroys a buffered transporter and its inner transporter.
+ *
+ * @param transporter The buffered transporter to destroy.
+ * @return The result of the operation.
+ */
+OPERATE_RET tuya_buffered_transporter_destroy(tuya_transporter_t transporter);
+
+/**
+ * @brief Makes at least len bytes available in the buffer without consuming
+ * them.
+ *
+ * @param transporter The buffered transporter.
+ * @param data Output pointer to the first buffered byte, valid until the next
+ * read, peek or consume.
+ * @param len The number of bytes wanted, must not exceed the buffer size.
+ * @param timeout_ms The timeout value in milliseconds for each refill.
+ * @return The number of buffered bytes (may be less than len when the inner
+ * read timed out), or a negative error code on failure.
+ */
+int tuya_buffered_transporter_peek(tuya_transporter_t transporter, uint8_t **data, int len, int timeout_ms);
+
+/**
+ * @brief Drops bytes from the head of the buffer, usually after a peek.
+ *
+ * @param transporter The buffered transporter.
+ * @param len The number of bytes to drop, clipped to the buffered length.
+ * @return The result of the operation.
+ */
+OPERATE_RET tuya_buffered_transporter_consume(tuya_transporter_t transporter, int len);
+
+/**
+ * @brief Gets the read call counters of a buffered transporter.
+ *
+ * @param transporter The buffered transporter.
+ * @param read_cnt Output, read and peek calls served by the buffered layer.
+ * @param inner_read_cnt Output, read calls issued to the inner transporter.
+ * @return The result of the operation.
+ */
+OPERATE_RET tuya_buffered_transporter_get_stats(tuya_transporter_t transporter, uint32_t *read_cnt,
+                                                uint32_t *inner_read_cnt);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
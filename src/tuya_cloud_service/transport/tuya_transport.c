@@ -26,6 +26,7 @@
 #include "tls_transporter.h"
 #include "tcp_transporter.h"
 #include "websocket_transporter.h"
+#include "buffered_transporter.h"
 #include "mix_method.h"
 
 #define MAX_TRANSPORTER_NUM (2)
@@ -145,6 +146,9 @@ tuya_transporter_t tuya_transporter_create(TUYA_TRANSPORT_TYPE_E transport_type,
         return tuya_websocket_transporter_create();
     }
 #endif
+    else if (transport_type == TRANSPORT_TYPE_BUFFERED) {
+        return tuya_buffered_transporter_create(dependency, BUFFERED_TRANSPORTER_DEFAULT_SIZE);
+    }
     return NULL;
 }
 
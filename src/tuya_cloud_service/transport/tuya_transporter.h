@@ -56,6 +56,7 @@ typedef uint8_t TUYA_TRANSPORT_TYPE_E;
 #define TRANSPORT_TYPE_TCP       (1) // tcp transporter
 #define TRANSPORT_TYPE_TLS       (2) // tls transporter
 #define TRANSPORT_TYPE_WEBSOCKET (3) // websocket transporter
+#define TRANSPORT_TYPE_BUFFERED  (4) // read-ahead buffer over the dependency transporter
 
 typedef struct socket_config_t tuya_tcp_config_t;
 
@@ -165,7 +166,9 @@ tuya_transporter_t tuya_transport_array_get_transporter(tuya_transport_array_han
  * type and dependency.
  *
  * @param transport_type The transport type of the Tuya transporter.
- * @param dependency The dependency of the Tuya transporter.
+ * @param dependency The dependency of the Tuya transporter, for
+ * TRANSPORT_TYPE_BUFFERED it is the wrapped transporter and is owned by the
+ * created one.
  * @return The created Tuya transporter.
  */
 tuya_transporter_t tuya_transporter_create(TUYA_TRANSPORT_TYPE_E transport_type, tuya_transporter_t dependency);
@@ -250,6 +253,15 @@ OPERATE_RET tuya_transporter_write(tuya_transporter_t transporter, uint8_t *buf,
  */
 OPERATE_RET tuya_transporter_poll_read(tuya_transporter_t transporter, int timeout_ms);
 
+/**
+ * @brief Polls the transporter until it is ready for writing.
+ *
+ * @param transporter The transporter to poll.
+ * @param timeout_ms The timeout period (in milliseconds) to wait.
+ * @return The result of the operation.
+ */
+OPERATE_RET tuya_transporter_poll_write(tuya_transporter_t transporter, int timeout_ms);
+
 /**
  * @brief Closes the specified transporter.
  *
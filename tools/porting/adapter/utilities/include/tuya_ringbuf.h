@@ -16,6 +16,12 @@ extern "C" {
 
 #include "tuya_cloud_types.h"
 
+/**
+ * One producer and one consumer may use a ringbuff at the same time without a
+ * lock, e.g. an ISR writing and a task reading. Several producers or several
+ * consumers still need a lock on their side, and reset/free must not race with
+ * either side.
+ */
 typedef void *TUYA_RINGBUFF_T;
 
 typedef enum {
@@ -97,6 +103,48 @@ uint32_t tuya_ring_buff_peek(TUYA_RINGBUFF_T ringbuff, void *data, uint32_t len)
  */
 uint32_t tuya_ring_buff_write(TUYA_RINGBUFF_T ringbuff, const void *data, uint32_t len);
 
+/**
+ * @brief ringbuff write reserve
+ * get the contiguous free area at the write position to fill in place,
+ * e.g. by DMA. the data becomes readable after tuya_ring_buff_write_commit
+ *
+ * @param[in]   ringbuff: ringbuff handle
+ * @param[out]  data:     point to the start of the free area
+ * @param[in]   len:      wanted len
+ * @return  length of the reserved area, may be less than len at the buff end
+ */
+uint32_t tuya_ring_buff_write_reserve(TUYA_RINGBUFF_T ringbuff, void **data, uint32_t len);
+
+/**
+ * @brief ringbuff write commit
+ * publish data filled into a reserved area
+ *
+ * @param[in]   ringbuff: ringbuff handle
+ * @param[in]   len:      filled len, not more than reserved
+ * @return  length of the data committed
+ */
+uint32_t tuya_ring_buff_write_commit(TUYA_RINGBUFF_T ringbuff, uint32_t len);
+
+/**
+ * @brief ringbuff contiguous data peek
+ * get the unread data up to the buff end in place, without copy
+ *
+ * @param[in]   ringbuff: ringbuff handle
+ * @param[out]  data:     point to the first unread byte
+ * @return  length of the contiguous data, call again after release for the wrapped part
+ */
+uint32_t tuya_ring_buff_peek_contiguous(TUYA_RINGBUFF_T ringbuff, void **data);
+
+/**
+ * @brief ringbuff release
+ * drop data from the read position, usually after tuya_ring_buff_peek_contiguous
+ *
+ * @param[in]   ringbuff: ringbuff handle
+ * @param[in]   len:      release len
+ * @return  length of the data released
+ */
+uint32_t tuya_ring_buff_release(TUYA_RINGBUFF_T ringbuff, uint32_t len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,6 +7,16 @@
 #define GET_MIN(x, y) ((x) < (y) ? (x) : (y))
 #define GET_MAX(x, y) ((x) > (y) ? (x) : (y))
 
+/*
+ * in is only stored by the producer and out only by the consumer. The side
+ * that owns an index publishes it with release order after touching the data,
+ * the other side loads it with acquire order before touching the data, so one
+ * producer and one consumer (task or ISR) need no lock between them.
+ */
+#define RINGBUFF_LOAD_ACQ(ptr)       __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define RINGBUFF_LOAD_RLX(ptr)       __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define RINGBUFF_STORE_REL(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
 /*
  * ringbuff structure
  */
@@ -27,6 +37,20 @@ static void __ringbuff_init(__RINGBUFF_T *ringbuff, uint32_t len)
     ringbuff->len = len;
 }
 
+static uint32_t __ringbuff_used(__RINGBUFF_T *ringbuff, uint32_t in, uint32_t out)
+{
+    return (in >= out) ? (in - out) : (ringbuff->len - (out - in));
+}
+
+static uint32_t __ringbuff_advance(__RINGBUFF_T *ringbuff, uint32_t pos, uint32_t len)
+{
+    pos += len;
+    if (pos >= ringbuff->len) {
+        pos -= ringbuff->len;
+    }
+    return pos;
+}
+
 OPERATE_RET tuya_ring_buff_create(uint32_t len, RINGBUFF_TYPE_E type, TUYA_RINGBUFF_T *ringbuff)
 {
     __RINGBUFF_T *rbuff = NULL;
@@ -77,50 +101,31 @@ OPERATE_RET tuya_ring_buff_reset(TUYA_RINGBUFF_T ringbuff)
 
 uint32_t tuya_ring_buff_free_size_get(TUYA_RINGBUFF_T ringbuff)
 {
-    uint32_t size, in, out;
     __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
 
     if (rbuff == NULL) {
         return 0;
     }
 
-    in = rbuff->in;
-    out = rbuff->out;
-    if (in == out) {
-        size = rbuff->len;
-    } else if (out > in) {
-        size = out - in;
-    } else {
-        size = rbuff->len - (in - out);
-    }
-
-    return size - 1;
+    // one byte stays unused so that a full buff is not taken for an empty one
+    return rbuff->len - 1 -
+           __ringbuff_used(rbuff, RINGBUFF_LOAD_ACQ(&rbuff->in), RINGBUFF_LOAD_ACQ(&rbuff->out));
 }
 
 uint32_t tuya_ring_buff_used_size_get(TUYA_RINGBUFF_T ringbuff)
 {
-    uint32_t size, in, out;
     __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
 
     if (rbuff == NULL) {
         return 0;
     }
 
-    in = rbuff->in;
-    out = rbuff->out;
-    if (in == out) {
-        size = 0;
-    } else if (in > out) {
-        size = in - out;
-    } else {
-        size = rbuff->len - (out - in);
-    }
-
-    return size;
+    return __ringbuff_used(rbuff, RINGBUFF_LOAD_ACQ(&rbuff->in), RINGBUFF_LOAD_ACQ(&rbuff->out));
 }
 
 uint32_t tuya_ring_buff_write(TUYA_RINGBUFF_T ringbuff, const void *data, uint32_t len)
 {
+    uint32_t in, out;
     uint32_t tmp_len;
     uint32_t free_len;
     const uint8_t *pdata = data;
@@ -129,35 +134,51 @@ uint32_t tuya_ring_buff_write(TUYA_RINGBUFF_T ringbuff, const void *data, uint32
     if (rbuff == NULL || data == NULL || len == 0) {
         return 0;
     }
+
+    in = RINGBUFF_LOAD_RLX(&rbuff->in);
+    out = RINGBUFF_LOAD_ACQ(&rbuff->out);
+
     // overwriting unread parts is not supported when the write is full
-    free_len = tuya_ring_buff_free_size_get(rbuff);
+    free_len = rbuff->len - 1 - __ringbuff_used(rbuff, in, out);
     len = GET_MIN(free_len, len);
     if (len == 0) {
         return 0;
     }
 
     // write data to remaining buff
-    tmp_len = GET_MIN(rbuff->len - rbuff->in, len);
-    memcpy(&rbuff->buff[rbuff->in], pdata, tmp_len);
-    rbuff->in += tmp_len;
-    len -= tmp_len;
+    tmp_len = GET_MIN(rbuff->len - in, len);
+    memcpy(&rbuff->buff[in], pdata, tmp_len);
 
     // write remaining data to beginning of buffer
-    if (len > 0) {
-        memcpy(rbuff->buff, &pdata[tmp_len], len);
-        rbuff->in = len;
+    if (len > tmp_len) {
+        memcpy(rbuff->buff, &pdata[tmp_len], len - tmp_len);
     }
 
-    // buff loopback check
-    if (rbuff->in >= rbuff->len) {
-        rbuff->in = 0;
-    }
+    RINGBUFF_STORE_REL(&rbuff->in, __ringbuff_advance(rbuff, in, len));
 
-    return tmp_len + len;
+    return len;
 }
 
 uint32_t tuya_ring_buff_read(TUYA_RINGBUFF_T ringbuff, void *data, uint32_t len)
 {
+    uint32_t out;
+
+    if (ringbuff == NULL || data == NULL || len == 0) {
+        return 0;
+    }
+
+    out = RINGBUFF_LOAD_RLX(&((__RINGBUFF_T *)ringbuff)->out);
+    len = tuya_ring_buff_peek(ringbuff, data, len);
+    if (len > 0) {
+        RINGBUFF_STORE_REL(&((__RINGBUFF_T *)ringbuff)->out, __ringbuff_advance(ringbuff, out, len));
+    }
+
+    return len;
+}
+
+uint32_t tuya_ring_buff_peek(TUYA_RINGBUFF_T ringbuff, void *data, uint32_t len)
+{
+    uint32_t in, out;
     uint32_t tmp_len;
     uint32_t used_len;
     uint8_t *pdata = data;
@@ -167,59 +188,98 @@ uint32_t tuya_ring_buff_read(TUYA_RINGBUFF_T ringbuff, void *data, uint32_t len)
         return 0;
     }
 
-    used_len = tuya_ring_buff_used_size_get(rbuff);
-    len = GET_MIN(used_len, len);
+    in = RINGBUFF_LOAD_ACQ(&rbuff->in);
+    out = RINGBUFF_LOAD_RLX(&rbuff->out);
+    used_len = __ringbuff_used(rbuff, in, out);
+
+    len = GET_MIN(len, used_len);
     if (len == 0) {
         return 0;
     }
 
     // read data from linear part of buffer
-    tmp_len = GET_MIN(rbuff->len - rbuff->out, len);
-    memcpy(pdata, &rbuff->buff[rbuff->out], tmp_len);
-    rbuff->out += tmp_len;
-    len -= tmp_len;
+    tmp_len = GET_MIN(rbuff->len - out, len);
+    memcpy(pdata, &rbuff->buff[out], tmp_len);
 
     // read data from beginning of buffer (overflow part)
-    if (len > 0) {
-        memcpy(&pdata[tmp_len], rbuff->buff, len);
-        rbuff->out = len;
+    if (len > tmp_len) {
+        memcpy(&pdata[tmp_len], rbuff->buff, len - tmp_len);
     }
 
-    // check end of buffer
-    if (rbuff->out >= rbuff->len) {
-        rbuff->out = 0;
+    return len;
+}
+
+uint32_t tuya_ring_buff_write_reserve(TUYA_RINGBUFF_T ringbuff, void **data, uint32_t len)
+{
+    uint32_t in, out;
+    uint32_t free_len;
+    __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
+
+    if (rbuff == NULL || data == NULL || len == 0) {
+        return 0;
     }
 
-    return tmp_len + len;
+    in = RINGBUFF_LOAD_RLX(&rbuff->in);
+    out = RINGBUFF_LOAD_ACQ(&rbuff->out);
+
+    free_len = rbuff->len - 1 - __ringbuff_used(rbuff, in, out);
+    len = GET_MIN(len, GET_MIN(free_len, rbuff->len - in));
+
+    *data = &rbuff->buff[in];
+    return len;
 }
 
-uint32_t tuya_ring_buff_peek(TUYA_RINGBUFF_T ringbuff, void *data, uint32_t len)
+uint32_t tuya_ring_buff_write_commit(TUYA_RINGBUFF_T ringbuff, uint32_t len)
 {
-    uint32_t out;
-    uint32_t tmp_len;
-    uint32_t used_len;
-    uint8_t *pdata = data;
+    uint32_t in, out;
+    uint32_t free_len;
     __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
 
-    if (rbuff == NULL || data == NULL || len == 0) {
+    if (rbuff == NULL || len == 0) {
         return 0;
     }
 
-    out = rbuff->out;
-    used_len = tuya_ring_buff_used_size_get(rbuff);
+    in = RINGBUFF_LOAD_RLX(&rbuff->in);
+    out = RINGBUFF_LOAD_ACQ(&rbuff->out);
 
-    len = GET_MIN(len, used_len);
-    if (len == 0) {
+    free_len = rbuff->len - 1 - __ringbuff_used(rbuff, in, out);
+    len = GET_MIN(len, GET_MIN(free_len, rbuff->len - in));
+
+    RINGBUFF_STORE_REL(&rbuff->in, __ringbuff_advance(rbuff, in, len));
+
+    return len;
+}
+
+uint32_t tuya_ring_buff_peek_contiguous(TUYA_RINGBUFF_T ringbuff, void **data)
+{
+    uint32_t in, out;
+    __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
+
+    if (rbuff == NULL || data == NULL) {
         return 0;
     }
 
-    tmp_len = GET_MIN(rbuff->len - out, len);
-    memcpy(pdata, &rbuff->buff[out], tmp_len);
-    len -= tmp_len;
+    in = RINGBUFF_LOAD_ACQ(&rbuff->in);
+    out = RINGBUFF_LOAD_RLX(&rbuff->out);
 
-    if (len > 0) {
-        memcpy(&pdata[tmp_len], rbuff->buff, len);
+    *data = &rbuff->buff[out];
+    return GET_MIN(__ringbuff_used(rbuff, in, out), rbuff->len - out);
+}
+
+uint32_t tuya_ring_buff_release(TUYA_RINGBUFF_T ringbuff, uint32_t len)
+{
+    uint32_t in, out;
+    __RINGBUFF_T *rbuff = (__RINGBUFF_T *)ringbuff;
+
+    if (rbuff == NULL || len == 0) {
+        return 0;
     }
 
-    return tmp_len + len;
+    in = RINGBUFF_LOAD_ACQ(&rbuff->in);
+    out = RINGBUFF_LOAD_RLX(&rbuff->out);
+
+    len = GET_MIN(len, __ringbuff_used(rbuff, in, out));
+    RINGBUFF_STORE_REL(&rbuff->out, __ringbuff_advance(rbuff, out, len));
+
+    return len;
 }